@@ -20,6 +20,7 @@
  */
 
 #include "bluetooth.h"
+#include "perm5.h"
 
 bdaddr target;
 u64 syncword;
@@ -34,6 +35,18 @@ u16 d1;
 u8 bank[NUM_BREDR_CHANNELS];
 u8 afh_bank[NUM_BREDR_CHANNELS];
 
+/* precomputed hop sequence, one entry per master/slave slot pair
+ * indexed by CLK[5:1] and tagged with the slot's even clock */
+#define HOP_TABLE_SIZE 32
+#define HOP_TABLE_INVALID 1 // odd, never matches a tag
+typedef struct {
+	u32 clk;
+	u8 channel;
+} hop_entry;
+static hop_entry hop_table[HOP_TABLE_SIZE];
+static u32 hop_table_next; // next clock to precompute
+static u8 hop_table_stale = 1;
+
 /* count the number of 1 bits in a uint64_t */
 static uint8_t count_bits(uint64_t n)
 {
@@ -46,7 +59,7 @@ static uint8_t count_bits(uint64_t n)
 /* do all of the one time precalculation */
 void precalc(void)
 {
-	u8 i, j, chan;
+	u8 i;
 	u32 address;
 	address = target.address & 0xffffffff;
 	syncword = 0;
@@ -74,6 +87,14 @@ void precalc(void)
 		((address >> 2) & 0x02) +
 		((address >> 1) & 0x01);
 
+	precalc_afh();
+}
+
+/* AFH part of the precalculation, to be redone when the map changes */
+void precalc_afh(void)
+{
+	u8 i, j, chan;
+
 	if(afh_enabled) {
 		used_channels = 0;
 		for(i = 0; i < 10; i++)
@@ -82,53 +103,14 @@ void precalc(void)
 		for (i = 0; i < NUM_BREDR_CHANNELS; i++) {
 			chan = (i * 2) % NUM_BREDR_CHANNELS;
 			if(afh_map[chan/8] & (0x1 << (chan % 8)))
-				bank[j++] = chan;
-		}
-	}
-}
-
-/* 5 bit permutation */
-static u8 perm5(u8 z, u8 p_high, u16 p_low)
-{
-	/* z is constrained to 5 bits, p_high to 5 bits, p_low to 9 bits */
-	z &= 0x1f;
-	p_high &= 0x1f;
-	p_low &= 0x1ff;
-
-	int i;
-	u8 tmp, output, z_bit[5], p[14];
-	static const u8 index1[] = {0, 2, 1, 3, 0, 1, 0, 3, 1, 0, 2, 1, 0, 1};
-	static const u8 index2[] = {1, 3, 2, 4, 4, 3, 2, 4, 4, 3, 4, 3, 3, 2};
-
-	/* bits of p_low and p_high are control signals */
-	for (i = 0; i < 9; i++)
-		p[i] = (p_low >> i) & 0x01;
-	for (i = 0; i < 5; i++)
-		p[i+9] = (p_high >> i) & 0x01;
-
-	/* bit swapping will be easier with an array of bits */
-	for (i = 0; i < 5; i++)
-		z_bit[i] = (z >> i) & 0x01;
-
-	/* butterfly operations */
-	for (i = 13; i >= 0; i--) {
-		/* swap bits according to index arrays if control signal tells us to */
-		if (p[i]) {
-			tmp = z_bit[index1[i]];
-			z_bit[index1[i]] = z_bit[index2[i]];
-			z_bit[index2[i]] = tmp;
+				afh_bank[j++] = chan;
 		}
 	}
 
-	/* reconstruct output from rearranged bits */
-	output = 0;
-	for (i = 0; i < 5; i++)
-		output += z_bit[i] << i;
-
-	return output;
+	hop_table_invalidate();
 }
 
-u16 next_hop(u32 clock)
+static u8 hop_selection(u32 clock)
 {
 	u8 a, c, x, y1, perm, next_channel;
 	u16 d, y2;
@@ -153,12 +135,56 @@ u16 next_hop(u32 clock)
 		d);
 	/* hop selection */
 	next_channel = bank[(perm + e + f + y2) % NUM_BREDR_CHANNELS];
-	if(afh_enabled) {
+	if(afh_enabled && used_channels) {
 		f_dash = base_f % used_channels;
 		next_channel = afh_bank[(perm + e + f_dash + y2) % used_channels];
 	}
-	return (2402 + next_channel);
+	return next_channel;
+}
 
+/* drop all precomputed hops, e.g. after the address or AFH map changed */
+void hop_table_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < HOP_TABLE_SIZE; i++)
+		hop_table[i].clk = HOP_TABLE_INVALID;
+	hop_table_stale = 1;
+}
+
+/* Precompute the hop sequence for the next HOP_TABLE_SIZE slot pairs.
+ * Called from the main loop so that next_hop() only costs a lookup on the
+ * timer-driven hop path. */
+void hop_table_fill(u32 clock)
+{
+	hop_entry *entry;
+
+	clock &= ~1;
+
+	/* start over if the clock jumped or we fell behind */
+	if (hop_table_stale
+			|| (int32_t)(hop_table_next - clock) < 0
+			|| (int32_t)(hop_table_next - clock) > 2 * HOP_TABLE_SIZE) {
+		hop_table_next = clock;
+		hop_table_stale = 0;
+	}
+
+	while ((int32_t)(hop_table_next - clock) < 2 * HOP_TABLE_SIZE) {
+		entry = &hop_table[(hop_table_next >> 1) % HOP_TABLE_SIZE];
+		entry->channel = hop_selection(hop_table_next);
+		entry->clk = hop_table_next;
+		hop_table_next += 2;
+	}
+}
+
+u16 next_hop(u32 clock)
+{
+	hop_entry *entry = &hop_table[(clock >> 1) % HOP_TABLE_SIZE];
+
+	if (entry->clk == (clock & ~1))
+		return (2402 + entry->channel);
+
+	return (2402 + hop_selection(clock));
 }
 
 int find_access_code(u8 *idle_rxbuf)
@@ -184,12 +210,13 @@ int find_access_code(u8 *idle_rxbuf)
 		if (bit_errors < MAX_SYNCWORD_ERRS)
 			return count;
 
-		if (count%8 == 0)
-			curr_buf = idle_rxbuf[++i];
-
 		syncword <<= 1;
 		syncword = (syncword & 0xfffffffffffffffe) | ((curr_buf & 0x80) >> 7);
 		curr_buf <<= 1;
+
+		/* next byte once all 8 bits of this one are shifted in */
+		if ((count+1)%8 == 0)
+			curr_buf = idle_rxbuf[++i];
 	}
 	return -1;
 }
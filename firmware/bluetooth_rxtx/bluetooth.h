@@ -56,6 +56,9 @@ static const u8 ao_barker_correct[] = {
 */
 
 void precalc();
+void precalc_afh();
+void hop_table_invalidate(void);
+void hop_table_fill(u32 clkn);
 u16 next_hop(u32 clkn);
 int find_access_code(u8 *idle_rxbuf);
 
@@ -184,21 +184,28 @@ u32 btle_crcgen_lut(u32 crc_init, u8 *data, int len) {
 /*
  * Dewhiten and reverse the bit order of a buffer in place.
  * Channel is a physical channel in the range [2402, 2480]
- * TODO convert this to use whitening word
  */
 void le_dewhiten(uint8_t *data, unsigned size, unsigned channel) {
-	unsigned i, j, bit;
+	unsigned i;
 	unsigned idx = whitening_index[btle_channel_index(channel)];
+	uint32_t v;
+
+	// a word at a time: REV then RBIT reverses the bits within each byte
+	// while keeping the byte order, then XOR the next 32 whitening bits
+	for (i = 0; i + 4 <= size; i += 4) {
+		__builtin_memcpy(&v, data + i, 4);
+		v = rbit(__builtin_bswap32(v)) ^ whitening_seq[idx];
+		__builtin_memcpy(data + i, &v, 4);
+		idx += 32;
+		if (idx >= sizeof(whitening))
+			idx -= sizeof(whitening);
+	}
 
-	for (i = 0; i < size; ++i) {
-		uint8_t out = 0;
-		for (j = 0; j < 8; ++j) {
-			bit = (data[i] >> (7-j)) & 1;
-			bit ^= whitening[idx];
-			idx = (idx + 1) % sizeof(whitening);
-			out |= bit << j;
-		}
-		data[i] = out;
+	for (; i < size; ++i) {
+		data[i] = (rbit(data[i]) >> 24) ^ (whitening_seq[idx] & 0xff);
+		idx += 8;
+		if (idx >= sizeof(whitening))
+			idx -= sizeof(whitening);
 	}
 }
 
@@ -83,6 +83,33 @@ static const u8 whitening[] = {
     1, 1, 1, 0, 1, 1, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1
 };
 
+// whitening sequence as words: whitening_seq[i] holds the 32 whitening
+// bits starting at bit i of whitening[], first bit in the LSB
+static const u32 whitening_seq[127] = {
+	0x4e7b42af, 0xa73da157, 0x539ed0ab, 0xa9cf6855, 0xd4e7b42a, 0x6a73da15,
+	0x3539ed0a, 0x9a9cf685, 0xcd4e7b42, 0x66a73da1, 0x33539ed0, 0x19a9cf68,
+	0x0cd4e7b4, 0x066a73da, 0x833539ed, 0xc19a9cf6, 0x60cd4e7b, 0xb066a73d,
+	0xd833539e, 0x6c19a9cf, 0xb60cd4e7, 0x5b066a73, 0xad833539, 0xd6c19a9c,
+	0xeb60cd4e, 0x75b066a7, 0xbad83353, 0x5d6c19a9, 0x2eb60cd4, 0x175b066a,
+	0x8bad8335, 0xc5d6c19a, 0x62eb60cd, 0x3175b066, 0x98bad833, 0x4c5d6c19,
+	0x262eb60c, 0x13175b06, 0x898bad83, 0x44c5d6c1, 0x2262eb60, 0x113175b0,
+	0x0898bad8, 0x044c5d6c, 0x02262eb6, 0x8113175b, 0x40898bad, 0x2044c5d6,
+	0x902262eb, 0x48113175, 0x240898ba, 0x92044c5d, 0xc902262e, 0x64811317,
+	0xb240898b, 0x592044c5, 0x2c902262, 0x96481131, 0xcb240898, 0xe592044c,
+	0xf2c90226, 0x79648113, 0xbcb24089, 0xde592044, 0xef2c9022, 0x77964811,
+	0x3bcb2408, 0x1de59204, 0x0ef2c902, 0x87796481, 0xc3bcb240, 0xe1de5920,
+	0xf0ef2c90, 0xf8779648, 0xfc3bcb24, 0xfe1de592, 0x7f0ef2c9, 0x3f877964,
+	0x1fc3bcb2, 0x8fe1de59, 0xc7f0ef2c, 0xe3f87796, 0x71fc3bcb, 0xb8fe1de5,
+	0xdc7f0ef2, 0x6e3f8779, 0x371fc3bc, 0x1b8fe1de, 0x8dc7f0ef, 0x46e3f877,
+	0xa371fc3b, 0x51b8fe1d, 0x28dc7f0e, 0x946e3f87, 0x4a371fc3, 0xa51b8fe1,
+	0xd28dc7f0, 0xe946e3f8, 0xf4a371fc, 0xfa51b8fe, 0x7d28dc7f, 0xbe946e3f,
+	0x5f4a371f, 0xafa51b8f, 0x57d28dc7, 0xabe946e3, 0x55f4a371, 0x2afa51b8,
+	0x157d28dc, 0x0abe946e, 0x855f4a37, 0x42afa51b, 0xa157d28d, 0xd0abe946,
+	0x6855f4a3, 0xb42afa51, 0xda157d28, 0xed0abe94, 0xf6855f4a, 0x7b42afa5,
+	0x3da157d2, 0x9ed0abe9, 0xcf6855f4, 0xe7b42afa, 0x73da157d, 0x39ed0abe,
+	0x9cf6855f,
+};
+
 static const u8 whitening_index[] = {
     70, 62, 120, 111, 77, 46, 15, 101, 66, 39, 31, 26, 80,
     83, 125, 89, 10, 35, 8, 54, 122, 17, 33, 0, 58, 115, 6,
@@ -29,12 +29,15 @@
 #include "ubertooth_cs.h"
 #include "ubertooth_dma.h"
 #include "ubertooth_clock.h"
+#include "ubertooth_sched.h"
 #include "bluetooth.h"
 #include "bluetooth_le.h"
 #include "cc2400_rangetest.h"
 #include "ego.h"
 #include "debug_uart.h"
 #include "xmas.h"
+#include "sync_rx.h"
+#include "ubertooth_trace.h"
 
 #define MIN(x,y)	((x)<(y)?(x):(y))
 #define MAX(x,y)	((x)>(y)?(x):(y))
@@ -72,6 +75,13 @@ volatile uint8_t modulation = MOD_BT_BASIC_RATE;
 volatile uint16_t low_freq = 2400;
 volatile uint16_t high_freq = 2483;
 volatile int8_t rssi_threshold = -30;  // -54dBm - 30 = -84dBm
+#define SPECAN_DWELL_DEFAULT SCHED_USEC(25)
+#define SPECAN_LOCK_POLL     SCHED_USEC(3)
+#define SPECAN_CONFIG_DEFAULT { .step = 1, .samples = 1, \
+                                .reduce = SPECAN_REDUCE_MAX, \
+                                .dwell = SPECAN_DWELL_DEFAULT }
+specan_config specan_cfg = SPECAN_CONFIG_DEFAULT;
+uint8_t specan_packed = 0;             // send SPECAN_FRAME instead of triplets
 
 /* Generic TX stuff */
 generic_tx_packet tx_pkt;
@@ -101,16 +111,25 @@ typedef struct _le_promisc_active_aa_t {
 	int count;
 } le_promisc_active_aa_t;
 
+/* AA candidate table: open addressed on a multiplicative hash of the AA,
+ * probing AA_PROBE_LEN slots. An empty slot has a count of zero. */
+#define AA_HASH_BITS 6
+#define AA_HASH_SIZE (1 << AA_HASH_BITS)
+#define AA_PROBE_LEN 4
+
 typedef struct _le_promisc_state_t {
 	// LFU cache of recently seen AA's
-	le_promisc_active_aa_t active_aa[32];
+	le_promisc_active_aa_t active_aa[AA_HASH_SIZE];
 
 	// recovering hop interval
 	u32 smallest_hop_interval;
 	int consec_intervals;
 } le_promisc_state_t;
 le_promisc_state_t le_promisc;
-#define AA_LIST_SIZE (int)(sizeof(le_promisc.active_aa) / sizeof(le_promisc_active_aa_t))
+
+/* PROMISC_RECOVER_HOST: scan until the host has sent the parameters */
+static u8 le_promisc_host = 0;
+static volatile u8 le_promisc_params_ready = 0;
 
 /* LE jamming */
 #define JAM_COUNT_DEFAULT 40
@@ -156,6 +175,7 @@ static int enqueue(uint8_t type, uint8_t* buf)
 
 	f->status = status;
 	status = 0;
+	usb_enqueue_commit();
 
 	return 1;
 }
@@ -183,10 +203,35 @@ int enqueue_with_ts(uint8_t type, uint8_t* buf, uint32_t ts)
 
 	f->status = status;
 	status = 0;
+	usb_enqueue_commit();
 
 	return 1;
 }
 
+int le_phy_conn_stats(le_conn_stats *stats);
+void le_phy_adv_stats(le_adv_stats *stats);
+
+/* Fill a page of squelch statistics starting at channel slot first.
+ * Returns the number of entries. */
+static int squelch_stats_get(squelch_stats *stats, unsigned first)
+{
+	int n = 0;
+	unsigned i;
+	int8_t floor;
+
+	for (i = first; i < SQUELCH_CHANNELS && n < SQUELCH_STATS_MAX; i++, n++) {
+		floor = rssi_get_floor(i == SQUELCH_CHANNELS - 1 ? 0 : 2402 + i);
+		stats[n].noise_floor = (floor == INT8_MIN) ? INT8_MIN : floor - 54;
+		stats[n].open = rssi_squelch_state[i].open;
+		stats[n].reserved[0] = 0;
+		stats[n].reserved[1] = 0;
+		stats[n].passed = rssi_squelch_state[i].passed;
+		stats[n].dropped = rssi_squelch_state[i].dropped;
+	}
+
+	return n;
+}
+
 static int vendor_request_handler(uint8_t request, uint16_t* request_params, uint8_t* data, int* data_len)
 {
 	uint32_t clock;
@@ -194,6 +239,8 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 	usb_pkt_rx* p = NULL;
 	uint16_t reg_val;
 	uint8_t i;
+	specan_config cfg;
+	le_conn_params conn_params;
 	unsigned data_in_len = request_params[2];
 
 	switch (request) {
@@ -375,6 +422,10 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 			channel = requested_channel;
 			requested_channel = 0;
 
+			/* a running promiscuous scan retunes on the next block */
+			if (mode == MODE_BT_PROMISC_LE)
+				do_hop = 1;
+
 			/* CS threshold is mode-dependent. Update it after
 			 * possible mode change. TODO - kludgy. */
 			cs_threshold_calc_and_set(channel);
@@ -402,6 +453,19 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 		*data_len = 0;
 		break;
 
+	case UBERTOOTH_SPECAN_CONFIG:
+		if (data_in_len < sizeof(specan_config))
+			return 0;
+		memcpy(&cfg, data, sizeof(specan_config));
+		if (cfg.step == 0 || cfg.samples == 0 ||
+				cfg.samples > SPECAN_MAX_SAMPLES ||
+				cfg.reduce > SPECAN_REDUCE_AVG)
+			return 0;
+		specan_cfg = cfg;
+		specan_packed = 1;
+		*data_len = 0;
+		break;
+
 	case UBERTOOTH_RX_GENERIC:
 		requested_mode = MODE_RX_GENERIC;
 		*data_len = 0;
@@ -441,6 +505,7 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 
 	case UBERTOOTH_SET_SQUELCH:
 		cs_threshold_req = (int8_t)request_params[0];
+		rssi_squelch_reset();
 		cs_threshold_calc_and_set(channel);
 		break;
 
@@ -449,6 +514,26 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 		*data_len = 1;
 		break;
 
+	case UBERTOOTH_SET_SQUELCH_HYST:
+		cs_hysteresis = MIN(request_params[0], 40);
+		break;
+
+	case UBERTOOTH_TRACE:
+		if (request_params[0])
+			trace_start();
+		else
+			trace_stop();
+		break;
+
+	case UBERTOOTH_TRACE_READ:
+		*data_len = trace_read((trace_page *)data);
+		break;
+
+	case UBERTOOTH_GET_SQUELCH_STATS:
+		*data_len = squelch_stats_get((squelch_stats *)data, request_params[1]) *
+				sizeof(squelch_stats);
+		break;
+
 	case UBERTOOTH_SET_BDADDR:
 		target.address = 0;
 		target.syncword = 0;
@@ -500,6 +585,7 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 			afh_map[i] = data[i];
 		}
 		afh_enabled = 1;
+		precalc_afh();
 		*data_len = 10;
 		break;
 
@@ -508,6 +594,7 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 			afh_map[i] = 0;
 		}
 		afh_enabled = 0;
+		precalc_afh();
 		*data_len = 10;
 		break;
 
@@ -552,7 +639,7 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 		hop_mode = HOP_BTLE;
 		requested_mode = MODE_BT_FOLLOW_LE;
 
-		usb_queue_init();
+		// the queue is reset on mode entry, not here in the interrupt
 		cs_threshold_calc_and_set(channel);
 		break;
 
@@ -603,13 +690,29 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 	case UBERTOOTH_BTLE_PROMISC:
 		*data_len = 0;
 
+		le_promisc_host = request_params[0] == PROMISC_RECOVER_HOST;
+		le_promisc_params_ready = 0;
 		hop_mode = HOP_NONE;
 		requested_mode = MODE_BT_PROMISC_LE;
 
-		usb_queue_init();
 		cs_threshold_calc_and_set(channel);
 		break;
 
+	case UBERTOOTH_BTLE_SET_CONN_PARAMS:
+		if (data_in_len < sizeof(le_conn_params))
+			return 0;
+		memcpy(&conn_params, data, sizeof(conn_params));
+		if (conn_params.conn_interval < 6 || conn_params.conn_interval > 3200
+				|| conn_params.hop_increment < 5
+				|| conn_params.hop_increment > 16)
+			return 0;
+		le.crc_init = conn_params.crc_init & 0xffffff;
+		le.crc_init_reversed = rbit(le.crc_init) >> 8;
+		le.conn_interval = conn_params.conn_interval;
+		le.channel_increment = conn_params.hop_increment;
+		le_promisc_params_ready = 1;
+		break;
+
 	case UBERTOOTH_READ_REGISTER:
 		reg_val = cc2400_get(request_params[0]);
 		data[0] = (reg_val >> 8) & 0xff;
@@ -703,10 +806,20 @@ static int vendor_request_handler(uint8_t request, uint16_t* request_params, uin
 		break;
 
 	case UBERTOOTH_CANCEL_FOLLOW:
-		// cancel following an active connection
+		// cancel following active connections
 		cancel_follow = 1;
 		break;
 
+	case UBERTOOTH_LE_CONN_STATS:
+		*data_len = le_phy_conn_stats((le_conn_stats *)data) *
+				sizeof(le_conn_stats);
+		break;
+
+	case UBERTOOTH_LE_ADV_STATS:
+		le_phy_adv_stats((le_adv_stats *)data);
+		*data_len = sizeof(le_adv_stats);
+		break;
+
 #ifdef TX_ENABLE
 	case UBERTOOTH_JAM_MODE:
 		jam_mode = request_params[0];
@@ -812,6 +925,12 @@ void TIMER0_IRQHandler()
 #ifndef TC13BADGE
 void EINT3_IRQHandler()
 {
+	/* GIO6 reports sync words instead of carrier sense while capturing */
+	if (sync_rx_active) {
+		sync_rx_sync_irq();
+		return;
+	}
+
 	/* TODO - check specific source of shared interrupt */
 	IO2IntClr   = PIN_GIO6; // clear interrupt
 	DIO_SSEL_CLR;           // enable SPI
@@ -823,21 +942,23 @@ void EINT3_IRQHandler()
 #endif // TC13BADGE
 
 /*
- * Sleep (busy wait) for 'millis' milliseconds
- * Needs clkn. Be sure to call clkn_init() before using it.
+ * Sleep for 'millis' milliseconds. The core waits in WFI on a TIMER3 match,
+ * so interrupt driven work carries on meanwhile.
  */
 static void msleep(uint32_t millis)
 {
-	uint32_t now = (clkn & 0xffffff);
-	uint32_t stop_at = now + millis * 10000 / 3125; // millis -> clkn ticks
+	sched_delay(SCHED_MSEC(millis));
+}
 
-	// handle clkn overflow
-	if (stop_at >= ((uint32_t)1<<28)) {
-		stop_at -= ((uint32_t)1<<28);
-		while ((clkn & 0xffffff) >= now || (clkn & 0xffffff) < stop_at);
-	} else {
-		while ((clkn & 0xffffff) < stop_at);
-	}
+/* Wake the USB interrupt now and then so an idle link gets keep-alives. */
+#define USB_SERVICE_INTERVAL SCHED_MSEC(100)
+
+static void usb_service(void *arg)
+{
+	(void)arg;
+	usb_kick();
+	if (sched_in(USB_SERVICE_INTERVAL, usb_service, NULL) < 0)
+		debug_printf("usb_service: event queue full, keep-alives stopped\n");
 }
 
 void legacy_DMA_IRQHandler();
@@ -845,6 +966,8 @@ void le_DMA_IRQHandler();
 void DMA_IRQHandler(void) {
 	if (mode == MODE_BT_FOLLOW_LE)
 		le_DMA_IRQHandler();
+	else if (sync_rx_active)
+		sync_rx_DMA_IRQHandler();
 	else
 		legacy_DMA_IRQHandler();
 
@@ -886,6 +1009,7 @@ void legacy_DMA_IRQHandler()
 				idle_buf_clk100ns  = CLK100NS;
 				idle_buf_clkn_high = (clkn >> 20) & 0xff;
 				idle_buf_channel   = channel;
+				TRACE(TRACE_DMA_TC, DMA_SIZE, channel);
 
 				/* Keep buffer swapping in sync with DMA. */
 				volatile uint8_t* tmp = active_rxbuf;
@@ -950,6 +1074,8 @@ static void cc2400_idle()
 	low_freq = 2400;
 	high_freq = 2483;
 	rssi_threshold = -30;
+	specan_cfg = (specan_config)SPECAN_CONFIG_DEFAULT;
+	specan_packed = 0;
 
 	target.address = 0;
 	target.syncword = 0;
@@ -1298,6 +1424,8 @@ void hop(void)
 	else if (hop_mode == HOP_DIRECT) {
 		channel = hop_direct_channel;
 	}
+	TRACE(TRACE_HOP, channel, clkn);
+
 	/* IDLE mode, but leave amp on, so don't call cc2400_idle(). */
 	cc2400_strobe(SRFOFF);
 	while ((cc2400_status() & FS_LOCK)); // need to wait for unlock?
@@ -1326,6 +1454,8 @@ void hop(void)
 	} else {
 		cc2400_strobe(SRX);
 	}
+
+	TRACE(TRACE_HOP_DONE, channel, clkn);
 }
 
 /* Bluetooth packet monitoring */
@@ -1333,6 +1463,7 @@ void bt_stream_rx()
 {
 	int8_t rssi;
 	int8_t rssi_at_trigger;
+	u8 hold = 0;
 
 	RXLED_CLR;
 
@@ -1370,13 +1501,13 @@ void bt_stream_rx()
 			}
 			rssi_add(rssi);
 
-			handle_usb(clkn);
-
 			/* If timer says time to hop, do it. */
 			if (do_hop) {
 				hop();
 			} else {
 				TXLED_CLR;
+				if (hop_mode == HOP_BLUETOOTH)
+					hop_table_fill(clkn);
 			}
 			/* TODO - set per-channel carrier sense threshold.
 			 * Set by firmware or host. */
@@ -1399,22 +1530,31 @@ void bt_stream_rx()
 
 		rssi_iir_update(channel);
 
-		/* Set squelch hold if there was either a CS trigger, squelch
-		 * is disabled, or if the current rssi_max is above the same
-		 * threshold. Currently, this is redundant, but allows for
-		 * per-channel or other rssi triggers in the future. */
+		/* Set squelch hold if the squelch gate of the channel is
+		 * open. A CS trigger raises rssi_max to the hardware
+		 * threshold above, so it only opens the gate when that
+		 * threshold is current. Blocks are dropped once the hold
+		 * expires unless squelch is disabled. */
 		if (cs_trigger || cs_no_squelch) {
 			status |= CS_TRIGGER;
 			cs_trigger = 0;
 		}
 
-		if (rssi_max >= (cs_threshold_cur + 54)) {
+		if (cs_squelch_open(channel)) {
 			status |= RSSI_TRIGGER;
+			hold = CS_HOLD_TIME;
 		}
 
-		enqueue(BR_PACKET, (uint8_t*)idle_rxbuf);
+		if (hold || cs_no_squelch) {
+			if (hold)
+				hold--;
+			rssi_squelch_count(channel, 1);
+			enqueue(BR_PACKET, (uint8_t*)idle_rxbuf);
+		} else {
+			rssi_squelch_count(channel, 0);
+			TRACE(TRACE_DROP, TRACE_DROP_SQUELCH, channel);
+		}
 
-		handle_usb(clkn);
 		rx_tc = 0;
 		rx_err = 0;
 	}
@@ -1497,6 +1637,8 @@ void br_transmit()
 			// If timer says time to hop, do it.
 			if (do_hop) {
 				hop();
+			} else if (hop_mode == HOP_BLUETOOTH) {
+				hop_table_fill(clkn);
 			}
 		}
 
@@ -1518,8 +1660,6 @@ void br_transmit()
 
 		while ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON);
 		cc2400_strobe(STX);
-
-		handle_usb(clkn);
 	}
 
 #ifdef UBERTOOTH_ONE
@@ -1590,9 +1730,6 @@ void bt_generic_le(u8 active_mode)
 
 	reset_le();
 
-	// enable USB interrupts
-	ISER0 = ISER0_ISE_USB;
-
 	RXLED_CLR;
 
 	usb_queue_init();
@@ -1658,23 +1795,24 @@ void bt_generic_le(u8 active_mode)
 
 		rssi_iir_update(channel);
 
-		/* Set squelch hold if there was either a CS trigger, squelch
-		 * is disabled, or if the current rssi_max is above the same
-		 * threshold. Currently, this is redundant, but allows for
-		 * per-channel or other rssi triggers in the future. */
+		/* Set squelch hold if squelch is disabled or the squelch
+		 * gate of the channel is open. See bt_stream_rx(). */
 		if (cs_trigger || cs_no_squelch) {
 			status |= CS_TRIGGER;
-			hold = CS_HOLD_TIME;
 			cs_trigger = 0;
 		}
+		if (cs_no_squelch)
+			hold = CS_HOLD_TIME;
 
-		if (rssi_max >= (cs_threshold_cur + 54)) {
+		if (cs_squelch_open(channel)) {
 			status |= RSSI_TRIGGER;
 			hold = CS_HOLD_TIME;
 		}
 
 		/* Hold expired? Ignore data. */
+		rssi_squelch_count(channel, hold != 0);
 		if (hold == 0) {
+			TRACE(TRACE_DROP, TRACE_DROP_SQUELCH, channel);
 			goto rx_continue;
 		}
 		hold--;
@@ -1699,9 +1837,6 @@ void bt_generic_le(u8 active_mode)
 		rx_err = 0;
 	}
 
-	// disable USB interrupts
-	ICER0 = ICER0_ICE_USB;
-
 	// reset the radio completely
 	cc2400_idle();
 	dio_ssp_stop();
@@ -1720,9 +1855,6 @@ void bt_le_sync(u8 active_mode)
 
 	le.link_state = LINK_LISTENING;
 
-	// enable USB interrupts
-	ISER0 = ISER0_ISE_USB;
-
 	RXLED_CLR;
 
 	usb_queue_init();
@@ -1832,10 +1964,7 @@ void bt_le_sync(u8 active_mode)
 		RXLED_SET;
 		packet_cb((uint8_t *)packet);
 
-		// disable USB interrupts while we touch USB data structures
-		ICER0 = ICER0_ICE_USB;
 		enqueue(LE_PACKET, (uint8_t *)packet);
-		ISER0 = ISER0_ISE_USB;
 
 		le.last_packet = CLK100NS;
 
@@ -1917,9 +2046,6 @@ void bt_le_sync(u8 active_mode)
 
 cleanup:
 
-	// disable USB interrupts
-	ICER0 = ICER0_ICE_USB;
-
 	// reset the radio completely
 	cc2400_idle();
 	dio_ssp_stop();
@@ -2196,6 +2322,23 @@ void promisc_recover_hop_interval(u8 *packet) {
 	prev_clk = cur_clk;
 }
 
+/* PROMISC_RECOVER_HOST: every parameter but the position in the hop
+ * sequence is known, take that from the first packet on this channel */
+void promisc_anchor_cb(u8 *packet) {
+	le.channel_idx = (btle_channel_index(channel) + le.channel_increment) % 37;
+	le.interval_timer = le.conn_interval / 2;
+	le.conn_count = 0;
+	le.conn_epoch = 0;
+	do_hop = 0;
+	le.link_state = LINK_CONNECTED;
+	hop_mode = HOP_BTLE;
+	packet_cb = connection_follow_cb;
+	le_promisc_state(3, &le.channel_increment, 1);
+
+	if (jam_mode != JAM_NONE)
+		le_jam_count = JAM_COUNT_DEFAULT;
+}
+
 void promisc_follow_cb(u8 *packet) {
 	int i;
 
@@ -2214,123 +2357,113 @@ void promisc_follow_cb(u8 *packet) {
 	}
 }
 
-// called when we see an AA, add it to the list
-void see_aa(u32 aa) {
-	int i, max = -1, killme = -1;
-	for (i = 0; i < AA_LIST_SIZE; ++i)
-		if (le_promisc.active_aa[i].aa == aa) {
-			++le_promisc.active_aa[i].count;
-			return;
-		}
+static inline unsigned aa_hash(u32 aa) {
+	return (aa * 2654435761u) >> (32 - AA_HASH_BITS);
+}
 
-	// evict someone
-	for (i = 0; i < AA_LIST_SIZE; ++i)
-		if (le_promisc.active_aa[i].count < max || max < 0) {
-			killme = i;
-			max = le_promisc.active_aa[i].count;
+// called when we see an AA, add it to the list
+// returns the number of times the AA has been seen
+int see_aa(u32 aa) {
+	int i, min = -1;
+	unsigned slot = aa_hash(aa);
+	le_promisc_active_aa_t *entry, *killme = NULL;
+
+	for (i = 0; i < AA_PROBE_LEN; ++i) {
+		entry = &le_promisc.active_aa[(slot + i) & (AA_HASH_SIZE - 1)];
+		if (entry->count > 0 && entry->aa == aa)
+			return ++entry->count;
+
+		// evict the least frequently seen AA in the probe window
+		if (entry->count < min || min < 0) {
+			killme = entry;
+			min = entry->count;
 		}
+	}
 
-	le_promisc.active_aa[killme].aa = aa;
-	le_promisc.active_aa[killme].count = 1;
+	killme->aa = aa;
+	killme->count = 1;
+	return 1;
 }
 
 /* le promiscuous mode */
 int cb_le_promisc(char *unpacked) {
 	int i, j, k;
 	int idx;
+	u32 aa;
+	u16 window, whitened = 0;
 
 	// empty data PDU: 01 00
-	char desired[4][16] = {
-		{ 1, 0, 0, 0, 0, 0, 0, 0,
-		  0, 0, 0, 0, 0, 0, 0, 0, },
-		{ 1, 0, 0, 1, 0, 0, 0, 0,
-		  0, 0, 0, 0, 0, 0, 0, 0, },
-		{ 1, 0, 1, 0, 0, 0, 0, 0,
-		  0, 0, 0, 0, 0, 0, 0, 0, },
-		{ 1, 0, 1, 1, 0, 0, 0, 0,
-		  0, 0, 0, 0, 0, 0, 0, 0, },
-	};
-
-	for (i = 0; i < 4; ++i) {
-		idx = whitening_index[btle_channel_index(channel)];
+	//
+	// The four empty PDU headers we look for only differ in bits 2 and 3
+	// (NESN and SN), so a single masked compare against the whitened
+	// header tests all of them at once.
+	const u16 desired = 0x0001;
+	const u16 desired_mask = (u16)~0x000c;
+
+	// the host has recovered the connection, go follow it
+	if (le_promisc_params_ready)
+		return 0;
 
-		// whiten the desired data
-		for (j = 0; j < (int)sizeof(desired[i]); ++j) {
-			desired[i][j] ^= whitening[idx];
-			idx = (idx + 1) % sizeof(whitening);
-		}
+	idx = whitening_index[btle_channel_index(channel)];
+	for (j = 0; j < 16; ++j) {
+		whitened |= (u16)(((desired >> j) & 1) ^ whitening[idx]) << j;
+		idx = (idx + 1) % sizeof(whitening);
 	}
+	whitened &= desired_mask;
+
+	// bit k of each word holds the k-th symbol of the window
+	aa = 0;
+	for (k = 0; k < 32; ++k)
+		aa |= (u32)unpacked[k] << k;
+	window = 0;
+	for (k = 0; k < 16; ++k)
+		window |= (u16)unpacked[32 + k] << k;
 
 	// then look for that bitsream in our receive buffer
 	for (i = 32; i < (DMA_SIZE*8*2 - 32 - 16); i++) {
-		int ok[4] = { 1, 1, 1, 1 };
-		int matching = -1;
-
-		for (j = 0; j < 4; ++j) {
-			for (k = 0; k < (int)sizeof(desired[j]); ++k) {
-				if (unpacked[i+k] != desired[j][k]) {
-					ok[j] = 0;
-					break;
+		if ((window & desired_mask) == whitened) {
+			// found a match! unwhiten it and send it home
+			idx = whitening_index[btle_channel_index(channel)];
+			for (j = 0; j < 4+3+3; ++j) {
+				u8 byte = 0;
+				for (k = 0; k < 8; k++) {
+					int offset = k + (j * 8) + i - 32;
+					if (offset >= DMA_SIZE*8*2) break;
+					int bit = unpacked[offset];
+					if (j >= 4) { // unwhiten data bytes
+						bit ^= whitening[idx];
+						idx = (idx + 1) % sizeof(whitening);
+					}
+					byte |= bit << k;
 				}
+				idle_rxbuf[j] = byte;
 			}
-		}
-
-		// see if any match
-		for (j = 0; j < 4; ++j) {
-			if (ok[j]) {
-				matching = j;
-				break;
-			}
-		}
 
-		// skip if no match
-		if (matching < 0)
-			continue;
+			enqueue(LE_PACKET, (uint8_t*)idle_rxbuf);
 
-		// found a match! unwhiten it and send it home
-		idx = whitening_index[btle_channel_index(channel)];
-		for (j = 0; j < 4+3+3; ++j) {
-			u8 byte = 0;
-			for (k = 0; k < 8; k++) {
-				int offset = k + (j * 8) + i - 32;
-				if (offset >= DMA_SIZE*8*2) break;
-				int bit = unpacked[offset];
-				if (j >= 4) { // unwhiten data bytes
-					bit ^= whitening[idx];
-					idx = (idx + 1) % sizeof(whitening);
-				}
-				byte |= bit << k;
+			// once we see an AA 4 times, start following it
+			if (!le_promisc_host && see_aa(aa) > 3) {
+				le_set_access_address(aa);
+				data_cb = cb_follow_le;
+				packet_cb = promisc_follow_cb;
+				le.crc_verify = 0;
+				le_promisc_state(0, &le.access_address, 4);
+				// quit using the old stuff and switch to sync mode
+				return 0;
 			}
-			idle_rxbuf[j] = byte;
 		}
 
-		u32 aa = (idle_rxbuf[3] << 24) |
-				 (idle_rxbuf[2] << 16) |
-				 (idle_rxbuf[1] <<  8) |
-				 (idle_rxbuf[0]);
-		see_aa(aa);
-
-		enqueue(LE_PACKET, (uint8_t*)idle_rxbuf);
-
-	}
-
-	// once we see an AA 5 times, start following it
-	for (i = 0; i < AA_LIST_SIZE; ++i) {
-		if (le_promisc.active_aa[i].count > 3) {
-			le_set_access_address(le_promisc.active_aa[i].aa);
-			data_cb = cb_follow_le;
-			packet_cb = promisc_follow_cb;
-			le.crc_verify = 0;
-			le_promisc_state(0, &le.access_address, 4);
-			// quit using the old stuff and switch to sync mode
-			return 0;
-		}
+		// slide both windows along by one symbol
+		aa = (aa >> 1) | ((u32)(window & 1) << 31);
+		window = (window >> 1) | ((u16)unpacked[i + 16] << 15);
 	}
 
 	return 1;
 }
 
 void bt_promisc_le() {
+	u32 aa;
+
 	while (requested_mode == MODE_BT_PROMISC_LE) {
 		reset_le_promisc();
 
@@ -2338,8 +2471,9 @@ void bt_promisc_le() {
 		if ((channel & 1) == 1)
 			channel = 2440;
 
-		// if the PC hasn't given us AA, determine by listening
-		if (!le.target_set) {
+		// if the PC hasn't given us AA, determine by listening. when
+		// the host does the recovery, listen until it is done.
+		if (le_promisc_host ? !le_promisc_params_ready : !le.target_set) {
 			// cs_threshold_req = -80;
 			cs_threshold_calc_and_set(channel);
 			data_cb = cb_le_promisc;
@@ -2351,9 +2485,24 @@ void bt_promisc_le() {
 			break;
 
 		le_promisc_state(0, &le.access_address, 4);
-		packet_cb = promisc_follow_cb;
-		le.crc_verify = 0;
+		if (le_promisc_host) {
+			le_promisc_params_ready = 0;
+			le.target_set = 0;
+			le_promisc_state(1, &le.crc_init, 3);
+			le_promisc_state(2, &le.conn_interval, 2);
+			packet_cb = promisc_anchor_cb;
+			le.crc_verify = 1;
+		} else {
+			packet_cb = promisc_follow_cb;
+			le.crc_verify = 0;
+		}
+
+		aa = le.access_address;
 		bt_le_sync(MODE_BT_PROMISC_LE);
+
+		// connection timed out, back to listening
+		if (requested_mode == MODE_BT_PROMISC_LE)
+			le_promisc_state(4, &aa, 4);
 	}
 }
 
@@ -2389,62 +2538,43 @@ void bt_slave_le() {
 
 	clkn_start();
 
-	// enable USB interrupts due to busy waits
-	ISER0 = ISER0_ISE_USB;
-
 	// spam advertising packets
 	while (requested_mode == MODE_BT_SLAVE_LE) {
 		le_transmit(0x8e89bed6, adv_ind_len+3, adv_ind);
 		msleep(100);
 	}
 
-	// disable USB interrupts
-	ICER0 = ICER0_ICE_USB;
 }
 #endif
 
-void rx_generic_sync(void) {
-	u8 len = 32;
-	u8 buf[len+4];
-	u16 reg_val;
-
-	/* Put syncword at start of buffer
-	 * DGS: fix this later, we don't know number of syncword bytes, etc
-	 */
-	reg_val = cc2400_get(SYNCH);
-	buf[0] = (reg_val >> 8) & 0xFF;
-	buf[1] = reg_val & 0xFF;
-	reg_val = cc2400_get(SYNCL);
-	buf[2] = (reg_val >> 8) & 0xFF;
-	buf[3] = reg_val & 0xFF;
-
+/* Capture packets after the sync word the host programmed, streaming
+ * RFCAT_CAP_LEN bytes of each over bulk. See sync_rx.c. */
+static void rx_generic_sync(void)
+{
 	usb_queue_init();
 	clkn_start();
 
 	while (!(cc2400_status() & XOSC16M_STABLE));
-	cc2400_strobe(SFSON);
-	while (!(cc2400_status() & FS_LOCK));
-	RXLED_SET;
 #ifdef UBERTOOTH_ONE
-		PAEN_SET;
-		HGM_SET;
+	PAEN_SET;
+	HGM_SET;
 #endif
-	while (1) {
-		while ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON);
-		cc2400_strobe(SRX);
-		USRLED_CLR;
-		while (!(cc2400_status() & SYNC_RECEIVED));
-		USRLED_SET;
-
-		cc2400_fifo_read(len, buf+4);
-		enqueue(BR_PACKET, buf);
-		handle_usb(clkn);
+	sync_rx_start(GENERIC_PACKET, packet_len);
+
+	/* A rearm flagged after the poll is picked up at the latest on the
+	 * next CLKN tick, which wakes sched_wait() */
+	while (requested_mode == MODE_RX_GENERIC) {
+		sync_rx_poll();
+		sched_run();
+		sched_wait();
 	}
+
+	sync_rx_stop();
 }
 
 void rx_generic(void) {
 	// Check for packet mode
-	if(cc2400_get(GRMDM) && 0x0400) {
+	if (cc2400_get(GRMDM) & 0x0400) {
 		rx_generic_sync();
 	} else {
 		modulation = MOD_NONE;
@@ -2500,13 +2630,126 @@ void tx_generic(void) {
 }
 #endif
 
-/* spectrum analysis */
-void specan()
+/* read RSSI specan_cfg.samples times, reduced to a single value. The SPI
+ * transfer itself spaces the reads a few microseconds apart. */
+static int8_t specan_sample(void)
 {
+	int8_t rssi, max = -128;
+	int sum = 0;
+	u8 n;
+
+	for (n = 0; n < specan_cfg.samples; n++) {
+		rssi = (int8_t)(cc2400_get(RSSI) >> 8);
+		if (rssi > max)
+			max = rssi;
+		sum += rssi;
+	}
+
+	if (specan_cfg.reduce == SPECAN_REDUCE_AVG)
+		return sum / specan_cfg.samples;
+	return max;
+}
+
+/* Sweep state shared by the specan events. */
+static struct {
 	u16 f;
-	u8 i = 0;
+	u8 i;
+	u32 sweep_start;
 	u8 buf[DMA_SIZE];
+} sweep;
+
+static void specan_store(u16 f, u16 next, int8_t rssi)
+{
+	u8 *buf = sweep.buf;
+
+	if (specan_packed) {
+		if (sweep.i == 0) {
+			buf[0] = (f >> 8) & 0xFF;
+			buf[1] = f & 0xFF;
+			buf[2] = specan_cfg.step;
+		}
+		buf[SPECAN_FRAME_HDR + sweep.i++] = rssi;
+		if (sweep.i == SPECAN_FRAME_BINS || next == low_freq) {
+			buf[3] = sweep.i;
+			enqueue_with_ts(SPECAN_FRAME, buf, sweep.sweep_start);
+			sweep.i = 0;
+		}
+	} else {
+		buf[3 * sweep.i] = (f >> 8) & 0xFF;
+		buf[(3 * sweep.i) + 1] = f  & 0xFF;
+		buf[(3 * sweep.i) + 2] = rssi;
+		if (++sweep.i == 16) {
+			enqueue(SPECAN, buf);
+			sweep.i = 0;
+		}
+	}
+}
+
+/* Queue the next step of a sweep. The steps run as a chain with one
+ * event in flight, so a full queue would silently stall the sweep;
+ * drop back to idle instead and say why. */
+static void specan_sched(u32 delay, sched_cb_t cb)
+{
+	if (sched_in(delay, cb, NULL) < 0) {
+		debug_printf("specan: event queue full, stopping\n");
+		requested_mode = MODE_IDLE;
+	}
+}
+
+static void specan_locked(void *arg);
+static void specan_read(void *arg);
+
+/* synthesizer released after SRFOFF: tune to the next bin */
+static void specan_unlocked(void *arg)
+{
+	(void)arg;
+	if (cc2400_status() & FS_LOCK) {
+		specan_sched(SPECAN_LOCK_POLL, specan_unlocked);
+		return;
+	}
+	cc2400_set(FSDIV, sweep.f - 1);
+	cc2400_strobe(SFSON);
+	specan_sched(SPECAN_LOCK_POLL, specan_locked);
+}
+
+/* synthesizer locked: enter RX and let the RSSI settle */
+static void specan_locked(void *arg)
+{
+	(void)arg;
+	if (!(cc2400_status() & FS_LOCK)) {
+		specan_sched(SPECAN_LOCK_POLL, specan_locked);
+		return;
+	}
+	cc2400_strobe(SRX);
+	specan_sched(specan_cfg.dwell, specan_read);
+}
+
+/* Sample the current bin, then start tuning to the next one before the
+ * sample is stored, so that the lock time overlaps the bookkeeping. */
+static void specan_read(void *arg)
+{
+	u16 f = sweep.f;
+	u16 next = f + specan_cfg.step;
+	int8_t rssi;
+
+	(void)arg;
+	if (next > high_freq)
+		next = low_freq;
+
+	rssi = specan_sample();
+
+	sweep.f = next;
+	cc2400_strobe(SRFOFF);
+	specan_unlocked(NULL);
+
+	specan_store(f, next, rssi);
+	if (next == low_freq)
+		sweep.sweep_start = CLK100NS;
+}
 
+/* spectrum analysis */
+void specan()
+{
 	RXLED_SET;
 
 	usb_queue_init();
@@ -2524,42 +2767,100 @@ void specan()
 	while (!(cc2400_status() & XOSC16M_STABLE));
 	while ((cc2400_status() & FS_LOCK));
 
-	while (requested_mode == MODE_SPECAN) {
-		for (f = low_freq; f < high_freq + 1; f++) {
-			cc2400_set(FSDIV, f - 1);
-			cc2400_strobe(SFSON);
-			while (!(cc2400_status() & FS_LOCK));
-			cc2400_strobe(SRX);
-
-			/* give the CC2400 time to acquire RSSI reading */
-			volatile u32 j = 500; while (--j); //FIXME crude delay
-			buf[3 * i] = (f >> 8) & 0xFF;
-			buf[(3 * i) + 1] = f  & 0xFF;
-			buf[(3 * i) + 2] = cc2400_get(RSSI) >> 8;
-			i++;
-			if (i == 16) {
-				enqueue(SPECAN, buf);
-				i = 0;
-
-				handle_usb(clkn);
-			}
+	sweep.f = low_freq;
+	sweep.i = 0;
+	sweep.sweep_start = CLK100NS;
+	cc2400_set(FSDIV, low_freq - 1);
+	cc2400_strobe(SFSON);
+	specan_sched(SPECAN_LOCK_POLL, specan_locked);
 
-			cc2400_strobe(SRFOFF);
-			while ((cc2400_status() & FS_LOCK));
-		}
+	while (requested_mode == MODE_SPECAN) {
+		sched_run();
+		sched_wait();
 	}
+
+	sched_cancel(specan_unlocked);
+	sched_cancel(specan_locked);
+	sched_cancel(specan_read);
+	cc2400_strobe(SRFOFF);
+	while ((cc2400_status() & FS_LOCK));
 	RXLED_CLR;
 }
 
 /* LED based spectrum analysis */
-void led_specan()
+static u16 led_channels[3] = {2412, 2437, 2462};
+static u8 led_index;
+
+static void led_specan_locked(void *arg);
+static void led_specan_read(void *arg);
+
+static void led_specan_unlocked(void *arg)
+{
+	(void)arg;
+	if (cc2400_status() & FS_LOCK) {
+		specan_sched(SPECAN_LOCK_POLL, led_specan_unlocked);
+		return;
+	}
+	cc2400_set(FSDIV, led_channels[led_index] - 1);
+	cc2400_strobe(SFSON);
+	specan_sched(SPECAN_LOCK_POLL, led_specan_locked);
+}
+
+static void led_specan_locked(void *arg)
+{
+	(void)arg;
+	if (!(cc2400_status() & FS_LOCK)) {
+		specan_sched(SPECAN_LOCK_POLL, led_specan_locked);
+		return;
+	}
+	cc2400_strobe(SRX);
+
+	/* give the CC2400 time to acquire RSSI reading */
+	specan_sched(SPECAN_DWELL_DEFAULT, led_specan_read);
+}
+
+static void led_specan_read(void *arg)
 {
 	int8_t lvl;
-	u8 i = 0;
-	u16 channels[3] = {2412, 2437, 2462};
-	//void (*set[3]) = {TXLED_SET, RXLED_SET, USRLED_SET};
-	//void (*clr[3]) = {TXLED_CLR, RXLED_CLR, USRLED_CLR};
+	u8 i = led_index;
+
+	(void)arg;
+	lvl = (int8_t)((cc2400_get(RSSI) >> 8) & 0xff);
+
+	led_index = (i + 1) % 3;
+	cc2400_strobe(SRFOFF);
+	led_specan_unlocked(NULL);
 
+	if (lvl > rssi_threshold) {
+		switch (i) {
+			case 0:
+				TXLED_SET;
+				break;
+			case 1:
+				RXLED_SET;
+				break;
+			case 2:
+				USRLED_SET;
+				break;
+		}
+	}
+	else {
+		switch (i) {
+			case 0:
+				TXLED_CLR;
+				break;
+			case 1:
+				RXLED_CLR;
+				break;
+			case 2:
+				USRLED_CLR;
+				break;
+		}
+	}
+}
+
+void led_specan()
+{
 #ifdef UBERTOOTH_ONE
 	PAEN_SET;
 	//HGM_SET;
@@ -2573,49 +2874,21 @@ void led_specan()
 	while (!(cc2400_status() & XOSC16M_STABLE));
 	while ((cc2400_status() & FS_LOCK));
 
-	while (requested_mode == MODE_LED_SPECAN) {
-		cc2400_set(FSDIV, channels[i] - 1);
-		cc2400_strobe(SFSON);
-		while (!(cc2400_status() & FS_LOCK));
-		cc2400_strobe(SRX);
-
-		/* give the CC2400 time to acquire RSSI reading */
-		volatile u32 j = 500; while (--j); //FIXME crude delay
-		lvl = (int8_t)((cc2400_get(RSSI) >> 8) & 0xff);
-		if (lvl > rssi_threshold) {
-			switch (i) {
-				case 0:
-					TXLED_SET;
-					break;
-				case 1:
-					RXLED_SET;
-					break;
-				case 2:
-					USRLED_SET;
-					break;
-			}
-		}
-		else {
-			switch (i) {
-				case 0:
-					TXLED_CLR;
-					break;
-				case 1:
-					RXLED_CLR;
-					break;
-				case 2:
-					USRLED_CLR;
-					break;
-			}
-		}
-
-		i = (i+1) % 3;
-
-		handle_usb(clkn);
+	led_index = 0;
+	cc2400_set(FSDIV, led_channels[0] - 1);
+	cc2400_strobe(SFSON);
+	specan_sched(SPECAN_LOCK_POLL, led_specan_locked);
 
-		cc2400_strobe(SRFOFF);
-		while ((cc2400_status() & FS_LOCK));
+	while (requested_mode == MODE_LED_SPECAN) {
+		sched_run();
+		sched_wait();
 	}
+
+	sched_cancel(led_specan_unlocked);
+	sched_cancel(led_specan_locked);
+	sched_cancel(led_specan_read);
+	cc2400_strobe(SRFOFF);
+	while ((cc2400_status() & FS_LOCK));
 }
 
 int main()
@@ -2632,8 +2905,13 @@ int main()
 	debug_uart_init(0);
 	debug_printf("\n\n****UBERTOOTH BOOT****\n%s\n", compile_info);
 
+	/* USB is serviced from its own interrupt; the scheduler only wakes it
+	 * for keep-alives while no packets are flowing. */
+	sched_init();
+	usb_service(NULL);
+
 	while (1) {
-		handle_usb(clkn);
+		sched_run();
 		if(requested_mode != mode) {
 			switch (requested_mode) {
 				case MODE_RESET:
@@ -2714,6 +2992,9 @@ int main()
 					/* This is really an error state, but what can you do? */
 					break;
 			}
+		} else {
+			/* nothing to do until the next event or interrupt */
+			sched_wait();
 		}
 	}
 }
@@ -20,7 +20,9 @@
  */
 
 #include "ego.h"
+#include "sync_rx.h"
 #include "ubertooth_clock.h"
+#include "ubertooth_interface.h"
 
 /*
  * This code performs several functions related to the Yuneec E-GO electric
@@ -31,9 +33,6 @@
  *  - jamming
  */
 
-int enqueue_with_ts(u8 type, u8 *buf, u32 ts);
-#define CLK100NS (3125*(clkn & 0xfffff) + T0TC)
-extern volatile u32 clkn; // TODO: replace with timer1
 extern volatile u8 requested_mode;
 extern volatile u16 channel;
 
@@ -68,42 +67,10 @@ typedef struct _ego_fsm_state_t {
 typedef void (*ego_st_handler)(ego_fsm_state_t *);
 
 uint8_t packet_len = 18;
-#define EGO_MAX_PACKET_LEN 48
-typedef struct _ego_packet_t {
-	u8 rxbuf[EGO_MAX_PACKET_LEN];
-	u32 rxtime;
-} ego_packet_t;
-
-static void ssp_start(void) {
-	// make sure the (active low) slave select signal is not active
-	DIO_SSEL_SET;
-
-	// enable SSP
-	DIO_SSP_CR1 |= SSPCR1_SSE;
-
-	// activate slave select pin
-	DIO_SSEL_CLR;
-}
-
-static void ssp_stop() {
-	// disable CC2400's output (active low)
-	DIO_SSEL_SET;
-
-	// disable SSP
-	DIO_SSP_CR1 &= ~SSPCR1_SSE;
-}
-
-static void ego_init(void) {
-	// enable USB interrupts
-	ISER0 = ISER0_ISE_USB;
-
-	dio_ssp_init();
-}
 
 static void ego_deinit(void) {
+	sync_rx_stop();
 	cc2400_strobe(SRFOFF);
-	ssp_stop(); // TODO disable SSP
-	ICER0 = ICER0_ICE_USB;
 }
 
 static void rf_on(void) {
@@ -127,26 +94,8 @@ static void rf_on(void) {
 
 	while (!(cc2400_status() & XOSC16M_STABLE));
 
-	ssp_start();
-
-	cc2400_strobe(SFSON);
-	while (!(cc2400_status() & FS_LOCK));
-	while ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON);
-
-	cc2400_strobe(SRX);
-}
-
-static void do_rx(ego_packet_t *packet) {
-	int i;
-	for (i = 0; i < packet_len; i++) {
-		// make sure there are bytes ready
-		while (!(SSP1SR & SSPSR_RNE)) ;
-		packet->rxbuf[i] = (u8)DIO_SSP_DR;
-	}
-}
-
-static inline int sync_received(void) {
-	return cc2400_status() & SYNC_RECEIVED;
+	// packets stream to the host from the DMA interrupt
+	sync_rx_start(EGO_PACKET, packet_len);
 }
 
 // sleep for some milliseconds
@@ -189,29 +138,20 @@ static void start_rf_state(ego_fsm_state_t *state) {
 }
 
 static void cap_state(ego_fsm_state_t *state) {
-	ego_packet_t packet = {
-		.rxtime = CLK100NS,
-	};
-
 	if (sleep_elapsed(state)) {
 		sleep_ms(state, 4);
 		state->state = EGO_ST_SLEEP;
 	}
 
-	if (sync_received()) {
-		RXLED_SET;
-		do_rx(&packet);
-		enqueue_with_ts(EGO_PACKET, packet.rxbuf, packet.rxtime);
-		RXLED_CLR;
-
+	// packet captured and queued for the host
+	if (sync_rx_count) {
 		sleep_ms(state, 6);
 		state->state = EGO_ST_SLEEP;
 	}
 
 	// kill RF on state change
 	if (state->state != EGO_ST_CAP) {
-		cc2400_strobe(SRFOFF);
-		ssp_stop();
+		sync_rx_stop();
 		state->timer_active = 1;
 	}
 }
@@ -235,39 +175,13 @@ static void continuous_init_state(ego_fsm_state_t *state) {
 	state->state = EGO_ST_START_RX;
 }
 
-static void continuous_cap_state(ego_fsm_state_t *state) {
-	ego_packet_t packet = {
-		.rxtime = CLK100NS,
-	};
-
-	if (sync_received()) {
-		RXLED_SET;
-		do_rx(&packet);
-		enqueue_with_ts(EGO_PACKET, packet.rxbuf, packet.rxtime);
-		RXLED_CLR;
-
-		ssp_stop();
-		// restart cap with radio warm
-		cc2400_strobe(SFSON);
-		while (!(cc2400_status() & FS_LOCK));
-		while ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON);
-
-		while (SSP1SR & SSPSR_RNE) {
-			uint8_t tmp = (uint8_t)DIO_SSP_DR;
-		}
-		ssp_start();
-
-		cc2400_strobe(SRX);
-	}
-}
-
 #ifdef TX_ENABLE
 // jammer states
 static void jam_cap_state(ego_fsm_state_t *state) {
-	if (sync_received()) {
+	if (sync_rx_syncs) {
 		state->state = EGO_ST_START_JAMMING;
 		state->packet_observed = 1;
-		state->anchor = CLK100NS;
+		state->anchor = sync_rx_time;
 	}
 	if (state->timer_active && sleep_elapsed(state)) {
 		state->state = EGO_ST_START_JAMMING;
@@ -276,10 +190,8 @@ static void jam_cap_state(ego_fsm_state_t *state) {
 	}
 
 	// state changed, kill radio
-	if (state->state != EGO_ST_CAP) {
-		cc2400_strobe(SRFOFF);
-		ssp_stop();
-	}
+	if (state->state != EGO_ST_CAP)
+		sync_rx_stop();
 }
 
 static void start_jamming_state(ego_fsm_state_t *state) {
@@ -365,7 +277,7 @@ void ego_main(ego_mode_t mode) {
 	static const ego_st_handler continuous_rx_handler[] = {
 		continuous_init_state, // do not override user channel
 		start_rf_state,
-		continuous_cap_state,
+		nop_state,             // capture rearms itself
 		nop_state,
 		nop_state,
 		nop_state,
@@ -402,11 +314,10 @@ void ego_main(ego_mode_t mode) {
 			return;
 	}
 
-	ego_init();
-
 	while (1) {
 		if (requested_mode != MODE_EGO)
 			break;
+		sync_rx_poll();
 		handler[state.state](&state);
 	}
 
@@ -434,7 +345,7 @@ int rfcat_subcommand(uint16_t cmd, uint8_t *body, int body_len) {
 
 			// set length
 		case RFCAT_CAP_LEN:
-			if (body_len != 1)
+			if (body_len != 1 || body[0] == 0 || body[0] > DMA_SIZE)
 				return 0;
 			packet_len = body[0];
 			break;
@@ -30,6 +30,9 @@ typedef enum _ego_mode_t {
 	EGO_JAM,
 } ego_mode_t;
 
+// bytes captured after the sync word (RFCAT_CAP_LEN)
+extern uint8_t packet_len;
+
 void ego_main(ego_mode_t mode);
 int rfcat_subcommand(uint16_t cmd, uint8_t *body, int body_len);
 
@@ -12,6 +12,7 @@
 #include "ubertooth_clock.h"
 #include "ubertooth_dma.h"
 #include "ubertooth_usb.h"
+#include "ubertooth_trace.h"
 #include "bluetooth_le.h"
 #include "queue.h"
 
@@ -68,6 +69,8 @@ typedef struct _le_rx_t {
 	uint32_t timestamp;         // timestamp taken after first byte rx
 	unsigned channel;           // physical channel
 	uint32_t access_address;    // access address
+	uint32_t crc_init_reversed; // CRCInit of the connection, bits reversed
+	struct _le_conn_t *conn;    // connection the radio was serving
 	int available;              // 1 if available, 0 in use
 	int8_t rssi_min, rssi_max;  // min and max RSSI observed values
 	int rssi_sum;               // running sum of all RSSI values
@@ -86,10 +89,13 @@ queue_t packet_queue;
 /////////////////////
 // connections
 
-// this system is architected so that following multiple connections may
-// be possible in the future. all connection state lives in an le_conn_t
-// struct. at present only one such structure exists. refer to
-// connection event below for how anchors are handled.
+// all connection state lives in an le_conn_t struct. up to LE_MAX_CONNS
+// connections are followed at once out of the conns table, and adv_conn
+// stands in for the advertising channel. conn points at whichever of
+// these the radio is serving. between connection events it points at
+// adv_conn and the radio listens for further CONNECT_REQs. refer to
+// connection event below for how anchors are handled and to scheduling
+// for how the radio is shared between connections.
 
 typedef struct _le_conn_t {
 	uint32_t access_address;
@@ -120,11 +126,23 @@ typedef struct _le_conn_t {
 	int      channel_map_update_pending;
 	uint16_t channel_map_update_instant;
 	le_channel_remapping_t pending_remapping;
+
+	int      active;        // 1 while the connection is followed
+	uint32_t next_event;    // time to start warming up for the next event
+	uint32_t missed_run;    // events missed in a row
+	le_conn_stats stats;    // reported to the host
 } le_conn_t;
-le_conn_t conn = { 0, };
+
+static le_conn_t adv_conn;
+static le_conn_t conns[LE_MAX_CONNS] __ahbram; // ~2K, too much for local ram
+static le_conn_t *conn = &adv_conn;
+
+// connection whose event starts when MR0 next fires
+static le_conn_t *next_conn = NULL;
 
 // every connection event is tracked using this global le_conn_event_t
-// structure named conn_event. when a packet is observed, anchor is set.
+// structure named conn_event. only one event is open at a time, the one
+// belonging to conn. when a packet is observed, anchor is set.
 // the event may close due to receiving two packets, or if a timeout
 // occurs. in both cases, finish_conn_event() is called, which updates
 // the active connection's anchor. opened is set to 1 once the radio is
@@ -136,9 +154,65 @@ typedef struct _le_conn_event_t {
 } le_conn_event_t;
 le_conn_event_t conn_event;
 
+
+/////////////////////
+// advertising channels
+
+// a CONNECT_REQ goes out on whichever advertising channel the initiator
+// heard the advertiser on, so a radio parked on one channel misses
+// about two thirds of them. when a target is set the radio instead
+// moves along with the target's advertising events: once an ADV_IND
+// was not answered within T_IFS it retunes to the channel the next PDU
+// of the event is expected on, and after the last one it returns to
+// the channel events start on. the channel order and the advertising
+// interval are learned from the target's PDUs. see adv_sched_packet().
+
+#define ADV_CHANNELS 3
+
+typedef struct _le_adv_sched_t {
+	uint8_t  order[ADV_CHANNELS]; // channel order in an event, 0-2 for 37-39
+	uint8_t  len;        // channels of order[] used by the target
+	uint8_t  pos;        // position in order[] the radio listens on
+	uint8_t  current;    // channel the radio listens on, 0-2 for 37-39
+	int      expect;     // waiting for a PDU on current
+	int      hop_pending;
+	uint32_t hop_at;     // time to move to the next channel
+	uint32_t wait_until; // give up on the expected PDU, if expect
+	uint32_t last_adv;   // start of the last PDU of the target
+	uint32_t event_start;
+	int      event_start_valid;
+	uint32_t interval;   // advertising interval, 0 until learned
+	unsigned miss_run;   // expected PDUs missed in a row
+	unsigned events;     // events seen since the order was last widened
+	le_adv_channel_stats stats[ADV_CHANNELS];
+} le_adv_sched_t;
+
+static le_adv_sched_t adv;
+
+// channel chosen with UBERTOOTH_SET_CHANNEL, 0-2 for 37-39
+static uint8_t adv_home(void) {
+	switch (le_adv_channel) {
+		case 2426: return 1;
+		case 2480: return 2;
+		default:   return 0;
+	}
+}
+
 static void reset_conn(void) {
-	memset(&conn, 0, sizeof(conn));
-	conn.access_address = ADVERTISING_AA;
+	memset(&adv_conn, 0, sizeof(adv_conn));
+	adv_conn.access_address = ADVERTISING_AA;
+	adv_conn.crc_init = 0x555555;
+	adv_conn.crc_init_reversed = 0xaaaaaa;
+
+	memset(conns, 0, sizeof(conns));
+	conn = &adv_conn;
+	next_conn = NULL;
+}
+
+// stop following a connection. its statistics are kept for the host
+// until the slot is reused.
+static void drop_conn(le_conn_t *c) {
+	c->active = 0;
 }
 
 
@@ -158,6 +232,7 @@ static void blink(int tx, int rx, int usr);
 static void le_dma_init(void);
 static void le_cc2400_strobe_rx(void);
 static void change_channel(void);
+static void schedule_next_event(void);
 static uint8_t dewhiten_length(unsigned channel, uint8_t data);
 
 // resets the state of all available buffers
@@ -228,6 +303,8 @@ static void finish_conn_event(void) {
 	uint32_t last_anchor = 0;
 	int last_anchor_set = 0;
 
+	TRACE(TRACE_CONN_CLOSE, conn_event.num_packets, conn->access_address);
+
 	// two packets -- update anchor
 	if (conn_event.num_packets == 2) {
 		last_anchor = conn_event.anchor;
@@ -235,9 +312,9 @@ static void finish_conn_event(void) {
 	}
 
 	// if there's one packet, we need to find out if it was the master
-	else if (conn_event.num_packets == 1 && conn.anchor_set) {
+	else if (conn_event.num_packets == 1 && conn->anchor_set) {
 		// calculate the difference between the estimated and observed anchor
-		uint32_t estimated_anchor = conn.last_anchor + conn.conn_interval;
+		uint32_t estimated_anchor = conn->last_anchor + conn->conn_interval;
 		uint32_t delta = estimated_anchor - conn_event.anchor;
 		// see whether the observed anchor is within 3 us of the estimate
 		delta += ANCHOR_EPSILON;
@@ -249,48 +326,168 @@ static void finish_conn_event(void) {
 
 	// if we observed a new anchor, set it
 	if (last_anchor_set) {
-		conn.last_anchor = last_anchor;
-		conn.anchor_set = 1;
+		conn->last_anchor = last_anchor;
+		conn->anchor_set = 1;
 	}
 
 	// without a new anchor, estimate the next anchor
-	else if (conn.anchor_set) {
-		conn.last_anchor += conn.conn_interval;
+	else if (conn->anchor_set) {
+		conn->last_anchor += conn->conn_interval;
 	}
 
 	else {
 		// FIXME this is totally broken if we receive the slave's packet first
-		conn.last_anchor = conn_event.anchor;
-		conn.last_packet_ts = NOW; // FIXME gross hack
+		if (conn_event.num_packets > 0)
+			conn->last_anchor = conn_event.anchor;
+		else
+			conn->last_anchor = conn->next_event + RX_WARMUP_TIME;
+		conn->last_packet_ts = NOW; // FIXME gross hack
 	}
 
 	// update last packet for supervision timeout
 	if (conn_event.num_packets > 0) {
-		conn.last_packet_ts = NOW;
+		conn->last_packet_ts = NOW;
+	} else {
+		++conn->stats.empty;
 	}
+	++conn->stats.events;
+	conn->missed_run = 0;
 
 	reset_conn_event();
 
 	// increment connection event counter
-	++conn.conn_event_counter;
+	++conn->conn_event_counter;
+	conn->next_event = conn->last_anchor + conn->conn_interval - RX_WARMUP_TIME;
 
-	// supervision timeout reached - switch back to advertising
-	if (NOW - conn.last_packet_ts > conn.supervision_timeout) {
-		reset_conn();
-		change_channel();
+	// supervision timeout reached - stop following
+	if (NOW - conn->last_packet_ts > conn->supervision_timeout)
+		drop_conn(conn);
+
+	// hand the radio to whichever connection is due next
+	conn = &adv_conn;
+	schedule_next_event();
+}
+
+// account for a connection event the radio was too busy to serve. the
+// anchor, event counter and channel are advanced as if the event had
+// been observed empty, so the connection can be picked up again later.
+static void skip_conn_event(le_conn_t *c) {
+	uint32_t anchor = c->next_event + RX_WARMUP_TIME;
+
+	TRACE(TRACE_CONN_SKIP, c->conn_event_counter, c->access_address);
+
+	if (c->channel_map_update_pending &&
+			c->conn_event_counter == c->channel_map_update_instant) {
+		c->remapping = c->pending_remapping;
+		c->channel_map_update_pending = 0;
 	}
 
-	// FIXME - hack to cancel following a connection
-	else if (cancel_follow) {
-		cancel_follow = 0;
-		reset_conn();
+	if (c->conn_update_pending &&
+			c->conn_event_counter == c->conn_update_instant) {
+		anchor += c->win_offset;
+		c->anchor_set = 0;
+		c->conn_interval = c->conn_update_pending_interval;
+		c->supervision_timeout = c->conn_update_pending_supervision_timeout;
+		c->conn_update_pending = 0;
+	}
+
+	c->channel_idx = (c->channel_idx + c->hop_increment) % 37;
+	c->last_anchor = anchor;
+	++c->conn_event_counter;
+	c->next_event = anchor + c->conn_interval - RX_WARMUP_TIME;
+
+	++c->stats.events;
+	++c->stats.missed;
+	++c->missed_run;
+
+	if (NOW - c->last_packet_ts > c->supervision_timeout)
+		drop_conn(c);
+}
+
+// scheduling
+//
+// the radio serves one connection event at a time. once an event is
+// finished, events of other connections that should have started in
+// the meantime are skipped, and the earliest remaining event is
+// scheduled on MR0. when events collide, ie several start within the
+// span of one event, the connection that has missed the most events in
+// a row wins and the others are skipped once the radio is free again.
+// long gaps between events are spent on the advertising channel.
+
+// an event that started more than this long ago is missed
+#define EVENT_LATE USEC(150)
+
+// radio time taken by one event: warmup plus a max length packet
+#define EVENT_SPAN (RX_WARMUP_TIME + USEC(2120))
+
+// shortest gap worth retuning to the advertising channel for
+#define ADV_PARK_MIN MSEC(2)
+
+// listen for CONNECT_REQs until the next event
+static void park_radio(void) {
+	// no buffer to receive into: RX restarts once one is released
+	if (current_rxbuf == NULL)
+		return;
+
+	// the advertising channel scheduler may have moved on meanwhile
+	if (btle_channel_index(rf_channel) < 37 ||
+			(le.target_set &&
+			 rf_channel != btle_channel_index_to_phys(37 + adv.current)))
 		change_channel();
+}
+
+static void schedule_next_event(void) {
+	le_conn_t *c, *next = NULL;
+	uint32_t start;
+	int i;
+
+	// FIXME - hack to cancel following connections
+	if (cancel_follow) {
+		cancel_follow = 0;
+		for (i = 0; i < LE_MAX_CONNS; ++i)
+			drop_conn(&conns[i]);
 	}
 
-	// supervision timeout not reached - hop to next channel
-	else {
-		timer1_set_match(conn.last_anchor + conn.conn_interval - RX_WARMUP_TIME);
+	for (i = 0; i < LE_MAX_CONNS; ++i) {
+		c = &conns[i];
+		while (c->active && (int32_t)(NOW - c->next_event) > EVENT_LATE)
+			skip_conn_event(c);
+		if (c->active && (next == NULL ||
+				(int32_t)(c->next_event - next->next_event) < 0))
+			next = c;
+	}
+
+	timer1_clear_match();
+	T1IR = TIR_MR0_Interrupt;
+	next_conn = NULL;
+
+	if (next == NULL) {
+		park_radio();
+		return;
+	}
+
+	// resolve collisions with the earliest event
+	start = next->next_event;
+	for (i = 0; i < LE_MAX_CONNS; ++i) {
+		c = &conns[i];
+		if (c->active && c->next_event - start < EVENT_SPAN &&
+				c->missed_run > next->missed_run)
+			next = c;
+	}
+	next_conn = next;
+
+	start = next->next_event;
+	if ((int32_t)(start - NOW) < USEC(2))
+		start = NOW + USEC(2);
+
+	if (start - NOW > ADV_PARK_MIN) {
+		park_radio();
+	} else {
+		cc2400_strobe(SRFOFF);
+		timer1_cancel_fs_lock();
 	}
+
+	timer1_set_match(start);
 }
 
 // DMA handler
@@ -323,11 +520,13 @@ void le_DMA_IRQHandler(void) {
 			if (pos == 1) {
 				current_rxbuf->timestamp = timestamp - USEC(8 + 32); // packet starts at preamble
 				current_rxbuf->channel = rf_channel;
-				current_rxbuf->access_address = conn.access_address;
+				current_rxbuf->access_address = conn->access_address;
+				current_rxbuf->crc_init_reversed = conn->crc_init_reversed;
+				current_rxbuf->conn = conn;
 
 				// data packet received: cancel timeout
 				// new timeout or hop timer will be set at end of packet RX
-				if (btle_channel_index(rf_channel) < 37) {
+				if (conn != &adv_conn) {
 					timer1_clear_match();
 				}
 			}
@@ -340,6 +539,8 @@ void le_DMA_IRQHandler(void) {
 
 			// finished packet - state transition
 			if (pos > 2 && pos >= current_rxbuf->size) {
+				TRACE(TRACE_DMA_TC, pos, current_rxbuf->channel);
+
 				// stop the CC2400 before flushing SSP
 				cc2400_strobe(SFSON);
 
@@ -359,7 +560,7 @@ void le_DMA_IRQHandler(void) {
 				queue_insert(&packet_queue, current_rxbuf);
 
 				// track connection events
-				if (btle_channel_index(rf_channel) < 37) {
+				if (conn != &adv_conn) {
 					++conn_event.num_packets;
 
 					// first packet: set connection anchor
@@ -446,7 +647,7 @@ static void le_sys_init(void) {
 // initialize RF and strobe FSON
 static void le_cc2400_init_rf(void) {
 	u16 grmdm, mdmctrl;
-	uint32_t sync = rbit(conn.access_address);
+	uint32_t sync = rbit(conn->access_address);
 
 	mdmctrl = 0x0040; // 250 kHz frequency deviation
 	grmdm = 0x44E1; // un-buffered mode, packet w/ sync word detection
@@ -515,17 +716,11 @@ static void change_channel(void) {
 	le_dma_init();
 	dio_ssp_start();
 
-	if (conn.access_address == ADVERTISING_AA) {
-		// FIXME
-		switch (le_adv_channel) {
-			case 2402: channel_idx = 37; break;
-			case 2426: channel_idx = 38; break;
-			case 2480: channel_idx = 39; break;
-			default:   channel_idx = 37; break;
-		}
+	if (conn == &adv_conn) {
+		channel_idx = 37 + (le.target_set ? adv.current : adv_home());
 	} else {
-		conn.channel_idx = (conn.channel_idx + conn.hop_increment) % 37;
-		channel_idx = le_map_channel(conn.channel_idx, &conn.remapping);
+		conn->channel_idx = (conn->channel_idx + conn->hop_increment) % 37;
+		channel_idx = le_map_channel(conn->channel_idx, &conn->remapping);
 	}
 
 	rf_channel = btle_channel_index_to_phys(channel_idx);
@@ -578,81 +773,97 @@ static void timer1_cancel_wait_buffer(void) {
 	T1MCR &= ~TMCR_MR3I;
 }
 
-void TIMER1_IRQHandler(void) {
-	// MR0: connection events
-	if (T1IR & TIR_MR0_Interrupt) {
-		// ack the interrupt
-		T1IR = TIR_MR0_Interrupt;
-
-		// connection update procedure
-		if (conn.conn_update_pending &&
-				conn.conn_event_counter == conn.conn_update_instant) {
+// MR0: connection events
+static void conn_event_timer(void) {
+	// radio is free: open the event of the scheduled connection
+	if (conn == &adv_conn) {
+		if (next_conn == NULL || !next_conn->active) {
+			schedule_next_event();
+			return;
+		}
+		conn = next_conn;
+		next_conn = NULL;
+		reset_conn_event();
+		TRACE(TRACE_CONN_OPEN, conn->conn_event_counter, conn->access_address);
+	}
 
-			// on the first past through, handle the transmit window
-			// offset. if there's no offset, skip down to else block
-			if (!conn_event.opened && conn.win_offset > 0) {
-				timer1_set_match(conn.last_anchor + conn.conn_interval +
-						conn.win_offset - RX_WARMUP_TIME);
-				conn_event.opened = 1;
-			}
+	// connection update procedure
+	if (conn->conn_update_pending &&
+			conn->conn_event_counter == conn->conn_update_instant) {
 
-			// after the transmit window offset, or if there is no
-			// transmit window, set a packet timeout and change the
-			// channel
-			else { // conn_event.opened || conn.win_offset == 0
-				conn_event.opened = 1;
-
-				// this is like a new connection, so set all values
-				// accordingly
-				conn.anchor_set = 0;
-				conn.conn_interval = conn.conn_update_pending_interval;
-				conn.supervision_timeout = conn.conn_update_pending_supervision_timeout;
-				conn.conn_update_pending = 0;
-
-				// timeout after conn window + max packet length
-				timer1_set_match(conn.last_anchor + conn.conn_interval +
-						conn.win_offset + conn.win_size + USEC(2120));
-				change_channel();
-			}
-			return;
+		// on the first past through, handle the transmit window
+		// offset. if there's no offset, skip down to else block
+		if (!conn_event.opened && conn->win_offset > 0) {
+			timer1_set_match(conn->last_anchor + conn->conn_interval +
+					conn->win_offset - RX_WARMUP_TIME);
+			conn_event.opened = 1;
 		}
 
-		// channel map update
-		if (conn.channel_map_update_pending &&
-				conn.conn_event_counter == conn.channel_map_update_instant) {
-			conn.remapping = conn.pending_remapping;
-			conn.channel_map_update_pending = 0;
+		// after the transmit window offset, or if there is no
+		// transmit window, set a packet timeout and change the
+		// channel
+		else { // conn_event.opened || conn->win_offset == 0
+			conn_event.opened = 1;
+
+			// this is like a new connection, so set all values
+			// accordingly
+			conn->anchor_set = 0;
+			conn->conn_interval = conn->conn_update_pending_interval;
+			conn->supervision_timeout = conn->conn_update_pending_supervision_timeout;
+			conn->conn_update_pending = 0;
+
+			// timeout after conn window + max packet length
+			timer1_set_match(conn->last_anchor + conn->conn_interval +
+					conn->win_offset + conn->win_size + USEC(2120));
+			change_channel();
 		}
+		return;
+	}
 
+	// channel map update
+	if (conn->channel_map_update_pending &&
+			conn->conn_event_counter == conn->channel_map_update_instant) {
+		conn->remapping = conn->pending_remapping;
+		conn->channel_map_update_pending = 0;
+	}
+
+	// new connection event: set timeout and change channel
+	if (!conn_event.opened) {
+		conn_event.opened = 1;
+		// timeout is max packet length + warmup time (slack)
+		timer1_set_match(NOW + USEC(2120) + RX_WARMUP_TIME);
+		change_channel();
+	}
+
+	// regular connection event, plus timeout from connection updates
+	// FIXME connection update timeouts and initial connection
+	// timeouts need to be handled differently: they should have a
+	// full window until the packets from the new connection are
+	// captured and a new anchor is set.
+	else {
 		// new connection event: set timeout and change channel
 		if (!conn_event.opened) {
 			conn_event.opened = 1;
+
 			// timeout is max packet length + warmup time (slack)
 			timer1_set_match(NOW + USEC(2120) + RX_WARMUP_TIME);
 			change_channel();
 		}
 
-		// regular connection event, plus timeout from connection updates
-		// FIXME connection update timeouts and initial connection
-		// timeouts need to be handled differently: they should have a
-		// full window until the packets from the new connection are
-		// captured and a new anchor is set.
+		// timeout: close connection event and set timer for next hop
 		else {
-			// new connection event: set timeout and change channel
-			if (!conn_event.opened) {
-				conn_event.opened = 1;
-
-				// timeout is max packet length + warmup time (slack)
-				timer1_set_match(NOW + USEC(2120) + RX_WARMUP_TIME);
-				change_channel();
-			}
-
-			// timeout: close connection event and set timer for next hop
-			else {
-				finish_conn_event();
-			}
+			finish_conn_event();
 		}
 	}
+}
+
+void TIMER1_IRQHandler(void) {
+	// MR0: connection events
+	if (T1IR & TIR_MR0_Interrupt) {
+		// ack the interrupt
+		T1IR = TIR_MR0_Interrupt;
+		conn_event_timer();
+	}
 
 	// LEDs
 	if (T1IR & TIR_MR1_Interrupt) {
@@ -723,27 +934,20 @@ static void blink(int tx, int rx, int usr) {
 // helper function to dewhiten length from whitened data (only used
 // during DMA)
 static uint8_t dewhiten_length(unsigned channel, uint8_t data) {
-	unsigned int i, bit;
-	int idx = whitening_index[btle_channel_index(channel)];
-	uint8_t out = 0;
+	unsigned idx = whitening_index[btle_channel_index(channel)];
 
 	// length is second byte of packet
-	idx = (idx + 8) % sizeof(whitening);
-
-	for (i = 0; i < 8; ++i) {
-		bit = (data >> (7-i)) & 1;
-		bit ^= whitening[idx];
-		idx = (idx + 1) % sizeof(whitening);
-		out |= bit << i;
-	}
+	idx += 8;
+	if (idx >= sizeof(whitening))
+		idx -= sizeof(whitening);
 
-	return out;
+	return (rbit(data) >> 24) ^ (whitening_seq[idx] & 0xff);
 }
 
 // enqueue a packet for USB
 // FIXME this is cribbed from existing code, but does not have enough
 // room for larger LE packets
-static int usb_enqueue_le(le_rx_t *packet) {
+static int usb_enqueue_le(le_rx_t *packet, int crc_ok) {
 	usb_pkt_rx* f = usb_enqueue();
 
 	// fail if queue is full
@@ -765,7 +969,8 @@ static int usb_enqueue_le(le_rx_t *packet) {
 	memcpy(f->data, &packet->access_address, 4);
 	memcpy(f->data+4, packet->data, DMA_SIZE-4);
 
-	f->status = 0;
+	f->status = crc_ok ? 0 : CRC_ERROR;
+	usb_enqueue_commit();
 
 	return 1;
 }
@@ -780,9 +985,19 @@ static unsigned extract_field(le_rx_t *buf, size_t offset, unsigned size) {
 	return ret;
 }
 
+// verify the CRC of a dewhitened packet
+static int crc_check(le_rx_t *buf) {
+	unsigned len = buf->size - 3;
+	uint32_t calc_crc = btle_crcgen_lut(buf->crc_init_reversed, buf->data, len);
+	uint32_t wire_crc = extract_field(buf, len, 3);
+
+	return calc_crc == wire_crc;
+}
+
 static void le_connect_handler(le_rx_t *buf) {
-	uint32_t aa, crc_init;
+	le_conn_t new_conn, *c = &new_conn, *slot = NULL;
 	uint32_t win_size, max_win_size;
+	int i;
 
 	if (!le.do_follow)
 		return;
@@ -794,81 +1009,95 @@ static void le_connect_handler(le_rx_t *buf) {
 	if (cancel_follow)
 		cancel_follow = 0;
 
-	conn.access_address     = extract_field(buf, 14, 4);
-	conn.crc_init           = extract_field(buf, 18, 3);
-	conn.crc_init_reversed  = rbit(conn.crc_init);
-	conn.win_size           = extract_field(buf, 21, 1);
-	conn.win_offset         = extract_field(buf, 22, 2);
-	conn.conn_interval      = extract_field(buf, 24, 2);
-	conn.supervision_timeout = extract_field(buf, 28, 2);
-	conn.hop_increment      = extract_field(buf, 35, 1) & 0x1f;
-
-	if (conn.conn_interval < 6 || conn.conn_interval > 3200) {
-		goto err_out;
+	memset(c, 0, sizeof(*c));
+	c->access_address     = extract_field(buf, 14, 4);
+	c->crc_init           = extract_field(buf, 18, 3);
+	c->crc_init_reversed  = rbit(c->crc_init) >> 8;
+	c->win_size           = extract_field(buf, 21, 1);
+	c->win_offset         = extract_field(buf, 22, 2);
+	c->conn_interval      = extract_field(buf, 24, 2);
+	c->supervision_timeout = extract_field(buf, 28, 2);
+	c->hop_increment      = extract_field(buf, 35, 1) & 0x1f;
+
+	if (c->conn_interval < 6 || c->conn_interval > 3200) {
+		return;
 	} else {
-		conn.conn_interval *= USEC(1250);
+		c->conn_interval *= USEC(1250);
 	}
 
 	// window offset is in range [0, conn_interval]
-	conn.win_offset *= USEC(1250);
-	if (conn.win_offset > conn.conn_interval)
-		goto err_out;
+	c->win_offset *= USEC(1250);
+	if (c->win_offset > c->conn_interval)
+		return;
 
 	// win size is in range [1.25 ms, MIN(10 ms, conn_interval - 1.25 ms)]
-	win_size = conn.win_size * USEC(1250);
-	max_win_size = conn.conn_interval - USEC(1250);
+	win_size = c->win_size * USEC(1250);
+	max_win_size = c->conn_interval - USEC(1250);
 	if (max_win_size > MSEC(10))
 		max_win_size = MSEC(10);
 	if (win_size < USEC(1250) || win_size > max_win_size)
-		goto err_out;
+		return;
 
 	// The connSupervisionTimeout shall be a multiple of 10 ms in the
 	// range of 100 ms to 32.0 s and it shall be larger than (1 +
 	// connSlaveLatency) * connInterval * 2
-	conn.supervision_timeout *= MSEC(10);
-	if (conn.supervision_timeout < MSEC(100) || conn.supervision_timeout > SEC(32))
-		goto err_out;
+	c->supervision_timeout *= MSEC(10);
+	if (c->supervision_timeout < MSEC(100) || c->supervision_timeout > SEC(32))
+		return;
 	// TODO handle slave latency
 
-	le_parse_channel_map(&buf->data[30], &conn.remapping);
-	if (conn.remapping.total_channels == 0)
-		goto err_out;
-
-	// cancel RX on advertising channel
-	timer1_cancel_fs_lock();
+	le_parse_channel_map(&buf->data[30], &c->remapping);
+	if (c->remapping.total_channels == 0)
+		return;
 
-	reset_conn_event();
-	timer1_set_match(buf->timestamp + PACKET_DURATION(buf) +
-			conn.win_offset + USEC(1250) - RX_WARMUP_TIME);
-	return;
+	// find a free slot, unless we already follow this connection
+	for (i = 0; i < LE_MAX_CONNS; ++i) {
+		if (!conns[i].active) {
+			if (slot == NULL)
+				slot = &conns[i];
+		} else if (conns[i].access_address == c->access_address) {
+			return;
+		}
+	}
+	if (slot == NULL)
+		return;
 
-	// error condition: reset conn and return
-err_out:
-	reset_conn();
+	c->active = 1;
+	c->last_packet_ts = buf->timestamp;
+	c->next_event = buf->timestamp + PACKET_DURATION(buf) +
+			c->win_offset + USEC(1250) - RX_WARMUP_TIME;
+	c->stats.access_address = c->access_address;
+
+	// the radio only picks up a new schedule between events
+	asm volatile("cpsid i");
+	*slot = new_conn;
+	if (conn == &adv_conn)
+		schedule_next_event();
+	asm volatile("cpsie i");
 }
 
-static void connection_update_handler(le_rx_t *buf) {
-	conn.win_size            = extract_field(buf, 3, 1);
-	conn.win_offset          = extract_field(buf, 4, 2);
-	conn.conn_update_pending_interval = extract_field(buf, 6, 2);
-	conn.conn_update_pending_supervision_timeout = extract_field(buf, 10, 2);
-	conn.conn_update_instant = extract_field(buf, 12, 2);
+static void connection_update_handler(le_conn_t *c, le_rx_t *buf) {
+	c->win_size            = extract_field(buf, 3, 1);
+	c->win_offset          = extract_field(buf, 4, 2);
+	c->conn_update_pending_interval = extract_field(buf, 6, 2);
+	c->conn_update_pending_supervision_timeout = extract_field(buf, 10, 2);
+	c->conn_update_instant = extract_field(buf, 12, 2);
 
 	// TODO check for invalid values. XXX what do we even do in that
 	// case? we will probably drop the connection, but at least it's on
 	// our own terms and not some impossibly long supervision timeout.
-	conn.win_size   *= USEC(1250);
-	conn.win_offset *= USEC(1250);
-	conn.conn_update_pending_interval *= USEC(1250);
-	conn.conn_update_pending_supervision_timeout *= MSEC(10);
+	c->win_size   *= USEC(1250);
+	c->win_offset *= USEC(1250);
+	c->conn_update_pending_interval *= USEC(1250);
+	c->conn_update_pending_supervision_timeout *= MSEC(10);
 
-	conn.conn_update_pending = 1;
+	c->conn_update_pending = 1;
 }
 
-static void channel_map_update_handler(le_rx_t *buf) {
-	conn.channel_map_update_pending = 1;
-	conn.channel_map_update_instant = extract_field(buf, 8, 2);
-	le_parse_channel_map(&buf->data[3], &conn.pending_remapping);
+static void channel_map_update_handler(le_conn_t *c, le_rx_t *buf) {
+	c->channel_map_update_pending = 1;
+	c->channel_map_update_instant = extract_field(buf, 8, 2);
+	le_parse_channel_map(&buf->data[3], &c->pending_remapping);
 }
 
 static void packet_handler(le_rx_t *buf) {
@@ -885,19 +1114,26 @@ static void packet_handler(le_rx_t *buf) {
 
 	// data packet
 	else {
+		le_conn_t *c = buf->conn;
+
+		// the connection may have been dropped since the packet arrived
+		if (c == NULL || c == &adv_conn || !c->active ||
+				c->access_address != buf->access_address)
+			return;
+
 		// LL control PDU
 		if ((buf->data[0] & 0b11) == 0b11 && buf->data[1] > 0) {
 			switch (buf->data[2]) {
 				// LE_CONNECTION_UPDATE_REQ -- update connection parameters
 				case 0x0:
 					if (buf->data[1] == 12)
-						connection_update_handler(buf);
+						connection_update_handler(c, buf);
 					break;
 
 				// LE_CHANNEL_MAP_REQ -- update channel map
 				case 0x1:
 					if (buf->data[1] == 8)
-						channel_map_update_handler(buf);
+						channel_map_update_handler(c, buf);
 					break;
 			}
 		}
@@ -951,10 +1187,228 @@ static int filter_match(le_rx_t *buf) {
 	return 0;
 }
 
+// advertising channel scheduler, see advertising channels above
+
+// no PDU of the event is more than this far from the previous one
+#define ADV_EVENT_SPAN MSEC(10)
+
+// advDelay, the random 0-10 ms added to each advertising interval
+#define ADV_DELAY_MAX MSEC(10)
+
+// a request starts T_IFS after the ADV_IND and its first byte arrives
+// 48 us later. no byte by then: nothing to wait for.
+#define ADV_REQ_WAIT USEC(150 + 48 + 50)
+
+// expected PDUs missed in a row before the order is changed
+#define ADV_MISS_MAX 4
+
+// events after which a shortened order is tried one channel longer
+#define ADV_WIDEN_EVENTS 32
+
+static void adv_sched_reset(void) {
+	int i;
+
+	memset(&adv, 0, sizeof(adv));
+	for (i = 0; i < ADV_CHANNELS; ++i)
+		adv.order[i] = i;
+	adv.len = ADV_CHANNELS;
+
+	// start where the host asked for, keeping the usual 37-38-39 order
+	while (adv.order[0] != adv_home()) {
+		uint8_t first = adv.order[0];
+		adv.order[0] = adv.order[1];
+		adv.order[1] = adv.order[2];
+		adv.order[2] = first;
+	}
+	adv.current = adv.order[0];
+}
+
+static int conns_active(void) {
+	int i;
+
+	for (i = 0; i < LE_MAX_CONNS; ++i)
+		if (conns[i].active)
+			return 1;
+	return 0;
+}
+
+// listen on order[pos] next, expecting a PDU of the target there
+static void adv_tune(uint8_t pos) {
+	adv.pos = pos;
+	adv.current = adv.order[pos];
+	adv.expect = 1;
+	++adv.stats[adv.current].hops;
+
+	// retune now if the radio is parked on the advertising channel,
+	// otherwise park_radio() picks the channel up
+	asm volatile("cpsid i");
+	if (conn == &adv_conn && current_rxbuf != NULL && current_rxbuf->pos == 0 &&
+			(next_conn == NULL ||
+			 (int32_t)(next_conn->next_event - NOW) > ADV_PARK_MIN) &&
+			rf_channel != btle_channel_index_to_phys(37 + adv.current))
+		change_channel();
+	asm volatile("cpsie i");
+}
+
+// an expected PDU did not arrive. while connections are followed the
+// radio is away often, so only learn from misses when it is not.
+static void adv_miss(void) {
+	uint8_t tmp;
+
+	adv.expect = 0;
+	if (conns_active() || ++adv.miss_run < ADV_MISS_MAX)
+		goto next;
+	adv.miss_run = 0;
+
+	if (adv.pos == 0) {
+		// events do not start here: rotate the order and relearn it
+		tmp = adv.order[0];
+		adv.order[0] = adv.order[1];
+		adv.order[1] = adv.order[2];
+		adv.order[2] = tmp;
+		adv.len = ADV_CHANNELS;
+		adv.events = 0;
+		adv.interval = 0;
+		adv.event_start_valid = 0;
+	} else if (adv.pos + 1 < adv.len) {
+		// try the other channel second
+		tmp = adv.order[adv.pos];
+		adv.order[adv.pos] = adv.order[adv.pos + 1];
+		adv.order[adv.pos + 1] = tmp;
+	} else {
+		// the event ends earlier, or is too quick to retune for
+		adv.len = adv.pos;
+		adv.events = 0;
+	}
+
+next:
+	adv_tune(0);
+	adv.wait_until = 0;
+}
+
+// learn from an advertising channel packet that passed the filter
+static void adv_sched_packet(le_rx_t *buf) {
+	uint8_t ch = btle_channel_index(buf->channel) - 37;
+	uint32_t end = buf->timestamp + PACKET_DURATION(buf);
+	uint32_t since;
+	uint8_t type = buf->data[0] & 0xf;
+	int pos;
+
+	if (ch >= ADV_CHANNELS)
+		return;
+
+	// CONNECT_REQ: the advertiser stops, wait for its next event
+	if (type == 0x05) {
+		++adv.stats[ch].connect_reqs;
+		adv.hop_pending = 0;
+		if (le.target_set && adv.pos != 0)
+			adv_tune(0);
+		return;
+	}
+
+	// only ADV_IND and ADV_DIRECT_IND can be answered by a CONNECT_REQ
+	if (!le.target_set || (type != 0x00 && type != 0x01) ||
+			buf->size < 2 + 6 || !bd_addr_cmp(&buf->data[2]))
+		return;
+
+	++adv.stats[ch].adv;
+	if (adv.expect && ch == adv.current) {
+		++adv.stats[ch].hits;
+		adv.miss_run = 0;
+	}
+	adv.expect = 0;
+
+	for (pos = 0; pos < ADV_CHANNELS - 1; ++pos)
+		if (adv.order[pos] == ch)
+			break;
+
+	// first PDU of an event
+	since = buf->timestamp - adv.last_adv;
+	if (adv.last_adv == 0 || since > ADV_EVENT_SPAN) {
+		if (pos == 0) {
+			// the smallest gap is the interval plus the shortest advDelay
+			since = buf->timestamp - adv.event_start;
+			if (adv.event_start_valid &&
+					(adv.interval == 0 || since < adv.interval))
+				adv.interval = since;
+			adv.event_start = buf->timestamp;
+			adv.event_start_valid = 1;
+		}
+
+		if (adv.len < ADV_CHANNELS && ++adv.events >= ADV_WIDEN_EVENTS) {
+			++adv.len;
+			adv.events = 0;
+		}
+	}
+	adv.last_adv = buf->timestamp;
+
+	// move on once the ADV_IND was not answered, unless the event is
+	// over and the radio already waits where the next one starts
+	adv.pos = pos;
+	if (pos + 1 < adv.len || pos != 0) {
+		adv.hop_pending = 1;
+		adv.hop_at = end + ADV_REQ_WAIT;
+	}
+}
+
+// called from the main loop: carry out hops and timeouts
+static void adv_sched_poll(void) {
+	uint8_t next;
+
+	if (!le.target_set)
+		return;
+
+	if (adv.hop_pending && (int32_t)(NOW - adv.hop_at) >= 0) {
+		// a request is coming in, look again once it is done
+		if (current_rxbuf != NULL && current_rxbuf->pos > 0) {
+			adv.hop_at = NOW + USEC(500);
+			return;
+		}
+		adv.hop_pending = 0;
+
+		next = adv.pos + 1 < adv.len ? adv.pos + 1 : 0;
+		adv_tune(next);
+		if (next != 0)
+			adv.wait_until = NOW + ADV_EVENT_SPAN;
+		else if (adv.interval > 0)
+			adv.wait_until = adv.event_start + adv.interval +
+					ADV_DELAY_MAX + MSEC(2);
+		else
+			adv.wait_until = 0;
+		return;
+	}
+
+	if (adv.expect && adv.wait_until != 0 &&
+			(int32_t)(NOW - adv.wait_until) > 0)
+		adv_miss();
+}
+
+// copy out the advertising channel statistics for the host
+void le_phy_adv_stats(le_adv_stats *stats) {
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < ADV_CHANNELS; ++i) {
+		stats->channel[i] = adv.stats[i];
+		stats->order[i] = 37 + adv.order[i];
+	}
+	stats->order_len = adv.len;
+	stats->interval = adv.interval;
+}
+
+// copy out the statistics of every connection slot for the host
+int le_phy_conn_stats(le_conn_stats *stats) {
+	int i;
+
+	for (i = 0; i < LE_MAX_CONNS; ++i) {
+		stats[i] = conns[i].stats;
+		stats[i].active = conns[i].active;
+	}
+
+	return LE_MAX_CONNS;
+}
+
 void le_phy_main(void) {
-	// disable USB interrupts -- we poll them below
-	// n.b., they should not be enabled but let's be careful
-	ICER0 = ICER0_ICE_USB;
 	// disable clkn and timer0
 	clkn_disable();
 
@@ -964,7 +1418,10 @@ void le_phy_main(void) {
 
 	current_rxbuf = buffer_get();
 	rf_channel = le_adv_channel; // FIXME
-	conn.access_address = ADVERTISING_AA;
+	reset_conn();
+	adv_sched_reset();
+	if (le.target_set)
+		rf_channel = btle_channel_index_to_phys(37 + adv.current);
 	le_sys_init();
 	le_cc2400_init_rf();
 
@@ -973,19 +1430,29 @@ void le_phy_main(void) {
 	while (requested_mode == MODE_BT_FOLLOW_LE) {
 		le_rx_t *packet = NULL;
 		if (queue_remove(&packet_queue, (void **)&packet)) {
+			int crc_ok;
+
 			le_dewhiten(packet->data, packet->size, packet->channel);
+			crc_ok = crc_check(packet);
 
-			if (filter_match(packet)) {
+			// drop packets with a bad CRC if requested, otherwise
+			// flag them for the host
+			if ((crc_ok || !le.crc_verify) && filter_match(packet)) {
 				blink(0, 1, 0); // RX LED
-				usb_enqueue_le(packet);
-				packet_handler(packet);
+				usb_enqueue_le(packet, crc_ok);
+				if (crc_ok) {
+					if (btle_channel_index(packet->channel) >= 37)
+						adv_sched_packet(packet);
+					packet_handler(packet);
+				}
+			} else if (!crc_ok && le.crc_verify) {
+				TRACE(TRACE_DROP, TRACE_DROP_CRC, packet->channel);
 			}
 
 			buffer_release(packet);
 		}
 
-		// polled USB handling
-		handle_usb(0);
+		adv_sched_poll();
 
 		// XXX maybe LED light show?
 	}
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "sync_rx.h"
+#include "ubertooth.h"
+#include "ubertooth_clock.h"
+#include "ubertooth_dma.h"
+#include "ubertooth_trace.h"
+#include "ubertooth_interface.h"
+#include "ubertooth_usb.h"
+
+/*
+ * Sync word capture
+ *
+ * The CC2400 runs in un-buffered packet mode: once it has matched the sync
+ * word it clocks the following bits out on DIO, where the SSP assembles
+ * them into bytes for DMA channel 0 to move straight into a USB packet.
+ * GIO6 reports SYNC_RECEIVED and its rising edge timestamps the packet.
+ * The terminal count interrupt hands the packet to the USB queue and flags
+ * the radio for rearming; sync_rx_poll() does the SPI work from the main
+ * loop, where it cannot land in the middle of another CC2400 transaction.
+ */
+
+#define GRMDM_BUF_MODE (3 << 11) // 00 = un-buffered
+#define FS_ON_TRIES    1000      // FSMSTATE reads before restart() gives up
+
+extern volatile uint16_t channel;
+
+volatile uint8_t sync_rx_active = 0;
+volatile uint32_t sync_rx_syncs = 0;
+volatile uint32_t sync_rx_count = 0;
+volatile uint32_t sync_rx_time = 0;
+
+static uint8_t pkt_type;
+static uint8_t cap_len;
+static uint8_t pkt_status;
+static uint8_t sync_clkn_high;
+static int8_t sync_rssi;
+static uint8_t sync_rssi_valid;
+static volatile uint8_t rearm;     // set by the DMA interrupt, cleared by restart()
+static uint16_t grmdm_save;
+static uint16_t iocfg_save;
+
+static usb_pkt_rx *slot;           // USB packet the DMA is filling
+static uint8_t scratch[DMA_SIZE];  // DMA target while the USB queue is full
+
+/* Point the DMA at the next free USB packet. A packet that was reserved but
+ * never committed is simply reused. */
+static void arm(void)
+{
+	slot = usb_enqueue();
+	if (slot == NULL)
+		pkt_status |= FIFO_OVERFLOW;
+	dma_init_rx_single(slot ? slot->data : scratch, cap_len);
+}
+
+/* Leave RX so the demodulator hunts for a new sync word, drop the trailing
+ * bits the SSP picked up meanwhile and listen again. If the synthesiser
+ * does not settle, rearm stays set and the next poll tries again. */
+static void restart(void)
+{
+	int tries;
+
+	cc2400_strobe(SFSON);
+
+	DIO_SSEL_SET;
+	DIO_SSP_DMACR &= ~SSPDMACR_RXDMAE;
+	DMACC0Config = 0;
+	while (SSP1SR & SSPSR_RNE) {
+		uint8_t tmp = (uint8_t)DIO_SSP_DR;
+		(void)tmp;
+	}
+
+	arm();
+	dio_ssp_start();
+
+	for (tries = 0; tries < FS_ON_TRIES; tries++) {
+		if ((cc2400_get(FSMSTATE) & 0x1f) == STATE_STROBE_FS_ON) {
+			rearm = 0;
+			cc2400_strobe(SRX);
+			return;
+		}
+	}
+}
+
+static void packet_done(void)
+{
+	TRACE(TRACE_DMA_TC, cap_len, channel);
+	if (slot) {
+		slot->pkt_type = pkt_type;
+		slot->status = pkt_status;
+		slot->channel = (uint8_t)((channel - 2402) & 0xff);
+		slot->clkn_high = sync_clkn_high;
+		slot->clk100ns = sync_rx_time;
+		slot->rssi_max = sync_rssi;
+		slot->rssi_min = sync_rssi;
+		slot->rssi_avg = sync_rssi;
+		slot->rssi_count = sync_rssi_valid;
+		memset(slot->data + cap_len, 0, DMA_SIZE - cap_len);
+		usb_enqueue_commit();
+		pkt_status = 0;
+	}
+	++sync_rx_count;
+	RXLED_CLR;
+}
+
+/* Radio registers other than the buffer mode and GIO6 are left as the
+ * caller set them up, including the sync word. len is the number of bytes
+ * kept after the sync word, at most DMA_SIZE. */
+void sync_rx_start(uint8_t type, uint8_t len)
+{
+	pkt_type = type;
+	cap_len = (len == 0 || len > DMA_SIZE) ? DMA_SIZE : len;
+	pkt_status = 0;
+	rearm = 0;
+	sync_rx_syncs = 0;
+	sync_rx_count = 0;
+
+	grmdm_save = cc2400_get(GRMDM);
+	cc2400_set(GRMDM, grmdm_save & ~GRMDM_BUF_MODE);
+	iocfg_save = cc2400_get(IOCFG);
+	cc2400_set(IOCFG, (GIO_SYNC_RECEIVED << 9) | (iocfg_save & 0x1ff));
+
+	dio_ssp_init();
+	arm();
+	sync_rx_active = 1;
+
+	IO2IntClr = PIN_GIO6;
+	IO2IntEnR |= PIN_GIO6;
+	ISER0 = ISER0_ISE_EINT3;
+
+	dio_ssp_start();
+
+	cc2400_strobe(SFSON);
+	while (!(cc2400_status() & FS_LOCK));
+	while ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_FS_ON);
+	cc2400_strobe(SRX);
+}
+
+/* Stop capturing and turn the radio off. Safe to call when idle. */
+void sync_rx_stop(void)
+{
+	if (!sync_rx_active)
+		return;
+
+	/* From here on the DMA and GIO6 interrupts leave the radio alone */
+	sync_rx_active = 0;
+	rearm = 0;
+
+	IO2IntEnR &= ~PIN_GIO6;
+	IO2IntClr = PIN_GIO6;
+	ICER0 = ICER0_ICE_EINT3;
+	dio_ssp_stop();
+
+	cc2400_strobe(SRFOFF);
+	while ((cc2400_status() & FS_LOCK));
+	cc2400_set(IOCFG, iocfg_save);
+	cc2400_set(GRMDM, grmdm_save);
+	RXLED_CLR;
+}
+
+/* Rearm the radio after a packet. Call from the main loop while a capture
+ * runs; it returns straight away when there is nothing to do. */
+void sync_rx_poll(void)
+{
+	if (sync_rx_active && rearm)
+		restart();
+}
+
+/* GIO6 rising edge: the sync word has just been matched. EINT3 outranks
+ * the SPI lock, so RSSI is only sampled when no transaction was cut off;
+ * otherwise the packet goes out with rssi_count 0. */
+void sync_rx_sync_irq(void)
+{
+	sync_rx_time = CLK100NS;
+	sync_clkn_high = (clkn >> 20) & 0xff;
+	IO2IntClr = PIN_GIO6;
+
+	sync_rssi_valid = !cc2400_spi_locked();
+	sync_rssi = sync_rssi_valid ? (int8_t)(cc2400_get(RSSI) >> 8) : 0;
+	++sync_rx_syncs;
+	RXLED_SET;
+}
+
+void sync_rx_DMA_IRQHandler(void)
+{
+	if (!(DMACIntStat & (1 << 0)))
+		return;
+
+	/* An error halts the channel; the packet is dropped and its USB
+	 * slot reused */
+	if (DMACIntErrStat & (1 << 0)) {
+		DMACIntErrClr = (1 << 0);
+		DMACIntTCClear = (1 << 0);
+		pkt_status |= DMA_ERROR;
+		RXLED_CLR;
+		rearm = 1;
+		return;
+	}
+
+	if (DMACIntTCStat & (1 << 0)) {
+		DMACIntTCClear = (1 << 0);
+		packet_done();
+		rearm = 1;
+	}
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SYNC_RX_H
+#define __SYNC_RX_H
+
+#include "inttypes.h"
+
+extern volatile uint8_t sync_rx_active;    // capture running, owns DMA and GIO6
+extern volatile uint32_t sync_rx_syncs;    // sync words matched since start
+extern volatile uint32_t sync_rx_count;    // packets captured since start
+extern volatile uint32_t sync_rx_time;     // CLK100NS of the last sync word
+
+void sync_rx_start(uint8_t pkt_type, uint8_t len);
+void sync_rx_stop(void);
+void sync_rx_poll(void);
+void sync_rx_sync_irq(void);
+void sync_rx_DMA_IRQHandler(void);
+
+#endif /* __SYNC_RX_H */
@@ -26,6 +26,7 @@
 uint8_t cs_no_squelch;       // rx all packets if set
 int8_t cs_threshold_req;     // requested CS threshold in dBm
 int8_t cs_threshold_cur;     // current CS threshold in dBm
+uint8_t cs_hysteresis;       // squelch hysteresis in dB
 volatile uint8_t cs_trigger; // set by intr on P2.2 falling (CS)
 
 typedef enum {
@@ -36,36 +37,62 @@ typedef enum {
 } cs_samples_t;
 
 #define CS_THRESHOLD_DEFAULT (int8_t)(-120)
+#define CS_HYSTERESIS_DEFAULT 3
 
 
 /* Set CC2400 carrier sense threshold and store value to
  * global. CC2400 RSSI is determined by 54dBm + level. CS threshold is
  * in 4dBm steps, so the provided level is rounded to the nearest
  * multiple of 4 by adding 56. Useful range is -100 to -20. */
-static void cs_threshold_set(int8_t level, cs_samples_t samples)
+static void cs_threshold_set(int level, cs_samples_t samples)
 {
 	level = level < -120 ? -120 : level;
 	level = level > -20 ? -20 : level;
 	cc2400_set(RSSI, (uint8_t)((level + 56) & (0x3f << 2)) | ((uint8_t)samples&3));
 	cs_threshold_cur = level;
-	cs_no_squelch = (level <= -120);
 }
 
-void cs_threshold_calc_and_set(uint16_t channel)
+/* Squelch level for channel in raw RSSI units. A positive request is a
+ * margin in dB over the noise floor of the channel; until that floor is
+ * known the squelch stays open. */
+static int8_t cs_squelch_level(uint16_t channel)
 {
-	int8_t level;
+	int level;
 
-	/* If threshold is max/avg based (>0), reset here while rx is
-	 * off.  TODO - max-to-iir only works in SWEEP mode, where the
-	 * channel is known to be in the BT band, i.e., rssi_iir has a
-	 * value for it. */
 	if (cs_threshold_req > 0) {
-		int8_t rssi = rssi_get_avg(channel);
-		level = rssi - 54 + cs_threshold_req;
+		int8_t floor = rssi_get_floor(channel);
+		if (floor == INT8_MIN)
+			return INT8_MIN;
+		level = floor + cs_threshold_req;
 	} else {
 		level = cs_threshold_req;
+		level = level < -120 ? -120 : level;
+		level = level > -20 ? -20 : level;
+		level += 54;
 	}
+
+	return level > INT8_MAX ? INT8_MAX : level;
+}
+
+void cs_threshold_calc_and_set(uint16_t channel)
+{
+	int level;
+
+	/* Called while rx is off, so the hardware threshold follows the
+	 * noise floor of each channel as it is tuned.  An open squelch
+	 * keeps the lowered threshold of its hysteresis. */
+	level = cs_squelch_level(channel) - 54;
+	if (rssi_squelch_state[rssi_slot(channel)].open)
+		level -= cs_hysteresis;
 	cs_threshold_set(level, CS_SAMPLES_4);
+	cs_no_squelch = (cs_threshold_req <= CS_THRESHOLD_DEFAULT);
+}
+
+/* Run the squelch gate on the block just measured on channel. Returns
+ * nonzero while the block should go to the host. */
+int cs_squelch_open(uint16_t channel)
+{
+	return rssi_squelch(channel, cs_squelch_level(channel), cs_hysteresis);
 }
 
 /* CS comes from CC2400 GIO6, which is LPC P2.2, active low. GPIO
@@ -95,4 +122,5 @@ void cs_reset(void)
 	cs_no_squelch = 0;
 	cs_threshold_req=CS_THRESHOLD_DEFAULT;
 	cs_threshold_cur=CS_THRESHOLD_DEFAULT;
+	cs_hysteresis=CS_HYSTERESIS_DEFAULT;
 }
@@ -29,9 +29,11 @@
 extern uint8_t cs_no_squelch;       // rx all packets if set
 extern int8_t cs_threshold_req;     // requested CS threshold in dBm
 extern int8_t cs_threshold_cur;     // current CS threshold in dBm
+extern uint8_t cs_hysteresis;       // squelch hysteresis in dB
 extern volatile uint8_t cs_trigger; // set by intr on P2.2 falling (CS)
 
 void cs_threshold_calc_and_set(uint16_t channel);
+int cs_squelch_open(uint16_t channel);
 void cs_trigger_enable(void);
 void cs_trigger_disable(void);
 void cs_reset(void);
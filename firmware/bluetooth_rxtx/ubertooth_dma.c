@@ -136,6 +136,28 @@ void dma_init_rx_symbols(void) {
 	DMACC0Config |= 1;
 }
 
+/* Single transfer of len bytes from DIO into dest, one byte per request so
+ * that lengths which are not a multiple of the SSP burst size complete. */
+void dma_init_rx_single(volatile uint8_t *dest, unsigned len) {
+	dma_clear_interrupts(0);
+
+	/* configure DMA channel 0 */
+	DMACC0SrcAddr = (uint32_t)&(DIO_SSP_DR);
+	DMACC0DestAddr = (uint32_t)dest;
+	DMACC0LLI = 0;
+	DMACC0Control = (len & 0xfff) |
+			(0 << 12) |        /* source burst size = 1 */
+			(0 << 15) |        /* destination burst size = 1 */
+			(0 << 18) |        /* source width 8 bits */
+			(0 << 21) |        /* destination width 8 bits */
+			DMACCxControl_DI | /* destination increment */
+			DMACCxControl_I;   /* terminal count interrupt enable */
+	DMACC0Config = DIO_SSP_SRC
+	               | (0x2 << 11)       /* peripheral to memory */
+	               | DMACCxConfig_IE   /* allow error interrupts */
+	               | DMACCxConfig_ITC; /* allow terminal count interrupts */
+}
+
 void dma_init_le(void) {
 	int i;
 
@@ -43,6 +43,7 @@ void dma_poweron();
 void dma_poweroff();
 void dma_init_rx_symbols();
 void dma_init_le();
+void dma_init_rx_single(volatile uint8_t *dest, unsigned len);
 void dio_ssp_start();
 void dio_ssp_stop();
 
@@ -19,23 +19,52 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include "ubertooth.h"
 #include "ubertooth_rssi.h"
 
 #include <string.h>
 
 #define RSSI_IIR_ALPHA 3       // 3/256 = .012
 
+/* The noise floor falls to a quieter block average within a few blocks
+ * but rises only slowly, so bursts of traffic barely lift it. */
+#define RSSI_FLOOR_FALL 64     // 64/256 = .25
+#define RSSI_FLOOR_RISE 1      // 1/256 = .004
+
 int8_t rssi_max;
 int8_t rssi_min;
 uint8_t rssi_count;
 
 int32_t rssi_sum;
-int16_t rssi_iir[79] = {0};
+int16_t rssi_iir[RSSI_CHANNELS] = {0};
 
-void rssi_reset(void)
+/* Per channel noise floor and squelch state, ~1.2K: in AHB SRAM */
+int16_t rssi_floor[RSSI_CHANNELS] __ahbram;
+uint8_t rssi_floor_valid[RSSI_CHANNELS] __ahbram;
+
+rssi_squelch_t rssi_squelch_state[RSSI_CHANNELS] __ahbram;
+
+/* Scaled int math (x256): divide by 256 rounding to nearest. RSSI values
+ * are mostly negative, so rounding toward zero would bias them up. */
+static int32_t rssi_unscale(int32_t v)
 {
-	memset(rssi_iir, 0, sizeof(rssi_iir));
+	return (v >= 0 ? v + 128 : v - 128) / 256;
+}
+
+/* Use the array to track the 79 Bluetooth channels, or the last slot of
+ * the array if the frequency is not a valid Bluetooth channel. */
+unsigned rssi_slot(uint16_t channel)
+{
+	if (channel < 2402 || channel > 2480)
+		return RSSI_CHANNELS - 1;
+
+	return channel - 2402;
+}
 
+/* Start a new block.  The per-channel averages and noise floor carry over
+ * from block to block and from one mode to the next. */
+void rssi_reset(void)
+{
 	rssi_count = 0;
 	rssi_sum = 0;
 	rssi_max = INT8_MIN;
@@ -55,30 +84,76 @@ void rssi_iir_update(uint16_t channel)
 {
 	int32_t avg;
 	int32_t rssi_iir_acc;
+	int32_t alpha;
+	unsigned i = rssi_slot(channel);
 
-	/* Use array to track 79 Bluetooth channels, or just first slot
-	 * of array if the frequency is not a valid Bluetooth channel. */
-	if ( channel < 2402 || channel < 2480 )
-		channel = 2402;
-
-	int i = channel - 2402;
+	if (rssi_count == 0)
+		return; // really an error
 
 	// IIR using scaled int math (x256)
-	if (rssi_count != 0)
-		avg = (rssi_sum  + 128) / rssi_count;
-	else
-		avg = 0; // really an error
+	avg = rssi_sum / rssi_count;
 	rssi_iir_acc = rssi_iir[i] * (256-RSSI_IIR_ALPHA);
 	rssi_iir_acc += avg * RSSI_IIR_ALPHA;
-	rssi_iir[i] = (int16_t)((rssi_iir_acc + 128) / 256);
+	rssi_iir[i] = (int16_t)rssi_unscale(rssi_iir_acc);
+
+	/* Noise floor: seeded by the first block on the channel, then an
+	 * IIR that is fast going down and slow going up. */
+	if (!rssi_floor_valid[i]) {
+		rssi_floor[i] = (int16_t)avg;
+		rssi_floor_valid[i] = 1;
+		return;
+	}
+	alpha = (avg < rssi_floor[i]) ? RSSI_FLOOR_FALL : RSSI_FLOOR_RISE;
+	rssi_iir_acc = rssi_floor[i] * (256-alpha);
+	rssi_iir_acc += avg * alpha;
+	rssi_floor[i] = (int16_t)rssi_unscale(rssi_iir_acc);
 }
 
 int8_t rssi_get_avg(uint16_t channel)
 {
-	/* Use array to track 79 Bluetooth channels, or just first slot
-	 * of array if the frequency is not a valid Bluetooth channel. */
-	if ( channel < 2402 || channel < 2480 )
-		channel = 2402;
+	return rssi_unscale(rssi_iir[rssi_slot(channel)]);
+}
 
-	return (rssi_iir[channel-2402] + 128) / 256;
+/* Noise floor of the channel in raw RSSI units, or INT8_MIN while no
+ * block has been measured on it yet. */
+int8_t rssi_get_floor(uint16_t channel)
+{
+	unsigned i = rssi_slot(channel);
+
+	if (!rssi_floor_valid[i])
+		return INT8_MIN;
+
+	return rssi_unscale(rssi_floor[i]);
+}
+
+/* Squelch gate for the block just measured on channel.  The gate opens
+ * once the block's peak reaches level and closes again only when the
+ * peak falls hysteresis below it, so a signal sitting right at the
+ * threshold does not chop the stream.  Returns the new gate state. */
+int rssi_squelch(uint16_t channel, int8_t level, uint8_t hysteresis)
+{
+	rssi_squelch_t *sq = &rssi_squelch_state[rssi_slot(channel)];
+	int threshold = level;
+
+	if (sq->open)
+		threshold -= hysteresis;
+	sq->open = (rssi_max >= threshold);
+
+	return sq->open;
+}
+
+/* Count a block on channel as passed to the host or dropped. */
+void rssi_squelch_count(uint16_t channel, int passed)
+{
+	rssi_squelch_t *sq = &rssi_squelch_state[rssi_slot(channel)];
+
+	if (passed)
+		++sq->passed;
+	else
+		++sq->dropped;
+}
+
+void rssi_squelch_reset(void)
+{
+	memset(rssi_squelch_state, 0, sizeof(rssi_squelch_state));
 }
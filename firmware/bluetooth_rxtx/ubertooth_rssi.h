@@ -24,13 +24,28 @@
 
 #include "inttypes.h"
 
+/* 79 Bluetooth channels plus one slot for everything else */
+#define RSSI_CHANNELS 80
+
+typedef struct {
+	uint8_t  open;      // squelch gate state, see rssi_squelch()
+	uint32_t passed;    // blocks sent to the host
+	uint32_t dropped;   // blocks held back by the squelch
+} rssi_squelch_t;
+
 extern int8_t rssi_max;
 extern int8_t rssi_min;
 extern uint8_t rssi_count;
+extern rssi_squelch_t rssi_squelch_state[RSSI_CHANNELS];
 
+unsigned rssi_slot(uint16_t channel);
 void rssi_reset(void);
 void rssi_add(int8_t v);
 void rssi_iir_update(uint16_t channel);
 int8_t rssi_get_avg(uint16_t channel);
+int8_t rssi_get_floor(uint16_t channel);
+int rssi_squelch(uint16_t channel, int8_t level, uint8_t hysteresis);
+void rssi_squelch_count(uint16_t channel, int passed);
+void rssi_squelch_reset(void);
 
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth and is released under the
+ * terms of the GPL. Refer to COPYING for more information.
+ */
+
+#include "ubertooth_sched.h"
+#include "ubertooth.h"
+#include "ubertooth_trace.h"
+
+typedef struct {
+	uint32_t when;
+	sched_cb_t cb;
+	void *arg;
+} sched_event_t;
+
+/* sorted by deadline, earliest first */
+static sched_event_t queue[SCHED_MAX_EVENTS];
+static uint8_t queue_len = 0;
+
+#define BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+void sched_init(void)
+{
+	PCONP |= PCONP_PCTIM3;
+	T3TCR = TCR_Counter_Reset;
+#ifdef TC13BADGE
+	T3PR = 2; // 30 MHz pclk
+#else
+	T3PR = 4; // 50 MHz pclk
+#endif
+	T3MCR = 0;
+	T3IR = TIR_MR0_Interrupt | TIR_MR1_Interrupt;
+	queue_len = 0;
+	T3TCR = TCR_Counter_Enable;
+
+	ISER0 = ISER0_ISE_TIMER3;
+}
+
+void sched_stop(void)
+{
+	T3TCR = TCR_Counter_Reset;
+	ICER0 = ICER0_ICE_TIMER3;
+	PCONP &= ~PCONP_PCTIM3;
+	queue_len = 0;
+}
+
+/* point MR0 at the earliest deadline */
+static void sched_arm(void)
+{
+	if (queue_len == 0) {
+		T3MCR &= ~TMCR_MR0I;
+		return;
+	}
+	T3MR0 = queue[0].when;
+	T3MCR |= TMCR_MR0I;
+}
+
+int sched_at(uint32_t when, sched_cb_t cb, void *arg)
+{
+	int i;
+
+	if (queue_len == SCHED_MAX_EVENTS) {
+		TRACE(TRACE_SCHED_FULL, queue_len, (uint32_t)cb);
+		return -1;
+	}
+
+	/* events with equal deadlines run in the order they were queued */
+	for (i = queue_len; i > 0 && BEFORE(when, queue[i - 1].when); i--)
+		queue[i] = queue[i - 1];
+	queue[i].when = when;
+	queue[i].cb = cb;
+	queue[i].arg = arg;
+	queue_len++;
+
+	if (i == 0)
+		sched_arm();
+	return 0;
+}
+
+int sched_in(uint32_t delay, sched_cb_t cb, void *arg)
+{
+	return sched_at(SCHED_NOW + delay, cb, arg);
+}
+
+void sched_cancel(sched_cb_t cb)
+{
+	int i, j;
+
+	for (i = 0, j = 0; i < queue_len; i++) {
+		if (queue[i].cb != cb)
+			queue[j++] = queue[i];
+	}
+	queue_len = j;
+	sched_arm();
+}
+
+void sched_reset(void)
+{
+	queue_len = 0;
+	sched_arm();
+}
+
+int sched_run(void)
+{
+	sched_event_t ev;
+	int i, n = 0;
+
+	while (queue_len > 0 && !BEFORE(SCHED_NOW, queue[0].when)) {
+		ev = queue[0];
+		for (i = 1; i < queue_len; i++)
+			queue[i - 1] = queue[i];
+		queue_len--;
+
+		/* the callback is free to queue further events */
+		ev.cb(ev.arg);
+		n++;
+	}
+	sched_arm();
+	return n;
+}
+
+/*
+ * Interrupts are masked around the check so that a match landing between
+ * the check and WFI stays pending and wakes the core straight away.
+ */
+void sched_wait(void)
+{
+	asm volatile("cpsid i" ::: "memory");
+	if (queue_len == 0 || BEFORE(SCHED_NOW, queue[0].when))
+		asm volatile("wfi");
+	asm volatile("cpsie i" ::: "memory");
+}
+
+void sched_delay(uint32_t delay)
+{
+	uint32_t until = SCHED_NOW + delay;
+
+	T3MR1 = until;
+	T3MCR |= TMCR_MR1I;
+	while (1) {
+		asm volatile("cpsid i" ::: "memory");
+		if (!BEFORE(SCHED_NOW, until))
+			break;
+		asm volatile("wfi");
+		asm volatile("cpsie i" ::: "memory");
+	}
+	asm volatile("cpsie i" ::: "memory");
+	T3MCR &= ~TMCR_MR1I;
+}
+
+/* The match interrupts only exist to wake the core from WFI. */
+void TIMER3_IRQHandler(void)
+{
+	if (T3IR & TIR_MR0_Interrupt)
+		T3IR = TIR_MR0_Interrupt;
+	if (T3IR & TIR_MR1_Interrupt)
+		T3IR = TIR_MR1_Interrupt;
+}
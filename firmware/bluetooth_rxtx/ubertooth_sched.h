@@ -0,0 +1,66 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth and is released under the
+ * terms of the GPL. Refer to COPYING for more information.
+ */
+
+#ifndef __UBERTOOTH_SCHED_H
+#define __UBERTOOTH_SCHED_H value
+
+#include "inttypes.h"
+
+/*
+ * Deadline-driven event scheduler
+ *
+ * TIMER3 runs free at 100 ns per tick. Events are kept in a small queue
+ * sorted by deadline and the match register MR0 is always armed for the
+ * earliest one. The interrupt only wakes the CPU; callbacks are dispatched
+ * from sched_run() in thread context, so they may touch the radio and USB
+ * just like the old busy loops did.
+ *
+ * Deadlines are compared using signed differences, so they must lie
+ * within 2^31 ticks (about 3.5 minutes) of the current time.
+ *
+ * Only the main loop, specan, led_specan, rx_generic and msleep() run on
+ * the scheduler. The BR and LE modes still hop from the TIMER0 CLKN
+ * interrupt and spin in their own loops while a mode is active.
+ *
+ * A full queue refuses the event and leaves a TRACE_SCHED_FULL in the
+ * trace; callers must check the result, a lost event is never retried.
+ */
+
+#define SCHED_USEC(x)      ((x) * 10)
+#define SCHED_MSEC(x)      ((x) * 10000)
+
+#define SCHED_MAX_EVENTS   8
+
+typedef void (*sched_cb_t)(void *arg);
+
+void sched_init(void);
+void sched_stop(void);
+
+/* current time in 100 ns ticks */
+#define SCHED_NOW T3TC
+
+/* Queue cb to run at (or as soon as possible after) 'when'. Returns 0, or
+ * -1 if the queue is full. */
+int sched_at(uint32_t when, sched_cb_t cb, void *arg);
+int sched_in(uint32_t delay, sched_cb_t cb, void *arg);
+
+/* remove every queued instance of cb */
+void sched_cancel(sched_cb_t cb);
+
+/* drop all queued events */
+void sched_reset(void);
+
+/* Run every event whose deadline has passed. Returns the number run. */
+int sched_run(void);
+
+/* Sleep until an interrupt arrives, unless an event is already due. */
+void sched_wait(void);
+
+/* Sleep for 'delay' ticks without dispatching any events. */
+void sched_delay(uint32_t delay);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "ubertooth_trace.h"
+#include "ubertooth.h"
+#include "ubertooth_sched.h"
+
+/*
+ * Binary trace ring. Events are written from any context, so the few
+ * instructions that claim and fill a slot run with interrupts masked.
+ * head and tail are free running counts of written and read events.
+ */
+
+volatile uint8_t trace_enabled = 0;
+
+static trace_event ring[TRACE_EVENTS] __ahbram; // 3K
+static uint32_t head;
+static uint32_t tail;
+static uint16_t lost;
+
+static inline uint32_t irq_save(void)
+{
+	uint32_t primask;
+
+	asm volatile("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+	return primask;
+}
+
+static inline void irq_restore(uint32_t primask)
+{
+	asm volatile("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+void trace_start(void)
+{
+	uint32_t primask = irq_save();
+
+	head = 0;
+	tail = 0;
+	lost = 0;
+	trace_enabled = 1;
+	irq_restore(primask);
+}
+
+void trace_stop(void)
+{
+	trace_enabled = 0;
+}
+
+void trace_emit(uint8_t id, uint16_t arg0, uint32_t arg1)
+{
+	uint32_t primask = irq_save();
+	trace_event *ev;
+
+	if (head - tail == TRACE_EVENTS) {
+		++tail;
+		if (lost != UINT16_MAX)
+			++lost;
+	}
+	ev = &ring[head++ & (TRACE_EVENTS - 1)];
+	ev->time = SCHED_NOW;
+	ev->id = id;
+	ev->reserved = 0;
+	ev->arg0 = arg0;
+	ev->arg1 = arg1;
+
+	irq_restore(primask);
+}
+
+/* Move the oldest events into page. Returns the reply length in bytes. */
+int trace_read(trace_page *page)
+{
+	uint32_t primask = irq_save();
+	unsigned n = 0;
+
+	page->lost = lost;
+	lost = 0;
+	while (tail != head && n < TRACE_PAGE_EVENTS) {
+		memcpy(&page->events[n++], &ring[tail++ & (TRACE_EVENTS - 1)],
+				sizeof(trace_event));
+	}
+	page->count = n;
+	page->reserved = 0;
+
+	irq_restore(primask);
+
+	return sizeof(trace_page) - (TRACE_PAGE_EVENTS - n) * sizeof(trace_event);
+}
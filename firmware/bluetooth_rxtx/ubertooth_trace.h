@@ -0,0 +1,44 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_TRACE_H
+#define __UBERTOOTH_TRACE_H
+
+#include "inttypes.h"
+#include "ubertooth_interface.h"
+
+#define TRACE_EVENTS 256 // ring size, a power of two
+
+extern volatile uint8_t trace_enabled;
+
+void trace_start(void);
+void trace_stop(void);
+void trace_emit(uint8_t id, uint16_t arg0, uint32_t arg1);
+int trace_read(trace_page *page);
+
+/* Record an event, see enum trace_event_ids. Costs a flag test while
+ * tracing is off, so it may sit in interrupt handlers and hot loops. */
+#define TRACE(id, arg0, arg1) do { \
+	if (trace_enabled) \
+		trace_emit((id), (arg0), (arg1)); \
+} while (0)
+
+#endif /* __UBERTOOTH_TRACE_H */
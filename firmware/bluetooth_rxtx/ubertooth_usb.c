@@ -50,6 +50,8 @@
 #include "usbapi.h"
 #include "usbhw_lpc.h"
 #include "ubertooth.h"
+#include "ubertooth_clock.h"
+#include "ubertooth_trace.h"
 #include "ubertooth_usb.h"
 #include <string.h>
 
@@ -74,11 +76,6 @@
 
 #define LE_WORD(x)		((x)&0xFF),((x)>>8)
 
-/*
- * This is supposed to be a lock-free ring buffer, but I haven't verified
- * atomicity of the operations on head and tail.
- */
-
 static u8 abDescriptors[] = {
 
 /* Device descriptor */
@@ -91,7 +88,7 @@ static u8 abDescriptors[] = {
 	MAX_PACKET_SIZE0,  		// bMaxPacketSize
 	LE_WORD(ID_VENDOR),		// idVendor
 	LE_WORD(ID_PRODUCT),		// idProduct
-	LE_WORD(0x0107),		// bcdDevice
+	LE_WORD(0x0109),		// bcdDevice
 	0x01,              		// iManufacturer
 	0x02,              		// iProduct
 	0x03,              		// iSerialNumber
@@ -195,13 +192,15 @@ static u8 abDescriptors[] = {
 
 u8 abVendorReqData[258];
 
-/* Unused functions
-void usb_bulk_in_handler(u8 bEP, u8 bEPStatus)
+static void bulk_in_service(void);
+
+/* The host has taken a packet out of the bulk IN endpoint */
+static void usb_bulk_in_handler(u8 bEP, u8 bEPStatus)
 {
-	if (!(bEPStatus & EP_STATUS_DATA))
-		dequeue_send();
+	bulk_in_service();
 }
 
+/* Unused functions
 void usb_bulk_out_handler(u8 bEP, u8 bEPStatus)
 {
 }
@@ -235,6 +234,8 @@ void set_serial_descriptor(u8 *descriptors) {
 	}
 }
 
+static void usb_dma_init(void);
+
 int ubertooth_usb_init(VendorRequestHandler *vendor_req_handler)
 {
 	// initialise stack
@@ -252,31 +253,158 @@ int ubertooth_usb_init(VendorRequestHandler *vendor_req_handler)
 	USBRegisterRequestHandler(REQTYPE_TYPE_VENDOR, usb_vendor_request_handler, abVendorReqData);
 
 	// register endpoints
-	//USBHwRegisterEPIntHandler(BULK_IN_EP, usb_bulk_in_handler);
+	USBHwRegisterEPIntHandler(BULK_IN_EP, usb_bulk_in_handler);
 	//USBHwRegisterEPIntHandler(BULK_OUT_EP, usb_bulk_out_handler);
 
-	// enable USB interrupts
-	//ISER0 = ISER0_ISE_USB;
-
 	// Enable WCID / driverless setup on Windows - Consumes Vendor Request 0xFF
 	USBRegisterWinusbInterface(0xFF, "{8ac47a88-cc26-4aa9-887b-42ca8cf07a63}");
 
+	usb_dma_init();
+
+	// enable USB interrupts at the lowest priority, alongside GPDMA
+	IPR6 |= IPR6_IP_USB;
+	ISER0 = ISER0_ISE_USB;
+
 	// connect to bus
 	USBHwConnect(TRUE);
 
 	return 0;
 }
 
-usb_pkt_rx fifo[128];
+/*
+ * Packet queue
+ *
+ * A lock-free single-producer single-consumer ring.  The producer is
+ * whichever radio loop the current mode runs, in thread mode; it alone
+ * writes tail.  The consumer is the USB interrupt, which alone writes
+ * head.  Both indices are free running and only ever stored whole, and
+ * aligned word accesses are atomic on the Cortex-M3, so neither side
+ * can see the other's index torn.
+ *
+ * The producer fills the slot returned by usb_enqueue() and then
+ * publishes it with usb_enqueue_commit(), which advances tail only
+ * after a barrier, so the consumer never reads a half written packet.
+ * No producer can preempt the USB interrupt, so a slot the consumer has
+ * copied out with the CPU may be reused as soon as head moves past it.
+ */
+usb_pkt_rx fifo[128] __ahbram;
 
 volatile u32 head = 0;
 volatile u32 tail = 0;
 
+/*
+ * Bulk IN DMA
+ *
+ * Once the host is streaming from the bulk IN endpoint, packets are
+ * moved into the endpoint by the USB DMA engine straight out of the
+ * queue.  Whenever the engine is idle, every queued packet is handed to
+ * it as a chain of at most two descriptors (two when the run wraps
+ * around the end of the queue).  head only moves past a packet once the
+ * descriptor carrying it has been retired, so usb_enqueue() never
+ * reuses a slot the engine is still reading.
+ *
+ * Hosts that fetch packets with UBERTOOTH_POLL instead never read the
+ * bulk endpoint, and a descriptor chain handed to the engine would
+ * never retire.  The queue therefore starts out writing packets with
+ * the CPU and only switches to DMA once the host has been seen
+ * emptying the endpoint.
+ */
+#define USB_DMA_DDS 2
+#define DD_RETIRED  (1 << 0)
+#define DD_STATUS(dd) (((dd)[3] >> 1) & 0xF)
+#define DD_NORMAL_COMPLETION 2
+
+/* The engine only reaches AHB SRAM: the queue, descriptors and UDCA
+ * (Endpoint Communication Area, 128 byte aligned) all live there */
+static volatile U32 *udca[32] __ahbram __attribute__((aligned(128)));
+static volatile U32 dma_dd[USB_DMA_DDS][4] __ahbram;
+static u8 dma_pkts[USB_DMA_DDS];
+static u8 dma_active = 0;
+static u8 bulk_reader = 0;   // host seen reading the bulk IN endpoint
+static u8 cpu_writes = 0;    // packets written by the CPU since init
+static u32 usb_dma_errors = 0;   // descriptors retired with an error
+
+static void usb_dma_init(void)
+{
+	USBInitializeUSBDMA(udca);
+	USBDisableDMAForEndpoint(BULK_IN_EP);
+	dma_active = 0;
+
+	// retiring a descriptor wakes the USB interrupt
+	USBEoTIntClr = 0xFFFFFFFF;
+	USBDMAIntEn = USBDMAIntEn_EOT;
+}
+
+/* Hand every queued packet to the DMA engine, returns 1 if there were any */
+static int usb_dma_start(void)
+{
+	u8 h = head & 0x7F;
+	u8 t = tail & 0x7F;
+
+	if (h == t)
+		return 0;
+
+	if (t > h) {
+		dma_pkts[0] = t - h;
+		dma_pkts[1] = 0;
+	} else {
+		dma_pkts[0] = 128 - h;
+		dma_pkts[1] = t;
+	}
+
+	USBSetupDMADescriptor(dma_dd[1], NULL, 0, MAX_PACKET_SIZE,
+	                      dma_pkts[1] * sizeof(usb_pkt_rx), &fifo[0], NULL);
+	USBSetupDMADescriptor(dma_dd[0], dma_pkts[1] ? dma_dd[1] : NULL, 0,
+	                      MAX_PACKET_SIZE, dma_pkts[0] * sizeof(usb_pkt_rx),
+	                      &fifo[h], NULL);
+
+	dma_active = 1;
+	USBSetHeadDDForDMA(BULK_IN_EP, udca, dma_dd[0]);
+	USBEnableDMAForEndpoint(BULK_IN_EP);
+	return 1;
+}
+
+/* Release the slots of retired descriptors, returns 1 while the engine is busy */
+static int usb_dma_poll(void)
+{
+	int i;
+
+	if (!dma_active)
+		return 0;
+
+	for (i = 0; i < USB_DMA_DDS; i++) {
+		if (dma_pkts[i] == 0)
+			continue;
+		if (!(dma_dd[i][3] & DD_RETIRED))
+			return 1;
+		if (DD_STATUS(dma_dd[i]) != DD_NORMAL_COMPLETION)
+			usb_dma_errors++;
+		head += dma_pkts[i];
+		dma_pkts[i] = 0;
+	}
+
+	USBDisableDMAForEndpoint(BULK_IN_EP);
+	dma_active = 0;
+	return 0;
+}
+
+/* Drop all queued packets. Only from the main loop, on mode entry: the
+ * radio loop may be filling a slot. */
 void usb_queue_init(void)
 {
+	ICER0 = ICER0_ICE_USB;
+
+	USBDisableDMAForEndpoint(BULK_IN_EP);
+	dma_active = 0;
+	dma_pkts[0] = dma_pkts[1] = 0;
+	bulk_reader = 0;
+	cpu_writes = 0;
+
 	head = 0;
 	tail = 0;
 	memset(fifo, 0, sizeof(fifo));
+
+	ISER0 = ISER0_ISE_USB;
 }
 
 usb_pkt_rx *usb_enqueue(void)
@@ -287,12 +415,26 @@ usb_pkt_rx *usb_enqueue(void)
 
 	/* fail if queue is full */
 	if (h == n) {
+		TRACE(TRACE_DROP, TRACE_DROP_QUEUE_FULL, 0);
 		return NULL;
 	}
 
-	++tail;
 	return &fifo[t];
+}
 
+/* Publish the slot filled since the last usb_enqueue() */
+void usb_enqueue_commit(void)
+{
+	TRACE(TRACE_ENQUEUE, fifo[tail & 0x7F].pkt_type, tail + 1 - head);
+	asm volatile("dmb" ::: "memory");
+	++tail;
+	usb_kick();
+}
+
+/* Have the USB interrupt look at the queue and the keep-alive timer */
+void usb_kick(void)
+{
+	ISPR0 = ISPR0_ISP_USB;
 }
 
 usb_pkt_rx *dequeue(void)
@@ -300,6 +442,10 @@ usb_pkt_rx *dequeue(void)
 	u8 h = head & 0x7F;
 	u8 t = tail & 0x7F;
 
+	/* packets already handed to the DMA engine are not ours to give */
+	if (dma_active)
+		return NULL;
+
 	/* fail if queue is empty */
 	if (h == t) {
 		return NULL;
@@ -312,36 +458,56 @@ usb_pkt_rx *dequeue(void)
 #define USB_KEEP_ALIVE 400000
 u32 last_usb_pkt = 0;  // for keep alive packets
 
-int dequeue_send(u32 clkn)
+static int dequeue_send(void)
 {
 	usb_pkt_rx *pkt = dequeue();
 	if (pkt != NULL) {
 		last_usb_pkt = clkn;
 		USBHwEPWrite(BULK_IN_EP, (u8 *)pkt, sizeof(usb_pkt_rx));
+		cpu_writes = 1;
 		return 1;
 	} else {
 		if (clkn - last_usb_pkt > USB_KEEP_ALIVE) {
 			u8 pkt_type = KEEP_ALIVE;
 			last_usb_pkt = clkn;
 			USBHwEPWrite(BULK_IN_EP, &pkt_type, 1);
+			cpu_writes = 1;
 		}
 		return 0;
 	}
 }
 
-void handle_usb(u32 clkn)
+static void bulk_in_service(void)
 {
 	u8 epstat;
 
 	/* write queued packets to USB if possible */
+	if (usb_dma_poll())
+		return;
+
 	epstat = USBHwEPGetStatus(BULK_IN_EP);
-	if (!(epstat & EPSTAT_B1FULL)) {
-		dequeue_send(clkn);
-	}
-	if (!(epstat & EPSTAT_B2FULL)) {
-		dequeue_send(clkn);
+	if (!bulk_reader && cpu_writes &&
+	    !(epstat & (EPSTAT_B1FULL | EPSTAT_B2FULL)))
+		bulk_reader = 1;
+
+	if (bulk_reader) {
+		if (usb_dma_start())
+			last_usb_pkt = clkn;
+		else if (!(epstat & EPSTAT_B1FULL))
+			dequeue_send();
+	} else {
+		if (!(epstat & EPSTAT_B1FULL)) {
+			dequeue_send();
+		}
+		if (!(epstat & EPSTAT_B2FULL)) {
+			dequeue_send();
+		}
 	}
+}
 
-	/* polled "interrupt" */
+void USB_IRQHandler(void)
+{
+	USBEoTIntClr = USBEoTIntSt;
+	bulk_in_service();
 	USBHwISR();
 }
@@ -58,7 +58,8 @@ typedef int (VendorRequestHandler)(u8 request, u16 *request_params, u8 *data, in
 int ubertooth_usb_init(VendorRequestHandler *vendor_req_handler);
 void usb_queue_init();
 usb_pkt_rx *usb_enqueue();
+void usb_enqueue_commit(void);
 usb_pkt_rx *dequeue();
-void handle_usb(u32 clkn);
+void usb_kick(void);
 
 #endif /* __UBERTOOTH_USB_H */
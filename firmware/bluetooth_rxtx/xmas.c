@@ -35,9 +35,6 @@ static void timer2_stop(void) {
 #define BLINK (NOW + 400 + (rand() % 1200))
 
 void xmas_main(void) {
-	// enable USB interrupts
-	ISER0 = ISER0_ISE_USB;
-
 	timer2_start();
 
 	T2MR0 = BLINK;
@@ -50,9 +47,6 @@ void xmas_main(void) {
 		asm("WFI"); // wait for interrupt
 
 	timer2_stop();
-
-	// disable USB interrupts
-	ICER0 = ICER0_ICE_USB;
 }
 
 void TIMER2_IRQHandler(void) {
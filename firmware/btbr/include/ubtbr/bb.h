@@ -102,13 +102,52 @@ static inline uint8_t reverse8(uint8_t data)
 	extern const uint8_t rev8_map[256];
         return rev8_map[data];
 }
+
 static inline uint16_t reverse16(uint16_t data)
 {
         return (uint16_t)reverse8(data>>8) | (uint16_t)(reverse8(data&0xff)<<8);
 }
+
 static inline uint32_t reverse32(uint32_t data)
 {
+#ifdef __ARM_ARCH_7M__
+	uint32_t r;
+
+	__asm__ ("rbit %0, %1" : "=r" (r) : "r" (data));
+	return r;
+#else
         return (uint32_t)reverse16(data>>16)|((uint32_t)reverse16(data&0xffff)<<16);
+#endif
+}
+
+/* Reverse the bits of each byte of a word */
+static inline uint32_t reverse8x4(uint32_t data)
+{
+#ifdef __ARM_ARCH_7M__
+	uint32_t r;
+
+	__asm__ ("rbit %0, %1\n\trev %0, %0" : "=&r" (r) : "r" (data));
+	return r;
+#else
+	return (uint32_t)reverse8(data) | ((uint32_t)reverse8(data>>8)<<8)
+		| ((uint32_t)reverse8(data>>16)<<16) | ((uint32_t)reverse8(data>>24)<<24);
+#endif
+}
+
+/* Unaligned little-endian word access, a single ldr/str on cortex-m3.
+ * Readers may touch up to 3 bytes past the last bit they use. */
+typedef struct {
+	uint32_t v;
+} __attribute__((packed)) una_u32_t;
+
+static inline uint32_t load32(const uint8_t *p)
+{
+	return ((const una_u32_t*)p)->v;
+}
+
+static inline void store32(uint8_t *p, uint32_t v)
+{
+	((una_u32_t*)p)->v = v;
 }
 
 #ifdef DEBUG_CODE
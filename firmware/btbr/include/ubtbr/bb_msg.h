@@ -4,6 +4,7 @@
 #include <ubtbr/debug.h>
 #include <ubtbr/mem_pool.h>
 #define btctl_mem_alloc mem_pool_alloc
+#define btctl_mem_alloc_reserved mem_pool_alloc_reserved
 #define btctl_mem_free	mem_pool_free
 #include <ubtbr/msg.h>
 
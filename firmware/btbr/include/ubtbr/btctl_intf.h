@@ -12,6 +12,11 @@ typedef struct btctl_s {
 	msg_queue_t acl_tx_q;
 	msg_t *eir_msg;
 	btctl_tx_pkt_t *eir_pkt;
+	/* RX slots skipped for want of a buffer */
+	uint32_t slot_drops;
+	/* flow control state last reported to host */
+	uint8_t congested;
+	uint32_t lost;
 } btctl_t;
 
 extern btctl_t btctl;
@@ -31,19 +36,45 @@ static inline btctl_tx_pkt_t *btctl_get_eir(void)
 	return btctl.eir_pkt;
 }
 
-static inline msg_t *btctl_msg_alloc(unsigned type)
+static inline msg_t *btctl_msg_init(msg_t *msg, unsigned type)
 {
-	msg_t *msg;
 	btctl_hdr_t *hdr;
 
-	/* maximum size ?*/
-	msg = msg_alloc(sizeof(btctl_hdr_t)+sizeof(btctl_rx_pkt_t)+MAX_ACL_PACKET_SIZE);
+	if (msg == NULL)
+		return NULL;
 	hdr = (btctl_hdr_t*) msg_put(msg, sizeof(*hdr));
 	hdr->type = type;
 
 	return msg;
 }
 
+/* Allocate a message with room for any payload.
+ * All btctl_*msg_alloc return NULL when out of buffers. */
+static inline msg_t *btctl_msg_alloc(unsigned type)
+{
+	/* maximum size ?*/
+	return btctl_msg_init(msg_alloc(sizeof(btctl_hdr_t)+sizeof(btctl_rx_pkt_t)+MAX_ACL_PACKET_SIZE), type);
+}
+
+/* Allocate a control message from the small buffers */
+static inline msg_t *btctl_msg_alloc_small(unsigned type)
+{
+	return btctl_msg_init(msg_alloc(sizeof(btctl_hdr_t)+MEM_POOL_SMALL_PAYLOAD), type);
+}
+
+/* Allocate a RX packet, may use the reserved buffers */
+static inline msg_t *btctl_rx_pkt_alloc(void)
+{
+	return btctl_msg_init(msg_alloc_reserved(sizeof(btctl_hdr_t)+sizeof(btctl_rx_pkt_t)+MAX_ACL_PACKET_SIZE), BTCTL_RX_PKT);
+}
+
+/* Allocate a RX packet without room for data, from the small reserve.
+ * Only for skipped slots: the rx callback frees it before the next. */
+static inline msg_t *btctl_rx_empty_alloc(void)
+{
+	return btctl_msg_init(msg_alloc_reserved(sizeof(btctl_hdr_t)+sizeof(btctl_rx_pkt_t)), BTCTL_RX_PKT);
+}
+
 static inline msg_t *safe_dequeue(msg_queue_t* q)
 {
 	uint32_t flags = irq_save_disable();
@@ -72,7 +103,20 @@ static inline msg_t *btctl_tx_dequeue(void)
 	return safe_dequeue(&btctl.tx_q);
 }
 
-/* Enqueue a message for host */
+/* Take back the oldest message for host held in a buffer of class cls */
+static inline msg_t *btctl_tx_reclaim(unsigned cls)
+{
+	uint32_t flags = irq_save_disable();
+	msg_t *msg;
+
+	msg = msg_dequeue_class(&btctl.tx_q, cls);
+	irq_restore(flags);
+
+	return msg;
+}
+
+/* Enqueue a message for host.
+ * The oldest message is dropped if the host does not keep up. */
 static inline int btctl_tx_enqueue(msg_t *msg)
 {
 	return safe_enqueue(&btctl.tx_q, msg);
@@ -84,7 +128,8 @@ static inline msg_t *btctl_rx_dequeue(void)
 	return safe_dequeue(&btctl.rx_q);
 }
 
-/* Called by usb driver with last message received from host */
+/* Called by usb driver with last message received from host.
+ * The message is dropped if the queue is full. */
 static inline int btctl_rx_enqueue(msg_t *msg)
 {
 	return safe_enqueue(&btctl.rx_q, msg);
@@ -4,6 +4,7 @@
 #include <ubertooth_interface.h>
 #include <ubtbr/cfg.h>
 #include <ubtbr/queue.h>
+#include <ubtbr/btphy_timer.h>
 
 #define CLKN_RATE 3200
 #define PERIPH_CLK_RATE	50000000			// 50Mhz
@@ -43,8 +44,6 @@ typedef struct btphy_s {
 	uint64_t my_sw;
 } btphy_t;
 
-typedef void (*btphy_timer_fn_t)(void *arg);
-
 extern btphy_t btphy;
 
 #define CUR_MASTER_SLOT_IDX()	(btphy.master_clkn&3)
@@ -69,6 +68,5 @@ void btphy_set_bdaddr(uint64_t bdaddr);
 uint8_t btphy_whiten_seed(uint32_t clk);
 void btphy_adj_clkn_delay(int delay);
 void btphy_cancel_clkn_delay(void);
-void btphy_timer_add(uint32_t instant, btphy_timer_fn_t cb, void *cb_arg, uint8_t anyway);
 
 #endif
@@ -0,0 +1,62 @@
+#ifndef __BTPHY_TIMER_H
+#define __BTPHY_TIMER_H
+#include <stdint.h>
+#include <stddef.h>
+
+/* Hierarchical timing wheel keyed on clkn
+ *
+ * Four levels of 64 slots: level 0 holds timers due within 64 ticks,
+ * level n those due within 64^(n+1) ticks. Every tick runs the current
+ * level 0 slot; when it wraps, the next slot of the level above is
+ * cascaded down. Insertion, cancellation and expiry are O(1), and the
+ * number of pending timers is only bounded by the callers' storage.
+ *
+ * Timers fire from the clkn interrupt, before the TDMA scheduler runs,
+ * so a callback may tdma_schedule() work in the current slot.
+ * The wheel follows btphy_cur_clkn(): when it jumps (clk_delay, slave
+ * resync, mode change), pending timers are re-keyed on the new value and
+ * those whose instant was skipped fire on next tick.
+ * Instants further away than 2^24 ticks (~87 minutes) are clamped and
+ * re-inserted as time goes by.
+ */
+
+#define BTPHY_TIMER_LVL_BITS	6
+#define BTPHY_TIMER_LVL_SIZE	(1<<BTPHY_TIMER_LVL_BITS)
+#define BTPHY_TIMER_LVL_MASK	(BTPHY_TIMER_LVL_SIZE-1)
+#define BTPHY_TIMER_LEVELS	4
+#define BTPHY_TIMER_MAX_DELTA	((1<<(BTPHY_TIMER_LVL_BITS*BTPHY_TIMER_LEVELS))-1)
+
+typedef void (*btphy_timer_fn_t)(void *arg);
+
+typedef struct btphy_timer_s {
+	struct btphy_timer_s *next;
+	struct btphy_timer_s **pprev;	// NULL if not pending
+	uint32_t expires;		// clkn instant
+	btphy_timer_fn_t cb;
+	void *cb_arg;
+	uint8_t pooled;			// allocated by btphy_timer_add
+} btphy_timer_t;
+
+/* Forget all timers. Caller-owned ones must not be pending. */
+void btphy_timers_reset(void);
+/* Advance the wheel by one tick & run expired timers. Called each clkn. */
+void btphy_timers_execute(void);
+
+static inline int btphy_timer_pending(const btphy_timer_t *t)
+{
+	return t->pprev != NULL;
+}
+
+/* Arm a caller-owned timer to fire at clkn 'instant' (as returned by
+ * btphy_cur_clkn()). Returns -1 if the instant has already passed.
+ * Re-arming a pending timer moves it. */
+int btphy_timer_start(btphy_timer_t *t, uint32_t instant, btphy_timer_fn_t cb, void *cb_arg);
+/* Arm a caller-owned timer 'delay' ticks from now (delay >= 1) */
+void btphy_timer_start_in(btphy_timer_t *t, uint32_t delay, btphy_timer_fn_t cb, void *cb_arg);
+void btphy_timer_cancel(btphy_timer_t *t);
+
+/* One-shot timer from a small internal pool. If the instant has
+ * already passed, cb is run on next tick when 'anyway' is set. */
+void btphy_timer_add(uint32_t instant, btphy_timer_fn_t cb, void *cb_arg, uint8_t anyway);
+
+#endif
@@ -3,4 +3,6 @@
 //#define USE_TX_1MHZ_OFF
 //#define USE_LL_DEBUG
 #define USE_CONSOLE
+/* 'bench' debug command times the codec kernels */
+#define USE_CODEC_BENCH
 #endif
@@ -0,0 +1,8 @@
+#ifndef __CODEC_BENCH_H
+#define __CODEC_BENCH_H
+
+/* Time the codec kernels on DH5/DM5 sized buffers with the DWT cycle
+ * counter and print the best of a few runs on the console. */
+void codec_bench_run(void);
+
+#endif
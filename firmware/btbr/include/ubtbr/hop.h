@@ -2,6 +2,7 @@
 #define __HOP_H
 #include <stdint.h>
 #include <ubertooth_interface.h>
+#include <perm5.h>
 
 typedef struct hop_state_s {
 	uint8_t a27_23, a22_19, C, E;
@@ -25,18 +26,6 @@ void hop_cfg_afh(uint8_t* buf);
 /* FIXME ?*/
 extern hop_state_t hop_state;
 
-static inline uint8_t perm5(uint8_t z, uint8_t p_high, uint16_t p_low)
-{
-	extern uint8_t perm5_lut[2][4096];
-	uint16_t p = (p_low&0x1ff)|((p_high&0x1f)<<9);
-
-	z &= 0x1f;
-	z = perm5_lut[0][(((p>>7))<<5)|z];
-	z = perm5_lut[1][((0x7f&(p>>0))<<5)|z];
-
-	return z;
-}
-
 /* This function increment the x variable of for paging/inquiry hopping.
  * It must be called before each master's transmission. */
 static inline void hop_increment(void)
@@ -4,8 +4,37 @@
 #include <ubtbr/cfg.h>
 #include <ubtbr/debug.h>
 
+enum {
+	MEM_POOL_SMALL = 0,	// console & control messages
+	MEM_POOL_LARGE = 1,	// ACL packets
+	MEM_POOL_NUM_CLASSES
+};
+
+/* Largest payload served from the small class */
+#define MEM_POOL_SMALL_PAYLOAD 60
+
+/* Large buffers only mem_pool_alloc_reserved() may take, so that
+ * the radio can always receive the next packet */
+#define MEM_POOL_RESERVE 2
+
+/* Small buffers only mem_pool_alloc_reserved() may take. The RX path
+ * uses it to hand an empty packet to the state machine when it has to
+ * skip a slot; that packet is always freed by the rx callback, so one
+ * is enough. */
+#define MEM_POOL_SMALL_RESERVE 1
+
+typedef struct {
+	uint32_t alloc_fail[MEM_POOL_NUM_CLASSES];
+	uint32_t nfree[MEM_POOL_NUM_CLASSES];
+} mem_pool_stats_t;
+
 void mem_pool_init(void);
+/* Return NULL when the size class is exhausted */
 void *mem_pool_alloc(unsigned size);
+void *mem_pool_alloc_reserved(unsigned size);
 void mem_pool_free(void *p);
+/* MEM_POOL_SMALL or MEM_POOL_LARGE */
+unsigned mem_pool_class(void *p);
+void mem_pool_get_stats(mem_pool_stats_t *stats);
 
 #endif
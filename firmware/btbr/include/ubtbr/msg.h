@@ -1,6 +1,7 @@
 #ifndef __DEF_MSG_H
 #define __DEF_MSG_H
 #include <stdint.h>
+#include <stddef.h>
 
 typedef struct msg_s {
 	uint16_t len;
@@ -11,11 +12,12 @@ typedef struct msg_s {
 	uint8_t data[0];
 } msg_t;
 
-/* Allocate a msg_t wigh given room*/
-static inline msg_t *msg_alloc(unsigned size)
+static inline msg_t *msg_init(void *buf, unsigned size)
 {
-	msg_t *msg = (msg_t*)btctl_mem_alloc(sizeof(msg_t)+size);
+	msg_t *msg = (msg_t*)buf;
 
+	if (msg == NULL)
+		return NULL;
 	msg->write = msg->data;
 	msg->read = msg->data;
 	msg->data_len = size;
@@ -23,6 +25,19 @@ static inline msg_t *msg_alloc(unsigned size)
 	return msg;
 }
 
+/* Allocate a msg_t wigh given room.
+ * Returns NULL if no buffer is available. */
+static inline msg_t *msg_alloc(unsigned size)
+{
+	return msg_init(btctl_mem_alloc(sizeof(msg_t)+size), size);
+}
+
+/* Same, but may use the buffers reserved for the RX path */
+static inline msg_t *msg_alloc_reserved(unsigned size)
+{
+	return msg_init(btctl_mem_alloc_reserved(sizeof(msg_t)+size), size);
+}
+
 static inline void msg_free(msg_t *msg)
 {
 	btctl_mem_free(msg);
@@ -6,9 +6,17 @@
 // must be power of two
 #define MSG_QUEUE_SIZE 8
 
+/* What to do when enqueuing in a full queue */
+typedef enum {
+	MSG_QUEUE_DROP_NEWEST,	// free the message being enqueued
+	MSG_QUEUE_DROP_OLDEST	// free the message at the head
+} msg_queue_policy_t;
+
 typedef struct msg_queue_s {
 	int head;
 	int tail;
+	msg_queue_policy_t policy;
+	uint32_t drops;
 	msg_t *msg[MSG_QUEUE_SIZE];
 } msg_queue_t;
 
@@ -22,7 +30,17 @@ static inline int msg_queue_full(msg_queue_t *q)
 	return (q->tail+1)%MSG_QUEUE_SIZE == q->head;
 }
 
-void msg_queue_init(msg_queue_t *q);
+static inline int msg_queue_len(msg_queue_t *q)
+{
+	return (q->tail-q->head)&(MSG_QUEUE_SIZE-1);
+}
+
+void msg_queue_init(msg_queue_t *q, msg_queue_policy_t policy);
 msg_t* msg_dequeue(msg_queue_t *q);
+/* Remove the oldest message held in a buffer of the given mem_pool
+ * class, keeping the others in order. Returns NULL if there is none. */
+msg_t* msg_dequeue_class(msg_queue_t *q, unsigned cls);
+/* The queue always takes ownership of p.
+ * Returns -1 if a message had to be dropped, 0 otherwise. */
 int msg_enqueue(msg_queue_t *q, msg_t *p);
 #endif
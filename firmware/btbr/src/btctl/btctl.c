@@ -32,6 +32,7 @@
 #include <ubtbr/inquiry_scan_state.h>
 #include <ubtbr/page_scan_state.h>
 #include <ubtbr/monitor_state.h>
+#include <ubtbr/codec_bench.h>
 
 btctl_t btctl;
 
@@ -51,6 +52,13 @@ static void btctl_handle_debug_req(msg_t *msg)
 	btctl_hdr_t *hdr = (btctl_hdr_t*)msg->data;
 
 	cprintf("debug req: %s\n", (char*)hdr->data);
+#ifdef USE_CODEC_BENCH
+	if (msg->write - hdr->data >= 5 && !memcmp(hdr->data, "bench", 5)
+		&& btctl_get_state() == BTCTL_STATE_STANDBY)
+	{
+		codec_bench_run();
+	}
+#endif
 }
 
 static void btctl_handle_reset_req(msg_t *msg)
@@ -231,11 +239,49 @@ end_nofree:
 	return;
 }
 
+/* Tell the host when we start / stop losing messages */
+static void btctl_flow_work(void)
+{
+	mem_pool_stats_t stats;
+	msg_t *msg;
+	btctl_flow_ind_t *ind;
+	uint32_t lost;
+	uint8_t congested;
+
+	mem_pool_get_stats(&stats);
+	lost = btctl.tx_q.drops + btctl.rx_q.drops + btctl.acl_tx_q.drops
+		+ stats.alloc_fail[MEM_POOL_SMALL] + stats.alloc_fail[MEM_POOL_LARGE]
+		+ btctl.slot_drops;
+
+	if (btctl.congested)
+		congested = lost != btctl.lost || !msg_queue_empty(&btctl.tx_q);
+	else
+		congested = lost != btctl.lost || msg_queue_len(&btctl.tx_q) >= MSG_QUEUE_SIZE/2;
+	btctl.lost = lost;
+
+	if (congested == btctl.congested)
+		return;
+
+	/* Retry on next call if we're out of buffers */
+	if (!(msg = btctl_msg_alloc_small(BTCTL_FLOW_IND)))
+		return;
+	ind = (btctl_flow_ind_t*)msg_put(msg, sizeof(*ind));
+	ind->congested = congested;
+	ind->tx_drops = btctl.tx_q.drops;
+	ind->rx_drops = btctl.rx_q.drops + btctl.acl_tx_q.drops;
+	ind->alloc_fail = stats.alloc_fail[MEM_POOL_SMALL] + stats.alloc_fail[MEM_POOL_LARGE];
+	ind->slot_drops = btctl.slot_drops;
+	btctl_tx_enqueue(msg);
+	btctl.congested = congested;
+}
+
 int btctl_work(void)
 {
-	msg_t *msg = btctl_rx_dequeue();
+	msg_t *msg;
 
-	if (msg == NULL)
+	btctl_flow_work();
+
+	if ((msg = btctl_rx_dequeue()) == NULL)
 		return 0;
 
 	btctl_handle_msg(msg);
@@ -245,9 +291,11 @@ int btctl_work(void)
 
 void btctl_send_state_resp(btctl_state_t state, btctl_reason_t reason)
 {
-	msg_t *msg = btctl_msg_alloc(BTCTL_STATE_RESP);
+	msg_t *msg = btctl_msg_alloc_small(BTCTL_STATE_RESP);
 	btctl_state_resp_t *resp;
 
+	if (msg == NULL)
+		return;
 	resp = (btctl_state_resp_t*)msg_put(msg, sizeof(*resp));
 	resp->state = state;
 	resp->reason = reason;
@@ -317,7 +365,12 @@ void btctl_init(void)
 	btctl.state = BTCTL_STATE_STANDBY;
 	btctl.eir_msg = NULL;
 	btctl.eir_pkt = NULL;
-	msg_queue_init(&btctl.rx_q);
-	msg_queue_init(&btctl.tx_q);
-	msg_queue_init(&btctl.acl_tx_q);
+	btctl.slot_drops = 0;
+	btctl.congested = 0;
+	btctl.lost = 0;
+	/* Fresh RX data is worth more than stale one, but host requests
+	 * must be handled in order */
+	msg_queue_init(&btctl.rx_q, MSG_QUEUE_DROP_NEWEST);
+	msg_queue_init(&btctl.tx_q, MSG_QUEUE_DROP_OLDEST);
+	msg_queue_init(&btctl.acl_tx_q, MSG_QUEUE_DROP_NEWEST);
 }
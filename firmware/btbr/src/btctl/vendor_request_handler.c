@@ -30,7 +30,12 @@
 
 static void request_reset(void)
 {
-	btctl_rx_enqueue(btctl_msg_alloc(BTCTL_RESET_REQ));
+	msg_t *msg = btctl_msg_alloc_small(BTCTL_RESET_REQ);
+
+	if (msg)
+		btctl_rx_enqueue(msg);
+	else
+		reset();
 }
 
 int vendor_request_handler(uint8_t request, uint16_t* request_params, uint8_t* data, int* data_len)
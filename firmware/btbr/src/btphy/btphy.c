@@ -31,97 +31,13 @@
 #include <ubtbr/tx_task.h>
 #include <ubtbr/rx_task.h>
 #include <ubtbr/btphy.h>
+#include <ubtbr/btphy_timer.h>
 #include <ubtbr/system.h>
 
 #define DEFAULT_BDADDR 0x112233445566
 
-typedef void (*btphy_timer_fn_t)(void *arg);
-
-#define BTPHY_TIMER_COUNT 10
-typedef struct {
-	uint32_t instant;
-	btphy_timer_fn_t cb;
-	void *cb_arg;
-	uint8_t anyway;	// do it anyway if instant as already passed
-} btphy_timer_t;
-
-struct {
-	unsigned count;
-	btphy_timer_t timers[BTPHY_TIMER_COUNT];
-} btphy_timers;
-
 btphy_t btphy = {0};
 
-static void btphy_timers_reset(void)
-{
-	unsigned i;
-
-	btphy_timers.count = 0;
-	for(i=0;i<BTPHY_TIMER_COUNT;i++)
-		btphy_timers.timers[i].cb = NULL;
-}
-
-static void btphy_timers_execute(void)
-{
-	unsigned i;	// FIXME: unnecessary
-	unsigned j;
-	uint32_t clkn = btphy_cur_clkn();
-	btphy_timer_t *t;
-
-	for (i=0,j=0,t=btphy_timers.timers
-		; j<btphy_timers.count && i<BTPHY_TIMER_COUNT
-		; i++,t++)
-	{
-		if (t->cb)
-		{
-			if (t->instant == clkn)
-			{
-				t->cb(t->cb_arg);
-				t->cb = NULL;
-				btphy_timers.count--;
-			}
-			else if (t->instant < clkn)
-			{
-				if (t->anyway)
-				{
-					cprintf("(X)");
-					t->cb(t->cb_arg);
-				}
-				else{
-					cprintf("(missed timer)");
-				}
-				t->cb = NULL;
-				btphy_timers.count--;
-			}
-			j++;
-		}
-	}
-}
-
-void btphy_timer_add(uint32_t instant, btphy_timer_fn_t cb, void *cb_arg, uint8_t anyway)
-{
-	unsigned i;
-	btphy_timer_t *t;
-
-	if (btphy_timers.count == BTPHY_TIMER_COUNT)
-	{
-		DIE("too many timers");
-	}
-	for(i=0, t=btphy_timers.timers; i<BTPHY_TIMER_COUNT; i++,t++)
-	{
-		if (t->cb == NULL)
-		{
-			t->instant = instant;
-			t->cb = cb;
-			t->cb_arg = cb_arg;
-			t->anyway = anyway;
-			btphy_timers.count++;
-			return;
-		}
-	}
-	DIE("timers overflow");
-}
-
 static void btphy_handler(void)
 {
 	btphy.master_clkn++;
@@ -0,0 +1,258 @@
+/* Clkn timing wheel
+ *
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stddef.h>
+#include <ubtbr/cfg.h>
+#include <ubtbr/debug.h>
+#include <ubtbr/system.h>
+#include <ubtbr/btphy.h>
+#include <ubtbr/btphy_timer.h>
+
+#define BTPHY_TIMER_POOL_SIZE 16
+
+static struct {
+	/* clkn of the last tick, as returned by btphy_cur_clkn() */
+	uint32_t now;
+	btphy_timer_t *slot[BTPHY_TIMER_LEVELS][BTPHY_TIMER_LVL_SIZE];
+	btphy_timer_t pool[BTPHY_TIMER_POOL_SIZE];
+} wheel;
+
+static void timer_unlink(btphy_timer_t *t)
+{
+	if (t->next)
+		t->next->pprev = t->pprev;
+	*t->pprev = t->next;
+	t->next = NULL;
+	t->pprev = NULL;
+}
+
+static void timer_link(btphy_timer_t **head, btphy_timer_t *t)
+{
+	t->next = *head;
+	if (t->next)
+		t->next->pprev = &t->next;
+	t->pprev = head;
+	*head = t;
+}
+
+/* Put t in the slot matching its expiry */
+static void wheel_insert(btphy_timer_t *t)
+{
+	uint32_t delta = t->expires - wheel.now;
+	uint32_t expires = t->expires;
+	unsigned lvl;
+
+	if (delta > BTPHY_TIMER_MAX_DELTA)
+	{
+		/* Will be re-inserted when its slot cascades */
+		delta = BTPHY_TIMER_MAX_DELTA;
+		expires = wheel.now + delta;
+	}
+	for (lvl=0; lvl<BTPHY_TIMER_LEVELS-1; lvl++)
+	{
+		if (delta < (1u<<(BTPHY_TIMER_LVL_BITS*(lvl+1))))
+			break;
+	}
+	timer_link(&wheel.slot[lvl][(expires>>(BTPHY_TIMER_LVL_BITS*lvl))&BTPHY_TIMER_LVL_MASK], t);
+}
+
+/* Re-insert the timers of the current slot of level 'lvl' */
+static void wheel_cascade(unsigned lvl)
+{
+	unsigned idx = (wheel.now>>(BTPHY_TIMER_LVL_BITS*lvl))&BTPHY_TIMER_LVL_MASK;
+	btphy_timer_t *t, *next;
+
+	t = wheel.slot[lvl][idx];
+	wheel.slot[lvl][idx] = NULL;
+	for (; t; t=next)
+	{
+		next = t->next;
+		wheel_insert(t);
+	}
+}
+
+/* Re-key all pending timers on a new current clkn. Those whose instant
+ * was jumped over are due on next tick. */
+static void wheel_rebase(uint32_t now)
+{
+	btphy_timer_t *pending = NULL, *t;
+	unsigned lvl, idx;
+
+	for (lvl=0; lvl<BTPHY_TIMER_LEVELS; lvl++)
+	{
+		for (idx=0; idx<BTPHY_TIMER_LVL_SIZE; idx++)
+		{
+			while ((t = wheel.slot[lvl][idx]) != NULL)
+			{
+				timer_unlink(t);
+				timer_link(&pending, t);
+			}
+		}
+	}
+	wheel.now = now;
+	while ((t = pending) != NULL)
+	{
+		timer_unlink(t);
+		if ((int32_t)(t->expires - now) <= 0)
+			t->expires = now + 1;
+		wheel_insert(t);
+	}
+}
+
+/* clkn is moved outside of the tick (clk_delay, slave resync) and
+ * btphy_cur_clkn() changes source with the mode: follow it. */
+static void wheel_sync(void)
+{
+	uint32_t clkn = btphy_cur_clkn();
+
+	if (clkn != wheel.now)
+		wheel_rebase(clkn);
+}
+
+void btphy_timers_reset(void)
+{
+	unsigned i, j;
+	uint32_t flags = irq_save_disable();
+
+	for (i=0;i<BTPHY_TIMER_LEVELS;i++)
+		for (j=0;j<BTPHY_TIMER_LVL_SIZE;j++)
+			wheel.slot[i][j] = NULL;
+	for (i=0;i<BTPHY_TIMER_POOL_SIZE;i++)
+	{
+		wheel.pool[i].pprev = NULL;
+		wheel.pool[i].pooled = 0;
+	}
+	wheel.now = btphy_cur_clkn();
+	irq_restore(flags);
+}
+
+void btphy_timers_execute(void)
+{
+	btphy_timer_t *expired, *t;
+	uint32_t clkn = btphy_cur_clkn();
+	unsigned lvl;
+
+	/* clkn was already advanced for this tick */
+	if (clkn != wheel.now + 1)
+		wheel_rebase(clkn - 1);
+	wheel.now++;
+
+	/* Cascade upper levels when the one below wraps */
+	for (lvl=1; lvl<BTPHY_TIMER_LEVELS; lvl++)
+	{
+		if ((wheel.now>>(BTPHY_TIMER_LVL_BITS*(lvl-1)))&BTPHY_TIMER_LVL_MASK)
+			break;
+		wheel_cascade(lvl);
+	}
+
+	/* Detach the expired slot: callbacks may add or cancel timers */
+	expired = NULL;
+	t = wheel.slot[0][wheel.now&BTPHY_TIMER_LVL_MASK];
+	if (t)
+	{
+		expired = t;
+		t->pprev = &expired;
+		wheel.slot[0][wheel.now&BTPHY_TIMER_LVL_MASK] = NULL;
+	}
+	while ((t = expired) != NULL)
+	{
+		timer_unlink(t);
+		if (t->expires != wheel.now)
+		{
+			/* clamped long timer */
+			wheel_insert(t);
+			continue;
+		}
+		t->pooled = 0;
+		t->cb(t->cb_arg);
+	}
+}
+
+void btphy_timer_start_in(btphy_timer_t *t, uint32_t delay, btphy_timer_fn_t cb, void *cb_arg)
+{
+	uint32_t flags = irq_save_disable();
+
+	if (t->pprev)
+		timer_unlink(t);
+	wheel_sync();
+	t->cb = cb;
+	t->cb_arg = cb_arg;
+	t->expires = wheel.now + (delay ? delay : 1);
+	wheel_insert(t);
+	irq_restore(flags);
+}
+
+int btphy_timer_start(btphy_timer_t *t, uint32_t instant, btphy_timer_fn_t cb, void *cb_arg)
+{
+	uint32_t flags = irq_save_disable();
+	int32_t delay = (int32_t)(instant - btphy_cur_clkn());
+
+	if (delay <= 0)
+	{
+		irq_restore(flags);
+		return -1;
+	}
+	btphy_timer_start_in(t, delay, cb, cb_arg);
+	irq_restore(flags);
+
+	return 0;
+}
+
+void btphy_timer_cancel(btphy_timer_t *t)
+{
+	uint32_t flags = irq_save_disable();
+
+	if (t->pprev)
+		timer_unlink(t);
+	t->pooled = 0;
+	irq_restore(flags);
+}
+
+void btphy_timer_add(uint32_t instant, btphy_timer_fn_t cb, void *cb_arg, uint8_t anyway)
+{
+	uint32_t flags = irq_save_disable();
+	btphy_timer_t *t;
+	unsigned i;
+
+	for (i=0, t=wheel.pool; i<BTPHY_TIMER_POOL_SIZE; i++, t++)
+	{
+		if (!t->pooled)
+			break;
+	}
+	if (i == BTPHY_TIMER_POOL_SIZE)
+		DIE("too many timers");
+
+	if (btphy_timer_start(t, instant, cb, cb_arg) == 0)
+	{
+		t->pooled = 1;
+	}
+	else if (anyway)
+	{
+		cprintf("(X)");
+		btphy_timer_start_in(t, 1, cb, cb_arg);
+		t->pooled = 1;
+	}
+	else
+	{
+		cprintf("(missed timer)");
+	}
+	irq_restore(flags);
+}
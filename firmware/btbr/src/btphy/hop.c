@@ -62,18 +62,20 @@ void hop_init(uint32_t address)
 }
 
 /* BT Core v5.1 | Vol 2, Part B, Section 2.6*/
-static uint8_t hop_selection_kernel(uint8_t x, uint8_t y1, uint8_t y2,
+static unsigned hop_selection_kernel(uint8_t x, uint8_t y1, uint8_t y2,
 			uint8_t a, uint8_t b, uint8_t c,
 			uint16_t d, uint8_t e, uint8_t f)
 {
 	/* Extend y1 on 5 bits */
 	y1 = ~(y1-1);
-	return (perm5((a+x)^b, y1^c, d) + e + f + y2);
+	/* The sum goes up to 31+127+78+32: do not wrap it on 8 bits */
+	return (unsigned)perm5((a+x)^b, y1^c, d) + e + f + y2;
 }
 
 uint8_t hop_inquiry(uint32_t clk)
 {
-	uint8_t clk1, sel;
+	uint8_t clk1;
+	unsigned sel;
 
 	clk1 = 1&(clk>>1);
 
@@ -128,7 +130,8 @@ void hop_cfg_afh(uint8_t* buf)
 
 uint8_t hop_basic(uint32_t clk)
 {
-	uint8_t clk1, sel;
+	uint8_t clk1;
+	unsigned sel;
 
 	// Same-channel mechanism for AFH (FIXME: is this correct ?)
 	if (hop_state.afh_enabled)
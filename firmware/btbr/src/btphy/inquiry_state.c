@@ -79,10 +79,7 @@ static int inquiry_rx_cb(msg_t *msg, void *arg, int time_offset)
 			/* Schedule normal inquiry */
 			inquiry_schedule(3&(TX_PREPARE_IDX-CUR_MASTER_SLOT_IDX()));
 		}
-		if (btctl_tx_enqueue(msg))
-		{
-			DIE("txq full in inquiry\n");
-		}
+		btctl_tx_enqueue(msg);
 	}
 	return 0;
 }
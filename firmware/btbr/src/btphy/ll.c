@@ -122,10 +122,7 @@ int ll_process_rx(link_layer_t *ll, msg_t *msg)
 			{
 				LL_DEBUG('c');
 				/* Send the message to host */
-				if (btctl_tx_enqueue(msg) != 0)
-				{
-					DIE("txq full in master\n");
-				}
+				btctl_tx_enqueue(msg);
 				ll->rmt_seqn ^= 1;
 				ll->loc_arqn = 1;
 				do_free_msg = 0;
@@ -81,10 +81,7 @@ static int monitor2_rx_cb(msg_t *msg, void *arg, int time_offset)
 #endif
 	if (BBPKT_HAS_CRC(pkt))
 	{
-		if(btctl_tx_enqueue(msg) != 0)
-		{
-			DIE("mon2: txq full");
-		}
+		btctl_tx_enqueue(msg);
 		goto end_nofree;
 	}
 end:
@@ -64,12 +64,13 @@ static struct {
 	bbcodec_t codec;
 	uint8_t do_rx_payload;
 	/* Maximum acl packet is DH5: 32+4+54+(2+339+2)*8 */
-	uint8_t rx_dma_buf[BYTE_ALIGN(32+4+54+MAX_ACL_SIZE*12)];
+	uint8_t rx_dma_buf[BYTE_ALIGN(32+4+54+MAX_ACL_SIZE*12)] __attribute__((aligned(4)));
 	uint16_t pkt_time;
 	unsigned rx_offset;
 	uint8_t rx_done;
 	uint8_t slot_num;
 	uint8_t rx_raw;
+	uint8_t rx_skip;	// no buffer: the slot is not received
 } rx_task; 
 
 static int rx_decode(uint8_t p1, uint8_t p2, uint16_t p3);
@@ -78,10 +79,15 @@ static int rx_decode(uint8_t p1, uint8_t p2, uint16_t p3);
 static unsigned rx_buf_update(void)
 {
 	unsigned i, size = dma_get_rx_offset();
-
-	/* Reverse bytes to host order */
-	for(i=rx_task.rx_offset;i<size;i++)
-		rx_task.rx_dma_buf[i] = reverse8(rx_task.rx_dma_buf[i]);
+	uint8_t *buf = rx_task.rx_dma_buf;
+
+	/* Reverse bytes to host order, a word at the time once aligned */
+	for(i=rx_task.rx_offset;i<size && (i&3);i++)
+		buf[i] = reverse8(buf[i]);
+	for(;i+4<=size;i+=4)
+		*(uint32_t*)(buf+i) = reverse8x4(*(uint32_t*)(buf+i));
+	for(;i<size;i++)
+		buf[i] = reverse8(buf[i]);
 	rx_task.rx_offset = size;
 
 	/* Skip 32-bits of syncword*/
@@ -147,17 +153,29 @@ static int rx_prepare(uint8_t p1, uint8_t p2, uint16_t p3)
 		hop_increment();
 	chan = hop_channel(rx_clkn);
 
-	/* Tune to chan & start RX */
-	//cprintf("tune rx %d\n", pkt->chan);
-	btphy_rf_tune_chan(2402+chan, 0);
-	/* Here i must strobe SRX before & after GRMDM cfg. why ? */
-	cc2400_strobe(SFSON);
-	btphy_rf_cfg_rx();
-	btphy_rf_rx();
+	/* Alloc & reset RX packet. If the host is too slow, make room by
+	 * dropping the oldest packet waiting for it; small messages would
+	 * not free a large buffer. */
+	while (!(rx_task.rx_msg = btctl_rx_pkt_alloc()))
+	{
+		msg_t *old = btctl_tx_reclaim(MEM_POOL_LARGE);
+
+		if (!old)
+			break;
+		btctl.tx_q.drops++;
+		msg_free(old);
+	}
 
-	/* Alloc & reset RX packet */
-	if (!(rx_task.rx_msg = btctl_msg_alloc(BTCTL_RX_PKT)))
-		DIE("rx_prepare: no more buf");
+	/* Still nothing: the buffers are held elsewhere. Skip the slot and
+	 * give the callback an empty packet, as if nothing was received. */
+	rx_task.rx_skip = rx_task.rx_msg == NULL;
+	if (rx_task.rx_skip)
+	{
+		btctl.slot_drops++;
+		rx_task.rx_msg = btctl_rx_empty_alloc();
+		if (!rx_task.rx_msg)
+			DIE("rx_prepare: empty slot buffer in use");
+	}
 	pkt = rx_task.rx_pkt = (btctl_rx_pkt_t*)msg_put(rx_task.rx_msg, sizeof(*rx_task.rx_pkt));
 
 	/* Setup rx packet */
@@ -166,6 +184,17 @@ static int rx_prepare(uint8_t p1, uint8_t p2, uint16_t p3)
 	pkt->clkn = rx_clkn; // clkn at time of execute
 	pkt->flags = 0;
 
+	if (rx_task.rx_skip)
+		return 0;
+
+	/* Tune to chan & start RX */
+	//cprintf("tune rx %d\n", pkt->chan);
+	btphy_rf_tune_chan(2402+chan, 0);
+	/* Here i must strobe SRX before & after GRMDM cfg. why ? */
+	cc2400_strobe(SFSON);
+	btphy_rf_cfg_rx();
+	btphy_rf_rx();
+
 	bbcodec_init(&rx_task.codec, btphy_whiten_seed(rx_clkn), btphy.chan_uap, 1, rx_task.rx_raw);
 	rx_task.pkt_time = 0;
 	rx_task.rx_done = 0;
@@ -228,6 +257,12 @@ static int rx_execute(uint8_t p1, uint8_t p2, uint16_t p3)
 	unsigned i, delay;
 	btctl_rx_pkt_t *pkt = rx_task.rx_pkt;
 
+	if (rx_task.rx_skip)
+	{
+		rx_finalize();
+		return 0;
+	}
+
 	if ((cc2400_get(FSMSTATE) & 0x1f) != STATE_STROBE_RX)
 	{
 		cprintf("rxne: RF not rdy\n");
@@ -139,6 +139,38 @@ const uint8_t whiten_state_tbl[8][128] = {
 0x1e, 0x3c, 0x5a, 0x78, 0x07, 0x25, 0x43, 0x61, 0x2c, 0x0e, 0x68, 0x4a, 0x35, 0x17, 0x71, 0x53, 
 }};
 
+/* 32 bits of whiten word for given state */
+const uint32_t whiten_word32_tbl[128] = {
+	0x00000000, 0xc3bcb240, 0xe1de5920, 0x2262eb60, 0xf0ef2c90, 0x33539ed0, 0x113175b0, 0xd28dc7f0, 
+	0xf8779648, 0x3bcb2408, 0x19a9cf68, 0xda157d28, 0x0898bad8, 0xcb240898, 0xe946e3f8, 0x2afa51b8, 
+	0xfc3bcb24, 0x3f877964, 0x1de59204, 0xde592044, 0x0cd4e7b4, 0xcf6855f4, 0xed0abe94, 0x2eb60cd4, 
+	0x044c5d6c, 0xc7f0ef2c, 0xe592044c, 0x262eb60c, 0xf4a371fc, 0x371fc3bc, 0x157d28dc, 0xd6c19a9c, 
+	0xfe1de592, 0x3da157d2, 0x1fc3bcb2, 0xdc7f0ef2, 0x0ef2c902, 0xcd4e7b42, 0xef2c9022, 0x2c902262, 
+	0x066a73da, 0xc5d6c19a, 0xe7b42afa, 0x240898ba, 0xf6855f4a, 0x3539ed0a, 0x175b066a, 0xd4e7b42a, 
+	0x02262eb6, 0xc19a9cf6, 0xe3f87796, 0x2044c5d6, 0xf2c90226, 0x3175b066, 0x13175b06, 0xd0abe946, 
+	0xfa51b8fe, 0x39ed0abe, 0x1b8fe1de, 0xd833539e, 0x0abe946e, 0xc902262e, 0xeb60cd4e, 0x28dc7f0e, 
+	0x7f0ef2c9, 0xbcb24089, 0x9ed0abe9, 0x5d6c19a9, 0x8fe1de59, 0x4c5d6c19, 0x6e3f8779, 0xad833539, 
+	0x87796481, 0x44c5d6c1, 0x66a73da1, 0xa51b8fe1, 0x77964811, 0xb42afa51, 0x96481131, 0x55f4a371, 
+	0x833539ed, 0x40898bad, 0x62eb60cd, 0xa157d28d, 0x73da157d, 0xb066a73d, 0x92044c5d, 0x51b8fe1d, 
+	0x7b42afa5, 0xb8fe1de5, 0x9a9cf685, 0x592044c5, 0x8bad8335, 0x48113175, 0x6a73da15, 0xa9cf6855, 
+	0x8113175b, 0x42afa51b, 0x60cd4e7b, 0xa371fc3b, 0x71fc3bcb, 0xb240898b, 0x902262eb, 0x539ed0ab, 
+	0x79648113, 0xbad83353, 0x98bad833, 0x5b066a73, 0x898bad83, 0x4a371fc3, 0x6855f4a3, 0xabe946e3, 
+	0x7d28dc7f, 0xbe946e3f, 0x9cf6855f, 0x5f4a371f, 0x8dc7f0ef, 0x4e7b42af, 0x6c19a9cf, 0xafa51b8f, 
+	0x855f4a37, 0x46e3f877, 0x64811317, 0xa73da157, 0x75b066a7, 0xb60cd4e7, 0x946e3f87, 0x57d28dc7, 
+};
+
+/* Advance whiten state by 32 steps */
+const uint8_t whiten_state32_tbl[128] = {
+	0x00, 0x73, 0x77, 0x04, 0x7f, 0x0c, 0x08, 0x7b, 0x6f, 0x1c, 0x18, 0x6b, 0x10, 0x63, 0x67, 0x14, 
+	0x4f, 0x3c, 0x38, 0x4b, 0x30, 0x43, 0x47, 0x34, 0x20, 0x53, 0x57, 0x24, 0x5f, 0x2c, 0x28, 0x5b, 
+	0x0f, 0x7c, 0x78, 0x0b, 0x70, 0x03, 0x07, 0x74, 0x60, 0x13, 0x17, 0x64, 0x1f, 0x6c, 0x68, 0x1b, 
+	0x40, 0x33, 0x37, 0x44, 0x3f, 0x4c, 0x48, 0x3b, 0x2f, 0x5c, 0x58, 0x2b, 0x50, 0x23, 0x27, 0x54, 
+	0x1e, 0x6d, 0x69, 0x1a, 0x61, 0x12, 0x16, 0x65, 0x71, 0x02, 0x06, 0x75, 0x0e, 0x7d, 0x79, 0x0a, 
+	0x51, 0x22, 0x26, 0x55, 0x2e, 0x5d, 0x59, 0x2a, 0x3e, 0x4d, 0x49, 0x3a, 0x41, 0x32, 0x36, 0x45, 
+	0x11, 0x62, 0x66, 0x15, 0x6e, 0x1d, 0x19, 0x6a, 0x7e, 0x0d, 0x09, 0x7a, 0x01, 0x72, 0x76, 0x05, 
+	0x5e, 0x2d, 0x29, 0x5a, 0x21, 0x52, 0x56, 0x25, 0x31, 0x42, 0x46, 0x35, 0x4e, 0x3d, 0x39, 0x4a, 
+};
+
 /* F13 Lut to encode 8 bits */
 const uint32_t fec13_tbl[256] = {
 	0x000000, 0x000007, 0x000038, 0x00003f, 0x0001c0, 0x0001c7, 0x0001f8, 0x0001ff, 
@@ -299,7 +331,7 @@ const uint8_t hec_tbl[32] = {
 void null_decode(uint8_t *out, uint8_t *in, unsigned in_of, unsigned byte_count)
 {
 	unsigned i;
-	uint8_t b, byte_of;
+	unsigned byte_of;
 
 	if (byte_count == 0)
 		return;
@@ -315,7 +347,11 @@ void null_decode(uint8_t *out, uint8_t *in, unsigned in_of, unsigned byte_count)
 	if (in_of != 2)
 		DIE("nyi unaligned in %d\n", in_of);
 
-	for (i=0;i<byte_count;i++)
+	for (i=0;i+4<=byte_count;i+=4)
+	{
+		store32(out+i, (load32(in+i)>>2)|((uint32_t)in[i+4]<<30));
+	}
+	for (;i<byte_count;i++)
 	{
 		out[i] = 0xff & ((in[i]>>2)|(in[i+1]<<6));
 	}
@@ -324,7 +360,7 @@ void null_decode(uint8_t *out, uint8_t *in, unsigned in_of, unsigned byte_count)
 void null_encode(uint8_t *out, uint8_t *in, unsigned out_of, unsigned byte_count)
 {
 	unsigned i;
-	uint8_t b, byte_of;
+	unsigned byte_of;
 
 	if (byte_count == 0)
 		return;
@@ -359,7 +395,12 @@ void whiten(uint8_t* output, uint8_t* input, int length, uint8_t *statep)
 
 	state &= 0x7f;
 
-	for(i=0;i<nbytes;i++)
+	for(i=0;i+4<=nbytes;i+=4)
+	{
+		store32(output+i, load32(input+i)^whiten_word32_tbl[state]);
+		state = whiten_state32_tbl[state];
+	}
+	for(;i<nbytes;i++)
 	{
 		output[i] = input[i]^whiten_word_tbl[state];
 		state = whiten_state_tbl[7][state];
@@ -383,11 +424,11 @@ void whiten(uint8_t* output, uint8_t* input, int length, uint8_t *statep)
 int fec23(uint8_t *out, uint8_t *in, unsigned out_of, unsigned nbits)
 {
 	unsigned in_bit_pos, byte_pos, out_bit_pos, data;
-	unsigned nout = ((nbits+9)/10)*15;
+	unsigned nin = ((nbits+9)/10)*10;
 
 	// 10 bits in -> 15 output bits
 	for(in_bit_pos=0, out_bit_pos=out_of
-		; in_bit_pos<nout
+		; in_bit_pos<nin
 		; in_bit_pos+=10, out_bit_pos+=15)
 	{
 		byte_pos =in_bit_pos>>3;
@@ -459,37 +500,36 @@ static inline uint16_t unfec23_10bits(uint16_t in)
 /* Unfec23 15 bytes in -> 10 bytes out, start at bit 2 for obvious reasons */
 int unfec23_10bytes(uint8_t *out, uint8_t *in)
 {
-	uint16_t in1, in2, in3, in4, in5, in6, in7, in8;
-	int rc = 0;
-
-	in1 = unfec23_10bits(EXTRACT15_2(in));
-	in2 = unfec23_10bits(EXTRACT15_1(in+2));
-	in3 = unfec23_10bits(EXTRACT15_0(in+4));
-	in4 = unfec23_10bits(EXTRACT15_7(in+5));
-	in5 = unfec23_10bits(EXTRACT15_6(in+7));
-	in6 = unfec23_10bits(EXTRACT15_5(in+9));
-	in7 = unfec23_10bits(EXTRACT15_4(in+11));
-	in8 = unfec23_10bits(EXTRACT15_3(in+13));
-
-	ENCODE10_0(out,  in1&0x3ff);
-	ENCODE10_2(out+1,in2&0x3ff);
-	ENCODE10_4(out+2,in3&0x3ff);
-	ENCODE10_6(out+3,in4&0x3ff);
-	ENCODE10_0(out+5,in5&0x3ff);
-	ENCODE10_2(out+6,in6&0x3ff);
-	ENCODE10_4(out+7,in7&0x3ff);
-	ENCODE10_6(out+8,in8&0x3ff);
+	uint32_t in1, in2, in3, in4, in5, in6, in7, in8;
+
+	in1 = unfec23_10bits(0x7fff & (load32(in)>>2));
+	in2 = unfec23_10bits(0x7fff & (load32(in+2)>>1));
+	in3 = unfec23_10bits(0x7fff & (load32(in+4)));
+	in4 = unfec23_10bits(0x7fff & (load32(in+5)>>7));
+	in5 = unfec23_10bits(0x7fff & (load32(in+7)>>6));
+	in6 = unfec23_10bits(0x7fff & (load32(in+9)>>5));
+	in7 = unfec23_10bits(0x7fff & (load32(in+11)>>4));
+	in8 = unfec23_10bits(0x7fff & (load32(in+13)>>3));
+
+	/* 8 x 10 bits -> 2 words + 2 bytes */
+	store32(out, in1 | (in2<<10) | (in3<<20) | (in4<<30));
+	store32(out+4, (in4>>2) | (in5<<8) | (in6<<18) | (in7<<28));
+	in7 = (in7>>4) | (in8<<6);
+	out[8] = in7;
+	out[9] = in7>>8;
 
 	/* FIXME: return bit error count */
-	//return ((in1 | in2 | in3 | in4 | in5 | in6 | in7 | in8) >> 10);
 	return 0;
 
 }
 int unfec23(uint8_t *out, uint8_t *in, unsigned in_of, unsigned nbits)
 {
-	unsigned in_bit_pos=in_of, byte_pos, data;
+	unsigned in_bit_pos=in_of, data;
 	int out_bit_pos=0;
 	int rc = 0;
+	uint32_t acc = 0;
+	unsigned acc_bits = 0;
+	uint8_t *outp;
 
 	/* align output to 10 bits */
 	nbits = (10*nbits+9)/10;
@@ -508,40 +548,26 @@ int unfec23(uint8_t *out, uint8_t *in, unsigned in_of, unsigned nbits)
 		}
 	}
 
-
-	// 15 bits in -> 10 output bits
+	// 15 bits in -> 10 output bits, output is byte aligned from here
+	outp = out + out_bit_pos/8;
 	for(//out_bit_pos=0, in_bit_pos=in_of
 		; out_bit_pos<(int)nbits
 		; in_bit_pos+=15, out_bit_pos+=10)
 	{
-		byte_pos = in_bit_pos>>3;
-		switch(in_bit_pos&7) {
-		case 0: data = EXTRACT15_0(in+byte_pos); break;
-		case 1: data = EXTRACT15_1(in+byte_pos); break;
-		case 2: data = EXTRACT15_2(in+byte_pos); break;
-		case 3: data = EXTRACT15_3(in+byte_pos); break;
-		case 4: data = EXTRACT15_4(in+byte_pos); break;
-		case 5: data = EXTRACT15_5(in+byte_pos); break;
-		case 6: data = EXTRACT15_6(in+byte_pos); break;
-		default:data = EXTRACT15_7(in+byte_pos); break;
-		}
+		data = 0x7fff & (load32(in+(in_bit_pos>>3)) >> (in_bit_pos&7));
 		data = unfec23_10bits(data);
 		rc |= (data>>10);
-		data &= 0x3ff;
-		/* write output */
-		byte_pos = out_bit_pos>>3;
-		switch(out_bit_pos&7) {
-		case 0: ENCODE10_0(out+byte_pos,data); break;
-		case 1: ENCODE10_1(out+byte_pos,data); break;
-		case 2: ENCODE10_2(out+byte_pos,data); break;
-		case 3: ENCODE10_3(out+byte_pos,data); break;
-		case 4: ENCODE10_4(out+byte_pos,data); break;
-		case 5: ENCODE10_5(out+byte_pos,data); break;
-		case 6: ENCODE10_6(out+byte_pos,data); break;
-		default:ENCODE10_7(out+byte_pos,data); break;
+		acc |= (data&0x3ff)<<acc_bits;
+		acc_bits += 10;
+		while (acc_bits >= 8)
+		{
+			*outp++ = acc;
+			acc >>= 8;
+			acc_bits -= 8;
 		}
-		
 	}
+	if (acc_bits)
+		*outp = acc;
 	return rc;
 }
 /* Fec13 
@@ -618,13 +644,7 @@ int unfec13(uint8_t *out, uint8_t *in, unsigned in_of, unsigned nbits)
 	{
 		/* Read 6 bits from in at bit offset bof */
 		byte_pos = in_bit_pos>>3;	// byte idx
-		/* bi should be multiple of 2 now */
-		switch(in_bit_pos&7){
-		case 0: li = unfec13_tbl[EXTRACT6_0(in+byte_pos)]; break;
-		case 2:	li = unfec13_tbl[EXTRACT6_2(in+byte_pos)]; break;
-		case 4: li = unfec13_tbl[EXTRACT6_4(in+byte_pos)]; break;
-		default:li = unfec13_tbl[EXTRACT6_6(in+byte_pos)]; break; // 6
-		}
+		li = unfec13_tbl[0x3f & ((in[byte_pos]|(in[byte_pos+1]<<8))>>(in_bit_pos&7))];
 		be += li>>14;
 		out[out_bit_pos>>3] |= (li&3)<<(out_bit_pos&7);
 	}
@@ -194,7 +194,7 @@ void bbcodec_encode_header(bbcodec_t *codec, uint8_t *air_data, bbhdr_t *in_hdr,
 void bbcodec_encode_chunk(bbcodec_t *codec, uint8_t *air_data, bbhdr_t *in_hdr, uint8_t *in_data)
 {
 	const bbcodec_types_t *t = codec->t;
-	uint8_t tmp[CODEC_TX_CHUNK_SIZE], *inp;
+	uint8_t tmp[CODEC_TX_CHUNK_SIZE], *inp, *src;
 	unsigned byte_left, crc_num, byte_num, out_bitlen;
 
 	/* Current input pointer */
@@ -227,18 +227,22 @@ void bbcodec_encode_chunk(bbcodec_t *codec, uint8_t *air_data, bbhdr_t *in_hdr,
 	byte_num = MIN(byte_left, CODEC_TX_CHUNK_SIZE);
 
 	/* whiten the encode bytes */
+	src = inp;
 	if (codec->use_whiten)
+	{
 		bbcodec_unwhiten(&codec->whiten_state, tmp, inp, byte_num*8);
+		src = tmp;
+	}
 
 	/* Encode data in the air buffer */
 	if (t->has_fec23)
 	{
-		fec23(air_data+(codec->air_off_b>>3), tmp, codec->air_off_b&7, byte_num*8);
+		fec23(air_data+(codec->air_off_b>>3), src, codec->air_off_b&7, byte_num*8);
 		out_bitlen = byte_num*12;
 	}
 	else
 	{
-		null_encode(air_data+(codec->air_off_b>>3), tmp, codec->air_off_b&7, byte_num);
+		null_encode(air_data+(codec->air_off_b>>3), src, codec->air_off_b&7, byte_num);
 		out_bitlen = byte_num*8;
 	}
 
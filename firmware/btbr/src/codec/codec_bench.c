@@ -0,0 +1,143 @@
+/* Codec kernels benchmark
+ *
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stddef.h>
+#include <ubtbr/cfg.h>
+#include <ubtbr/debug.h>
+#include <ubtbr/system.h>
+#include <ubtbr/bb.h>
+#include <ubtbr/codec.h>
+#include <ubtbr/codec_bench.h>
+
+#ifdef USE_CODEC_BENCH
+
+#define DEMCR		(*(volatile uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA	(1<<24)
+#define DWT_CTRL	(*(volatile uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA (1<<0)
+#define DWT_CYCCNT	(*(volatile uint32_t *)0xE0001004)
+
+#define BENCH_RUNS	8
+
+/* Coded payload sizes (header, data, crc): DH5 is sent as is,
+ * DM5 is fec23 encoded. Air buffer holds the 58 bits header too. */
+#define DH5_BYTES	(2+MAX_ACL_SIZE-5+2)
+#define DM5_BYTES	(2+224+2)
+#define AIR_BYTES	BYTE_ALIGN(58+DM5_BYTES*12)
+
+static struct {
+	uint8_t air[AIR_BYTES+4] __attribute__((aligned(4)));
+	uint8_t out[DH5_BYTES+4] __attribute__((aligned(4)));
+} bench;
+
+enum {
+	K_REVERSE,
+	K_WHITEN,
+	K_NULL_DECODE,
+	K_UNFEC23,
+	K_UNFEC13_HDR,
+	K_CRC,
+	K_COUNT
+};
+
+static const char *kernel_name[K_COUNT] = {
+	[K_REVERSE]	= "reverse",
+	[K_WHITEN]	= "whiten",
+	[K_NULL_DECODE]	= "null_decode",
+	[K_UNFEC23]	= "unfec23",
+	[K_UNFEC13_HDR]	= "unfec13_hdr",
+	[K_CRC]		= "crc",
+};
+
+/* Same work as rx_buf_update() on a full DM5 air buffer */
+static void bench_reverse(void)
+{
+	unsigned i;
+
+	for (i=0;i<AIR_BYTES;i+=4)
+		*(uint32_t*)(bench.air+i) = reverse8x4(*(uint32_t*)(bench.air+i));
+}
+
+static void bench_kernel(unsigned k)
+{
+	uint8_t state = 0x55;
+
+	switch(k)
+	{
+	case K_REVERSE:
+		bench_reverse();
+		break;
+	case K_WHITEN:
+		whiten(bench.out, bench.out, DH5_BYTES*8, &state);
+		break;
+	case K_NULL_DECODE:
+		null_decode(bench.out, bench.air, 58, DH5_BYTES);
+		break;
+	case K_UNFEC23:
+		unfec23(bench.out, bench.air, 58, DM5_BYTES*8);
+		break;
+	case K_UNFEC13_HDR:
+		unfec13_hdr(bench.out, bench.air);
+		break;
+	case K_CRC:
+		crc_compute(bench.out, DH5_BYTES, 0x5500);
+		break;
+	}
+}
+
+void codec_bench_run(void)
+{
+	uint32_t flags, start, cycles, best;
+	unsigned i, k;
+
+	DEMCR |= DEMCR_TRCENA;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+	for (i=0;i<sizeof(bench.air);i++)
+		bench.air[i] = i*13+7;
+
+	cprintf("codec bench (cycles, best of %d):\n", BENCH_RUNS);
+	for (k=0;k<K_COUNT;k++)
+	{
+		best = ~0u;
+		for (i=0;i<BENCH_RUNS;i++)
+		{
+			flags = irq_save_disable();
+			start = DWT_CYCCNT;
+			bench_kernel(k);
+			cycles = DWT_CYCCNT - start;
+			irq_restore(flags);
+			if (cycles < best)
+				best = cycles;
+		}
+		cprintf(" %s: %u\n", kernel_name[k], best);
+	}
+}
+
+#else
+
+void codec_bench_run(void)
+{
+	cprintf("codec bench not compiled in\n");
+}
+
+#endif
@@ -82,6 +82,8 @@ static uint8_t abVendorReqData[258];
 static msg_t *tx_msg = NULL;
 // Current msg we're receiving from host
 static msg_t *rx_msg = NULL;
+// Bytes left to skip of a message we had no buffer for
+static uint16_t rx_skip = 0;
 
 /*
  * This is supposed to be a lock-free ring buffer, but I haven't verified
@@ -219,6 +221,16 @@ void usb_bulk_out_handler(u8 bEP, u8 bEPStatus)
 	/* copy/pasted from host code */
 	type = data[0];
 
+	/* Drop the rest of a message we could not allocate */
+	if (rx_skip)
+	{
+		if (type != BTUSB_MSG_CONT)
+		{
+			DIE("Invalid type %d while skipping rx_msg\n", type);
+		}
+		rx_skip -= MIN(bulk_size-1, rx_skip);
+		return;
+	}
 	/* Receive normal messages */
 	if (rx_msg == NULL)
 	{
@@ -228,7 +240,12 @@ void usb_bulk_out_handler(u8 bEP, u8 bEPStatus)
 			DIE("Unexpected type %c while waiting rx_msg\n", type);
 		}
 		packet_size = data[2]|(data[3]<<8);
-		rx_msg = msg_alloc(packet_size);
+		if (!(rx_msg = msg_alloc(packet_size)))
+		{
+			/* Out of buffers: the loss is reported by btctl_flow_work */
+			rx_skip = packet_size - MIN(bulk_size-4, packet_size);
+			return;
+		}
 
 		// skip packet type / packet size 
 		wsize = MIN(bulk_size-4, msg_write_avail(rx_msg));
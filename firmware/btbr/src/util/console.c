@@ -36,10 +36,7 @@ void console_flush(void)
 		goto end;
 	p = (char*)msg_put(cur_msg, 1);
 	*p = 0;
-	if (btctl_tx_enqueue(cur_msg))
-	{
-		DIE("txq full in console\n");
-	}
+	btctl_tx_enqueue(cur_msg);
 	cur_msg = NULL;
 end:
 	irq_restore(flags);
@@ -54,7 +51,9 @@ void console_putc(char c)
 
 	if (cur_msg == NULL)
 	{
-		cur_msg = btctl_msg_alloc(BTCTL_DEBUG);
+		/* Drop the output if we're out of buffers */
+		if (!(cur_msg = btctl_msg_alloc_small(BTCTL_DEBUG)))
+			goto end;
 	}
 	p = (char*)msg_put(cur_msg, 1);
 	*p = c;
@@ -63,6 +62,7 @@ void console_putc(char c)
 	{
 		console_flush();
 	}
+end:
 	irq_restore(flags);
 #endif
 }
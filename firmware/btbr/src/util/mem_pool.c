@@ -27,62 +27,132 @@
 
 //#define MEM_DEBUG // this was to fix a small double free
 
-#define BUF_NUM 16
+/* Buffers come in two classes, so that a flood of console or control
+ * messages cannot eat the buffers needed to receive ACL packets.
+ * Classes never borrow from each other. */
+#define SMALL_BUF_NUM 16
+#define LARGE_BUF_NUM 16
+
+/* enough for a console line or any control message */
+#define SMALL_BUF_SIZE (sizeof(msg_t)+sizeof(btctl_hdr_t)+MEM_POOL_SMALL_PAYLOAD)
 
 /* shoult be enough for any ACL packet */
-#define BUF_SIZE (sizeof(msg_t)+sizeof(btctl_hdr_t)+sizeof(btctl_rx_pkt_t)+344)
+#define LARGE_BUF_SIZE (sizeof(msg_t)+sizeof(btctl_hdr_t)+sizeof(btctl_rx_pkt_t)+344)
 
-typedef struct pool_el_s {
+typedef struct pool_hdr_s {
+	struct pool_hdr_s *li;
+	uint8_t cls;
 #ifdef MEM_DEBUG
-	int allocated;
+	uint8_t allocated;
 #endif
-	struct pool_el_s *li;
-	uint8_t buf[BUF_SIZE];
+} __attribute__((aligned(4))) pool_hdr_t;
+
+typedef struct {
+	pool_hdr_t h;
+	uint8_t buf[0];
 } pool_el_t;
 
+typedef struct {
+	pool_hdr_t h;
+	uint8_t buf[SMALL_BUF_SIZE];
+} small_el_t;
+
+typedef struct {
+	pool_hdr_t h;
+	uint8_t buf[LARGE_BUF_SIZE];
+} large_el_t;
+
+typedef struct {
+	unsigned size;
+	pool_hdr_t *li;
+	unsigned nfree;
+	unsigned reserve;
+} pool_class_t;
+
 static struct {
 	int init;
-	pool_el_t *li;
-	pool_el_t el[BUF_NUM];
+	pool_class_t cls[MEM_POOL_NUM_CLASSES];
+	mem_pool_stats_t stats;
+	small_el_t small[SMALL_BUF_NUM];
+	large_el_t large[LARGE_BUF_NUM];
 } pool = {0};
 
-void mem_pool_init(void)
+static void pool_class_init(unsigned cls, void *el, unsigned el_size,
+	unsigned num, unsigned buf_size, unsigned reserve)
 {
-	int i;
+	pool_class_t *c = &pool.cls[cls];
+	pool_hdr_t *h;
+	unsigned i;
+
+	c->size = buf_size;
+	c->li = NULL;
+	c->nfree = num;
+	c->reserve = reserve;
+	for(i=0;i<num;i++)
+	{
+		h = (pool_hdr_t*)((uint8_t*)el+(num-1-i)*el_size);
+		h->cls = cls;
+		h->li = c->li;
+		c->li = h;
+	}
+}
 
-	for(i=0;i<BUF_NUM-1;i++)
-		pool.el[i].li = &pool.el[i+1];
-	pool.el[BUF_NUM-1].li = NULL;
-	pool.li = pool.el;
+void mem_pool_init(void)
+{
+	pool_class_init(MEM_POOL_SMALL, pool.small, sizeof(small_el_t),
+		SMALL_BUF_NUM, SMALL_BUF_SIZE, MEM_POOL_SMALL_RESERVE);
+	pool_class_init(MEM_POOL_LARGE, pool.large, sizeof(large_el_t),
+		LARGE_BUF_NUM, LARGE_BUF_SIZE, MEM_POOL_RESERVE);
 	pool.init = 1;
 }
 
-void *mem_pool_alloc(unsigned size)
+static void *pool_alloc(unsigned size, int use_reserve)
 {
 	uint32_t flags = irq_save_disable();
-	pool_el_t *el;
-	void *buf;
+	pool_class_t *c;
+	pool_hdr_t *h = NULL;
+	unsigned cls;
 
 	if (!pool.init)
 		DIE("pool ny initalized\n");
 
-	if (size > BUF_SIZE)
+	for (cls=0;cls<MEM_POOL_NUM_CLASSES;cls++)
+	{
+		if (size <= pool.cls[cls].size)
+			break;
+	}
+	if (cls == MEM_POOL_NUM_CLASSES)
 		DIE("Cannot alloc %d\n", size);
 
-	if ((el = pool.li) == NULL)
-		DIE("No more buffers\n");
+	c = &pool.cls[cls];
+	if (c->nfree > (use_reserve ? 0 : c->reserve))
+	{
+		h = c->li;
 #ifdef MEM_DEBUG
-	if (el->allocated)
-		DIE("el already allocated\n");
-#endif
-
-	pool.li = el->li;
-#ifdef MEM_DEBUG
-	el->allocated = 1;
+		if (h->allocated)
+			DIE("el already allocated\n");
+		h->allocated = 1;
 #endif
+		c->li = h->li;
+		c->nfree--;
+	}
+	else
+	{
+		pool.stats.alloc_fail[cls]++;
+	}
 	irq_restore(flags);
 
-	return &el->buf;
+	return h ? ((pool_el_t*)h)->buf : NULL;
+}
+
+void *mem_pool_alloc(unsigned size)
+{
+	return pool_alloc(size, 0);
+}
+
+void *mem_pool_alloc_reserved(unsigned size)
+{
+	return pool_alloc(size, 1);
 }
 
 void mem_pool_free(void *p)
@@ -90,17 +160,35 @@ void mem_pool_free(void *p)
 #ifdef MEM_DEBUG
 	uint32_t lr = get_lr();
 #endif
-	pool_el_t * el = (pool_el_t*)((unsigned long)p-offsetof(pool_el_t, buf));
+	pool_hdr_t *h = &((pool_el_t*)((unsigned long)p-offsetof(pool_el_t, buf)))->h;
 	uint32_t flags = irq_save_disable();
+	pool_class_t *c = &pool.cls[h->cls];
 
 #ifdef MEM_DEBUG
-	if (el->allocated != 1)
-		DIE("el not allocated %08x|%d\n",lr,el->allocated);
-	el->allocated = 0;
+	if (h->allocated != 1)
+		DIE("el not allocated %08x|%d\n",lr,h->allocated);
+	h->allocated = 0;
 #endif
 
-	el->li = pool.li;
-	pool.li = el;
+	h->li = c->li;
+	c->li = h;
+	c->nfree++;
+
+	irq_restore(flags);
+}
+
+unsigned mem_pool_class(void *p)
+{
+	return ((pool_el_t*)((unsigned long)p-offsetof(pool_el_t, buf)))->h.cls;
+}
+
+void mem_pool_get_stats(mem_pool_stats_t *stats)
+{
+	uint32_t flags = irq_save_disable();
+	unsigned cls;
 
+	*stats = pool.stats;
+	for (cls=0;cls<MEM_POOL_NUM_CLASSES;cls++)
+		stats->nfree[cls] = pool.cls[cls].nfree;
 	irq_restore(flags);
 }
@@ -37,18 +37,52 @@ msg_t *msg_dequeue(msg_queue_t*q)
 	return p;
 }
 
+msg_t *msg_dequeue_class(msg_queue_t *q, unsigned cls)
+{
+	msg_t *p;
+	int i, next;
+
+	for (i = q->head; i != q->tail; i = (i+1)%MSG_QUEUE_SIZE)
+	{
+		if (mem_pool_class(q->msg[i]) == cls)
+			break;
+	}
+	if (i == q->tail)
+		return NULL;
+
+	p = q->msg[i];
+	/* Close the gap */
+	for (; (next = (i+1)%MSG_QUEUE_SIZE) != q->tail; i = next)
+		q->msg[i] = q->msg[next];
+	q->tail = i;
+
+	return p;
+}
+
 int msg_enqueue(msg_queue_t *q, msg_t *p)
 {
-	if (msg_queue_full(q))
-		return -1;
+	int rc = 0;
 
+	if (msg_queue_full(q))
+	{
+		q->drops++;
+		rc = -1;
+		if (q->policy == MSG_QUEUE_DROP_NEWEST)
+		{
+			msg_free(p);
+			return rc;
+		}
+		msg_free(msg_dequeue(q));
+	}
 	q->msg[q->tail] = p;
 	q->tail = (q->tail+1)%MSG_QUEUE_SIZE;
 
-	return 0;
+	return rc;
 }
 
-void msg_queue_init(msg_queue_t *q)
+void msg_queue_init(msg_queue_t *q, msg_queue_policy_t policy)
 {
 	q->head = q->tail = 0;
+	q->policy = policy;
+	q->drops = 0;
 }
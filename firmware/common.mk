@@ -326,7 +326,7 @@ end:
 	@echo
 
 # Display size of file.
-ELFSIZE = $(SIZE) $(FORMAT_FLAG) $(TARGET).elf
+ELFSIZE = $(SIZE) -A $(TARGET).elf | grep -E '^\.(text|data|bss|ahbram) ' 
 
 sizebefore:
 	@if test -f $(TARGET).elf; then echo; echo $(MSG_SIZE_BEFORE); $(ELFSIZE); \
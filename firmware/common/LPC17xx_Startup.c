@@ -53,6 +53,8 @@ extern unsigned long _edata;
 extern unsigned long _etext;
 extern unsigned long _bss;
 extern unsigned long _ebss;
+extern unsigned long _ahbram;
+extern unsigned long _eahbram;
 
 extern void __libc_init_array(void);
 extern int main(void);
@@ -76,6 +78,13 @@ void Reset_Handler(void)
 		*src++ = 0;
 	}
 
+	// and the variables placed in AHB SRAM
+	src = &_ahbram;
+	while (src < &_eahbram)
+	{
+		*src++ = 0;
+	}
+
 	__libc_init_array();
 
 	// Set the vector table location.
@@ -0,0 +1,42 @@
+/* perm5
+ *
+ * Copyright 2020 Etienne Helluy-Lafont, Univ. Lille, CNRS.
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef __PERM5_H
+#define __PERM5_H
+#include <stdint.h>
+
+/* Two lookup tables indexed by (7 control bits, z), each one performing
+ * 7 of the 14 butterfly stages of the hop selection kernel's PERM5. */
+extern const uint8_t perm5_lut[2][4096];
+
+/* 5 bit permutation
+ * z is constrained to 5 bits, p_high to 5 bits, p_low to 9 bits */
+static inline uint8_t perm5(uint8_t z, uint8_t p_high, uint16_t p_low)
+{
+	uint16_t p = (p_low&0x1ff)|((p_high&0x1f)<<9);
+
+	z &= 0x1f;
+	z = perm5_lut[0][(((p>>7))<<5)|z];
+	z = perm5_lut[1][((0x7f&(p>>0))<<5)|z];
+
+	return z;
+}
+#endif
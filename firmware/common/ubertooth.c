@@ -269,9 +269,32 @@ void cc2400_init()
  * 3. The CC2400 needs CSN held low for the entire transaction which the
  *    LPC17xx SPI peripheral won't do without some workaround anyway.
  */
+/*
+ * Vendor requests read and write cc2400 registers from the USB interrupt,
+ * which must not land in the middle of a bit-banged transaction.  Mask
+ * the lowest interrupt priority, shared by USB and GPDMA, while CSN is
+ * low; anything more urgent still gets in.
+ */
+#define SPI_BASEPRI (0x1F << 3)
+
+static inline u32 spi_lock(void)
+{
+	u32 basepri;
+
+	asm volatile("mrs %0, basepri" : "=r" (basepri));
+	asm volatile("msr basepri_max, %0" : : "r" (SPI_BASEPRI) : "memory");
+	return basepri;
+}
+
+static inline void spi_unlock(u32 basepri)
+{
+	asm volatile("msr basepri, %0" : : "r" (basepri) : "memory");
+}
+
 u32 cc2400_spi(u8 len, u32 data)
 {
 	u32 msb = 1 << (len - 1);
+	u32 basepri = spi_lock();
 
 	/* start transaction by dropping CSN */
 	CSN_CLR;
@@ -291,10 +314,24 @@ u32 cc2400_spi(u8 len, u32 data)
 
 	/* end transaction by raising CSN */
 	CSN_SET;
+	spi_unlock(basepri);
 
 	return data;
 }
 
+/*
+ * BASEPRI is not stacked on exception entry, so an interrupt above the lock
+ * priority sees the value of the code it preempted.  Such a handler must
+ * leave the SPI alone while this returns nonzero.
+ */
+int cc2400_spi_locked(void)
+{
+	u32 basepri;
+
+	asm volatile("mrs %0, basepri" : "=r" (basepri));
+	return basepri != 0;
+}
+
 /* read 16 bit value from a register */
 u16 cc2400_get(u8 reg)
 {
@@ -341,6 +378,7 @@ void cc2400_fifo_write(u8 len, u8 *data) {
 	u8 msb = 1 << 7;
 	u8 reg = FIFOREG;
 	u8 i, j, temp;
+	u32 basepri = spi_lock();
 
 	/* start transaction by dropping CSN */
 	CSN_CLR;
@@ -377,6 +415,7 @@ void cc2400_fifo_write(u8 len, u8 *data) {
 	spi_delay();
 	/* end transaction by raising CSN */
 	CSN_SET;
+	spi_unlock(basepri);
 }
 
 /* read multiple bytes from SPI */
@@ -384,6 +423,7 @@ void cc2400_fifo_read(u8 len, u8 *buf) {
 	u8 msb = 1 << 7;
 	u8 i, j, temp, reg;
 	// Set first bit because it's a read
+	u32 basepri = spi_lock();
 	reg = 0x80 | FIFOREG;
 
 	/* start transaction by dropping CSN */
@@ -416,6 +456,7 @@ void cc2400_fifo_read(u8 len, u8 *buf) {
 	/* end transaction by raising CSN */
 	spi_delay();
 	CSN_SET;
+	spi_unlock(basepri);
 }
 
 /* get the status */
@@ -480,11 +521,11 @@ void clock_start()
  	 */
 #ifdef TC13BADGE
 	PCLKSEL0  = (1 << 2); /* TIMER0 at cclk (30 MHz) */
-	PCLKSEL1  = 0;
+	PCLKSEL1  = (1 << 14); /* TIMER3 at cclk (30 MHz) */
 #else
         // XXX here
 	PCLKSEL0  = (2 << 2) | (2 << 4); /* TIMER0 and TIMER1 at cclk/2 (50 MHz) */
-	PCLKSEL1  = (2 << 12); /* TIMER2 at cclk/2 (50 MHz) */
+	PCLKSEL1  = (2 << 12) | (2 << 14); /* TIMER2 and TIMER3 at cclk/2 (50 MHz) */
 #endif
 
 	/* switch to main oscillator */
@@ -27,6 +27,10 @@
 #include "cc2400.h"
 #include "ubertooth_interface.h"
 
+/* Place a zero initialized variable in the 16K AHB SRAM bank rather than
+ * the local ram. Required for anything the USB DMA engine reads. */
+#define __ahbram __attribute__((section(".ahbram")))
+
 typedef void (*IAP_ENTRY)(u32[], u32[]);
 extern const IAP_ENTRY iap_entry;
 
@@ -323,6 +327,7 @@ void dio_ssp_init(void);
 void atest_init(void);
 void cc2400_init(void);
 u32 cc2400_spi(u8 len, u32 data);
+int cc2400_spi_locked(void);
 u16 cc2400_get(u8 reg);
 void cc2400_set(u8 reg, u16 val);
 u8 cc2400_get8(u8 reg);
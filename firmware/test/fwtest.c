@@ -0,0 +1,99 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "fwtest.h"
+
+unsigned fwtest_failures;
+unsigned fwtest_checks;
+volatile uint32_t fwtest_sink;
+
+void fwtest_bench_report(const char *name, uint64_t ns, unsigned iters,
+                         unsigned bytes)
+{
+	double per_call = (double)ns / iters;
+
+	if (bytes)
+		printf("%-28s %10.1f ns/call %8.1f MB/s\n", name, per_call,
+		       bytes * 1e3 / per_call);
+	else
+		printf("%-28s %10.1f ns/call\n", name, per_call);
+}
+
+static const fwtest_case *find_case(const fwtest_case *cases, const char *name)
+{
+	for (; cases->name; cases++) {
+		if (!strcmp(cases->name, name))
+			return cases;
+	}
+	return NULL;
+}
+
+static void usage(const char *prog, const fwtest_case *tests,
+                  const fwtest_case *benches)
+{
+	printf("usage: %s [--bench] [case ...]\n", prog);
+	printf("tests:");
+	for (; tests->name; tests++)
+		printf(" %s", tests->name);
+	printf("\nbenchmarks:");
+	for (; benches->name; benches++)
+		printf(" %s", benches->name);
+	printf("\n");
+}
+
+int fwtest_main(int argc, char **argv, const fwtest_case *tests,
+                const fwtest_case *benches)
+{
+	const fwtest_case *cases = tests, *c;
+	int i, first = 1, selected = 0;
+
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		cases = benches;
+		first = 2;
+	} else if (argc > 1 && !strcmp(argv[1], "-h")) {
+		usage(argv[0], tests, benches);
+		return 0;
+	}
+
+	for (i = first; i < argc; i++) {
+		c = find_case(cases, argv[i]);
+		if (!c) {
+			fprintf(stderr, "unknown case '%s'\n", argv[i]);
+			usage(argv[0], tests, benches);
+			return 2;
+		}
+		c->fn();
+		selected = 1;
+	}
+	if (!selected) {
+		for (c = cases; c->name; c++) {
+			if (cases == tests)
+				printf("%s\n", c->name);
+			c->fn();
+		}
+	}
+
+	if (cases == tests) {
+		printf("%u checks, %u failures\n", fwtest_checks, fwtest_failures);
+		return fwtest_failures ? 1 : 0;
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __FWTEST_H
+#define __FWTEST_H
+
+/* Minimal test and benchmark helpers for the host build of firmware code.
+ * Each test binary runs its checks by default, or its benchmarks when
+ * given --bench. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+extern unsigned fwtest_failures;
+extern unsigned fwtest_checks;
+
+#define CHECK(cond, fmt, ...) do { \
+	fwtest_checks++; \
+	if (!(cond)) { \
+		fwtest_failures++; \
+		fprintf(stderr, "%s:%d: FAIL: " fmt "\n", \
+		        __FILE__, __LINE__, ##__VA_ARGS__); \
+	} \
+} while (0)
+
+typedef struct {
+	const char *name;
+	void (*fn)(void);
+} fwtest_case;
+
+/* Deterministic xorshift generator, so that failures are reproducible */
+static inline uint32_t fwtest_rand(void)
+{
+	static uint32_t s = 0x2545f491;
+
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return s;
+}
+
+static inline void fwtest_fill(uint8_t *buf, unsigned len)
+{
+	unsigned i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = fwtest_rand();
+}
+
+static inline uint64_t fwtest_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Keep the compiler from optimising away a benchmarked result */
+extern volatile uint32_t fwtest_sink;
+
+/* Run 'stmt' 'iters' times, best of 5, and report the time per call.
+ * 'bytes' is the payload handled by one call, 0 if not meaningful. */
+#define BENCH(name, iters, bytes, stmt) do { \
+	uint64_t _best = ~0ull, _t; \
+	unsigned _r, _i; \
+	for (_r = 0; _r < 5; _r++) { \
+		_t = fwtest_now_ns(); \
+		for (_i = 0; _i < (iters); _i++) { stmt; } \
+		_t = fwtest_now_ns() - _t; \
+		if (_t < _best) \
+			_best = _t; \
+	} \
+	fwtest_bench_report(name, _best, iters, bytes); \
+} while (0)
+
+void fwtest_bench_report(const char *name, uint64_t ns, unsigned iters,
+                         unsigned bytes);
+
+/* Run the test or bench cases according to argv, returns the exit code */
+int fwtest_main(int argc, char **argv, const fwtest_case *tests,
+                const fwtest_case *benches);
+
+#endif /* __FWTEST_H */
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "ref.h"
+
+uint32_t ref_reverse(uint32_t v, unsigned nbits)
+{
+	uint32_t r = 0;
+	unsigned i;
+
+	for (i = 0; i < nbits; i++)
+		r |= ((v >> i) & 1) << (nbits - 1 - i);
+	return r;
+}
+
+/* Butterflies of figure 2.15: P_i swaps bits index1[i] and index2[i] */
+uint8_t ref_perm5(uint8_t z, uint8_t p_high, uint16_t p_low)
+{
+	static const uint8_t index1[14] = {0, 2, 1, 3, 0, 1, 0, 3, 1, 0, 2, 1, 0, 1};
+	static const uint8_t index2[14] = {1, 3, 2, 4, 4, 3, 2, 4, 4, 3, 4, 3, 3, 2};
+	uint16_t p = (p_low & 0x1ff) | ((p_high & 0x1f) << 9);
+	uint8_t b1, b2;
+	int i;
+
+	z &= 0x1f;
+	for (i = 13; i >= 0; i--) {
+		if (!((p >> i) & 1))
+			continue;
+		b1 = (z >> index1[i]) & 1;
+		b2 = (z >> index2[i]) & 1;
+		if (b1 != b2)
+			z ^= (1 << index1[i]) | (1 << index2[i]);
+	}
+	return z;
+}
+
+static uint8_t addr_c(uint32_t a)
+{
+	/* A8, A6, A4, A2, A0 */
+	return ((a >> 4) & 0x10) | ((a >> 3) & 0x08) | ((a >> 2) & 0x04)
+		| ((a >> 1) & 0x02) | (a & 0x01);
+}
+
+static uint8_t addr_e(uint32_t a)
+{
+	/* A13, A11, A9, A7, A5, A3, A1 */
+	uint8_t e = 0;
+	int i;
+
+	for (i = 0; i < 7; i++)
+		e |= ((a >> (2 * i + 1)) & 1) << i;
+	return e;
+}
+
+/* Figure 2.13, the register bank holds even channels then odd ones */
+static uint8_t kernel(uint8_t x, uint8_t y1, uint8_t a, uint8_t b,
+                      uint8_t c, uint16_t d, uint8_t e, uint32_t f)
+{
+	uint8_t z, idx;
+
+	z = ((x + a) % 32) ^ b;
+	z = ref_perm5(z, (y1 ? 0x1f : 0) ^ c, d);
+	idx = (z + e + f + 32 * y1) % 79;
+	return idx < 40 ? 2 * idx : 2 * (idx - 40) + 1;
+}
+
+uint8_t ref_hop_basic(uint32_t address, uint32_t clk)
+{
+	return kernel((clk >> 2) & 0x1f, (clk >> 1) & 1,
+	              ((address >> 23) ^ (clk >> 21)) & 0x1f,
+	              (address >> 19) & 0x0f,
+	              (addr_c(address) ^ (clk >> 16)) & 0x1f,
+	              ((address >> 10) ^ (clk >> 7)) & 0x1ff,
+	              addr_e(address),
+	              (16 * ((clk >> 7) & 0x1fffff)) % 79);
+}
+
+uint8_t ref_hop_inquiry(uint32_t address, uint32_t clk, uint8_t x)
+{
+	return kernel(x & 0x1f, (clk >> 1) & 1,
+	              (address >> 23) & 0x1f,
+	              (address >> 19) & 0x0f,
+	              addr_c(address),
+	              (address >> 10) & 0x1ff,
+	              addr_e(address), 0);
+}
+
+/* Figure 7.1: header bits enter the LFSR LSB first */
+uint8_t ref_hec(uint16_t hdr10, uint8_t uap)
+{
+	uint8_t reg = uap, fb;
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		fb = ((reg >> 7) ^ (hdr10 >> i)) & 1;
+		reg <<= 1;
+		if (fb)
+			reg ^= 0xa7;	// D^7+D^5+D^2+D+1
+	}
+	/* HEC is sent from position 7 down to 0 */
+	return ref_reverse(reg, 8);
+}
+
+/* Figure 7.2, with the register kept in transmit order */
+uint16_t ref_crc16(const uint8_t *data, unsigned len, uint16_t state)
+{
+	unsigned i, j;
+	uint16_t fb;
+
+	for (i = 0; i < len; i++) {
+		for (j = 0; j < 8; j++) {
+			fb = (state ^ (data[i] >> j)) & 1;
+			state >>= 1;
+			if (fb)
+				state ^= 0x8408;	// D^16+D^12+D^5+1, reversed
+		}
+	}
+	return state;
+}
+
+/* Figure 7.3: position 6 is the output, fed back into positions 0 and 4 */
+void ref_whiten(uint8_t *data, unsigned nbits, uint8_t *state)
+{
+	uint8_t reg = *state & 0x7f, out;
+	unsigned i;
+
+	for (i = 0; i < nbits; i++) {
+		out = (reg >> 6) & 1;
+		data[i / 8] ^= out << (i % 8);
+		reg = (reg << 1) & 0x7f;
+		if (out)
+			reg ^= 0x11;
+	}
+	*state = reg;
+}
+
+/* g(D) = (D+1)(D^4+D+1) = D^5+D^4+D^2+1, parity sent after the data,
+ * highest remainder bit first */
+uint16_t ref_fec23(uint16_t data10)
+{
+	uint8_t reg = 0, fb;
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		fb = ((reg >> 4) ^ (data10 >> i)) & 1;
+		reg = (reg << 1) & 0x1f;
+		if (fb)
+			reg ^= 0x15;
+	}
+	return (data10 & 0x3ff) | (ref_reverse(reg, 5) << 10);
+}
+
+/* x^24+x^10+x^9+x^6+x^4+x^3+x+1 */
+uint32_t ref_le_crc(uint32_t crc_init, const uint8_t *data, unsigned len)
+{
+	uint32_t reg = crc_init & 0xffffff, fb;
+	unsigned i, j;
+
+	for (i = 0; i < len; i++) {
+		for (j = 0; j < 8; j++) {
+			fb = ((reg >> 23) ^ (data[i] >> j)) & 1;
+			reg = (reg << 1) & 0xffffff;
+			if (fb)
+				reg ^= 0x00065b;
+		}
+	}
+	return reg;
+}
+
+/* Figure 3.5: x^7+x^4+1, position 0 preset to 1 and positions 1 to 6 to
+ * the channel index, MSB in position 1 */
+void ref_le_whiten(uint8_t *data, unsigned len, uint8_t chan)
+{
+	uint8_t reg = 0x40 | (chan & 0x3f);
+	unsigned i, j;
+
+	for (i = 0; i < len; i++) {
+		for (j = 0; j < 8; j++) {
+			if (reg & 1) {
+				reg ^= 0x88;
+				data[i] ^= 1 << j;
+			}
+			reg >>= 1;
+		}
+	}
+}
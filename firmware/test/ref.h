@@ -0,0 +1,57 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __REF_H
+#define __REF_H
+
+/* Bit-serial reference implementations, written from the figures of the
+ * Bluetooth Core specification rather than from the firmware code. They
+ * are slow on purpose: the firmware's table-driven and word-wise versions
+ * are checked against them. Bits are numbered in air order, LSB first. */
+
+#include <stdint.h>
+
+uint32_t ref_reverse(uint32_t v, unsigned nbits);
+
+/* BR/EDR, Vol 2, Part B, 2.6: hop selection kernel */
+uint8_t ref_perm5(uint8_t z, uint8_t p_high, uint16_t p_low);
+/* Channel index (0-78) of the basic hopping sequence, no AFH */
+uint8_t ref_hop_basic(uint32_t address, uint32_t clk);
+/* Channel index (0-78) of the page/inquiry hopping sequence */
+uint8_t ref_hop_inquiry(uint32_t address, uint32_t clk, uint8_t x);
+
+/* BR/EDR, Vol 2, Part B, 7.1: HEC, D^8+D^7+D^5+D^2+D+1 preset with UAP */
+uint8_t ref_hec(uint16_t hdr10, uint8_t uap);
+/* BR/EDR, Vol 2, Part B, 7.1: CRC-CCITT, register in air order */
+uint16_t ref_crc16(const uint8_t *data, unsigned len, uint16_t state);
+/* BR/EDR, Vol 2, Part B, 7.2: D^7+D^4+1 whitening, 7 bit state */
+void ref_whiten(uint8_t *data, unsigned nbits, uint8_t *state);
+/* BR/EDR, Vol 2, Part B, 7.5: (15,10) shortened Hamming code,
+ * returns the 15 bit codeword in air order */
+uint16_t ref_fec23(uint16_t data10);
+
+/* LE, Vol 6, Part B, 3.1.1: CRC-24 with crc_init as given in CONNECT_IND,
+ * returns the CRC with the first bit on air in bit 23 */
+uint32_t ref_le_crc(uint32_t crc_init, const uint8_t *data, unsigned len);
+/* LE, Vol 6, Part B, 3.2: data whitening for channel index 'chan' */
+void ref_le_whiten(uint8_t *data, unsigned len, uint8_t chan);
+
+#endif /* __REF_H */
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Hardware dependent symbols needed by the bluetooth_rxtx modules under
+ * test. rbit() is a single instruction on the target. */
+
+#include "ubertooth.h"
+
+u32 rbit(u32 value)
+{
+	value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+	value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+	value = ((value >> 4) & 0x0f0f0f0f) | ((value & 0x0f0f0f0f) << 4);
+	return __builtin_bswap32(value);
+}
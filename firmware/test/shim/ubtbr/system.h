@@ -0,0 +1,39 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Host stand-in for ubtbr/system.h: the tests are single threaded, there
+ * are no interrupts to mask. */
+
+#ifndef __SYSTEM_H
+#define __SYSTEM_H
+#include <stdint.h>
+
+static inline uint32_t irq_save_disable(void)
+{
+	return 0;
+}
+
+static inline void irq_restore(uint32_t primask)
+{
+	(void)primask;
+}
+
+#endif
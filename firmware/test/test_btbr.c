@@ -0,0 +1,534 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Host tests and benchmarks for the btbr baseband codec, hopping and
+ * clkn timers */
+
+#include <stdlib.h>
+#include <ubtbr/bb.h>
+#include <ubtbr/codec.h>
+#include <ubtbr/btbb.h>
+#include <ubtbr/hop.h>
+#include <ubtbr/btphy.h>
+#include "fwtest.h"
+#include "ref.h"
+
+/* General Inquiry Access Code, LAP 0x9e8b33 (Vol 2, Part B, 1.2.1).
+ * Its sync word as sent on air, first bit in the MSB. */
+#define GIAC_LAP	0x9e8b33
+#define GIAC_SYNCWORD	0x475c58cc73345e72ULL
+
+/* Room for a DM5/DH5 air packet, and slack for the word-wise readers */
+#define AIR_BUF_SIZE	(BYTE_ALIGN(58 + 228 * 12) + 8)
+
+static void test_reverse(void)
+{
+	unsigned v;
+	uint32_t w;
+
+	for (v = 0; v < 256; v++)
+		CHECK(reverse8(v) == ref_reverse(v, 8), "reverse8 %02x", v);
+	for (v = 0; v < 1000; v++) {
+		w = fwtest_rand();
+		CHECK(reverse16(w) == ref_reverse(w & 0xffff, 16), "reverse16 %04x", w & 0xffff);
+		CHECK(reverse32(w) == ref_reverse(w, 32), "reverse32 %08x", w);
+		CHECK(reverse8x4(w) == (ref_reverse(w & 0xff, 8)
+		                        | ref_reverse((w >> 8) & 0xff, 8) << 8
+		                        | ref_reverse((w >> 16) & 0xff, 8) << 16
+		                        | ref_reverse(w >> 24, 8) << 24),
+		      "reverse8x4 %08x", w);
+	}
+}
+
+static void test_syncword(void)
+{
+	uint64_t sw = btbb_gen_syncword(GIAC_LAP);
+	uint64_t air = 0;
+	int i;
+
+	/* btbb_gen_syncword() returns the first bit on air in the LSB */
+	for (i = 0; i < 64; i++)
+		air |= ((sw >> i) & 1) << (63 - i);
+	CHECK(air == GIAC_SYNCWORD, "GIAC sync word %016llx",
+	      (unsigned long long)air);
+}
+
+static void test_hec(void)
+{
+	unsigned uap, hdr;
+
+	for (uap = 0; uap < 256; uap++) {
+		for (hdr = 0; hdr < 1024; hdr += 7) {
+			if (hec_compute(hdr, uap) != ref_hec(hdr, uap)) {
+				CHECK(0, "hec uap=%02x hdr=%03x: %02x != %02x", uap, hdr,
+				      hec_compute(hdr, uap), ref_hec(hdr, uap));
+				return;
+			}
+		}
+	}
+	CHECK(1, "hec");
+}
+
+static void test_crc(void)
+{
+	uint8_t buf[MAX_ACL_SIZE];
+	unsigned n, len;
+	uint16_t init;
+
+	for (n = 0; n < 200; n++) {
+		len = fwtest_rand() % sizeof(buf);
+		init = reverse8(fwtest_rand()) << 8;	// as set by bbcodec_init()
+		fwtest_fill(buf, len);
+		CHECK(crc_compute(buf, len, init) == ref_crc16(buf, len, init),
+		      "crc len=%u", len);
+	}
+}
+
+static void test_whiten(void)
+{
+	uint8_t in[64], out[64], ref[64];
+	uint8_t st, ref_st;
+	unsigned state, nbits;
+
+	for (state = 0; state < 128; state++) {
+		for (nbits = 0; nbits <= 8 * sizeof(in); nbits += 1 + nbits / 8) {
+			fwtest_fill(in, sizeof(in));
+			memcpy(ref, in, sizeof(in));
+			memset(out, 0, sizeof(out));
+			st = ref_st = state;
+			whiten(out, in, nbits, &st);
+			ref_whiten(ref, nbits, &ref_st);
+			/* whiten() clears the unused bits of a partial byte */
+			if (nbits & 7)
+				ref[nbits / 8] &= (1 << (nbits & 7)) - 1;
+			CHECK(!memcmp(out, ref, BYTE_ALIGN(nbits)) && st == ref_st,
+			      "whiten state=%02x nbits=%u", state, nbits);
+		}
+	}
+}
+
+static unsigned get_bit(const uint8_t *p, unsigned idx)
+{
+	return 1 & (p[idx >> 3] >> (idx & 7));
+}
+
+static void flip_bit(uint8_t *p, unsigned idx)
+{
+	p[idx >> 3] ^= 1 << (idx & 7);
+}
+
+static void test_fec13(void)
+{
+	uint8_t in[10], air[40], out[12];
+	unsigned n, off, nbits, i, err;
+	int be;
+
+	for (n = 0; n < 500; n++) {
+		off = 2 * (fwtest_rand() % 8);
+		nbits = 2 * (1 + fwtest_rand() % 40);
+		fwtest_fill(in, sizeof(in));
+		memset(air, 0, sizeof(air));
+		fec13(air, in, off, nbits);
+
+		for (i = 0; i < 3 * nbits; i++) {
+			if (get_bit(air, off + i) != get_bit(in, i / 3)) {
+				CHECK(0, "fec13 off=%u nbits=%u bit %u", off, nbits, i);
+				break;
+			}
+		}
+
+		/* one error in every repeated triple is corrected */
+		for (i = 0; i < nbits; i++)
+			flip_bit(air, off + 3 * i + fwtest_rand() % 3);
+		memset(out, 0, sizeof(out));
+		be = unfec13(out, air, off, nbits);
+		for (i = 0, err = 0; i < nbits; i++)
+			err += get_bit(out, i) != get_bit(in, i);
+		CHECK(err == 0, "unfec13 off=%u nbits=%u: %u errors", off, nbits, err);
+		CHECK(be == (int)nbits, "unfec13 reported %d errors, expected %u",
+		      be, nbits);
+	}
+}
+
+static void test_fec13_hdr(void)
+{
+	uint8_t hdr[3], air[12], out[3];
+	unsigned n, i;
+
+	for (n = 0; n < 500; n++) {
+		fwtest_fill(hdr, sizeof(hdr));
+		hdr[2] &= 3;
+		memset(air, 0, sizeof(air));
+		fec13(air, hdr, 4, 18);
+		for (i = 0; i < 18; i++) {
+			if (n & 1)
+				flip_bit(air, 4 + 3 * i + fwtest_rand() % 3);
+		}
+		memset(out, 0, sizeof(out));
+		CHECK(unfec13_hdr(out, air) == (n & 1 ? 18 : 0), "hdr errors");
+		CHECK(!memcmp(out, hdr, 3), "unfec13_hdr %02x%02x%02x",
+		      hdr[2], hdr[1], hdr[0]);
+	}
+}
+
+static void test_fec23(void)
+{
+	uint8_t in[MAX_ACL_SIZE], air[AIR_BUF_SIZE], out[MAX_ACL_SIZE + 4];
+	unsigned n, i, cw, nbits, off, data, code;
+
+	/* encoder against the generator polynomial */
+	for (data = 0; data < 1024; data++) {
+		in[0] = data;
+		in[1] = data >> 8;
+		memset(air, 0, sizeof(air));
+		fec23(air, in, 0, 10);
+		code = air[0] | air[1] << 8;
+		CHECK(code == ref_fec23(data), "fec23 %03x: %04x != %04x", data,
+		      code, ref_fec23(data));
+	}
+
+	/* round trip at the offsets the codec uses, with one corrected
+	 * error per codeword */
+	for (n = 0; n < 300; n++) {
+		off = n & 1 ? 58 : 2 + 8 * (fwtest_rand() % 4);
+		nbits = 10 * (1 + fwtest_rand() % (8 * 228 / 10));
+		fwtest_fill(in, sizeof(in));
+		memset(air, 0, sizeof(air));
+		fec23(air, in, off, nbits);
+		for (cw = 0; cw < nbits / 10; cw++) {
+			if (fwtest_rand() & 1)
+				flip_bit(air, off + 15 * cw + fwtest_rand() % 15);
+		}
+		memset(out, 0, sizeof(out));
+		unfec23(out, air, off, nbits);
+		for (i = 0; i < nbits; i++) {
+			if (get_bit(out, i) != get_bit(in, i)) {
+				CHECK(0, "unfec23 off=%u nbits=%u bit %u", off, nbits, i);
+				break;
+			}
+		}
+	}
+}
+
+static void test_null_codec(void)
+{
+	uint8_t in[MAX_ACL_SIZE], air[AIR_BUF_SIZE], out[MAX_ACL_SIZE + 4];
+	unsigned n, len, off;
+
+	for (n = 0; n < 300; n++) {
+		off = n & 1 ? 58 : 8 * (fwtest_rand() % 4);
+		len = 1 + fwtest_rand() % (sizeof(in) - 1);
+		fwtest_fill(in, len);
+		memset(air, 0, sizeof(air));
+		null_encode(air + off / 8, in, off & 7, len);
+		memset(out, 0, sizeof(out));
+		null_decode(out, air, off, len);
+		CHECK(!memcmp(out, in, len), "null codec off=%u len=%u", off, len);
+	}
+}
+
+extern const bbcodec_types_t bbcodec_acl_types[16];
+
+/* Encode a whole packet like tx_task does, decode it like rx_task does */
+static int codec_round_trip(unsigned type, unsigned len, int use_whiten,
+                            int errors)
+{
+	const bbcodec_types_t *t;
+	bbcodec_t enc, dec;
+	bbhdr_t hdr = { .lt_addr = 3, .type = type, .flags = 5 }, out_hdr;
+	uint8_t data[2 + MAX_ACL_SIZE + 2], air[AIR_BUF_SIZE];
+	uint8_t out[2 + MAX_ACL_SIZE + 2 + CODEC_RX_CHUNK_SIZE];
+	uint8_t uap = fwtest_rand(), seed = 0x40 | (fwtest_rand() & 0x3f);
+	uint16_t size;
+	unsigned hlen, i;
+	int rc;
+
+	/* payload header with the length, then data */
+	t = &bbcodec_acl_types[type];
+	hlen = t->payload_header_bytes;
+	fwtest_fill(data, sizeof(data));
+	if (hlen == 1)
+		data[0] = (data[0] & 7) | (len << 3);
+	else if (hlen == 2) {
+		data[0] = (data[0] & 7) | (len << 3);
+		data[1] = (data[1] & 0xe0) | (len >> 5);
+	}
+	memset(air, 0, sizeof(air));
+	bbcodec_init(&enc, seed, uap, use_whiten, 0);
+	bbcodec_encode_header(&enc, air, &hdr, 0xa, data);
+	while (enc.coded_pos < enc.coded_total)
+		bbcodec_encode_chunk(&enc, air, &hdr, data);
+
+	/* one error in some fec23 codewords of the payload */
+	for (i = 0; t->has_fec23 && errors && i < enc.coded_total * 8 / 10; i++) {
+		if (fwtest_rand() % 4 == 0)
+			flip_bit(air, 58 + 15 * i + fwtest_rand() % 15);
+	}
+
+	bbcodec_init(&dec, seed, uap, use_whiten, 0);
+	rc = bbcodec_decode_header(&dec, &out_hdr, air);
+	CHECK(rc == 0, "type %u: header not decoded", type);
+	if (rc)
+		return -1;
+	CHECK(out_hdr.lt_addr == hdr.lt_addr && out_hdr.type == hdr.type
+	      && out_hdr.flags == hdr.flags, "type %u: header mismatch", type);
+
+	memset(out, 0, sizeof(out));
+	/* like the DMA buffer, air holds more than the packet */
+	while ((rc = bbcodec_decode_chunk(&dec, out, &out_hdr, air,
+	                                  sizeof(air))) == 0)
+		;
+	CHECK(rc == BBCODEC_DONE, "type %u len %u: decode rc %d", type, len, rc);
+	rc = bbcodec_decode_finalize(&dec, out, &size);
+	if (t->has_crc)
+		CHECK(rc & (1 << BBPKT_F_GOOD_CRC), "type %u len %u: bad crc",
+		      type, len);
+	CHECK(size == enc.coded_total - (t->has_crc ? 2 : 0),
+	      "type %u: size %u", type, size);
+	CHECK(!memcmp(out, data, size), "type %u len %u: payload mismatch",
+	      type, len);
+	return 0;
+}
+
+static void test_codec(void)
+{
+	static const struct {
+		uint8_t type;
+		uint16_t max_len;
+	} types[] = {
+		{ BB_TYPE_NULL, 0 }, { BB_TYPE_POLL, 0 }, { BB_TYPE_FHS, 0 },
+		{ BB_TYPE_DM1, 17 }, { BB_TYPE_DH1, 27 },
+		{ BB_TYPE_DM3, 121 }, { BB_TYPE_DH3, 183 },
+		{ BB_TYPE_DM5, 224 }, { BB_TYPE_DH5, 339 },
+	};
+	unsigned i, n, len;
+
+	for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		for (n = 0; n < 40; n++) {
+			len = types[i].max_len ? fwtest_rand() % (types[i].max_len + 1) : 0;
+			if (n == 0)
+				len = types[i].max_len;
+			codec_round_trip(types[i].type, len, n & 1, n & 2);
+		}
+	}
+}
+
+static void test_hop(void)
+{
+	static const uint32_t addrs[] = {
+		0x00000000, 0x2a96ef25, 0x6587cba9, 0x9e8b33, 0xffffffff,
+	};
+	unsigned i, x, bad = 0;
+	uint32_t clk;
+
+	for (i = 0; i < sizeof(addrs) / sizeof(addrs[0]); i++) {
+		hop_init(addrs[i]);
+		for (clk = 0x3ffff00; clk < 0x4000400; clk += 2) {
+			if (hop_basic(clk) != ref_hop_basic(addrs[i], clk))
+				bad++;
+		}
+		for (x = 0; x < 32; x++) {
+			hop_state.x = x;
+			for (clk = 0; clk < 4; clk += 2) {
+				if (hop_inquiry(clk) != ref_hop_inquiry(addrs[i], clk, x))
+					bad++;
+			}
+		}
+	}
+	CHECK(bad == 0, "hop: %u mismatches", bad);
+}
+
+/* One clkn interrupt, as btphy_handler() */
+static void timer_tick(void)
+{
+	btphy.master_clkn++;
+	btphy.slave_clkn++;
+	btphy_timers_execute();
+}
+
+static uint32_t timer_fired[8];
+
+static void timer_cb(void *arg)
+{
+	timer_fired[(uintptr_t)arg] = btphy_cur_clkn();
+}
+
+static void test_timer(void)
+{
+	static const uint32_t delays[] = { 1, 2, 63, 64, 65, 4095, 4097, 300000 };
+	btphy_timer_t t[8];
+	uint32_t start, i, n;
+
+	memset(t, 0, sizeof(t));
+	memset(timer_fired, 0, sizeof(timer_fired));
+	btphy.mode = BT_MODE_MASTER;
+	btphy.master_clkn = 0x0ffffff0;
+	btphy_timers_reset();
+	start = btphy.master_clkn;
+	for (i = 0; i < 8; i++)
+		btphy_timer_start(&t[i], start + delays[i], timer_cb, (void*)(uintptr_t)i);
+	for (n = 0; n < 300001; n++)
+		timer_tick();
+	for (i = 0; i < 8; i++) {
+		CHECK(timer_fired[i] == start + delays[i],
+			"timer +%u fired at +%u", delays[i], timer_fired[i] - start);
+		CHECK(!btphy_timer_pending(&t[i]), "timer +%u still pending", delays[i]);
+	}
+}
+
+/* clkn moved outside the tick: the instants stay in clkn */
+static void test_timer_clkn_jump(void)
+{
+	btphy_timer_t t[5];
+	uint32_t start, n;
+
+	memset(t, 0, sizeof(t));
+	memset(timer_fired, 0, sizeof(timer_fired));
+	btphy.mode = BT_MODE_MASTER;
+	btphy.master_clkn = 1000;
+	btphy.slave_clkn = 0x5000000;
+	btphy_timers_reset();
+	start = btphy.master_clkn;
+	btphy_timer_start(&t[0], start + 20, timer_cb, (void*)0);
+	btphy_timer_start(&t[1], start + 100, timer_cb, (void*)1);
+	btphy_timer_start(&t[2], start + 5000, timer_cb, (void*)2);
+	timer_tick();
+
+	/* clk_delay: jump over t[0] */
+	btphy.master_clkn += 50;
+	timer_tick();
+	CHECK(timer_fired[0] == start + 52, "jumped over timer fired at +%u",
+		timer_fired[0] - start);
+
+	/* resync backwards */
+	btphy.master_clkn -= 10;
+	while (btphy.master_clkn != start + 100)
+		timer_tick();
+	CHECK(timer_fired[1] == start + 100, "timer +100 fired at +%u",
+		timer_fired[1] - start);
+
+	/* Switch to the slave clock, armed from master time */
+	btphy.mode = BT_MODE_SLAVE;
+	btphy_timer_start(&t[3], btphy.slave_clkn + 30, timer_cb, (void*)3);
+	btphy_timer_start(&t[4], btphy.slave_clkn + 4000, timer_cb, (void*)4);
+	start = btphy.slave_clkn;
+	for (n = 0; n < 4000; n++)
+		timer_tick();
+	CHECK(timer_fired[3] == start + 30, "slave timer +30 fired at +%u",
+		timer_fired[3] - start);
+	CHECK(timer_fired[4] == start + 4000, "slave timer +4000 fired at +%u",
+		timer_fired[4] - start);
+	/* t[2] was keyed on master clkn, which is far behind slave clkn */
+	CHECK(timer_fired[2] == start + 1, "master timer fired at +%u",
+		timer_fired[2] - start);
+}
+
+static const fwtest_case tests[] = {
+	{ "reverse", test_reverse },
+	{ "syncword", test_syncword },
+	{ "hec", test_hec },
+	{ "crc", test_crc },
+	{ "whiten", test_whiten },
+	{ "fec13", test_fec13 },
+	{ "fec13_hdr", test_fec13_hdr },
+	{ "fec23", test_fec23 },
+	{ "null_codec", test_null_codec },
+	{ "codec", test_codec },
+	{ "hop", test_hop },
+	{ "timer", test_timer },
+	{ "timer_clkn_jump", test_timer_clkn_jump },
+	{ NULL, NULL }
+};
+
+/* Payload sizes of the largest packets: DH5 and DM5 coded bytes */
+#define DH5_BYTES	(2 + 339 + 2)
+#define DM5_BYTES	(2 + 224 + 2)
+
+static uint8_t bench_air[AIR_BUF_SIZE], bench_out[MAX_ACL_SIZE + 16];
+
+static void bench_bitstream(void)
+{
+	uint8_t st = 0x55;
+	unsigned i;
+
+	fwtest_fill(bench_air, sizeof(bench_air));
+	BENCH("reverse8x4 (DM5 air)", 100000, BYTE_ALIGN(58 + DM5_BYTES * 12),
+	      for (i = 0; i + 4 <= BYTE_ALIGN(58 + DM5_BYTES * 12); i += 4)
+		      store32(bench_air + i, reverse8x4(load32(bench_air + i))));
+	BENCH("whiten (DH5)", 100000, DH5_BYTES,
+	      whiten(bench_out, bench_air, DH5_BYTES * 8, &st));
+	BENCH("null_decode (DH5)", 100000, DH5_BYTES,
+	      null_decode(bench_out, bench_air, 58, DH5_BYTES));
+	BENCH("unfec23 (DM5)", 100000, DM5_BYTES,
+	      unfec23(bench_out, bench_air, 58, DM5_BYTES * 8));
+	BENCH("fec23 (DM5)", 100000, DM5_BYTES,
+	      fec23(bench_air, bench_out, 58, DM5_BYTES * 8));
+	BENCH("unfec13_hdr", 1000000, 0,
+	      fwtest_sink += unfec13_hdr(bench_out, bench_air));
+	BENCH("crc_compute (DH5)", 100000, DH5_BYTES,
+	      fwtest_sink += crc_compute(bench_out, DH5_BYTES, 0x5500));
+	BENCH("hec_compute", 1000000, 0,
+	      fwtest_sink += hec_compute(fwtest_sink, 0x47));
+}
+
+static void bench_codec(void)
+{
+	bbhdr_t hdr = { .lt_addr = 1, .type = BB_TYPE_DM5 }, out_hdr;
+	uint8_t data[DH5_BYTES];
+	uint16_t size;
+	bbcodec_t c;
+
+	memset(data, 0, sizeof(data));
+	data[0] = (224 << 3) & 0xff;
+	data[1] = 224 >> 5;
+	memset(bench_air, 0, sizeof(bench_air));
+	bbcodec_init(&c, 0x55, 0x47, 1, 0);
+	bbcodec_encode_header(&c, bench_air, &hdr, 0, data);
+	while (c.coded_pos < c.coded_total)
+		bbcodec_encode_chunk(&c, bench_air, &hdr, data);
+
+	BENCH("decode DM5 packet", 20000, DM5_BYTES,
+	      bbcodec_init(&c, 0x55, 0x47, 1, 0);
+	      bbcodec_decode_header(&c, &out_hdr, bench_air);
+	      while (!bbcodec_decode_chunk(&c, bench_out, &out_hdr, bench_air,
+	                                   sizeof(bench_air)));
+	      fwtest_sink += bbcodec_decode_finalize(&c, bench_out, &size));
+}
+
+static void bench_hop(void)
+{
+	uint32_t clk = 0;
+
+	hop_init(0x2a96ef25);
+	BENCH("hop_basic", 1000000, 0, fwtest_sink += hop_basic(clk); clk += 2);
+}
+
+static const fwtest_case benches[] = {
+	{ "bitstream", bench_bitstream },
+	{ "codec", bench_codec },
+	{ "hop", bench_hop },
+	{ NULL, NULL }
+};
+
+int main(int argc, char **argv)
+{
+	return fwtest_main(argc, argv, tests, benches);
+}
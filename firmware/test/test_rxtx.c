@@ -0,0 +1,356 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Host tests and benchmarks for the bluetooth_rxtx DSP code */
+
+#include "bluetooth.h"
+#include "bluetooth_le.h"
+#include "perm5.h"
+#include "ubertooth_rssi.h"
+#include "fwtest.h"
+#include "ref.h"
+
+/* General Inquiry Access Code, LAP 0x9e8b33 (Vol 2, Part B, 1.2.1).
+ * Its sync word as sent on air, first bit in the MSB. */
+#define GIAC_SYNCWORD 0x475c58cc73345e72ULL
+
+static void test_perm5(void)
+{
+	unsigned z, p;
+
+	for (p = 0; p < (1 << 14); p++) {
+		for (z = 0; z < 32; z++) {
+			if (perm5(z, p >> 9, p) != ref_perm5(z, p >> 9, p)) {
+				CHECK(0, "perm5 z=%02x p=%04x", z, p);
+				return;
+			}
+		}
+	}
+	CHECK(1, "perm5");
+}
+
+static void test_next_hop(void)
+{
+	static const uint32_t addrs[] = {
+		0x00000000, 0x2a96ef25, 0x6587cba9, 0xffffffff,
+	};
+	unsigned i, bad = 0;
+	u32 clk;
+
+	afh_enabled = 0;
+	for (i = 0; i < sizeof(addrs) / sizeof(addrs[0]); i++) {
+		target.address = addrs[i];
+		precalc();
+		/* cross a CLK27-7 boundary and the 32 entries of the table */
+		for (clk = 0x3ffff00; clk < 0x4000400; clk += 2) {
+			hop_table_fill(clk);
+			if (next_hop(clk) != 2402 + ref_hop_basic(addrs[i], clk))
+				bad++;
+		}
+	}
+	CHECK(bad == 0, "next_hop: %u mismatches", bad);
+}
+
+static void test_le_channels(void)
+{
+	unsigned idx, chan;
+
+	/* Vol 6, Part B, 1.4.1 */
+	CHECK(btle_channel_index(2402) == 37, "2402 -> %u", btle_channel_index(2402));
+	CHECK(btle_channel_index(2426) == 38, "2426 -> %u", btle_channel_index(2426));
+	CHECK(btle_channel_index(2480) == 39, "2480 -> %u", btle_channel_index(2480));
+	CHECK(btle_channel_index(2404) == 0, "2404 -> %u", btle_channel_index(2404));
+	CHECK(btle_channel_index(2424) == 10, "2424 -> %u", btle_channel_index(2424));
+	CHECK(btle_channel_index(2428) == 11, "2428 -> %u", btle_channel_index(2428));
+	CHECK(btle_channel_index(2478) == 36, "2478 -> %u", btle_channel_index(2478));
+
+	for (idx = 0; idx < BTLE_CHANNELS; idx++) {
+		chan = btle_channel_index_to_phys(idx);
+		CHECK(btle_channel_index(chan) == idx, "index %u -> %u -> %u",
+		      idx, chan, btle_channel_index(chan));
+	}
+}
+
+static void test_le_crc(void)
+{
+	uint8_t pdu[2 + 255 + 3];
+	uint32_t init, crc, lut, ref;
+	unsigned len, n;
+
+	for (n = 0; n < 200; n++) {
+		len = fwtest_rand() % 258;
+		init = n ? fwtest_rand() & 0xffffff : 0x555555;
+		fwtest_fill(pdu, len);
+
+		/* the firmware takes CRCInit and returns the CRC bit reversed */
+		crc = btle_calc_crc(ref_reverse(init, 24), pdu, len);
+		lut = btle_crcgen_lut(ref_reverse(init, 24), pdu, len);
+		ref = ref_reverse(ref_le_crc(init, pdu, len), 24);
+		CHECK(crc == ref, "calc_crc len=%u: %06x != %06x", len, crc, ref);
+		CHECK(lut == ref, "crcgen_lut len=%u: %06x != %06x", len, lut, ref);
+		CHECK(btle_reverse_crc(crc, pdu, len) == init,
+		      "reverse_crc len=%u: %06x != %06x", len,
+		      btle_reverse_crc(crc, pdu, len), init);
+
+		/* CRC appended as on air leaves a null remainder */
+		pdu[len] = crc;
+		pdu[len + 1] = crc >> 8;
+		pdu[len + 2] = crc >> 16;
+		CHECK(btle_crcgen_lut(ref_reverse(init, 24), pdu, len + 3) == 0,
+		      "residue len=%u", len);
+	}
+}
+
+static void test_le_dewhiten(void)
+{
+	uint8_t buf[64], ref[64];
+	unsigned idx, len, i;
+
+	for (idx = 0; idx < BTLE_CHANNELS; idx++) {
+		for (len = 0; len <= sizeof(buf); len += 7) {
+			fwtest_fill(buf, len);
+			/* le_dewhiten() also turns air order into host order */
+			for (i = 0; i < len; i++)
+				ref[i] = ref_reverse(buf[i], 8);
+			ref_le_whiten(ref, len, idx);
+			le_dewhiten(buf, len, btle_channel_index_to_phys(idx));
+			CHECK(!memcmp(buf, ref, len), "channel %u len %u", idx, len);
+		}
+	}
+}
+
+static void test_le_channel_map(void)
+{
+	le_channel_remapping_t remap;
+	uint8_t map[5], used[37];
+	unsigned n, i, count, expect;
+
+	for (n = 0; n < 100; n++) {
+		fwtest_fill(map, sizeof(map));
+		map[4] &= 0x1f;
+		map[n % 4] |= 1 << (n % 8);	// at least one used channel
+
+		for (i = 0, count = 0; i < 37; i++) {
+			if (map[i / 8] & (1 << (i % 8)))
+				used[count++] = i;
+		}
+		le_parse_channel_map(map, &remap);
+		CHECK(remap.total_channels == count, "%u != %u channels",
+		      remap.total_channels, count);
+
+		/* Channel selection algorithm #1 remapping */
+		for (i = 0; i < 37; i++) {
+			if (map[i / 8] & (1 << (i % 8)))
+				expect = i;
+			else
+				expect = used[i % count];
+			CHECK(le_map_channel(i, &remap) == expect,
+			      "map %u -> %u, expected %u", i,
+			      le_map_channel(i, &remap), expect);
+		}
+	}
+}
+
+/* Write the on-air sync word at bit 'pos' of buf, MSB first */
+static void put_syncword(u8 *buf, unsigned pos, u64 sw)
+{
+	unsigned i, bit;
+
+	for (i = 0; i < 64; i++, pos++) {
+		bit = (sw >> (63 - i)) & 1;
+		buf[pos / 8] &= ~(0x80 >> (pos % 8));
+		buf[pos / 8] |= bit << (7 - pos % 8);
+	}
+}
+
+static void test_find_access_code(void)
+{
+	u8 buf[DMA_SIZE];
+	unsigned pos, errs, i;
+	u64 sw;
+	int found;
+
+	target.syncword = GIAC_SYNCWORD;
+	/* the last sync word ending the search window is at 8*DMA_SIZE-65 */
+	for (pos = 0; pos + 64 < 8 * DMA_SIZE - 64; pos++) {
+		for (errs = 0; errs <= MAX_SYNCWORD_ERRS; errs++) {
+			sw = GIAC_SYNCWORD;
+			for (i = 0; i < errs; i++)
+				sw ^= 1ULL << (3 + 11 * i);
+			memset(buf, 0, sizeof(buf));
+			put_syncword(buf, pos, sw);
+
+			syncword = 0;
+			found = find_access_code(buf);
+			if (errs < MAX_SYNCWORD_ERRS)
+				CHECK(found == (int)(pos + 64),
+				      "pos %u, %u errors: %d", pos, errs, found);
+			else
+				CHECK(found == -1, "pos %u, %u errors: %d",
+				      pos, errs, found);
+		}
+	}
+}
+
+/* Feed one block of constant RSSI v to channel */
+static void rssi_block(uint16_t channel, int8_t v)
+{
+	int i;
+
+	rssi_reset();
+	for (i = 0; i < 50; i++)
+		rssi_add(v);
+	rssi_iir_update(channel);
+}
+
+static void test_rssi_floor(void)
+{
+	int i;
+
+	CHECK(rssi_slot(2402) == 0, "slot 2402: %u", rssi_slot(2402));
+	CHECK(rssi_slot(2480) == 78, "slot 2480: %u", rssi_slot(2480));
+	CHECK(rssi_slot(2401) == RSSI_CHANNELS - 1, "slot 2401: %u",
+	      rssi_slot(2401));
+	CHECK(rssi_slot(2481) == RSSI_CHANNELS - 1, "slot 2481: %u",
+	      rssi_slot(2481));
+
+	CHECK(rssi_get_floor(2410) == INT8_MIN, "floor before first block: %d",
+	      rssi_get_floor(2410));
+
+	/* Channels are tracked separately */
+	rssi_block(2410, -40);
+	rssi_block(2470, -20);
+	CHECK(rssi_get_floor(2410) == -40, "floor 2410: %d",
+	      rssi_get_floor(2410));
+	CHECK(rssi_get_floor(2470) == -20, "floor 2470: %d",
+	      rssi_get_floor(2470));
+
+	/* A burst of traffic barely lifts the floor... */
+	for (i = 0; i < 20; i++)
+		rssi_block(2410, 0);
+	CHECK(rssi_get_floor(2410) <= -37, "floor after burst: %d",
+	      rssi_get_floor(2410));
+
+	/* ...while a quieter channel pulls it down quickly */
+	for (i = 0; i < 20; i++)
+		rssi_block(2470, -50);
+	CHECK(rssi_get_floor(2470) == -50, "floor after drop: %d",
+	      rssi_get_floor(2470));
+}
+
+static void test_rssi_squelch(void)
+{
+	rssi_squelch_reset();
+
+	/* Opens at the level, closes only below level - hysteresis */
+	rssi_block(2440, -10);
+	CHECK(!rssi_squelch(2440, -5, 3), "open below level");
+	rssi_block(2440, -5);
+	CHECK(rssi_squelch(2440, -5, 3), "closed at level");
+	rssi_block(2440, -8);
+	CHECK(rssi_squelch(2440, -5, 3), "closed within hysteresis");
+	rssi_block(2440, -9);
+	CHECK(!rssi_squelch(2440, -5, 3), "open below hysteresis");
+
+	/* Gate state is per channel */
+	rssi_block(2441, 0);
+	CHECK(rssi_squelch(2441, -5, 3), "2441 closed");
+	CHECK(!rssi_squelch_state[rssi_slot(2440)].open, "2440 opened");
+
+	rssi_squelch_count(2440, 1);
+	rssi_squelch_count(2440, 0);
+	rssi_squelch_count(2440, 0);
+	CHECK(rssi_squelch_state[rssi_slot(2440)].passed == 1 &&
+	      rssi_squelch_state[rssi_slot(2440)].dropped == 2,
+	      "counts %u/%u", rssi_squelch_state[rssi_slot(2440)].passed,
+	      rssi_squelch_state[rssi_slot(2440)].dropped);
+}
+
+static const fwtest_case tests[] = {
+	{ "perm5", test_perm5 },
+	{ "next_hop", test_next_hop },
+	{ "le_channels", test_le_channels },
+	{ "le_crc", test_le_crc },
+	{ "le_dewhiten", test_le_dewhiten },
+	{ "le_channel_map", test_le_channel_map },
+	{ "find_access_code", test_find_access_code },
+	{ "rssi_floor", test_rssi_floor },
+	{ "rssi_squelch", test_rssi_squelch },
+	{ NULL, NULL }
+};
+
+static u8 bench_buf[256];
+
+static void bench_crc(void)
+{
+	fwtest_fill(bench_buf, sizeof(bench_buf));
+	BENCH("btle_calc_crc (39B)", 100000, 39,
+	      fwtest_sink += btle_calc_crc(0x555555, bench_buf, 39));
+	BENCH("btle_crcgen_lut (39B)", 100000, 39,
+	      fwtest_sink += btle_crcgen_lut(0x555555, bench_buf, 39));
+	BENCH("btle_crcgen_lut (255B)", 100000, 255,
+	      fwtest_sink += btle_crcgen_lut(0x555555, bench_buf, 255));
+}
+
+static void bench_dewhiten(void)
+{
+	BENCH("le_dewhiten (39B)", 100000, 39,
+	      le_dewhiten(bench_buf, 39, 2402));
+	BENCH("le_dewhiten (255B)", 100000, 255,
+	      le_dewhiten(bench_buf, 255, 2426));
+}
+
+static void bench_hop(void)
+{
+	u32 clk = 0;
+
+	target.address = 0x2a96ef25;
+	afh_enabled = 0;
+	precalc();
+	BENCH("perm5", 1000000, 0,
+	      fwtest_sink += perm5(fwtest_sink, clk >> 9, clk); clk++);
+	BENCH("hop_table_fill + next_hop", 1000000, 0,
+	      hop_table_fill(clk); fwtest_sink += next_hop(clk); clk += 2);
+}
+
+static void bench_find_access_code(void)
+{
+	u8 buf[DMA_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	target.syncword = GIAC_SYNCWORD;
+	/* worst case: nothing found */
+	BENCH("find_access_code (miss)", 10000, DMA_SIZE,
+	      syncword = 0; fwtest_sink += find_access_code(buf));
+}
+
+static const fwtest_case benches[] = {
+	{ "crc", bench_crc },
+	{ "dewhiten", bench_dewhiten },
+	{ "hop", bench_hop },
+	{ "find_access_code", bench_find_access_code },
+	{ NULL, NULL }
+};
+
+int main(int argc, char **argv)
+{
+	return fwtest_main(argc, argv, tests, benches);
+}
@@ -23,6 +23,7 @@
 
 #include "config.h"
 
+#include <fcntl.h>
 #include <vector>
 
 #include <util.h>
@@ -50,8 +51,6 @@ PacketSource_Ubertooth::PacketSource_Ubertooth(GlobalRegistry *in_globalreg, str
 	fake_fd[0] = -1;
 	fake_fd[1] = -1;
 
-	pending_packet = 0;
-
 	channel = 39;
 
 	ut = ubertooth_init();
@@ -90,79 +89,6 @@ int PacketSource_Ubertooth::AutotypeProbe(string in_device) {
 	return 0;
 }
 
-void enqueue(PacketSource_Ubertooth* ubertooth, btbb_packet* pkt)
-{
-	int write_size;
-
-	if (btbb_packet_get_ac_errors(pkt) <= 2)
-		printf("GOT PACKET ch=%2d LAP=%06x err=%u clk100ns=%u\n",
-			   btbb_packet_get_channel(pkt),
-			   btbb_packet_get_lap(pkt),
-			   btbb_packet_get_ac_errors(pkt),
-			   btbb_packet_get_clkn(pkt));
-	// Lock the packet queue, throw away when there are more than 20 in the queue
-	// that haven't been handled, raise the file descriptor hot if we need to
-	pthread_mutex_lock(&(ubertooth->packet_lock));
-
-	if (ubertooth->packet_queue.size() > 20) {
-		// printf("debug - thread packet queue too big\n");
-	} else {
-		ubertooth->packet_queue.push_back(pkt);
-		if (ubertooth->pending_packet == 0) {
-			// printf("debug - writing to fakefd\n");
-			ubertooth->pending_packet = 1;
-			write_size = write(ubertooth->fake_fd[1], "bogus", 1);
-			if (write_size <= 0)
-				printf("Error writing to fakefd\n");
-		}
-	}
-	pthread_mutex_unlock(&(ubertooth->packet_lock));
-}
-
-static void cb_cap(ubertooth_t* ut, void* args)
-{
-	PacketSource_Ubertooth* ubertooth = (PacketSource_Ubertooth*) args;
-	btbb_packet* pkt = NULL;
-	usb_pkt_rx usb = fifo_pop(ut->fifo);
-	usb_pkt_rx* rx = &usb;
-	char syms[BANK_LEN];
-
-	ubertooth_unpack_symbols((uint8_t*)rx->data, syms);
-
-	int offset = btbb_find_ac(syms, BANK_LEN, LAP_ANY, 1, &pkt);
-	if (offset >= 0) {
-
-		uint32_t clkn = (rx->clkn_high << 20) + (le32toh(rx->clk100ns) + offset*10) / 3125;
-
-		btbb_packet_set_data(pkt, syms + offset,
-		                     BANK_LEN - offset,
-		                     rx->channel, clkn);
-
-		enqueue(ubertooth, pkt);
-	}
-}
-
-// Capture thread to fake async io
-void* ubertooth_cap_thread(void* arg)
-{
-	PacketSource_Ubertooth* ubertooth = (PacketSource_Ubertooth*) arg;
-
-	ubertooth_bulk_init(ubertooth->ut);
-
-	ubertooth_bulk_thread_start();
-
-	cmd_rx_syms(ubertooth->ut->devh);
-
-	while (ubertooth->thread_active) {
-		ubertooth_bulk_receive(ubertooth->ut, cb_cap, ubertooth);
-	}
-
-	ubertooth->thread_active = -1;
-	close(ubertooth->fake_fd[1]);
-	ubertooth->fake_fd[1] = -1;
-	pthread_exit((void *) 0);
-}
-
 int PacketSource_Ubertooth::OpenSource() {
 	if ((ut = ubertooth_start(atoi(usb_dev.c_str()))) == NULL) {
 		_MSG("Ubertooth '" + name + "' failed to open device '" + usb_dev +
@@ -173,47 +99,55 @@ int PacketSource_Ubertooth::OpenSource() {
 	/* Set sweep mode on startup */
 	cmd_set_channel(ut->devh, 9999);
 
-	/* Initialize the pipe, mutex, and reading thread */
+	/* Initialize the pipe the packet ring raises when it has data */
 	if (pipe(fake_fd) < 0) {
 		_MSG("Ubertooth '" + name + "' failed to make a pipe() (this is really "
 			 "weird): " + string(strerror(errno)), MSGFLAG_ERROR);
-		ubertooth_bulk_thread_stop();
 		ubertooth_stop(ut);
+		ut = NULL;
 		return 0;
 	}
+	fcntl(fake_fd[0], F_SETFL, fcntl(fake_fd[0], F_GETFL, 0) | O_NONBLOCK);
 
-	if (pthread_mutex_init(&packet_lock, NULL) < 0) {
-		_MSG("Ubertooth '" + name + "' failed to initialize pthread mutex: " +
-			 string(strerror(errno)), MSGFLAG_ERROR);
-		ubertooth_bulk_thread_stop();
+	/*
+	 * Packets go straight from the USB transfer callback into the ring
+	 * and are decoded in place from Poll(), with no copy, queue or lock
+	 * in between.
+	 */
+	if (ubertooth_ring_attach(ut, 0, 1) < 0) {
+		_MSG("Ubertooth '" + name + "' failed to create packet ring",
+			 MSGFLAG_ERROR);
 		ubertooth_stop(ut);
+		ut = NULL;
 		return 0;
 	}
+	ubertooth_ring_reader_init(&ring_reader, ut->ring);
+	ubertooth_ring_set_notify(ut->ring, fake_fd[1]);
+	ubertooth_ring_arm(&ring_reader);
 
-	/* Launch a capture thread */
+	if (ubertooth_bulk_init(ut) < 0 || ubertooth_bulk_thread_start() != 0) {
+		_MSG("Ubertooth '" + name + "' failed to start USB transfers",
+			 MSGFLAG_ERROR);
+		ubertooth_stop(ut);
+		ut = NULL;
+		return 0;
+	}
 	thread_active = 1;
-	pthread_create(&cap_thread, NULL, ubertooth_cap_thread, this);
+
+	cmd_rx_syms(ut->devh);
 
 	return 1;
 }
 
 int PacketSource_Ubertooth::CloseSource() {
-	void *ret;
-
 	if (thread_active > 0) {
-		// Tell the thread to die
 		thread_active = 0;
-
-		// Grab it back
-		pthread_join(cap_thread, &ret);
-
-		// Kill the mutex
-		pthread_mutex_destroy(&packet_lock);
+		ubertooth_bulk_thread_stop();
 	}
 
 	if (ut) {
-		ubertooth_bulk_thread_stop();
 		ubertooth_stop(ut);
+		ut = NULL;
 	}
 
 	if (fake_fd[0] >= 0) {
@@ -254,9 +188,8 @@ int PacketSource_Ubertooth::SetChannel(unsigned int in_ch) {
 
 int PacketSource_Ubertooth::FetchDescriptor() {
 	// This is as good a place as any to catch a failure
-	if (thread_active < 0) {
-		_MSG("Ubertooth '" + name + "' capture thread failed: " +
-			 thread_error, MSGFLAG_INFO);
+	if (thread_active > 0 && (ut->stop_ubertooth || ut->usb_lost)) {
+		_MSG("Ubertooth '" + name + "' capture failed", MSGFLAG_INFO);
 		CloseSource();
 		return -1;
 	}
@@ -341,79 +274,104 @@ void PacketSource_Ubertooth::decode_pkt(btbb_packet* pkt, btbb_piconet* pn) {
 	btbb_process_packet(pkt, pn);
 }
 
-int PacketSource_Ubertooth::Poll() {
-	char rx;
-	int read_size;
-	int process_packet;
+/* Look for an access code in a packet still sitting in the ring */
+btbb_packet* PacketSource_Ubertooth::find_packet(const usb_pkt_rx* rx) {
+	btbb_packet* pkt = NULL;
+	char syms[BANK_LEN];
+
+	ubertooth_unpack_symbols((uint8_t*)rx->data, syms);
+
+	int offset = btbb_find_ac(syms, BANK_LEN, LAP_ANY, 1, &pkt);
+	if (offset < 0)
+		return NULL;
 
-	// Consume the junk byte we used to raise the FD high
-	read_size = read(fake_fd[0], &rx, 1);
-	if (read_size <= 0)
-		printf("Error reading from fakefd\n");
+	uint32_t clkn = (rx->clkn_high << 20) + (le32toh(rx->clk100ns) + offset*10) / 3125;
 
-	pthread_mutex_lock(&packet_lock);
+	btbb_packet_set_data(pkt, syms + offset,
+	                     BANK_LEN - offset,
+	                     rx->channel, clkn);
 
-	pending_packet = 0;
+	if (btbb_packet_get_ac_errors(pkt) <= 2)
+		printf("GOT PACKET ch=%2d LAP=%06x err=%u clk100ns=%u\n",
+			   btbb_packet_get_channel(pkt),
+			   btbb_packet_get_lap(pkt),
+			   btbb_packet_get_ac_errors(pkt),
+			   btbb_packet_get_clkn(pkt));
+	return pkt;
+}
+
+void PacketSource_Ubertooth::process_packet(btbb_packet* pkt) {
+	int process;
+
+	process = 1;
+	if (btbb_header_present(pkt))
+		process = handle_header(pkt);
+	else if (btbb_packet_get_ac_errors(pkt) > 1)
+		process = 0;
 
-	while (!packet_queue.empty()) {
-		kis_packet *newpack = globalreg->packetchain->GeneratePacket();
-		btbb_packet *pkt = packet_queue.front();
-		packet_queue.erase(packet_queue.begin());
+	/*
+	 * Only continue processing packet if it has a header and piconet or if
+	 * it is an ID packet (without header).
+	 */
+	if (!process)
+		return;
 
-		newpack->ts.tv_sec = globalreg->timestamp.tv_sec;
-		newpack->ts.tv_usec = globalreg->timestamp.tv_usec;
+	kis_packet *newpack = globalreg->packetchain->GeneratePacket();
 
-		kis_datachunk *rawchunk = new kis_datachunk;
+	newpack->ts.tv_sec = globalreg->timestamp.tv_sec;
+	newpack->ts.tv_usec = globalreg->timestamp.tv_usec;
 
-		process_packet = 1;
-		if (btbb_header_present(pkt))
-			process_packet = handle_header(pkt);
-		else if (btbb_packet_get_ac_errors(pkt) > 1)
-			process_packet = 0;
+	kis_datachunk *rawchunk = new kis_datachunk;
 
-		/*
-		 * Only continue processing packet if it has a header and piconet or if
-		 * it is an ID packet (without header).
-		 */
-		if (process_packet) {
-			rawchunk->length = 14;
-			if (btbb_packet_get_flag(pkt, BTBB_HAS_PAYLOAD))
-				rawchunk->length += 9 + btbb_packet_get_payload_length(pkt);
-			rawchunk->data = new uint8_t[rawchunk->length];
-			build_pcap_header(rawchunk->data, btbb_packet_get_lap(pkt));
-			if (btbb_packet_get_flag(pkt, BTBB_HAS_PAYLOAD))
-				build_pcap_payload(rawchunk->data, pkt);
+	rawchunk->length = 14;
+	if (btbb_packet_get_flag(pkt, BTBB_HAS_PAYLOAD))
+		rawchunk->length += 9 + btbb_packet_get_payload_length(pkt);
+	rawchunk->data = new uint8_t[rawchunk->length];
+	build_pcap_header(rawchunk->data, btbb_packet_get_lap(pkt));
+	if (btbb_packet_get_flag(pkt, BTBB_HAS_PAYLOAD))
+		build_pcap_payload(rawchunk->data, pkt);
 
-			rawchunk->source_id = source_id;
+	rawchunk->source_id = source_id;
 
-			rawchunk->dlt = KDLT_BTBB;
+	rawchunk->dlt = KDLT_BTBB;
 
-			newpack->insert(_PCM(PACK_COMP_LINKFRAME), rawchunk);
+	newpack->insert(_PCM(PACK_COMP_LINKFRAME), rawchunk);
 
-			//printf("debug - Got packet lap %06x chan %d len=%d\n",
-			//	   btbb_packet_get_lap(pkt), btbb_packet_get_channel(pkt),
-			//	   btbb_packet_get_payload_length(pkt));
+	num_packets++;
 
-			num_packets++;
+	kis_ref_capsource *csrc_ref = new kis_ref_capsource;
+	csrc_ref->ref_source = this;
+	newpack->insert(_PCM(PACK_COMP_KISCAPSRC), csrc_ref);
 
-			kis_ref_capsource *csrc_ref = new kis_ref_capsource;
-			csrc_ref->ref_source = this;
-			newpack->insert(_PCM(PACK_COMP_KISCAPSRC), csrc_ref);
+	globalreg->packetchain->ProcessPacket(newpack);
+}
 
-			globalreg->packetchain->ProcessPacket(newpack);
-		}
+int PacketSource_Ubertooth::Poll() {
+	const ubertooth_ring_slot* slot;
+	btbb_packet* pkt;
+	char junk[64];
 
-		// Delete the temp struct
-		btbb_packet_unref(pkt);
-		pkt = NULL;
-	}
+	// Consume the junk bytes used to raise the FD high
+	while (read(fake_fd[0], junk, sizeof(junk)) > 0)
+		;
 
-	// Flush the queue
-	packet_queue.clear();
+	// Arm before draining so a packet landing meanwhile raises the FD again
+	ubertooth_ring_arm(&ring_reader);
 
-	//printf("debug - packet queue cleared %d\n", packet_queue.size());
+	while ((slot = ubertooth_ring_peek(&ring_reader)) != NULL) {
+		pkt = find_packet(&slot->pkt);
 
-	pthread_mutex_unlock(&packet_lock);
+		// Drop anything the USB callback overwrote while we decoded it
+		if (ubertooth_ring_release(&ring_reader) < 0) {
+			if (pkt)
+				btbb_packet_unref(pkt);
+			continue;
+		}
+		if (pkt) {
+			process_packet(pkt);
+			btbb_packet_unref(pkt);
+		}
+	}
 
 	return 1;
 }
@@ -90,29 +90,19 @@ protected:
 
 	int thread_active;
 
-	pthread_t cap_thread;
-
 	// Named USB interface
 	string usb_dev;
 
-	// FD pipes
+	// FD pipes, raised by the packet ring when it has new packets
 	int fake_fd[2];
 
-	// Packet storage, locked with packet_lock
-	vector<btbb_packet *> packet_queue;
-
-	// Pending packet, locked with packet_lock
-	int pending_packet;
-
-	// Error from thread
-	string thread_error;
+	// Our cursor into the libubertooth packet ring
+	ubertooth_ring_reader ring_reader;
 
 	ubertooth_t* ut;
 
 	unsigned int channel;
 
-	pthread_mutex_t packet_lock;
-
 	map<int, btbb_piconet*> piconets;
 
 	static const uint32_t GIAC = 0x9E8B33;
@@ -122,11 +112,8 @@ protected:
 	void build_pcap_payload(uint8_t*, btbb_packet*);
 	int handle_header(btbb_packet*);
 	void decode_pkt(btbb_packet*, btbb_piconet*);
-
-
-	friend void enqueue(PacketSource_Ubertooth*, btbb_packet*);
-	friend void cb_xfer(struct libusb_transfer*);
-	friend void* ubertooth_cap_thread(void*);
+	btbb_packet* find_packet(const usb_pkt_rx*);
+	void process_packet(btbb_packet*);
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -100,101 +101,430 @@ void ubertooth_set_timeout(ubertooth_t* ut, int seconds) {
 	alarm(seconds);
 }
 
-unsigned ubertooth_count(void) {
-	struct libusb_device **usb_list = NULL;
-	struct libusb_context *ctx = NULL;
-	struct libusb_device_descriptor desc;
-	int usb_devs, i, r;
-	unsigned uberteeth = 0;
+/*
+ * Device enumeration
+ *
+ * The bus is enumerated once and cached, so that an index chosen with
+ * ubertooth_select() refers to the same radio when ubertooth_connect()
+ * later opens it.  Serial numbers are read lazily, since reading one
+ * means opening the device.
+ */
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#define HAVE_LIBUSB_HOTPLUG
+#endif
+
+#define MAX_UBERTEETH 32
+
+typedef struct {
+	libusb_device* dev;
+	char usb_path[24];
+	char serial[33];
+	uint8_t serial_read;
+} ubertooth_devinfo;
+
+static ubertooth_devinfo dev_cache[MAX_UBERTEETH];
+static int dev_cache_count = -1;
+static int usb_initialised = 0;
+
+static int ubertooth_usb_init(void)
+{
+	int r;
 
+	if (usb_initialised)
+		return 0;
 	r = libusb_init(NULL);
 	if (r < 0) {
 		fprintf(stderr, "libusb_init failed (got 1.0?)\n");
 		return -1;
 	}
+	usb_initialised = 1;
+	return 0;
+}
 
-	usb_devs = libusb_get_device_list(ctx, &usb_list);
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
-	for(i = 0 ; i < usb_devs ; ++i) {
-		r = libusb_get_device_descriptor(usb_list[i], &desc);
-		if(r < 0)
-			fprintf(stderr, "couldn't get usb descriptor for dev #%d!\n", i);
-		if ((desc.idVendor == TC13_VENDORID && desc.idProduct == TC13_PRODUCTID)
-		    || (desc.idVendor == U0_VENDORID && desc.idProduct == U0_PRODUCTID)
-		    || (desc.idVendor == U1_VENDORID && desc.idProduct == U1_PRODUCTID))
-		{
-			uberteeth++;
-		}
-	}
+static int is_ubertooth(struct libusb_device_descriptor* desc)
+{
+	return (desc->idVendor == TC13_VENDORID && desc->idProduct == TC13_PRODUCTID)
+	    || (desc->idVendor == U0_VENDORID && desc->idProduct == U0_PRODUCTID)
+	    || (desc->idVendor == U1_VENDORID && desc->idProduct == U1_PRODUCTID);
+}
+
+static void usb_path(libusb_device* dev, char* path, size_t len)
+{
+	int n;
+#ifdef HAVE_LIBUSB_HOTPLUG
+	uint8_t ports[7];
+	int i, num_ports;
+
+	num_ports = libusb_get_port_numbers(dev, ports, sizeof(ports));
+	n = snprintf(path, len, "%d-", libusb_get_bus_number(dev));
+	for (i = 0; i < num_ports && n < (int) len; i++)
+		n += snprintf(path + n, len - n, i ? ".%d" : "%d", ports[i]);
+#else
+	n = snprintf(path, len, "%d-%d", libusb_get_bus_number(dev),
+	             libusb_get_device_address(dev));
+#endif
+	(void) n;
+}
 
-	libusb_free_device_list(usb_list,1);
-	return uberteeth;
+static void dev_cache_free(void)
+{
+	int i;
+
+	for (i = 0; i < dev_cache_count; i++)
+		libusb_unref_device(dev_cache[i].dev);
+	dev_cache_count = -1;
 }
 
-static struct libusb_device_handle* find_ubertooth_device(int ubertooth_device)
+static int dev_cache_refresh(int refresh)
 {
 	struct libusb_device **usb_list = NULL;
-	struct libusb_context *ctx = NULL;
-	struct libusb_device_handle *devh = NULL;
 	struct libusb_device_descriptor desc;
-	int usb_devs, i, r, ret, uberteeth = 0;
-	int *ubertooth_devs = NULL;
+	int usb_devs, i, r;
 
-	usb_devs = libusb_get_device_list(ctx, &usb_list);
-	ubertooth_devs = calloc(usb_devs, sizeof(int));
+	if (dev_cache_count >= 0 && !refresh)
+		return dev_cache_count;
+	if (ubertooth_usb_init() < 0)
+		return -1;
+	dev_cache_free();
 
-	for(i = 0 ; i < usb_devs ; ++i) {
+	dev_cache_count = 0;
+	usb_devs = libusb_get_device_list(NULL, &usb_list);
+	for (i = 0; i < usb_devs && dev_cache_count < MAX_UBERTEETH; ++i) {
 		r = libusb_get_device_descriptor(usb_list[i], &desc);
-		if(r < 0)
+		if (r < 0) {
 			fprintf(stderr, "couldn't get usb descriptor for dev #%d!\n", i);
-		if ((desc.idVendor == TC13_VENDORID && desc.idProduct == TC13_PRODUCTID)
-		    || (desc.idVendor == U0_VENDORID && desc.idProduct == U0_PRODUCTID)
-		    || (desc.idVendor == U1_VENDORID && desc.idProduct == U1_PRODUCTID))
-		{
-			ubertooth_devs[uberteeth] = i;
-			uberteeth++;
+			continue;
+		}
+		if (is_ubertooth(&desc)) {
+			ubertooth_devinfo* info = &dev_cache[dev_cache_count++];
+			info->dev = libusb_ref_device(usb_list[i]);
+			usb_path(info->dev, info->usb_path, sizeof(info->usb_path));
+			info->serial[0] = '\0';
+			info->serial_read = 0;
+		}
+	}
+	libusb_free_device_list(usb_list, 1);
+	return dev_cache_count;
+}
+
+static const char* dev_cache_serial(int i)
+{
+	struct libusb_device_handle* devh;
+	uint8_t serial[17];
+	int j;
+
+	if (!dev_cache[i].serial_read) {
+		dev_cache[i].serial_read = 1;
+		if (libusb_open(dev_cache[i].dev, &devh) == 0) {
+			if (cmd_get_serial(devh, serial) == 0)
+				for (j = 0; j < 16; j++)
+					sprintf(dev_cache[i].serial + 2*j, "%02x", serial[j+1]);
+			libusb_close(devh);
 		}
 	}
-	if(uberteeth == 1) {
-		ret = libusb_open(usb_list[ubertooth_devs[0]], &devh);
-		if (ret)
-			show_libusb_error(ret);
+	return dev_cache[i].serial;
+}
+
+static void dev_cache_print(FILE* fp)
+{
+	int i;
+
+	for (i = 0; i < dev_cache_count; i++) {
+		const char* serial = dev_cache_serial(i);
+		fprintf(fp, "  Device %d: USB path %s, Serial No: %s\n", i,
+		        dev_cache[i].usb_path, serial[0] ? serial : "unknown");
 	}
-	else if (uberteeth == 0)
-		return NULL;
-	else {
-		if (ubertooth_device < 0) {
-			fprintf(stderr, "multiple Ubertooth devices found! Use '-U' to specify device number\n");
-			uint8_t serial[17], r;
-			for(i = 0 ; i < uberteeth ; ++i) {
-				libusb_get_device_descriptor(usb_list[ubertooth_devs[i]], &desc);
-				ret = libusb_open(usb_list[ubertooth_devs[i]], &devh);
-				if (ret) {
-					fprintf(stderr, "  Device %d: ", i);
-					show_libusb_error(ret);
-				}
-				else {
-					r = cmd_get_serial(devh, serial);
-					if(r==0) {
-						fprintf(stderr, "  Device %d: ", i);
-						print_serial(serial, stderr);
-					}
-					libusb_close(devh);
+}
+
+unsigned ubertooth_count(void) {
+	int r = dev_cache_refresh(1);
+	return r < 0 ? 0 : r;
+}
+
+/* Serial number of the device with this index, "" if it can not be read */
+const char* ubertooth_serial(unsigned index)
+{
+	int n = dev_cache_refresh(0);
+
+	if (n < 0 || index >= (unsigned)n)
+		return "";
+	return dev_cache_serial(index);
+}
+
+/* Resolve a -U argument: device index, USB path (bus-port.port...) or
+ * serial number (or a unique prefix of one) */
+int ubertooth_select(const char* spec)
+{
+	int i, n, match = -1;
+	size_t len = strlen(spec);
+	char* end;
+	long index;
+
+	n = dev_cache_refresh(0);
+	if (n < 0)
+		return -1;
+
+	index = strtol(spec, &end, 10);
+	if (end != spec && *end == '\0' && index < 0) {
+		/* "-1" means the only Ubertooth, as when -U is not given */
+		if (n == 1)
+			return 0;
+		if (n > 1) {
+			fprintf(stderr, "multiple Ubertooth devices found! Use '-U' to specify device\n");
+			dev_cache_print(stderr);
+			return -1;
+		}
+	} else if (len > 0 && len <= 2 && *end == '\0') {
+		if (index < n)
+			return index;
+	} else if (strchr(spec, '-')) {
+		for (i = 0; i < n; i++)
+			if (strcmp(spec, dev_cache[i].usb_path) == 0)
+				return i;
+	} else {
+		for (i = 0; i < n; i++) {
+			if (strncasecmp(spec, dev_cache_serial(i), len) == 0) {
+				if (match >= 0) {
+					fprintf(stderr, "Serial number '%s' is ambiguous\n", spec);
+					dev_cache_print(stderr);
+					return -1;
 				}
+				match = i;
 			}
-			devh = NULL;
-		} else {
-			ret = libusb_open(usb_list[ubertooth_devs[ubertooth_device]], &devh);
-			if (ret) {
-					show_libusb_error(ret);
-					devh = NULL;
-				}
 		}
+		if (match >= 0)
+			return match;
+	}
+
+	fprintf(stderr, "No Ubertooth matching '%s'\n", spec);
+	dev_cache_print(stderr);
+	return -1;
+}
+
+static struct libusb_device_handle* find_ubertooth_device(int ubertooth_device,
+                                                          int* index)
+{
+	struct libusb_device_handle *devh = NULL;
+	int ret, uberteeth;
+
+	uberteeth = dev_cache_refresh(0);
+	if (uberteeth <= 0)
+		return NULL;
+
+	if (uberteeth == 1) {
+		ubertooth_device = 0;
+	} else if (ubertooth_device < 0) {
+		fprintf(stderr, "multiple Ubertooth devices found! Use '-U' to specify device\n");
+		dev_cache_print(stderr);
+		return NULL;
+	} else if (ubertooth_device >= uberteeth) {
+		fprintf(stderr, "Ubertooth device %d not found\n", ubertooth_device);
+		return NULL;
 	}
-libusb_free_device_list(usb_list,1);
+
+	ret = libusb_open(dev_cache[ubertooth_device].dev, &devh);
+	if (ret) {
+		show_libusb_error(ret);
+		return NULL;
+	}
+	*index = ubertooth_device;
 	return devh;
 }
 
+/*
+ * Re-attach after USB reset
+ *
+ * A capture that registered a reattach callback survives the device
+ * dropping off the bus: the bulk transfer completes with NO_DEVICE (or
+ * hotplug reports the device gone), the device is looked up again by
+ * serial number or USB path once it reappears, and the callback replays
+ * the capture setup.  Each gap is counted and reported on stop.
+ */
+static int usb_lost(ubertooth_t* ut)
+{
+	return __atomic_load_n(&ut->usb_lost, __ATOMIC_ACQUIRE);
+}
+
+/* Called on the event thread */
+static void mark_usb_lost(ubertooth_t* ut)
+{
+	if (!usb_lost(ut)) {
+		ut->lost_ns = now_ns();
+		__atomic_store_n(&ut->usb_lost, 1, __ATOMIC_RELEASE);
+		fprintf(stderr, "Ubertooth disconnected%s\n",
+		        ut->reattach_cb ? ", waiting to re-attach" : "");
+	}
+}
+
+/* Keep a reference to the device that is open, dev may be NULL */
+static void set_usb_dev(ubertooth_t* ut, libusb_device* dev)
+{
+	libusb_device* old;
+
+	if (dev)
+		libusb_ref_device(dev);
+	old = __atomic_exchange_n(&ut->usb_dev, dev, __ATOMIC_ACQ_REL);
+	if (old)
+		libusb_unref_device(old);
+}
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+/* Runs on the event thread while the main thread may be closing devh,
+ * so only the cached device is looked at */
+static int LIBUSB_CALL hotplug_cb(libusb_context* ctx __attribute__((unused)),
+                                  libusb_device* dev,
+                                  libusb_hotplug_event event, void* user_data)
+{
+	ubertooth_t* ut = (ubertooth_t*)user_data;
+
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+		__atomic_store_n(&ut->usb_arrived, 1, __ATOMIC_RELEASE);
+	else if (dev == __atomic_load_n(&ut->usb_dev, __ATOMIC_ACQUIRE))
+		mark_usb_lost(ut);
+	return 0;
+}
+#endif
+
+void ubertooth_set_reattach(ubertooth_t* ut, reattach_callback cb, void* args)
+{
+	ut->reattach_cb = cb;
+	ut->reattach_args = args;
+}
+
+/*
+ * Publish received packets into a shared-memory ring as well as the
+ * fifo (or, with ring_only, instead of it).  Must be called before
+ * ubertooth_bulk_init().
+ */
+int ubertooth_ring_attach(ubertooth_t* ut, unsigned slots, int ring_only)
+{
+	ut->ring = ubertooth_ring_create(slots ? slots : UBERTOOTH_RING_DEFAULT);
+	if (ut->ring == NULL)
+		return -1;
+	ut->ring_only = ring_only;
+	return 0;
+}
+
+/* Send the output of the rx callbacks through a sink thread */
+int ubertooth_sink_attach(ubertooth_t* ut, int format)
+{
+	ut->sink = ubertooth_sink_start(format, 0);
+	return ut->sink == NULL ? -1 : 0;
+}
+
+/* Write out what the sink still holds, then print directly again */
+void ubertooth_sink_detach(ubertooth_t* ut)
+{
+	ubertooth_sink_stop(ut->sink);
+	ut->sink = NULL;
+}
+
+/* Record for a callback to fill in. Without a sink it is printed right
+ * away by ubertooth_record_commit(). NULL when the sink is full. */
+sink_record* ubertooth_record_claim(ubertooth_t* ut)
+{
+	static sink_record direct;
+
+	if (ut->sink)
+		return ubertooth_sink_claim(ut->sink);
+	return &direct;
+}
+
+void ubertooth_record_commit(ubertooth_t* ut, sink_record* rec)
+{
+	if (ut->sink) {
+		ubertooth_sink_commit(ut->sink);
+		return;
+	}
+
+	ubertooth_sink_write(stdout, SINK_TEXT, rec);
+	if (rec->type == SINK_BTLE || rec->type == SINK_EGO)
+		fflush(stdout);
+}
+
+/* Cancel the bulk transfer if it is still in flight. Returns 0 once
+ * cb_xfer has retired it. */
+static int rx_xfer_cancel(ubertooth_t* ut)
+{
+	int pending;
+
+	pthread_mutex_lock(&ut->xfer_lock);
+	pending = ut->rx_xfer != NULL;
+	if (pending)
+		libusb_cancel_transfer(ut->rx_xfer);
+	pthread_mutex_unlock(&ut->xfer_lock);
+
+	return pending;
+}
+
+static void ubertooth_reattach(ubertooth_t* ut)
+{
+	struct libusb_device_handle* devh;
+	uint64_t now = now_ns();
+	int i, n, r;
+
+	if (ut->reattach_cb == NULL) {
+		ut->stop_ubertooth = 1;
+		return;
+	}
+
+	/* Wait for the failed transfer to be retired first */
+	if (rx_xfer_cancel(ut))
+		return;
+
+	/* Without hotplug, poll the bus once a second */
+	if (ut->hotplug_handle < 0
+	    || !__atomic_load_n(&ut->usb_arrived, __ATOMIC_ACQUIRE)) {
+		if (now - ut->last_attempt_ns < 1000000000ull)
+			return;
+	}
+	ut->last_attempt_ns = now;
+	__atomic_store_n(&ut->usb_arrived, 0, __ATOMIC_RELAXED);
+
+	if (ut->devh) {
+		libusb_release_interface(ut->devh, 0);
+		libusb_close(ut->devh);
+		ut->devh = NULL;
+	}
+
+	n = dev_cache_refresh(1);
+	for (i = 0; i < n; i++) {
+		if (ut->serial[0] ? strcmp(ut->serial, dev_cache_serial(i)) == 0
+		                  : strcmp(ut->usb_path, dev_cache[i].usb_path) == 0)
+			break;
+	}
+	if (i >= n)
+		return;
+
+	r = libusb_open(dev_cache[i].dev, &devh);
+	if (r)
+		return;
+	r = libusb_claim_interface(devh, 0);
+	if (r < 0) {
+		libusb_close(devh);
+		return;
+	}
+	ut->devh = devh;
+	set_usb_dev(ut, dev_cache[i].dev);
+	strcpy(ut->usb_path, dev_cache[i].usb_path);
+
+	if (ut->reattach_cb(ut, ut->reattach_args) < 0 || ubertooth_bulk_init(ut) < 0)
+		return;
+
+	__atomic_store_n(&ut->usb_lost, 0, __ATOMIC_RELEASE);
+	ut->reattach_count++;
+	ut->gap_ns += now_ns() - ut->lost_ns;
+	fprintf(stderr, "Ubertooth re-attached at %s after %.1f s gap\n",
+	        ut->usb_path, (now_ns() - ut->lost_ns) / 1e9);
+}
+
 /*
  * based on http://libusb.sourceforge.net/api-1.0/group__asyncio.html#ga9fcb2aa23d342060ebda1d0cf7478856
  */
@@ -232,25 +562,33 @@ static void cb_xfer(struct libusb_transfer *xfer)
 
 	if (xfer->status != LIBUSB_TRANSFER_COMPLETED) {
 		if(xfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
-			r = libusb_submit_transfer(ut->rx_xfer);
+			r = libusb_submit_transfer(xfer);
 			if (r < 0)
 				fprintf(stderr, "Failed to submit USB transfer (%d)\n", r);
 			return;
 		}
-		if(xfer->status != LIBUSB_TRANSFER_CANCELLED)
+		if(xfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+			mark_usb_lost(ut);
+		else if(xfer->status != LIBUSB_TRANSFER_CANCELLED)
 			rx_xfer_status(xfer->status);
-		libusb_free_transfer(xfer);
+		pthread_mutex_lock(&ut->xfer_lock);
 		ut->rx_xfer = NULL;
+		pthread_mutex_unlock(&ut->xfer_lock);
+		libusb_free_transfer(xfer);
 		return;
 	}
 
 	if(ut->stop_ubertooth)
 		return;
 
-	fifo_inc_write_ptr(ut->fifo);
-	ut->rx_xfer->buffer = (uint8_t*)fifo_get_write_element(ut->fifo);
+	if (ut->ring)
+		ubertooth_ring_publish(ut->ring, (usb_pkt_rx*)xfer->buffer);
+	if (!ut->ring_only) {
+		fifo_inc_write_ptr(ut->fifo);
+		xfer->buffer = (uint8_t*)fifo_get_write_element(ut->fifo);
+	}
 
-	r = libusb_submit_transfer(ut->rx_xfer);
+	r = libusb_submit_transfer(xfer);
 	if (r < 0)
 		fprintf(stderr, "Failed to submit USB transfer (%d)\n", r);
 }
@@ -288,32 +626,54 @@ void ubertooth_bulk_thread_stop()
 
 int ubertooth_bulk_init(ubertooth_t* ut)
 {
+	struct libusb_transfer* xfer;
 	int r;
 
-	ut->rx_xfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(ut->rx_xfer, ut->devh, DATA_IN, (uint8_t*)fifo_get_write_element(ut->fifo), PKT_LEN, cb_xfer, ut, TIMEOUT);
+	xfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(xfer, ut->devh, DATA_IN, (uint8_t*)fifo_get_write_element(ut->fifo), PKT_LEN, cb_xfer, ut, TIMEOUT);
 
-	r = libusb_submit_transfer(ut->rx_xfer);
+	/* Published before submission: cb_xfer may run right away */
+	pthread_mutex_lock(&ut->xfer_lock);
+	ut->rx_xfer = xfer;
+	r = libusb_submit_transfer(xfer);
 	if (r < 0) {
 		fprintf(stderr, "rx_xfer submission: %d\n", r);
-		return -1;
+		ut->rx_xfer = NULL;
+		libusb_free_transfer(xfer);
 	}
-	return 0;
+	pthread_mutex_unlock(&ut->xfer_lock);
+
+	return r < 0 ? -1 : 0;
+}
+
+/* Cancel the bulk transfer and give the poll thread up to a second to
+ * retire it, so that a later ubertooth_bulk_init() starts from scratch.
+ * Call before ubertooth_bulk_thread_stop(). */
+void ubertooth_bulk_cancel(ubertooth_t* ut)
+{
+	int tries;
+
+	for (tries = 0; tries < 1000 && rx_xfer_cancel(ut); tries++)
+		usleep(1000);
 }
 
 void ubertooth_bulk_wait(ubertooth_t* ut)
 {
-	while (fifo_empty(ut->fifo) && !ut->stop_ubertooth)
+	while (fifo_empty(ut->fifo) && !ut->stop_ubertooth && !usb_lost(ut))
 		usleep(1);
 }
 
 int ubertooth_bulk_receive(ubertooth_t* ut, rx_callback cb, void* cb_args)
 {
+	if (usb_lost(ut) && fifo_empty(ut->fifo)) {
+		ubertooth_reattach(ut);
+		usleep(1000);
+		return -1;
+	}
 	if (!fifo_empty(ut->fifo)) {
 		(*cb)(ut, cb_args);
 		if(ut->stop_ubertooth) {
-			if(ut->rx_xfer)
-				libusb_cancel_transfer(ut->rx_xfer);
+			rx_xfer_cancel(ut);
 			return 1;
 		}
 		fflush(stderr);
@@ -324,6 +684,9 @@ int ubertooth_bulk_receive(ubertooth_t* ut, rx_callback cb, void* cb_args)
 	}
 }
 
+/* Stream symbols from the radio as set up by the caller, whose reattach
+ * callback must replay that whole setup and cmd_rx_syms(). Without one
+ * the stream ends when the device drops off the bus. */
 static int stream_rx_usb(ubertooth_t* ut, rx_callback cb, void* cb_args)
 {
 	// init USB transfer
@@ -372,12 +735,26 @@ int stream_rx_file(ubertooth_t* ut, FILE* fp, rx_callback cb, void* cb_args)
 	}
 }
 
+/* Set up AFH map capture again: channel 9999 selects the hopping mode */
+static int reattach_afh(ubertooth_t* ut, void* args __attribute__((unused)))
+{
+	int r;
+
+	r = cmd_set_channel(ut->devh, 9999);
+	if (r >= 0)
+		r = cmd_afh(ut->devh);
+	if (r >= 0)
+		r = cmd_rx_syms(ut->devh);
+	return r;
+}
+
 void rx_afh(ubertooth_t* ut, btbb_piconet* pn, int timeout)
 {
 	int r = btbb_init(max_ac_errors);
 	if (r < 0)
 		return;
 
+	ubertooth_set_reattach(ut, reattach_afh, NULL);
 	cmd_set_channel(ut->devh, 9999);
 
 	if (timeout) {
@@ -409,6 +786,7 @@ void rx_afh_r(ubertooth_t* ut, btbb_piconet* pn, int timeout __attribute__((unus
 	if (r < 0)
 		return;
 
+	ubertooth_set_reattach(ut, reattach_afh, NULL);
 	cmd_set_channel(ut->devh, 9999);
 
 	cmd_afh(ut->devh);
@@ -521,17 +899,71 @@ void rx_dump(ubertooth_t* ut, int bitstream)
 		stream_rx_usb(ut, cb_dump_full, NULL);
 }
 
+/* dump the GENERIC_PACKETs captured after a sync word, in the same format
+ * as rx_dump(). The radio must be set up for packet mode and a reattach
+ * callback registered to set it up again. */
+int rx_dump_generic(ubertooth_t* ut)
+{
+	int r;
+
+	r = ubertooth_bulk_init(ut);
+	if (r < 0)
+		return r;
+
+	r = ubertooth_bulk_thread_start();
+	if (r < 0)
+		return r;
+
+	r = cmd_rx_generic(ut->devh);
+	if (r < 0) {
+		ubertooth_bulk_thread_stop();
+		return r;
+	}
+
+	while(!ut->stop_ubertooth) {
+		ubertooth_bulk_wait(ut);
+		ubertooth_bulk_receive(ut, cb_dump_full, NULL);
+	}
+
+	ubertooth_bulk_thread_stop();
+
+	return 0;
+}
+
 void ubertooth_stop(ubertooth_t* ut)
 {
 	/* make sure xfers are not active */
-	if(ut->rx_xfer != NULL)
-		libusb_cancel_transfer(ut->rx_xfer);
+	rx_xfer_cancel(ut);
 	if (ut->devh != NULL) {
 		cmd_stop(ut->devh);
 		libusb_release_interface(ut->devh, 0);
 	}
 	libusb_close(ut->devh);
-	libusb_exit(NULL);
+	ut->devh = NULL;
+#ifdef HAVE_LIBUSB_HOTPLUG
+	if (ut->hotplug_handle >= 0) {
+		libusb_hotplug_deregister_callback(NULL, ut->hotplug_handle);
+		ut->hotplug_handle = -1;
+	}
+#endif
+	set_usb_dev(ut, NULL);
+	dev_cache_free();
+	if (usb_initialised) {
+		libusb_exit(NULL);
+		usb_initialised = 0;
+	}
+
+	if (ut->ring) {
+		ubertooth_ring_free(ut->ring);
+		ut->ring = NULL;
+	}
+
+	ubertooth_sink_detach(ut);
+
+	if (ut->reattach_count)
+		fprintf(stderr, "USB re-attached %u time%s, %.1f s total gap\n",
+		        ut->reattach_count, ut->reattach_count == 1 ? "" : "s",
+		        ut->gap_ns / 1e9);
 
 	if (ut->h_pcap_bredr) {
 		btbb_pcap_close(ut->h_pcap_bredr);
@@ -565,7 +997,23 @@ ubertooth_t* ubertooth_init()
 		fprintf(stderr, "Unable to initialize ringbuffer\n");
 
 	ut->devh = NULL;
+	ut->usb_dev = NULL;
 	ut->rx_xfer = NULL;
+	pthread_mutex_init(&ut->xfer_lock, NULL);
+	ut->ring = NULL;
+	ut->ring_only = 0;
+	ut->sink = NULL;
+	ut->serial[0] = '\0';
+	ut->usb_path[0] = '\0';
+	ut->reattach_cb = NULL;
+	ut->reattach_args = NULL;
+	ut->hotplug_handle = -1;
+	ut->usb_lost = 0;
+	ut->usb_arrived = 0;
+	ut->lost_ns = 0;
+	ut->last_attempt_ns = 0;
+	ut->reattach_count = 0;
+	ut->gap_ns = 0;
 	ut->stop_ubertooth = 0;
 	ut->abs_start_ns = 0;
 	ut->start_clk100ns = 0;
@@ -582,13 +1030,12 @@ ubertooth_t* ubertooth_init()
 
 int ubertooth_connect(ubertooth_t* ut, int ubertooth_device)
 {
-	int r = libusb_init(NULL);
-	if (r < 0) {
-		fprintf(stderr, "libusb_init failed (got 1.0?)\n");
+	int index;
+	int r = ubertooth_usb_init();
+	if (r < 0)
 		return -1;
-	}
 
-	ut->devh = find_ubertooth_device(ubertooth_device);
+	ut->devh = find_ubertooth_device(ubertooth_device, &index);
 	if (ut->devh == NULL) {
 		fprintf(stderr, "could not open Ubertooth device\n");
 		ubertooth_stop(ut);
@@ -602,6 +1049,22 @@ int ubertooth_connect(ubertooth_t* ut, int ubertooth_device)
 		return -1;
 	}
 
+	set_usb_dev(ut, dev_cache[index].dev);
+	strcpy(ut->serial, dev_cache_serial(index));
+	strcpy(ut->usb_path, dev_cache[index].usb_path);
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+	if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		r = libusb_hotplug_register_callback(NULL,
+				LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+				LIBUSB_HOTPLUG_NO_FLAGS, LIBUSB_HOTPLUG_MATCH_ANY,
+				LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+				hotplug_cb, ut, &ut->hotplug_handle);
+		if (r != LIBUSB_SUCCESS)
+			ut->hotplug_handle = -1;
+	}
+#endif
+
 	return 1;
 }
 
@@ -635,6 +1098,12 @@ int ubertooth_get_api(ubertooth_t *ut, uint16_t *version) {
 }
 
 int ubertooth_check_api(ubertooth_t *ut) {
+	return ubertooth_check_api_min(ut, UBERTOOTH_API_VERSION);
+}
+
+/* Like ubertooth_check_api(), for tools that can fall back to older
+ * firmware as long as it is at least 'required'. */
+int ubertooth_check_api_min(ubertooth_t *ut, uint16_t required) {
 	uint16_t version;
 	int result;
 	result = ubertooth_get_api(ut, &version);
@@ -642,10 +1111,10 @@ int ubertooth_check_api(ubertooth_t *ut) {
 		return result;
 	}
 
-	if (version < UBERTOOTH_API_VERSION) {
+	if (version < required) {
 		fprintf(stderr, "Ubertooth API version %x.%02x found, libubertooth %s requires %x.%02x.\n",
 				(version>>8)&0xFF, version&0xFF, VERSION,
-				(UBERTOOTH_API_VERSION>>8)&0xFF, UBERTOOTH_API_VERSION&0xFF);
+				(required>>8)&0xFF, required&0xFF);
 		fprintf(stderr, "Please upgrade to latest released firmware.\n");
 		fprintf(stderr, "See: https://github.com/greatscottgadgets/ubertooth/wiki/Firmware\n");
 		ubertooth_stop(ut);
@@ -24,7 +24,11 @@
 
 #include "ubertooth_control.h"
 #include "ubertooth_fifo.h"
+#include "ubertooth_le_recover.h"
+#include "ubertooth_ring.h"
+#include "ubertooth_sink.h"
 #include <btbb.h>
+#include <pthread.h>
 
 /* specan output types
  * see https://github.com/dkogan/feedgnuplot for plotter */
@@ -41,12 +45,45 @@ enum board_ids {
 	BOARD_ID_TC13BADGE      = 2
 };
 
-typedef struct {
+typedef struct ubertooth_s ubertooth_t;
+
+/* Re-issues the capture setup on a re-attached device */
+typedef int (*reattach_callback)(ubertooth_t* ut, void* args);
+
+struct ubertooth_s {
 	/* Ringbuffers for USB and Bluetooth symbols */
 	fifo_t* fifo;
+	ubertooth_ring* ring;
+	uint8_t ring_only;
+
+	/* Packet output, see ubertooth_sink_attach() */
+	ubertooth_sink* sink;
 
 	struct libusb_device_handle* devh;
+	/* Freed by cb_xfer on the libusb event thread: only touch it
+	 * under xfer_lock from elsewhere */
 	struct libusb_transfer* rx_xfer;
+	pthread_mutex_t xfer_lock;
+
+	/* Referenced device behind devh, compared against by the hotplug
+	 * callback on the event thread: accessed with __atomic builtins */
+	struct libusb_device* usb_dev;
+
+	/* Identity of the radio, used to find it again after a USB reset */
+	char serial[33];
+	char usb_path[24];
+
+	/* Re-attach state, see ubertooth_set_reattach() */
+	reattach_callback reattach_cb;
+	void* reattach_args;
+	int hotplug_handle;
+	/* Set on the event thread, accessed with __atomic builtins */
+	uint8_t usb_lost;
+	uint8_t usb_arrived;
+	uint64_t lost_ns;
+	uint64_t last_attempt_ns;
+	unsigned reattach_count;
+	uint64_t gap_ns;
 
 	uint8_t stop_ubertooth;
 	uint64_t abs_start_ns;
@@ -58,7 +95,7 @@ typedef struct {
 	lell_pcap_handle* h_pcap_le;
 	btbb_pcapng_handle* h_pcapng_bredr;
 	lell_pcapng_handle* h_pcapng_le;
-} ubertooth_t;
+};
 
 typedef void (*rx_callback)(ubertooth_t* ut, void* args);
 
@@ -75,14 +112,24 @@ void print_version();
 void register_cleanup_handler(ubertooth_t* ut, int do_exit);
 ubertooth_t* ubertooth_init();
 unsigned ubertooth_count(void);
+const char* ubertooth_serial(unsigned index);
+int ubertooth_select(const char* spec);
 int ubertooth_connect(ubertooth_t* ut, int ubertooth_device);
 ubertooth_t* ubertooth_start(int ubertooth_device);
 void ubertooth_stop(ubertooth_t* ut);
 int ubertooth_get_api(ubertooth_t *ut, uint16_t *version);
 int ubertooth_check_api(ubertooth_t *ut);
+int ubertooth_check_api_min(ubertooth_t *ut, uint16_t required);
 void ubertooth_set_timeout(ubertooth_t* ut, int seconds);
+void ubertooth_set_reattach(ubertooth_t* ut, reattach_callback cb, void* args);
+int ubertooth_ring_attach(ubertooth_t* ut, unsigned slots, int ring_only);
+int ubertooth_sink_attach(ubertooth_t* ut, int format);
+void ubertooth_sink_detach(ubertooth_t* ut);
+sink_record* ubertooth_record_claim(ubertooth_t* ut);
+void ubertooth_record_commit(ubertooth_t* ut, sink_record* rec);
 
 int ubertooth_bulk_init(ubertooth_t* ut);
+void ubertooth_bulk_cancel(ubertooth_t* ut);
 void ubertooth_bulk_wait(ubertooth_t* ut);
 int ubertooth_bulk_receive(ubertooth_t* ut, rx_callback cb, void* cb_args);
 int ubertooth_bulk_thread_start();
@@ -91,6 +138,7 @@ void ubertooth_bulk_thread_stop();
 int stream_rx_file(ubertooth_t* ut,FILE* fp, rx_callback cb, void* cb_args);
 
 void rx_dump(ubertooth_t* ut, int full);
+int rx_dump_generic(ubertooth_t* ut);
 void rx_btle(ubertooth_t* ut);
 void rx_btle_file(FILE* fp);
 void rx_afh(ubertooth_t* ut, btbb_piconet* pn, int timeout);
@@ -0,0 +1,582 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ubertooth_btctl.h"
+
+/* A transfer spanning several packets only completes early on a short
+ * packet, so give up waiting after a while to deliver messages whose last
+ * packet happened to be full size. */
+#define BTCTL_XFER_TIMEOUT 10
+
+#define BTCTL_START_HDR_LEN 4
+#define BTCTL_CONT_HDR_LEN  1
+
+struct btctl_s {
+	ubertooth_t* ut;
+	btctl_callbacks cbs;
+
+	struct libusb_transfer* rx_xfer[BTCTL_NUM_XFERS];
+	/* shared between the libusb event thread and the caller's, only
+	 * accessed through __atomic builtins */
+	int rx_active;
+	int stopping;
+
+	/* message being reassembled */
+	uint8_t msg[BTCTL_MAX_MSG_LEN];
+	size_t msg_len;
+	size_t msg_size;
+	int in_msg;
+	char text[BTCTL_MAX_MSG_LEN + 1];
+
+	unsigned errors;   // atomic, see count_error()
+	pthread_mutex_t tx_lock;
+};
+
+/* only the event thread counts, btctl_errors() may read from any */
+static void count_error(btctl_t* bt)
+{
+	__atomic_fetch_add(&bt->errors, 1, __ATOMIC_RELAXED);
+}
+
+static uint16_t get_le16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le16(uint8_t* p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t* p, uint32_t v)
+{
+	put_le16(p, v & 0xffff);
+	put_le16(p + 2, v >> 16);
+}
+
+static void put_le64(uint8_t* p, uint64_t v)
+{
+	put_le32(p, v & 0xffffffff);
+	put_le32(p + 4, v >> 32);
+}
+
+int btctl_decode_rx_pkt(const uint8_t* payload, size_t len, btctl_rx_pkt* pkt)
+{
+	if (len < sizeof(btctl_rx_pkt_t))
+		return -1;
+
+	pkt->clkn = get_le32(payload);
+	pkt->chan = payload[4];
+	pkt->flags = payload[5];
+	pkt->data_size = get_le16(payload + 6);
+	memcpy(&pkt->bb_hdr, payload + 8, sizeof(bbhdr_t));
+	pkt->bt_data = payload + sizeof(btctl_rx_pkt_t);
+
+	if (pkt->data_size > len - sizeof(btctl_rx_pkt_t))
+		return -1;
+	return 0;
+}
+
+int btctl_decode_state_resp(const uint8_t* payload, size_t len,
+                            btctl_state_resp_t* resp)
+{
+	if (len < sizeof(btctl_state_resp_t))
+		return -1;
+
+	resp->state = payload[0];
+	resp->reason = payload[1];
+	return 0;
+}
+
+int btctl_decode_flow_ind(const uint8_t* payload, size_t len,
+                          btctl_flow_ind_t* ind)
+{
+	/* slot_drops was appended later, older firmware does not send it */
+	if (len < offsetof(btctl_flow_ind_t, slot_drops))
+		return -1;
+
+	ind->congested = payload[0];
+	ind->tx_drops = get_le32(payload + 4);
+	ind->rx_drops = get_le32(payload + 8);
+	ind->alloc_fail = get_le32(payload + 12);
+	ind->slot_drops = len < sizeof(btctl_flow_ind_t) ? 0 : get_le32(payload + 16);
+	return 0;
+}
+
+static void btctl_debug(btctl_t* bt, const uint8_t* text, size_t len)
+{
+	if (!bt->cbs.debug)
+		return;
+
+	/* firmware pads prints with NULs */
+	while (len > 0 && text[len - 1] == '\0')
+		len--;
+	memcpy(bt->text, text, len);
+	bt->text[len] = '\0';
+	bt->cbs.debug(bt, bt->text, bt->cbs.user);
+}
+
+static void btctl_dispatch(btctl_t* bt)
+{
+	uint8_t type;
+	const uint8_t* payload;
+	size_t len;
+	btctl_rx_pkt pkt;
+	btctl_state_resp_t resp;
+	btctl_flow_ind_t ind;
+
+	if (bt->msg_size < BTCTL_HDR_LEN) {
+		count_error(bt);
+		return;
+	}
+
+	type = bt->msg[0];
+	payload = bt->msg + BTCTL_HDR_LEN;
+	len = bt->msg_size - BTCTL_HDR_LEN;
+
+	switch (type) {
+	case BTCTL_DEBUG:
+		if (bt->cbs.debug) {
+			btctl_debug(bt, payload, len);
+			return;
+		}
+		break;
+	case BTCTL_RX_PKT:
+		if (bt->cbs.rx_pkt) {
+			if (btctl_decode_rx_pkt(payload, len, &pkt) < 0) {
+				count_error(bt);
+				return;
+			}
+			bt->cbs.rx_pkt(bt, &pkt, bt->cbs.user);
+			return;
+		}
+		break;
+	case BTCTL_STATE_RESP:
+		if (bt->cbs.state) {
+			if (btctl_decode_state_resp(payload, len, &resp) < 0) {
+				count_error(bt);
+				return;
+			}
+			bt->cbs.state(bt, resp.state, resp.reason, bt->cbs.user);
+			return;
+		}
+		break;
+	case BTCTL_FLOW_IND:
+		if (bt->cbs.flow) {
+			if (btctl_decode_flow_ind(payload, len, &ind) < 0) {
+				count_error(bt);
+				return;
+			}
+			bt->cbs.flow(bt, &ind, bt->cbs.user);
+			return;
+		}
+		break;
+	}
+
+	if (bt->cbs.msg)
+		bt->cbs.msg(bt, type, payload, len, bt->cbs.user);
+}
+
+/* Feed one USB packet into the reassembler. */
+static void btctl_rx_packet(btctl_t* bt, const uint8_t* data, size_t len)
+{
+	size_t hdr_len, chunk;
+
+	if (len == 0)
+		return;
+
+	switch (data[0]) {
+	case BTUSB_EARLY_PRINT:
+		btctl_debug(bt, data + 1, len - 1);
+		return;
+
+	case BTUSB_MSG_START:
+		if (bt->in_msg || len < BTCTL_START_HDR_LEN) {
+			/* previous message was truncated, drop it */
+			count_error(bt);
+			bt->in_msg = 0;
+			if (len < BTCTL_START_HDR_LEN)
+				return;
+		}
+		bt->msg_size = get_le16(data + 2);
+		bt->msg_len = 0;
+		bt->in_msg = 1;
+		hdr_len = BTCTL_START_HDR_LEN;
+		break;
+
+	case BTUSB_MSG_CONT:
+		if (!bt->in_msg) {
+			count_error(bt);
+			return;
+		}
+		hdr_len = BTCTL_CONT_HDR_LEN;
+		break;
+
+	default:
+		count_error(bt);
+		bt->in_msg = 0;
+		return;
+	}
+
+	chunk = len - hdr_len;
+	if (chunk > bt->msg_size - bt->msg_len) {
+		count_error(bt);
+		chunk = bt->msg_size - bt->msg_len;
+	}
+	memcpy(bt->msg + bt->msg_len, data + hdr_len, chunk);
+	bt->msg_len += chunk;
+
+	if (bt->msg_len == bt->msg_size) {
+		bt->in_msg = 0;
+		btctl_dispatch(bt);
+	}
+}
+
+static void cb_btctl_rx(struct libusb_transfer* xfer)
+{
+	btctl_t* bt = (btctl_t*)xfer->user_data;
+	int i, r;
+
+	switch (xfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		/* every packet but the last one in a transfer is full size */
+		for (i = 0; i < xfer->actual_length; i += PKT_LEN) {
+			int n = xfer->actual_length - i;
+			btctl_rx_packet(bt, xfer->buffer + i, n < PKT_LEN ? n : PKT_LEN);
+		}
+		break;
+	case LIBUSB_TRANSFER_CANCELLED:
+		break;
+	default:
+		fprintf(stderr, "btctl rx transfer failed (%d)\n", xfer->status);
+		__atomic_store_n(&bt->stopping, 1, __ATOMIC_RELEASE);
+		break;
+	}
+
+	if (__atomic_load_n(&bt->stopping, __ATOMIC_ACQUIRE) ||
+	    xfer->status == LIBUSB_TRANSFER_CANCELLED) {
+		__atomic_fetch_sub(&bt->rx_active, 1, __ATOMIC_RELEASE);
+		return;
+	}
+
+	r = libusb_submit_transfer(xfer);
+	if (r < 0) {
+		fprintf(stderr, "Failed to submit USB transfer (%d)\n", r);
+		__atomic_fetch_sub(&bt->rx_active, 1, __ATOMIC_RELEASE);
+	}
+}
+
+static void cb_btctl_tx(struct libusb_transfer* xfer)
+{
+	if (xfer->status != LIBUSB_TRANSFER_COMPLETED)
+		fprintf(stderr, "btctl tx transfer failed (%d)\n", xfer->status);
+}
+
+btctl_t* btctl_open(ubertooth_t* ut, const btctl_callbacks* cbs)
+{
+	btctl_t* bt;
+	int i;
+
+	bt = (btctl_t*)calloc(1, sizeof(btctl_t));
+	if (bt == NULL) {
+		fprintf(stderr, "Unable to allocate memory\n");
+		return NULL;
+	}
+
+	bt->ut = ut;
+	if (cbs)
+		bt->cbs = *cbs;
+	pthread_mutex_init(&bt->tx_lock, NULL);
+
+	for (i = 0; i < BTCTL_NUM_XFERS; i++) {
+		bt->rx_xfer[i] = libusb_alloc_transfer(0);
+		if (bt->rx_xfer[i] == NULL) {
+			btctl_close(bt);
+			return NULL;
+		}
+		bt->rx_xfer[i]->buffer = NULL;
+		libusb_fill_bulk_transfer(bt->rx_xfer[i], ut->devh, DATA_IN,
+		                          malloc(PKT_LEN * BTCTL_XFER_PKTS),
+		                          PKT_LEN * BTCTL_XFER_PKTS,
+		                          cb_btctl_rx, bt, BTCTL_XFER_TIMEOUT);
+		if (bt->rx_xfer[i]->buffer == NULL) {
+			btctl_close(bt);
+			return NULL;
+		}
+	}
+
+	return bt;
+}
+
+int btctl_start(btctl_t* bt)
+{
+	int i, r;
+
+	__atomic_store_n(&bt->stopping, 0, __ATOMIC_RELEASE);
+	bt->in_msg = 0;
+	for (i = 0; i < BTCTL_NUM_XFERS; i++) {
+		/* counted before submission, the callback may run at once */
+		__atomic_fetch_add(&bt->rx_active, 1, __ATOMIC_RELAXED);
+		r = libusb_submit_transfer(bt->rx_xfer[i]);
+		if (r < 0) {
+			__atomic_fetch_sub(&bt->rx_active, 1, __ATOMIC_RELAXED);
+			fprintf(stderr, "rx_xfer submission: %d\n", r);
+			btctl_stop(bt);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Cancel reception and wait for every transfer to come back. libusb events
+ * must still be handled by another thread while this runs. */
+void btctl_stop(btctl_t* bt)
+{
+	int i;
+
+	__atomic_store_n(&bt->stopping, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < BTCTL_NUM_XFERS; i++)
+		libusb_cancel_transfer(bt->rx_xfer[i]);
+	while (__atomic_load_n(&bt->rx_active, __ATOMIC_ACQUIRE) > 0)
+		usleep(1000);
+}
+
+void btctl_close(btctl_t* bt)
+{
+	int i;
+
+	if (bt == NULL)
+		return;
+
+	for (i = 0; i < BTCTL_NUM_XFERS; i++) {
+		if (bt->rx_xfer[i]) {
+			free(bt->rx_xfer[i]->buffer);
+			libusb_free_transfer(bt->rx_xfer[i]);
+		}
+	}
+	pthread_mutex_destroy(&bt->tx_lock);
+	free(bt);
+}
+
+unsigned btctl_errors(btctl_t* bt)
+{
+	return __atomic_load_n(&bt->errors, __ATOMIC_RELAXED);
+}
+
+static int btctl_submit_packet(btctl_t* bt, const uint8_t* hdr, size_t hdr_len,
+                               const uint8_t* data, size_t len)
+{
+	struct libusb_transfer* xfer;
+	uint8_t* buf;
+	int r;
+
+	xfer = libusb_alloc_transfer(0);
+	buf = malloc(hdr_len + len);
+	if (xfer == NULL || buf == NULL) {
+		free(buf);
+		if (xfer)
+			libusb_free_transfer(xfer);
+		return LIBUSB_ERROR_NO_MEM;
+	}
+	memcpy(buf, hdr, hdr_len);
+	memcpy(buf + hdr_len, data, len);
+
+	libusb_fill_bulk_transfer(xfer, bt->ut->devh, DATA_OUT, buf,
+	                          hdr_len + len, cb_btctl_tx, bt, TIMEOUT);
+	xfer->flags = LIBUSB_TRANSFER_FREE_BUFFER | LIBUSB_TRANSFER_FREE_TRANSFER;
+
+	r = libusb_submit_transfer(xfer);
+	if (r < 0) {
+		free(buf);
+		libusb_free_transfer(xfer);
+	}
+	return r;
+}
+
+int btctl_send(btctl_t* bt, uint8_t type, const uint8_t* payload, size_t len)
+{
+	uint8_t* msg;
+	uint8_t hdr[BTCTL_START_HDR_LEN];
+	size_t size = BTCTL_HDR_LEN + len, off, chunk;
+	int r;
+
+	if (size > BTCTL_MAX_MSG_LEN)
+		return -1;
+
+	msg = calloc(1, size);
+	if (msg == NULL)
+		return LIBUSB_ERROR_NO_MEM;
+	msg[0] = type;
+	if (len)
+		memcpy(msg + BTCTL_HDR_LEN, payload, len);
+
+	/* fragments of one message must not interleave with another's */
+	pthread_mutex_lock(&bt->tx_lock);
+
+	hdr[0] = BTUSB_MSG_START;
+	hdr[1] = 0;
+	put_le16(hdr + 2, size);
+	chunk = size < PKT_LEN - BTCTL_START_HDR_LEN ?
+	        size : PKT_LEN - BTCTL_START_HDR_LEN;
+	r = btctl_submit_packet(bt, hdr, BTCTL_START_HDR_LEN, msg, chunk);
+
+	hdr[0] = BTUSB_MSG_CONT;
+	for (off = chunk; r >= 0 && off < size; off += chunk) {
+		chunk = size - off;
+		if (chunk > PKT_LEN - BTCTL_CONT_HDR_LEN)
+			chunk = PKT_LEN - BTCTL_CONT_HDR_LEN;
+		r = btctl_submit_packet(bt, hdr, BTCTL_CONT_HDR_LEN, msg + off, chunk);
+	}
+
+	pthread_mutex_unlock(&bt->tx_lock);
+	free(msg);
+
+	if (r < 0) {
+		show_libusb_error(r);
+		return r;
+	}
+	return 0;
+}
+
+int btctl_send_debug(btctl_t* bt, const char* msg)
+{
+	size_t len = strlen(msg);
+
+	/* the firmware's console only takes this much */
+	if (len > 256)
+		len = 256;
+	return btctl_send(bt, BTCTL_DEBUG, (const uint8_t*)msg, len);
+}
+
+int btctl_send_reset(btctl_t* bt)
+{
+	return btctl_send(bt, BTCTL_RESET_REQ, NULL, 0);
+}
+
+int btctl_send_idle(btctl_t* bt)
+{
+	return btctl_send(bt, BTCTL_IDLE_REQ, NULL, 0);
+}
+
+int btctl_send_set_freq_off(btctl_t* bt, uint16_t off)
+{
+	uint8_t buf[2];
+
+	put_le16(buf, off);
+	return btctl_send(bt, BTCTL_SET_FREQ_OFF_REQ, buf, sizeof(buf));
+}
+
+int btctl_send_set_max_ac_errors(btctl_t* bt, uint16_t max_ac_errors)
+{
+	uint8_t buf[2];
+
+	put_le16(buf, max_ac_errors);
+	return btctl_send(bt, BTCTL_SET_MAX_AC_ERRORS_REQ, buf, sizeof(buf));
+}
+
+int btctl_send_set_bdaddr(btctl_t* bt, uint64_t bdaddr)
+{
+	uint8_t buf[8];
+
+	put_le64(buf, bdaddr);
+	return btctl_send(bt, BTCTL_SET_BDADDR_REQ, buf, sizeof(buf));
+}
+
+int btctl_send_inquiry(btctl_t* bt)
+{
+	return btctl_send(bt, BTCTL_INQUIRY_REQ, NULL, 0);
+}
+
+int btctl_send_inquiry_scan(btctl_t* bt)
+{
+	return btctl_send(bt, BTCTL_INQUIRY_SCAN_REQ, NULL, 0);
+}
+
+int btctl_send_paging(btctl_t* bt, uint64_t bdaddr)
+{
+	uint8_t buf[8];
+
+	put_le64(buf, bdaddr);
+	return btctl_send(bt, BTCTL_PAGING_REQ, buf, sizeof(buf));
+}
+
+int btctl_send_page_scan(btctl_t* bt)
+{
+	return btctl_send(bt, BTCTL_PAGE_SCAN_REQ, NULL, 0);
+}
+
+int btctl_send_monitor(btctl_t* bt, uint64_t bdaddr)
+{
+	uint8_t buf[8];
+
+	put_le64(buf, bdaddr);
+	return btctl_send(bt, BTCTL_MONITOR_REQ, buf, sizeof(buf));
+}
+
+/* 'data' is the ACL payload including its payload header */
+static int btctl_send_bb(btctl_t* bt, uint8_t type, const bbhdr_t* hdr,
+                         const uint8_t* data, size_t len)
+{
+	uint8_t buf[sizeof(bbhdr_t) + MAX_ACL_PACKET_SIZE];
+
+	if (len > MAX_ACL_PACKET_SIZE)
+		return -1;
+	memcpy(buf, hdr, sizeof(bbhdr_t));
+	memcpy(buf + sizeof(bbhdr_t), data, len);
+	return btctl_send(bt, type, buf, sizeof(bbhdr_t) + len);
+}
+
+int btctl_send_tx_acl(btctl_t* bt, const bbhdr_t* hdr, const uint8_t* data,
+                      size_t len)
+{
+	return btctl_send_bb(bt, BTCTL_TX_ACL_REQ, hdr, data, len);
+}
+
+int btctl_send_set_eir(btctl_t* bt, const bbhdr_t* hdr, const uint8_t* data,
+                       size_t len)
+{
+	return btctl_send_bb(bt, BTCTL_SET_EIR_REQ, hdr, data, len);
+}
+
+int btctl_send_set_afh(btctl_t* bt, uint32_t instant, uint8_t mode,
+                       const uint8_t map[10])
+{
+	uint8_t buf[sizeof(btctl_set_afh_req_t)];
+
+	put_le32(buf, instant);
+	buf[4] = mode;
+	memcpy(buf + 5, map, 10);
+	return btctl_send(bt, BTCTL_SET_AFH_REQ, buf, sizeof(buf));
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_BTCTL_H__
+#define __UBERTOOTH_BTCTL_H__
+
+#include <stddef.h>
+#include "ubertooth.h"
+
+/*
+ * Host side of the BTCTL protocol spoken by the btbr firmware.
+ *
+ * Messages are a 4 byte header (type, 3 bytes padding) followed by a
+ * payload. On the wire they are split into 64 byte USB packets: the first
+ * one starts with 'S', 0 and the 16 bit little endian message length, the
+ * following ones with 'C'. The firmware may also send 'P' packets holding
+ * early debug text outside of any message.
+ *
+ * Reception uses several multi-packet bulk transfers kept in flight, so
+ * libusb must be serviced by ubertooth_bulk_thread_start() or an event
+ * loop of your own. All callbacks run on that thread.
+ */
+
+#define BTCTL_HDR_LEN      4
+#define BTCTL_MAX_MSG_LEN  0xffff
+
+/* in-flight IN transfers, each covering several USB packets */
+#define BTCTL_NUM_XFERS    4
+#define BTCTL_XFER_PKTS    8
+
+typedef struct btctl_s btctl_t;
+
+/* decoded BTCTL_RX_PKT, in host byte order */
+typedef struct {
+	uint32_t clkn;
+	uint8_t chan;
+	uint8_t flags;
+	uint16_t data_size;
+	bbhdr_t bb_hdr;
+	const uint8_t* bt_data;   // points into the received message
+} btctl_rx_pkt;
+
+typedef struct {
+	/* BTCTL_RX_PKT */
+	void (*rx_pkt)(btctl_t* bt, const btctl_rx_pkt* pkt, void* user);
+	/* BTCTL_STATE_RESP */
+	void (*state)(btctl_t* bt, btctl_state_t state, btctl_reason_t reason,
+	              void* user);
+	/* BTCTL_FLOW_IND: the device started or stopped dropping messages */
+	void (*flow)(btctl_t* bt, const btctl_flow_ind_t* ind, void* user);
+	/* BTCTL_DEBUG messages and 'P' packets, NUL terminated */
+	void (*debug)(btctl_t* bt, const char* msg, void* user);
+	/* any message without a typed handler above */
+	void (*msg)(btctl_t* bt, uint8_t type, const uint8_t* payload,
+	            size_t len, void* user);
+	void* user;
+} btctl_callbacks;
+
+btctl_t* btctl_open(ubertooth_t* ut, const btctl_callbacks* cbs);
+int btctl_start(btctl_t* bt);
+void btctl_stop(btctl_t* bt);
+void btctl_close(btctl_t* bt);
+
+/* number of malformed packets or messages dropped so far */
+unsigned btctl_errors(btctl_t* bt);
+
+/* decode a complete message payload (after the 4 byte header) */
+int btctl_decode_rx_pkt(const uint8_t* payload, size_t len, btctl_rx_pkt* pkt);
+int btctl_decode_state_resp(const uint8_t* payload, size_t len,
+                            btctl_state_resp_t* resp);
+int btctl_decode_flow_ind(const uint8_t* payload, size_t len,
+                          btctl_flow_ind_t* ind);
+
+/* Queue a message for the device. Fragments are sent asynchronously and in
+ * order; returns 0 once all of them have been submitted. */
+int btctl_send(btctl_t* bt, uint8_t type, const uint8_t* payload, size_t len);
+
+int btctl_send_debug(btctl_t* bt, const char* msg);
+int btctl_send_reset(btctl_t* bt);
+int btctl_send_idle(btctl_t* bt);
+int btctl_send_set_freq_off(btctl_t* bt, uint16_t off);
+int btctl_send_set_max_ac_errors(btctl_t* bt, uint16_t max_ac_errors);
+int btctl_send_set_bdaddr(btctl_t* bt, uint64_t bdaddr);
+int btctl_send_inquiry(btctl_t* bt);
+int btctl_send_inquiry_scan(btctl_t* bt);
+int btctl_send_paging(btctl_t* bt, uint64_t bdaddr);
+int btctl_send_page_scan(btctl_t* bt);
+int btctl_send_monitor(btctl_t* bt, uint64_t bdaddr);
+int btctl_send_tx_acl(btctl_t* bt, const bbhdr_t* hdr, const uint8_t* data,
+                      size_t len);
+int btctl_send_set_eir(btctl_t* bt, const bbhdr_t* hdr, const uint8_t* data,
+                       size_t len);
+int btctl_send_set_afh(btctl_t* bt, uint32_t instant, uint8_t mode,
+                       const uint8_t map[10]);
+
+#endif /* __UBERTOOTH_BTCTL_H__ */
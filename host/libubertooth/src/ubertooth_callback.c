@@ -124,6 +124,7 @@ void cb_scan(ubertooth_t* ut, void* args __attribute__((unused)))
 	int8_t snr;
 	int offset;
 	uint32_t clkn;
+	sink_record* rec;
 
 	usb_pkt_rx usb = fifo_pop(ut->fifo);
 	usb_pkt_rx* rx = &usb;
@@ -150,16 +151,20 @@ void cb_scan(ubertooth_t* ut, void* args __attribute__((unused)))
 	btbb_packet_set_data(pkt, syms + offset, BANK_LEN - offset,
 	                     rx->channel, clkn);
 
-	printf("systime=%u ch=%2d LAP=%06x err=%u clk100ns=%u clk1=%u s=%d n=%d snr=%d\n",
-	       (int)time(NULL),
-	       btbb_packet_get_channel(pkt),
-	       btbb_packet_get_lap(pkt),
-	       btbb_packet_get_ac_errors(pkt),
-	       rx->clk100ns,
-	       btbb_packet_get_clkn(pkt),
-	       signal_level,
-	       noise_level,
-	       snr);
+	rec = ubertooth_record_claim(ut);
+	if (rec) {
+		rec->type = SINK_BR_SCAN;
+		rec->systime = (uint32_t)time(NULL);
+		rec->br.channel = btbb_packet_get_channel(pkt);
+		rec->br.lap = btbb_packet_get_lap(pkt);
+		rec->br.ac_errors = btbb_packet_get_ac_errors(pkt);
+		rec->br.clk = btbb_packet_get_clkn(pkt);
+		rec->br.signal = signal_level;
+		rec->br.noise = noise_level;
+		rec->br.snr = snr;
+		rec->pkt = *rx;
+		ubertooth_record_commit(ut, rec);
+	}
 
 	btbb_process_packet(pkt, NULL);
 
@@ -303,7 +308,6 @@ void cb_btle(ubertooth_t* ut, void* args)
 {
 	lell_packet* pkt;
 	btle_options* opts = (btle_options*) args;
-	int i;
 	usb_pkt_rx usb = fifo_pop(ut->fifo);
 	usb_pkt_rx* rx = &usb;
 	// u32 access_address = 0; // Build warning
@@ -311,33 +315,17 @@ void cb_btle(ubertooth_t* ut, void* args)
 	static u32 prev_ts = 0;
 	uint32_t refAA;
 	int8_t sig, noise;
+	sink_record* rec;
 
 	// display LE promiscuous mode state changes
 	if (rx->pkt_type == LE_PROMISC) {
-		u8 state = rx->data[0];
-		void *val = &rx->data[1];
-
-		printf("--------------------\n");
-		printf("LE Promisc - ");
-		switch (state) {
-			case 0:
-				printf("Access Address: %08x\n", *(uint32_t *)val);
-				break;
-			case 1:
-				printf("CRC Init: %06x\n", *(uint32_t *)val);
-				break;
-			case 2:
-				printf("Hop interval: %g ms\n", *(uint16_t *)val * 1.25);
-				break;
-			case 3:
-				printf("Hop increment: %u\n", *(uint8_t *)val);
-				break;
-			default:
-				printf("Unknown %u\n", state);
-				break;
-		};
-		printf("\n");
-
+		rec = ubertooth_record_claim(ut);
+		if (rec) {
+			rec->type = SINK_LE_PROMISC;
+			rec->systime = systime;
+			rec->pkt = *rx;
+			ubertooth_record_commit(ut, rec);
+		}
 		return;
 	}
 
@@ -398,49 +386,52 @@ void cb_btle(ubertooth_t* ut, void* args)
 		rx_ts += 3276800000;
 	u32 ts_diff = rx_ts - prev_ts;
 	prev_ts = rx->clk100ns;
-	printf("systime=%u freq=%d addr=%08x delta_t=%.03f ms rssi=%d\n",
-	       systime, rx->channel + 2402, lell_get_access_address(pkt),
-	       ts_diff / 10000.0, rx->rssi_min - 54);
-
-	int len = (rx->data[5] & 0x3f) + 6 + 3;
-	if (len > 50) len = 50;
 
-	for (i = 4; i < len; ++i)
-		printf("%02x ", rx->data[i]);
-	printf("\n");
-
-	lell_print(pkt);
-	printf("\n");
-
-	lell_packet_unref(pkt);
-
-	fflush(stdout);
+	/* our reference goes to the record, the sink drops it once printed.
+	 * libbtbb does not count references atomically, so the packet must
+	 * not be touched here after the commit. */
+	rec = ubertooth_record_claim(ut);
+	if (rec == NULL) {
+		lell_packet_unref(pkt);
+		return;
+	}
+	rec->type = SINK_BTLE;
+	rec->systime = systime;
+	rec->delta_t = ts_diff;
+	rec->btle.access_address = lell_get_access_address(pkt);
+	rec->btle.lell = pkt;
+	rec->pkt = *rx;
+	ubertooth_record_commit(ut, rec);
 }
 /*
  * Sniff E-GO packets
  */
 void cb_ego(ubertooth_t* ut, void* args)
 {
-	int i;
 	uint8_t len = *(uint8_t *)args;
+	sink_record* rec;
 	static u32 prev_ts = 0;
 	usb_pkt_rx usb = fifo_pop(ut->fifo);
 	usb_pkt_rx* rx = &usb;
 
+	if (rx->pkt_type != EGO_PACKET)
+		return;
+
 	u32 rx_time = rx->clk100ns;
 	if (rx_time < prev_ts)
 		rx_time += 3276800000; // rollover
 	u32 ts_diff = rx_time - prev_ts;
 	prev_ts = rx->clk100ns;
-	printf("time=%u delta_t=%.06f ms freq=%d \n",
-	       rx->clk100ns, ts_diff / 10000.0,
-	       rx->channel + 2402);
-
-	for (i = 0; i < len; ++i)
-		printf("%02x ", rx->data[i]);
-	printf("\n\n");
 
-	fflush(stdout);
+	rec = ubertooth_record_claim(ut);
+	if (rec) {
+		rec->type = SINK_EGO;
+		rec->systime = (uint32_t)time(NULL);
+		rec->delta_t = ts_diff;
+		rec->len = len;
+		rec->pkt = *rx;
+		ubertooth_record_commit(ut, rec);
+	}
 }
 
 #define CLOCK_TRIM_THRESHOLD 2
@@ -456,6 +447,7 @@ void cb_rx(ubertooth_t* ut, void* args)
 	int r;
 	uint32_t lap = LAP_ANY;
 	uint8_t uap = UAP_ANY;
+	sink_record* rec;
 
 	static int trim_counter = 0;
 	static int calibrated = 0;
@@ -516,17 +508,21 @@ void cb_rx(ubertooth_t* ut, void* args)
 	if (infile == NULL)
 		systime = time(NULL);
 
-	printf("systime=%u ch=%2d LAP=%06x err=%u clkn=%u clk_offset=%u s=%d n=%d snr=%d\n",
-	       (uint32_t)time(NULL),
-	       btbb_packet_get_channel(pkt),
-	       btbb_packet_get_lap(pkt),
-	       btbb_packet_get_ac_errors(pkt),
-	       clkn,
-	       clk_offset,
-	       signal_level,
-	       noise_level,
-	       snr
-	);
+	rec = ubertooth_record_claim(ut);
+	if (rec) {
+		rec->type = SINK_BR_RX;
+		rec->systime = (uint32_t)time(NULL);
+		rec->br.channel = btbb_packet_get_channel(pkt);
+		rec->br.lap = btbb_packet_get_lap(pkt);
+		rec->br.ac_errors = btbb_packet_get_ac_errors(pkt);
+		rec->br.clk = clkn;
+		rec->br.clk_offset = clk_offset;
+		rec->br.signal = signal_level;
+		rec->br.noise = noise_level;
+		rec->br.snr = snr;
+		rec->pkt = *rx;
+		ubertooth_record_commit(ut, rec);
+	}
 
 	/* calibrate Ubertooth clock such that the first bit of the AC
 	 * arrives CLK_TUNE_TIME after the rising edge of CLKN */
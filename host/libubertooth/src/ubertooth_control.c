@@ -133,6 +133,22 @@ int cmd_specan(struct libusb_device_handle* devh, u16 low_freq, u16 high_freq)
 	return 0;
 }
 
+int cmd_specan_config(struct libusb_device_handle* devh, specan_config* cfg)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_SPECAN_CONFIG, 0, 0,
+			(uint8_t*)cfg, sizeof(specan_config), 1000);
+	if (r < 0) {
+		/* older firmware stalls the request, callers fall back to
+		 * cmd_specan() and its fixed sweep */
+		if (r != LIBUSB_ERROR_PIPE)
+			show_libusb_error(r);
+		return r;
+	}
+	return 0;
+}
+
 int cmd_led_specan(struct libusb_device_handle* devh, u16 rssi_threshold)
 {
 	int r;
@@ -635,6 +651,88 @@ int cmd_get_squelch(struct libusb_device_handle* devh)
 	return level;
 }
 
+int cmd_set_squelch_hysteresis(struct libusb_device_handle* devh, u16 hysteresis)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_SET_SQUELCH_HYST,
+			hysteresis, 0, NULL, 0, 1000);
+	if (r != LIBUSB_SUCCESS) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return 0;
+}
+
+/* Read the squelch statistics of all SQUELCH_CHANNELS channels, one page
+ * of SQUELCH_STATS_MAX entries at a time. Returns the number of entries. */
+int cmd_get_squelch_stats(struct libusb_device_handle* devh, squelch_stats* stats)
+{
+	int r, n = 0;
+
+	while (n < SQUELCH_CHANNELS) {
+		r = libusb_control_transfer(devh, CTRL_IN, UBERTOOTH_GET_SQUELCH_STATS,
+				0, n, (u8*)&stats[n],
+				SQUELCH_STATS_MAX * sizeof(squelch_stats), 1000);
+		if (r < 0) {
+			if (r == LIBUSB_ERROR_PIPE) {
+				fprintf(stderr, "control message unsupported\n");
+			} else {
+				show_libusb_error(r);
+			}
+			return r;
+		}
+		if (r < (int)sizeof(squelch_stats))
+			break;
+		n += r / sizeof(squelch_stats);
+	}
+	return n;
+}
+
+int cmd_trace(struct libusb_device_handle* devh, u16 enable)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_TRACE,
+			enable, 0, NULL, 0, 1000);
+	if (r != LIBUSB_SUCCESS) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return 0;
+}
+
+/* Drain up to TRACE_PAGE_EVENTS events from the firmware trace ring.
+ * Returns the number of events in the page. */
+int cmd_trace_read(struct libusb_device_handle* devh, trace_page* page)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_IN, UBERTOOTH_TRACE_READ, 0, 0,
+			(u8*)page, sizeof(trace_page), 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	if (r < 4)
+		return 0;
+	if (page->count > (r - 4) / sizeof(trace_event))
+		page->count = (r - 4) / sizeof(trace_event);
+	return page->count;
+}
+
 int cmd_set_bdaddr(struct libusb_device_handle* devh, u64 address)
 {
 	int r, data_len;
@@ -898,6 +996,42 @@ int cmd_btle_promisc(struct libusb_device_handle* devh)
 	return 0;
 }
 
+/* Promiscuous mode in which the host recovers the connection parameters,
+ * see le_recover_update() */
+int cmd_btle_promisc_host(struct libusb_device_handle* devh)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_BTLE_PROMISC,
+			PROMISC_RECOVER_HOST, 0, NULL, 0, 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return 0;
+}
+
+int cmd_btle_set_conn_params(struct libusb_device_handle* devh, le_conn_params* params)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_BTLE_SET_CONN_PARAMS,
+			0, 0, (u8*)params, sizeof(le_conn_params), 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return 0;
+}
+
 int cmd_read_register(struct libusb_device_handle* devh, u8 reg)
 {
 	int r;
@@ -917,6 +1051,23 @@ int cmd_read_register(struct libusb_device_handle* devh, u8 reg)
 	return (data[0] << 8) | data[1];
 }
 
+int cmd_write_register(struct libusb_device_handle* devh, u8 reg, u16 value)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_WRITE_REGISTER, reg,
+			value, NULL, 0, 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return 0;
+}
+
 int cmd_btle_slave(struct libusb_device_handle* devh, u8 *mac_address)
 {
 	int r;
@@ -1013,6 +1164,25 @@ int cmd_ego(struct libusb_device_handle* devh, int mode)
 	return 0;
 }
 
+/* Radio registers must already be set up; in packet mode the dongle streams
+ * GENERIC_PACKETs of RFCAT_CAP_LEN bytes over bulk. */
+int cmd_rx_generic(struct libusb_device_handle* devh)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_OUT, UBERTOOTH_RX_GENERIC, 0, 0,
+			NULL, 0, 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return 0;
+}
+
 int cmd_afh(struct libusb_device_handle* devh)
 {
 	int r;
@@ -1055,6 +1225,43 @@ int cmd_cancel_follow(struct libusb_device_handle* devh)
 	return 0;
 }
 
+/* Returns the number of entries filled in, or a negative libusb error */
+int cmd_le_conn_stats(struct libusb_device_handle* devh, le_conn_stats* stats, int max)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_IN, UBERTOOTH_LE_CONN_STATS, 0, 0,
+			(u8*)stats, max * sizeof(le_conn_stats), 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	return r / sizeof(le_conn_stats);
+}
+
+int cmd_le_adv_stats(struct libusb_device_handle* devh, le_adv_stats* stats)
+{
+	int r;
+
+	r = libusb_control_transfer(devh, CTRL_IN, UBERTOOTH_LE_ADV_STATS, 0, 0,
+			(u8*)stats, sizeof(le_adv_stats), 1000);
+	if (r < 0) {
+		if (r == LIBUSB_ERROR_PIPE) {
+			fprintf(stderr, "control message unsupported\n");
+		} else {
+			show_libusb_error(r);
+		}
+		return r;
+	}
+	if (r < (int)sizeof(le_adv_stats))
+		return LIBUSB_ERROR_OTHER;
+	return 0;
+}
+
 int cmd_rfcat_subcmd(struct libusb_device_handle* devh, int cmd, uint8_t *body, size_t body_len) {
 	int r;
 
@@ -85,6 +85,7 @@ int cmd_ping(struct libusb_device_handle* devh);
 int cmd_rx_syms(struct libusb_device_handle* devh);
 int cmd_tx_syms(struct libusb_device_handle* devh);
 int cmd_specan(struct libusb_device_handle* devh, u16 low_freq, u16 high_freq);
+int cmd_specan_config(struct libusb_device_handle* devh, specan_config* cfg);
 int cmd_led_specan(struct libusb_device_handle* devh, u16 rssi_threshold);
 int cmd_set_usrled(struct libusb_device_handle* devh, u16 state);
 int cmd_get_usrled(struct libusb_device_handle* devh);
@@ -116,6 +117,10 @@ void cmd_get_compile_info(struct libusb_device_handle* devh, char *compile_info,
 int cmd_get_board_id(struct libusb_device_handle* devh);
 int cmd_set_squelch(struct libusb_device_handle* devh, u16 level);
 int cmd_get_squelch(struct libusb_device_handle* devh);
+int cmd_set_squelch_hysteresis(struct libusb_device_handle* devh, u16 hysteresis);
+int cmd_get_squelch_stats(struct libusb_device_handle* devh, squelch_stats* stats);
+int cmd_trace(struct libusb_device_handle* devh, u16 enable);
+int cmd_trace_read(struct libusb_device_handle* devh, trace_page* page);
 int cmd_set_bdaddr(struct libusb_device_handle* devh, u64 bdaddr);
 int cmd_set_syncword(struct libusb_device_handle* devh, u64 syncword);
 int cmd_next_hop(struct libusb_device_handle* devh, u16 clk);
@@ -133,15 +138,21 @@ int cmd_get_crc_verify(struct libusb_device_handle* devh);
 int cmd_set_crc_verify(struct libusb_device_handle* devh, int verify);
 int cmd_poll(struct libusb_device_handle* devh, usb_pkt_rx *p);
 int cmd_btle_promisc(struct libusb_device_handle* devh);
+int cmd_btle_promisc_host(struct libusb_device_handle* devh);
+int cmd_btle_set_conn_params(struct libusb_device_handle* devh, le_conn_params* params);
 int cmd_read_register(struct libusb_device_handle* devh, u8 reg);
+int cmd_write_register(struct libusb_device_handle* devh, u8 reg, u16 value);
 int cmd_btle_slave(struct libusb_device_handle* devh, u8 *mac_address);
 int cmd_le_set_adv_data(struct libusb_device_handle* devh, uint8_t *data, unsigned data_len);
 int cmd_btle_set_target(struct libusb_device_handle* devh, uint8_t *mac_address, uint8_t mac_mask);
 int cmd_set_jam_mode(struct libusb_device_handle* devh, int mode);
 int cmd_ego(struct libusb_device_handle* devh, int mode);
+int cmd_rx_generic(struct libusb_device_handle* devh);
 int cmd_afh(struct libusb_device_handle* devh);
 int cmd_hop(struct libusb_device_handle* devh);
 int cmd_cancel_follow(struct libusb_device_handle* devh);
+int cmd_le_conn_stats(struct libusb_device_handle* devh, le_conn_stats* stats, int max);
+int cmd_le_adv_stats(struct libusb_device_handle* devh, le_adv_stats* stats);
 int cmd_rfcat_subcmd(struct libusb_device_handle* devh, int cmd, uint8_t *body, size_t body_len);
 int cmd_xmas(struct libusb_device_handle* devh);
 
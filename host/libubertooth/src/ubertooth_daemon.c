@@ -0,0 +1,145 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ubertooth_daemon.h"
+
+void ubertoothd_filter_init(ubertoothd_filter* filter)
+{
+	memset(filter, 0, sizeof(*filter));
+	filter->magic = UBERTOOTHD_MAGIC;
+	filter->version = UBERTOOTHD_VERSION;
+	filter->channel_max = 0xff;
+	filter->rssi_min = -128;
+}
+
+int ubertoothd_filter_match(const ubertoothd_filter* filter, const usb_pkt_rx* pkt)
+{
+	if (filter->pkt_types && !(filter->pkt_types & (1u << (pkt->pkt_type & 31))))
+		return 0;
+	if (pkt->channel < filter->channel_min || pkt->channel > filter->channel_max)
+		return 0;
+	if (pkt->rssi_count && pkt->rssi_max < filter->rssi_min)
+		return 0;
+	return 1;
+}
+
+/* Connect to the daemon and subscribe, returns a socket or -1 */
+int ubertoothd_connect(const char* path, const ubertoothd_filter* filter)
+{
+	struct sockaddr_un addr;
+	ubertoothd_filter def;
+	int fd;
+
+	if (path == NULL)
+		path = UBERTOOTHD_SOCKET;
+	if (filter == NULL) {
+		ubertoothd_filter_init(&def);
+		filter = &def;
+	}
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "ubertoothd socket path too long: %s\n", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	if (write(fd, filter, sizeof(*filter)) != sizeof(*filter)) {
+		perror("ubertoothd subscribe");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Subscribe and wrap the stream for stream_rx_file() */
+FILE* ubertoothd_open(const char* path, const ubertoothd_filter* filter)
+{
+	FILE* fp;
+	int fd = ubertoothd_connect(path, filter);
+
+	if (fd < 0)
+		return NULL;
+	fp = fdopen(fd, "r");
+	if (fp == NULL)
+		close(fd);
+	return fp;
+}
+
+/* Ask the daemon for its packet ring and map it */
+ubertooth_ring* ubertoothd_map_ring(const char* path)
+{
+	ubertoothd_filter filter;
+	ubertooth_ring* ring;
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	struct iovec iov;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	char byte;
+	int sock, fd = -1;
+
+	ubertoothd_filter_init(&filter);
+	filter.flags = UBERTOOTHD_FLAG_RING;
+	sock = ubertoothd_connect(path, &filter);
+	if (sock < 0)
+		return NULL;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	if (recvmsg(sock, &msg, 0) > 0) {
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	close(sock);
+
+	if (fd < 0) {
+		fprintf(stderr, "ubertoothd did not provide a packet ring\n");
+		return NULL;
+	}
+	ring = ubertooth_ring_map(fd);
+	if (ring == NULL)
+		close(fd);
+	return ring;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_DAEMON_H__
+#define __UBERTOOTH_DAEMON_H__
+
+#include <stdio.h>
+#include "ubertooth_control.h"
+#include "ubertooth_ring.h"
+
+/*
+ * Client side of ubertoothd, the capture daemon that owns an Ubertooth
+ * and fans its packet stream out to local clients.
+ *
+ * A client connects to the daemon's Unix-domain socket and sends one
+ * ubertoothd_filter.  The daemon then streams every matching packet in
+ * the same format as "ubertooth-dump -f": a 4 byte big-endian capture
+ * time followed by the PKT_LEN byte usb_pkt_rx.  The stream can be read
+ * with stream_rx_file() exactly like a dump file.
+ *
+ * Each client has a bounded buffer in the daemon.  When a client falls
+ * behind, packets for that client are dropped (and counted by the
+ * daemon) rather than stalling the capture or the other clients.
+ *
+ * A client that sets UBERTOOTHD_FLAG_RING is instead handed the fd of
+ * the daemon's shared-memory packet ring (see ubertooth_ring.h) and
+ * reads the capture from there; the filter fields are then only a
+ * hint for the client's own use of ubertoothd_filter_match().
+ */
+
+#define UBERTOOTHD_SOCKET  "/tmp/ubertoothd.sock"
+#define UBERTOOTHD_MAGIC   0x55424444
+#define UBERTOOTHD_VERSION 1
+
+#define UBERTOOTHD_FLAG_RING 0x01
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t backlog;     // per-client buffer in packets, 0 for default
+	uint32_t pkt_types;   // mask of (1 << pkt_type), 0 for all
+	uint8_t  channel_min; // usb_pkt_rx channel, inclusive
+	uint8_t  channel_max;
+	int8_t   rssi_min;    // drop packets whose rssi_max is lower
+	uint8_t  flags;
+} ubertoothd_filter;
+
+void ubertoothd_filter_init(ubertoothd_filter* filter);
+int ubertoothd_filter_match(const ubertoothd_filter* filter, const usb_pkt_rx* pkt);
+
+int ubertoothd_connect(const char* path, const ubertoothd_filter* filter);
+FILE* ubertoothd_open(const char* path, const ubertoothd_filter* filter);
+ubertooth_ring* ubertoothd_map_ring(const char* path);
+
+#endif /* __UBERTOOTH_DAEMON_H__ */
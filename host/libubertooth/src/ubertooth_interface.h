@@ -25,7 +25,7 @@
 #include <stdint.h>
 
 // increment on every API change
-#define UBERTOOTH_API_VERSION 0x0107
+#define UBERTOOTH_API_VERSION 0x0109
 
 #define DMA_SIZE 50
 
@@ -114,6 +114,14 @@ enum ubertooth_usb_commands {
 	UBERTOOTH_LE_SET_ADV_DATA    = 71,
 	UBERTOOTH_RFCAT_SUBCMD       = 72,
 	UBERTOOTH_XMAS               = 73,
+	UBERTOOTH_SPECAN_CONFIG      = 74,
+	UBERTOOTH_LE_CONN_STATS      = 75,
+	UBERTOOTH_SET_SQUELCH_HYST   = 76,
+	UBERTOOTH_GET_SQUELCH_STATS  = 77,
+	UBERTOOTH_TRACE              = 78,
+	UBERTOOTH_TRACE_READ         = 79,
+	UBERTOOTH_BTLE_SET_CONN_PARAMS = 80,
+	UBERTOOTH_LE_ADV_STATS       = 81,
 };
 
 enum rfcat24_subcommands {
@@ -145,6 +153,12 @@ enum usb_pkt_types {
 	SPECAN     = 4,
 	LE_PROMISC = 5,
 	EGO_PACKET = 6,
+	SPECAN_FRAME = 7,
+	/* UBERTOOTH_RX_GENERIC in packet mode: the RFCAT_CAP_LEN bytes that
+	 * follow the sync word, zero padded, and clk100ns/rssi taken when it
+	 * matched. API 1.08 and older sent these as BR_PACKETs with the
+	 * SYNCH/SYNCL registers in the first 4 data bytes. */
+	GENERIC_PACKET = 8,
 };
 
 enum hop_mode {
@@ -163,6 +177,7 @@ enum usb_pkt_status {
 	CS_TRIGGER    = 0x08,
 	RSSI_TRIGGER  = 0x10,
 	DISCARD       = 0x20,
+	CRC_ERROR     = 0x40, // LE packet failed on-device CRC check
 };
 
 /*
@@ -182,6 +197,174 @@ typedef struct {
 	uint8_t  data[DMA_SIZE];
 } usb_pkt_rx;
 
+/*
+ * Spectrum analyzer sweep configuration (UBERTOOTH_SPECAN_CONFIG)
+ *
+ * Each bin is retuned to, left to settle for dwell * 100 ns after entering
+ * RX and then sampled 'samples' times.  The samples are reduced to a
+ * single RSSI value per bin by taking either the maximum or the mean.
+ */
+enum specan_reduce {
+	SPECAN_REDUCE_MAX = 0,
+	SPECAN_REDUCE_AVG = 1,
+};
+
+typedef struct {
+	uint8_t  step;     // MHz between bins
+	uint8_t  samples;  // RSSI reads per bin
+	uint8_t  reduce;   // enum specan_reduce
+	uint8_t  reserved;
+	uint16_t dwell;    // settle time per bin in units of 100 ns
+} __attribute__((packed)) specan_config;
+
+#define SPECAN_MAX_SAMPLES 64
+
+/*
+ * SPECAN_FRAME packets carry packed 8-bit RSSI values, one per bin.
+ * clk100ns is the time at which the sweep started and is shared by all
+ * frames belonging to the same sweep.
+ *
+ * data[0-1]  frequency of the first bin in this frame (MHz, big endian)
+ * data[2]    step between bins (MHz)
+ * data[3]    number of bins in this frame
+ * data[4-]   RSSI, one byte per bin
+ */
+#define SPECAN_FRAME_HDR  4
+#define SPECAN_FRAME_BINS (DMA_SIZE - SPECAN_FRAME_HDR)
+
+/*
+ * Per-connection statistics of the LE connection follower
+ * (UBERTOOTH_LE_CONN_STATS), one entry per connection slot.  Slots that
+ * were never used have an access address of zero.
+ */
+#define LE_MAX_CONNS 4
+
+typedef struct {
+	uint32_t access_address;
+	uint32_t events;   // connection events since the CONNECT_REQ
+	uint32_t missed;   // events lost while the radio served another connection
+	uint32_t empty;    // events listened to without receiving a packet
+	uint8_t  active;   // 1 while the connection is still followed
+	uint8_t  reserved[3];
+} __attribute__((packed)) le_conn_stats;
+
+/*
+ * Advertising channel statistics of the LE follower (UBERTOOTH_LE_ADV_STATS).
+ * With a target set the firmware follows the target's advertising events
+ * from channel to channel; channel[0-2] count for channels 37-39 the
+ * target's connectable advertisements, the retunes to the channel, the
+ * advertisements caught right after such a retune and the CONNECT_REQs
+ * seen.  order holds the learned channel order of an event, of which the
+ * first order_len entries are visited; interval is the learned
+ * advertising interval in 100 ns ticks, 0 until known.
+ */
+typedef struct {
+	uint32_t adv;
+	uint32_t hops;
+	uint32_t hits;
+	uint32_t connect_reqs;
+} __attribute__((packed)) le_adv_channel_stats;
+
+typedef struct {
+	le_adv_channel_stats channel[3];
+	uint32_t interval;
+	uint8_t  order[3];
+	uint8_t  order_len;
+} __attribute__((packed)) le_adv_stats;
+
+/*
+ * Per-channel squelch statistics (UBERTOOTH_GET_SQUELCH_STATS).  Entries
+ * 0-78 are the Bluetooth channels 2402-2480 MHz, entry 79 collects every
+ * other frequency.  wIndex selects the first entry of the reply, which
+ * holds up to SQUELCH_STATS_MAX entries.
+ */
+#define SQUELCH_CHANNELS  80
+#define SQUELCH_STATS_MAX 20
+
+typedef struct {
+	int8_t   noise_floor; // dBm, INT8_MIN until the channel was measured
+	uint8_t  open;        // 1 while the squelch gate is open
+	uint8_t  reserved[2];
+	uint32_t passed;      // blocks sent to the host
+	uint32_t dropped;     // blocks held back by the squelch
+} __attribute__((packed)) squelch_stats;
+
+/*
+ * Binary trace (UBERTOOTH_TRACE, UBERTOOTH_TRACE_READ)
+ *
+ * While tracing is on (wValue 1, which also clears the buffer) the
+ * firmware records fixed size events into a RAM ring, overwriting the
+ * oldest when it is full.  time counts 100 ns ticks of a free running
+ * timer.  Each UBERTOOTH_TRACE_READ drains up to TRACE_PAGE_EVENTS
+ * events, oldest first; lost counts the events overwritten since the
+ * previous read.  The buffer survives mode changes, so a capture can be
+ * read back after the tool that ran it has exited.
+ */
+enum trace_event_ids {
+	TRACE_NONE       = 0,
+	TRACE_HOP        = 1, // retune started   arg0: channel MHz  arg1: clkn
+	TRACE_HOP_DONE   = 2, // back in RX/TX    arg0: channel MHz  arg1: clkn
+	TRACE_DMA_TC     = 3, // DMA completed    arg0: bytes        arg1: channel MHz
+	TRACE_ENQUEUE    = 4, // packet to USB    arg0: pkt_type     arg1: queue depth
+	TRACE_DROP       = 5, // packet dropped   arg0: trace_drop_reasons  arg1: channel MHz
+	TRACE_CONN_OPEN  = 6, // LE conn event    arg0: event counter  arg1: access address
+	TRACE_CONN_CLOSE = 7, // LE conn event    arg0: packets      arg1: access address
+	TRACE_CONN_SKIP  = 8, // LE conn event    arg0: event counter  arg1: access address
+	TRACE_SCHED_FULL = 9, // event refused    arg0: queue length   arg1: callback address
+};
+
+enum trace_drop_reasons {
+	TRACE_DROP_QUEUE_FULL = 0,
+	TRACE_DROP_SQUELCH    = 1,
+	TRACE_DROP_CRC        = 2,
+};
+
+typedef struct {
+	uint32_t time;
+	uint8_t  id;
+	uint8_t  reserved;
+	uint16_t arg0;
+	uint32_t arg1;
+} __attribute__((packed)) trace_event;
+
+#define TRACE_PAGE_EVENTS 20
+
+typedef struct {
+	uint16_t lost;
+	uint8_t  count;
+	uint8_t  reserved;
+	trace_event events[TRACE_PAGE_EVENTS];
+} __attribute__((packed)) trace_page;
+
+/*
+ * LE promiscuous mode (UBERTOOTH_BTLE_PROMISC)
+ *
+ * wValue selects where the parameters of an unknown connection are
+ * recovered.  With PROMISC_RECOVER_HOST the firmware does not follow on
+ * its own: it keeps scanning and forwards every empty data PDU it finds
+ * as an LE_PACKET (access address, header and CRC) until the host sets
+ * the access address (UBERTOOTH_SET_ACCESS_ADDRESS) and the remaining
+ * parameters (UBERTOOTH_BTLE_SET_CONN_PARAMS).  The hop sequence is then
+ * anchored on the next packet of that connection seen on the current
+ * channel.  UBERTOOTH_SET_CHANNEL retunes a running scan.
+ *
+ * LE_PROMISC packets report the progress, data[0] is the state:
+ * 0 access address, 1 CRCInit, 2 hop interval, 3 hop increment (the
+ * connection is followed from here on), 4 connection lost, scanning
+ * again.  The value follows in data[1-].
+ */
+enum le_promisc_recovery {
+	PROMISC_RECOVER_DEVICE = 0,
+	PROMISC_RECOVER_HOST   = 1,
+};
+
+typedef struct {
+	uint32_t crc_init;      // as reported in LE_PROMISC state 1
+	uint16_t conn_interval; // units of 1.25 ms, 6-3200
+	uint8_t  hop_increment; // 5-16
+	uint8_t  reserved;
+} __attribute__((packed)) le_conn_params;
+
 typedef struct {
 	uint64_t address;
 	uint64_t syncword;
@@ -249,7 +432,8 @@ typedef enum {
 	BTCTL_MONITOR_REQ	= 32,
 	/* Device -> Host */
 	BTCTL_RX_PKT		= 40,
-	BTCTL_STATE_RESP	= 41
+	BTCTL_STATE_RESP	= 41,
+	BTCTL_FLOW_IND		= 42
 } btctl_cmd_type_t ;
 
 typedef struct btctl_hdr_s {
@@ -281,6 +465,17 @@ typedef struct btctl_state_resp_s {
 	uint8_t reason;
 } btctl_state_resp_t;
 
+/* Sent when the device starts or stops losing messages because the host
+ * does not read them fast enough. Counters are totals since reset. */
+typedef struct btctl_flow_ind_s {
+	uint8_t congested;
+	uint8_t padding[3];
+	uint32_t tx_drops;	// messages to host dropped
+	uint32_t rx_drops;	// messages from host dropped
+	uint32_t alloc_fail;	// failed buffer allocations
+	uint32_t slot_drops;	// RX slots skipped for want of a buffer
+} __attribute__((packed)) btctl_flow_ind_t;
+
 typedef struct bthdr_s {
 	uint8_t lt_addr;
 	uint8_t type;
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "ubertooth_le_recover.h"
+
+#define LE_BASECLK   12500ULL // 1.25 ms in units of 100 ns
+#define CLK100NS_MAX (256ULL * 3276800000ULL) // clkn_high:clk100ns wraps here
+
+#define INTERVAL_MIN 6
+#define INTERVAL_MAX 3200
+
+// divide, rounding to the nearest integer
+#define DIVIDE_ROUND(N, D) (((N) + (D)/2) / (D))
+
+static uint64_t rx_time(const usb_pkt_rx* rx)
+{
+	return (uint64_t)rx->clkn_high * 3276800000ULL + rx->clk100ns;
+}
+
+static uint64_t elapsed(uint64_t from, uint64_t to)
+{
+	return (to + CLK100NS_MAX - from) % CLK100NS_MAX;
+}
+
+/* data channel index of rx->channel (MHz - 2402), -1 for the advertising
+ * channels */
+static int data_index(uint8_t channel)
+{
+	if (channel & 1)
+		return -1;
+	channel /= 2;
+	if (channel == 0 || channel == 12 || channel >= 39)
+		return -1;
+	return channel < 12 ? channel - 1 : channel - 2;
+}
+
+static uint16_t index_to_phys(int idx)
+{
+	return idx <= 10 ? 2404 + idx * 2 : 2428 + (idx - 11) * 2;
+}
+
+/* runs the CRC backwards over the PDU to recover CRCInit, see
+ * btle_reverse_crc() in the firmware */
+static uint32_t reverse_crc(uint32_t crc, const uint8_t* data, int len)
+{
+	uint32_t state = crc;
+	uint32_t lfsr_mask = 0xb4c000;
+	uint32_t ret = 0;
+	int i, j;
+
+	for (i = len - 1; i >= 0; --i) {
+		uint8_t cur = data[i];
+		for (j = 0; j < 8; ++j) {
+			int top_bit = state >> 23;
+			state = (state << 1) & 0xffffff;
+			state |= top_bit ^ ((cur >> (7 - j)) & 1);
+			if (top_bit)
+				state ^= lfsr_mask;
+		}
+	}
+
+	for (i = 0; i < 24; ++i)
+		ret |= ((state >> i) & 1) << (23 - i);
+
+	return ret;
+}
+
+// find the entry of an access address, evicting the least seen one
+static le_recover_aa* see_aa(le_recover* rec, uint32_t aa)
+{
+	le_recover_aa* entry = &rec->aa[0];
+	int i;
+
+	for (i = 0; i < LE_RECOVER_AAS; ++i) {
+		if (rec->aa[i].seen > 0 && rec->aa[i].aa == aa)
+			return &rec->aa[i];
+		if (rec->aa[i].seen < entry->seen)
+			entry = &rec->aa[i];
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->aa = aa;
+	return entry;
+}
+
+static void vote_crc_init(le_recover_aa* entry, uint32_t crc_init)
+{
+	int i, min = 0;
+
+	for (i = 0; i < LE_RECOVER_CRCS; ++i) {
+		if (entry->crc_votes[i] > 0 && entry->crc_init[i] == crc_init) {
+			if (entry->crc_votes[i] < UINT8_MAX)
+				++entry->crc_votes[i];
+			return;
+		}
+		if (entry->crc_votes[i] < entry->crc_votes[min])
+			min = i;
+	}
+
+	entry->crc_init[min] = crc_init;
+	entry->crc_votes[min] = 1;
+}
+
+/* CRCInit with the most votes, if it has enough of them and no other
+ * value has as many */
+static int crc_init_winner(le_recover_aa* entry, uint32_t* crc_init)
+{
+	int i, best = 0, tie = 0;
+
+	for (i = 1; i < LE_RECOVER_CRCS; ++i) {
+		if (entry->crc_votes[i] > entry->crc_votes[best]) {
+			best = i;
+			tie = 0;
+		} else if (entry->crc_votes[i] == entry->crc_votes[best]) {
+			tie = 1;
+		}
+	}
+
+	if (tie || entry->crc_votes[best] < LE_RECOVER_MIN_VOTES)
+		return 0;
+	*crc_init = entry->crc_init[best];
+	return 1;
+}
+
+static int is_multiple(uint64_t time, uint64_t unit)
+{
+	uint64_t near = DIVIDE_ROUND(time, unit) * unit;
+	uint64_t err = time > near ? time - near : near - time;
+
+	return err <= unit / 8;
+}
+
+/* The gaps between sightings on one channel are whole multiples of 37
+ * connection events.  The hop interval is the largest interval that
+ * divides all of them: assume the smallest gap spans k rounds of 37
+ * events, for k = 1, 2, ..., and take the first fit.  If all gaps happen
+ * to be even multiples this finds twice the interval, cross (the time
+ * between sightings on two channels, a multiple of one event) settles
+ * that once it is known. */
+static uint16_t solve_interval(le_recover_aa* entry, uint64_t cross)
+{
+	unsigned n = entry->gaps < LE_RECOVER_GAPS ? entry->gaps : LE_RECOVER_GAPS;
+	uint64_t min = UINT64_MAX, round;
+	unsigned i, k, interval;
+
+	if (n < LE_RECOVER_MIN_GAPS)
+		return 0;
+
+	for (i = 0; i < n; ++i)
+		if (entry->gap[i] < min)
+			min = entry->gap[i];
+
+	for (k = 1; ; ++k) {
+		interval = DIVIDE_ROUND(min, k * 37 * LE_BASECLK);
+		if (interval < INTERVAL_MIN)
+			return 0;
+		if (interval > INTERVAL_MAX)
+			continue;
+
+		round = interval * 37 * LE_BASECLK;
+		for (i = 0; i < n; ++i)
+			if (!is_multiple(entry->gap[i], round))
+				break;
+		if (i == n && (cross == 0 || is_multiple(cross, round / 37)))
+			return interval;
+	}
+}
+
+/* Number of events between the reference sighting on the first channel
+ * and this one on the second tells the hop increment: n * increment is
+ * the distance between the two channel indices, modulo 37. */
+static uint8_t solve_increment(le_recover* rec, uint64_t time, int idx)
+{
+	le_recover_aa* target = rec->target;
+	uint64_t event = rec->params.conn_interval * LE_BASECLK;
+	uint64_t delta = elapsed(target->last_time, time);
+	uint64_t n = DIVIDE_ROUND(delta, event);
+	unsigned distance, inverse;
+
+	if (n == 0 || n % 37 == 0 || !is_multiple(delta, event))
+		return 0;
+
+	distance = (idx + 37 - target->last_index) % 37;
+	for (inverse = 1; inverse < 37; ++inverse)
+		if ((inverse * n) % 37 == 1)
+			break;
+
+	return (distance * inverse) % 37;
+}
+
+static void retune(le_recover* rec, struct libusb_device_handle* devh,
+                   uint64_t time, int idx)
+{
+	rec->retune_index = idx;
+	rec->retune_time = time;
+	cmd_set_channel(devh, index_to_phys(idx));
+}
+
+void le_recover_init(le_recover* rec)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->state = LE_RECOVER_SCAN;
+}
+
+/* Feed one packet received in PROMISC_RECOVER_HOST mode.  Retunes the
+ * radio and sends the recovered parameters as needed.  Returns the new
+ * state. */
+int le_recover_update(le_recover* rec, struct libusb_device_handle* devh,
+                      usb_pkt_rx* rx)
+{
+	le_recover_aa* entry;
+	uint64_t time, gap;
+	uint32_t aa, crc, crc_init;
+	uint16_t interval;
+	uint8_t increment;
+	int idx;
+
+	// the firmware lost the connection and went back to scanning
+	if (rx->pkt_type == LE_PROMISC && rx->data[0] == 4) {
+		le_recover_init(rec);
+		return rec->state;
+	}
+
+	if (rec->state == LE_RECOVER_DONE || rx->pkt_type != LE_PACKET)
+		return rec->state;
+
+	// empty data PDU: LLID 01, any NESN/SN, length 0
+	if ((rx->data[4] & 0xf3) != 0x01 || rx->data[5] != 0x00)
+		return rec->state;
+
+	idx = data_index(rx->channel);
+	if (idx < 0)
+		return rec->state;
+
+	aa = rx->data[0] | rx->data[1] << 8 | rx->data[2] << 16 |
+	     (uint32_t)rx->data[3] << 24;
+	time = rx_time(rx);
+
+	if (rec->state == LE_RECOVER_INCREMENT) {
+		interval = rec->params.conn_interval;
+		if (aa == rec->target->aa && idx == rec->retune_index) {
+			increment = solve_increment(rec, time, idx);
+			if (increment < 5 || increment > 16) {
+				// no valid increment fits: the interval is a multiple
+				gap = elapsed(rec->target->last_time, time);
+				interval = solve_interval(rec->target, gap);
+				if (interval != 0 && interval != rec->params.conn_interval) {
+					rec->params.conn_interval = interval;
+					increment = solve_increment(rec, time, idx);
+				}
+			}
+			if (increment >= 5 && increment <= 16) {
+				rec->params.hop_increment = increment;
+				rec->state = LE_RECOVER_DONE;
+				cmd_set_access_address(devh, aa);
+				cmd_btle_set_conn_params(devh, &rec->params);
+			}
+		} else if (elapsed(rec->retune_time, time) >
+		           2 * 37 * interval * LE_BASECLK) {
+			// channel probably not in the channel map, try the next one
+			retune(rec, devh, time, (rec->retune_index + 1) % 37);
+		}
+		return rec->state;
+	}
+
+	entry = see_aa(rec, aa);
+	++entry->seen;
+
+	crc = rx->data[8] << 16 | rx->data[7] << 8 | rx->data[6];
+	vote_crc_init(entry, reverse_crc(crc, &rx->data[4], 2));
+
+	if (entry->seen > 1 && idx == entry->last_index) {
+		gap = elapsed(entry->last_time, time);
+		// more than one PDU of the same connection event
+		if (gap < 4 * LE_BASECLK)
+			return rec->state;
+		entry->gap[entry->gaps++ % LE_RECOVER_GAPS] = gap;
+	}
+	entry->last_time = time;
+	entry->last_index = idx;
+
+	if (entry->seen < LE_RECOVER_MIN_SEEN ||
+	    !crc_init_winner(entry, &crc_init))
+		return rec->state;
+	interval = solve_interval(entry, 0);
+	if (interval == 0)
+		return rec->state;
+
+	rec->target = entry;
+	rec->params.crc_init = crc_init;
+	rec->params.conn_interval = interval;
+	rec->state = LE_RECOVER_INCREMENT;
+	retune(rec, devh, time, (idx + 1) % 37);
+
+	return rec->state;
+}
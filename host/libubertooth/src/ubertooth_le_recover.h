@@ -0,0 +1,85 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_LE_RECOVER_H__
+#define __UBERTOOTH_LE_RECOVER_H__
+
+#include "ubertooth_control.h"
+
+/*
+ * Host side recovery of LE connection parameters
+ *
+ * Fed with the empty data PDUs that the firmware forwards in
+ * PROMISC_RECOVER_HOST mode, this recovers everything needed to follow
+ * a connection that was already established when we started listening:
+ *
+ *  - the access address, once it has been seen LE_RECOVER_MIN_SEEN times
+ *  - CRCInit, by running the CRC of each PDU backwards and voting, so a
+ *    single corrupted PDU cannot lock in a wrong value
+ *  - the hop interval, from the gaps between sightings on one channel,
+ *    which are whole multiples of 37 connection events
+ *  - the hop increment, from one sighting on a second channel, since the
+ *    number of events between the two sightings is then known
+ *
+ * All observations of every candidate access address count from the
+ * first packet on, so the access address, CRCInit and hop interval are
+ * usually known at the same time.  The results are sent to the firmware,
+ * which resumes following on its own.
+ */
+
+#define LE_RECOVER_AAS       16 // candidate access addresses tracked
+#define LE_RECOVER_CRCS      4  // distinct CRCInit values per candidate
+#define LE_RECOVER_GAPS      8  // same-channel gaps kept per candidate
+#define LE_RECOVER_MIN_SEEN  3
+#define LE_RECOVER_MIN_VOTES 2
+#define LE_RECOVER_MIN_GAPS  3
+
+enum le_recover_state {
+	LE_RECOVER_SCAN      = 0, // collecting observations on one channel
+	LE_RECOVER_INCREMENT = 1, // waiting for the target on a second channel
+	LE_RECOVER_DONE      = 2, // parameters handed to the firmware
+};
+
+typedef struct {
+	uint32_t aa;
+	unsigned seen;
+	uint32_t crc_init[LE_RECOVER_CRCS];
+	uint8_t  crc_votes[LE_RECOVER_CRCS];
+	uint64_t gap[LE_RECOVER_GAPS];
+	unsigned gaps;
+	uint64_t last_time;  // 100 ns ticks
+	uint8_t  last_index; // data channel index of last_time
+} le_recover_aa;
+
+typedef struct {
+	enum le_recover_state state;
+	le_recover_aa aa[LE_RECOVER_AAS];
+	le_recover_aa* target;
+	le_conn_params params;
+	uint8_t  retune_index;
+	uint64_t retune_time;
+} le_recover;
+
+void le_recover_init(le_recover* rec);
+int le_recover_update(le_recover* rec, struct libusb_device_handle* devh,
+                      usb_pkt_rx* rx);
+
+#endif /* __UBERTOOTH_LE_RECOVER_H__ */
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memfd_create
+#endif
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ubertooth_ring.h"
+
+#define SEQ_BUSY UINT64_MAX
+
+/* The fd is handed to clients: with memfd, seal its size so that none
+ * of them can truncate the ring under the writer */
+static int ring_fd(size_t len)
+{
+	int fd;
+#ifdef MFD_ALLOW_SEALING
+	fd = memfd_create("ubertooth-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+	char name[32];
+	snprintf(name, sizeof(name), "/ubertooth-ring-%d", (int)getpid());
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0)
+		shm_unlink(name);
+#endif
+	if (fd < 0) {
+		perror("ubertooth ring");
+		return -1;
+	}
+	if (ftruncate(fd, len) < 0) {
+		perror("ubertooth ring");
+		close(fd);
+		return -1;
+	}
+#ifdef MFD_ALLOW_SEALING
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0) {
+		perror("ubertooth ring seal");
+		close(fd);
+		return -1;
+	}
+#endif
+	return fd;
+}
+
+static ubertooth_ring* ring_mmap(int fd, size_t len, int prot)
+{
+	ubertooth_ring* ring;
+	void* map;
+
+	map = mmap(NULL, len, prot, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("ubertooth ring mmap");
+		return NULL;
+	}
+
+	ring = (ubertooth_ring*)malloc(sizeof(ubertooth_ring));
+	if (ring == NULL) {
+		munmap(map, len);
+		return NULL;
+	}
+	ring->hdr = (ubertooth_ring_hdr*)map;
+	ring->slot = (ubertooth_ring_slot*)(ring->hdr + 1);
+	ring->map_len = len;
+	ring->fd = fd;
+	ring->notify_fd = -1;
+	ring->notify_armed = 0;
+	return ring;
+}
+
+/* Create a ring of at least the given number of slots */
+ubertooth_ring* ubertooth_ring_create(unsigned slots)
+{
+	ubertooth_ring* ring;
+	unsigned n = 1, i;
+	size_t len;
+	int fd;
+
+	while (n < slots)
+		n <<= 1;
+	len = sizeof(ubertooth_ring_hdr) + n * sizeof(ubertooth_ring_slot);
+
+	fd = ring_fd(len);
+	if (fd < 0)
+		return NULL;
+	ring = ring_mmap(fd, len, PROT_READ | PROT_WRITE);
+	if (ring == NULL) {
+		close(fd);
+		return NULL;
+	}
+#ifdef F_SEAL_FUTURE_WRITE
+	/* Only our mapping may write, clients can map the fd read only.
+	 * Needs Linux 5.1, older kernels leave the fd writable. */
+	fcntl(fd, F_ADD_SEALS, F_SEAL_FUTURE_WRITE | F_SEAL_SEAL);
+#endif
+
+	memset(ring->hdr, 0, sizeof(ubertooth_ring_hdr));
+	ring->hdr->magic = UBERTOOTH_RING_MAGIC;
+	ring->hdr->version = UBERTOOTH_RING_VERSION;
+	ring->hdr->slots = n;
+	ring->hdr->slot_len = sizeof(ubertooth_ring_slot);
+	for (i = 0; i < n; i++)
+		ring->slot[i].seq = SEQ_BUSY;
+	return ring;
+}
+
+/* Map a ring created by another process, read only */
+ubertooth_ring* ubertooth_ring_map(int fd)
+{
+	ubertooth_ring* ring;
+	ubertooth_ring_hdr* hdr;
+	struct stat st;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ubertooth_ring_hdr)) {
+		fprintf(stderr, "Not an Ubertooth ring\n");
+		return NULL;
+	}
+	ring = ring_mmap(fd, st.st_size, PROT_READ);
+	if (ring == NULL)
+		return NULL;
+
+	hdr = ring->hdr;
+	if (hdr->magic != UBERTOOTH_RING_MAGIC || hdr->version != UBERTOOTH_RING_VERSION ||
+	    hdr->slot_len != sizeof(ubertooth_ring_slot) ||
+	    (hdr->slots & (hdr->slots - 1)) != 0 ||
+	    sizeof(ubertooth_ring_hdr) + (size_t)hdr->slots * hdr->slot_len > ring->map_len) {
+		fprintf(stderr, "Not an Ubertooth ring\n");
+		munmap(ring->hdr, ring->map_len);
+		free(ring);
+		return NULL;
+	}
+	return ring;
+}
+
+void ubertooth_ring_free(ubertooth_ring* ring)
+{
+	if (ring == NULL)
+		return;
+	munmap(ring->hdr, ring->map_len);
+	close(ring->fd);
+	free(ring);
+}
+
+/* Write a byte to fd whenever a packet arrives for an armed reader */
+void ubertooth_ring_set_notify(ubertooth_ring* ring, int fd)
+{
+	ring->notify_fd = fd;
+}
+
+void ubertooth_ring_publish(ubertooth_ring* ring, const usb_pkt_rx* pkt)
+{
+	uint64_t seq = ring->hdr->head;
+	ubertooth_ring_slot* slot = &ring->slot[seq & (ring->hdr->slots - 1)];
+
+	__atomic_store_n(&slot->seq, SEQ_BUSY, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->systime = (uint32_t)time(NULL);
+	memcpy(&slot->pkt, pkt, sizeof(usb_pkt_rx));
+	__atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->hdr->head, seq + 1, __ATOMIC_RELEASE);
+
+	if (ring->notify_fd >= 0 &&
+	    __atomic_exchange_n(&ring->notify_armed, 0, __ATOMIC_SEQ_CST)) {
+		if (write(ring->notify_fd, "", 1) < 0)
+			perror("ubertooth ring notify");
+	}
+}
+
+/* Start reading at the newest packet */
+void ubertooth_ring_reader_init(ubertooth_ring_reader* rd, ubertooth_ring* ring)
+{
+	rd->ring = ring;
+	rd->cursor = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+	rd->lost = 0;
+}
+
+/*
+ * Return the next packet in place, or NULL when the reader has caught
+ * up.  The slot stays valid until ubertooth_ring_release(), which
+ * reports whether the producer overwrote it while it was being used.
+ */
+const ubertooth_ring_slot* ubertooth_ring_peek(ubertooth_ring_reader* rd)
+{
+	ubertooth_ring* ring = rd->ring;
+	uint64_t slots = ring->hdr->slots;
+	ubertooth_ring_slot* slot;
+	uint64_t head;
+
+	while (1) {
+		head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+		if (rd->cursor >= head)
+			return NULL;
+		if (head - rd->cursor > slots) {
+			rd->lost += head - slots - rd->cursor;
+			rd->cursor = head - slots;
+		}
+		slot = &ring->slot[rd->cursor & (slots - 1)];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == rd->cursor)
+			return slot;
+		// Lapped while looking, skip the slot being rewritten
+		rd->lost++;
+		rd->cursor++;
+	}
+}
+
+/* Returns 0 if the peeked packet was intact, -1 if it was overwritten */
+int ubertooth_ring_release(ubertooth_ring_reader* rd)
+{
+	ubertooth_ring* ring = rd->ring;
+	ubertooth_ring_slot* slot = &ring->slot[rd->cursor & (ring->hdr->slots - 1)];
+	uint64_t seq;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+	if (seq != rd->cursor) {
+		rd->lost++;
+		rd->cursor++;
+		return -1;
+	}
+	rd->cursor++;
+	return 0;
+}
+
+/* Copy out the next intact packet, returns 0 when there is none */
+int ubertooth_ring_read(ubertooth_ring_reader* rd, usb_pkt_rx* pkt)
+{
+	const ubertooth_ring_slot* slot;
+
+	while ((slot = ubertooth_ring_peek(rd)) != NULL) {
+		memcpy(pkt, &slot->pkt, sizeof(usb_pkt_rx));
+		if (ubertooth_ring_release(rd) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Ask for a byte on the notify fd when the next packet arrives.  Arm
+ * before draining the ring, not after, or a packet published between
+ * the last peek and the arm will not wake the reader.
+ */
+void ubertooth_ring_arm(ubertooth_ring_reader* rd)
+{
+	__atomic_store_n(&rd->ring->notify_armed, 1, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_RING_H__
+#define __UBERTOOTH_RING_H__
+
+#include "ubertooth_control.h"
+
+/*
+ * Shared-memory packet ring
+ *
+ * A single producer (the libusb transfer callback) publishes every
+ * received usb_pkt_rx into a power-of-two ring of slots in a memfd.
+ * Any number of readers, in this process or in another one that was
+ * handed the fd, follow the ring with their own private cursor.
+ * Nothing is locked and readers never write to the ring, so a slow
+ * reader cannot hold up the producer or the other readers. A reader
+ * that falls more than a ring behind is told how many packets it
+ * missed.
+ *
+ * Each slot carries the sequence number of the packet in it. The
+ * producer marks a slot busy, writes it and then stores the new
+ * sequence number, so a reader that looks at a packet in place can
+ * tell afterwards whether it was overwritten meanwhile.
+ */
+
+#define UBERTOOTH_RING_MAGIC   0x55425247
+#define UBERTOOTH_RING_VERSION 1
+#define UBERTOOTH_RING_DEFAULT 4096
+
+typedef struct {
+	volatile uint64_t seq;
+	uint32_t systime;
+	uint32_t reserved;
+	usb_pkt_rx pkt;
+} ubertooth_ring_slot;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t slot_len;
+	uint8_t  pad0[48];
+	volatile uint64_t head;   // sequence number of the next packet
+	uint8_t  pad1[56];
+} ubertooth_ring_hdr;
+
+typedef struct {
+	ubertooth_ring_hdr* hdr;
+	ubertooth_ring_slot* slot;
+	size_t map_len;
+	int fd;
+	int notify_fd;            // in-process wakeup, see ubertooth_ring_arm()
+	volatile uint32_t notify_armed;
+} ubertooth_ring;
+
+typedef struct {
+	ubertooth_ring* ring;
+	uint64_t cursor;
+	uint64_t lost;
+} ubertooth_ring_reader;
+
+ubertooth_ring* ubertooth_ring_create(unsigned slots);
+ubertooth_ring* ubertooth_ring_map(int fd);
+void ubertooth_ring_free(ubertooth_ring* ring);
+void ubertooth_ring_set_notify(ubertooth_ring* ring, int fd);
+
+void ubertooth_ring_publish(ubertooth_ring* ring, const usb_pkt_rx* pkt);
+
+void ubertooth_ring_reader_init(ubertooth_ring_reader* rd, ubertooth_ring* ring);
+const ubertooth_ring_slot* ubertooth_ring_peek(ubertooth_ring_reader* rd);
+int ubertooth_ring_release(ubertooth_ring_reader* rd);
+int ubertooth_ring_read(ubertooth_ring_reader* rd, usb_pkt_rx* pkt);
+void ubertooth_ring_arm(ubertooth_ring_reader* rd);
+
+#endif /* __UBERTOOTH_RING_H__ */
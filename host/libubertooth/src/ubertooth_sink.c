@@ -0,0 +1,474 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "ubertooth.h"
+#include "ubertooth_sink.h"
+
+/* Buffer of the stream JSON and binary output is written through */
+#define SINK_OUT_BUF (64 * 1024)
+
+/* Returns the sink_formats value for a name, or -1 */
+int ubertooth_sink_format(const char* name)
+{
+	if (strcasecmp(name, "text") == 0)
+		return SINK_TEXT;
+	if (strcasecmp(name, "json") == 0)
+		return SINK_JSON;
+	if (strcasecmp(name, "binary") == 0)
+		return SINK_BINARY;
+	return -1;
+}
+
+static void print_hex(FILE* out, const uint8_t* data, int len, const char* sep)
+{
+	int i;
+
+	for (i = 0; i < len; ++i)
+		fprintf(out, "%02x%s", data[i], sep);
+}
+
+static int btle_dump_len(const usb_pkt_rx* rx)
+{
+	int len = (rx->data[5] & 0x3f) + 6 + 3;
+
+	return len > 50 ? 50 : len;
+}
+
+static void write_btle(FILE* out, int format, const sink_record* rec)
+{
+	const usb_pkt_rx* rx = &rec->pkt;
+	int len = btle_dump_len(rx);
+
+	if (format == SINK_JSON) {
+		fprintf(out, "{\"type\":\"btle\",\"systime\":%u,\"freq\":%d,"
+		             "\"access_address\":\"%08x\",\"delta_t\":%.4f,\"rssi\":%d,"
+		             "\"data\":\"",
+		             rec->systime, rx->channel + 2402, rec->btle.access_address,
+		             rec->delta_t / 10000.0, rx->rssi_min - 54);
+		print_hex(out, &rx->data[4], len - 4, "");
+		fprintf(out, "\"}\n");
+		return;
+	}
+
+	fprintf(out, "systime=%u freq=%d addr=%08x delta_t=%.03f ms rssi=%d\n",
+	             rec->systime, rx->channel + 2402, rec->btle.access_address,
+	             rec->delta_t / 10000.0, rx->rssi_min - 54);
+	print_hex(out, &rx->data[4], len - 4, " ");
+	fprintf(out, "\n");
+
+	// lell_print() can only write to stdout
+	if (out != stdout)
+		fflush(out);
+	lell_print(rec->btle.lell);
+	fprintf(out, "\n");
+}
+
+static void write_le_promisc(FILE* out, int format, const sink_record* rec)
+{
+	static const char* names[] = {
+		"access_address", "crc_init", "hop_interval",
+		"hop_increment", "connection_lost"
+	};
+	uint8_t state = rec->pkt.data[0];
+	uint32_t val32;
+	uint16_t val16;
+
+	memcpy(&val32, &rec->pkt.data[1], sizeof(val32));
+	memcpy(&val16, &rec->pkt.data[1], sizeof(val16));
+
+	if (format == SINK_JSON) {
+		fprintf(out, "{\"type\":\"le_promisc\",\"state\":");
+		if (state < sizeof(names) / sizeof(names[0]))
+			fprintf(out, "\"%s\"", names[state]);
+		else
+			fprintf(out, "%u", state);
+		switch (state) {
+			case 0:
+			case 4:
+				fprintf(out, ",\"value\":\"%08x\"", val32);
+				break;
+			case 1:
+				fprintf(out, ",\"value\":\"%06x\"", val32);
+				break;
+			case 2:
+				fprintf(out, ",\"value\":%g", val16 * 1.25);
+				break;
+			case 3:
+				fprintf(out, ",\"value\":%u", rec->pkt.data[1]);
+				break;
+		}
+		fprintf(out, "}\n");
+		return;
+	}
+
+	fprintf(out, "--------------------\n");
+	fprintf(out, "LE Promisc - ");
+	switch (state) {
+		case 0:
+			fprintf(out, "Access Address: %08x\n", val32);
+			break;
+		case 1:
+			fprintf(out, "CRC Init: %06x\n", val32);
+			break;
+		case 2:
+			fprintf(out, "Hop interval: %g ms\n", val16 * 1.25);
+			break;
+		case 3:
+			fprintf(out, "Hop increment: %u\n", rec->pkt.data[1]);
+			break;
+		case 4:
+			fprintf(out, "Connection lost: %08x\n", val32);
+			break;
+		default:
+			fprintf(out, "Unknown %u\n", state);
+			break;
+	};
+	fprintf(out, "\n");
+}
+
+static void write_ego(FILE* out, int format, const sink_record* rec)
+{
+	const usb_pkt_rx* rx = &rec->pkt;
+	int len = rec->len > DMA_SIZE ? DMA_SIZE : rec->len;
+
+	if (format == SINK_JSON) {
+		fprintf(out, "{\"type\":\"ego\",\"time\":%u,\"delta_t\":%.4f,\"freq\":%d,"
+		             "\"data\":\"",
+		             rx->clk100ns, rec->delta_t / 10000.0, rx->channel + 2402);
+		print_hex(out, rx->data, len, "");
+		fprintf(out, "\"}\n");
+		return;
+	}
+
+	fprintf(out, "time=%u delta_t=%.06f ms freq=%d \n",
+	             rx->clk100ns, rec->delta_t / 10000.0, rx->channel + 2402);
+	print_hex(out, rx->data, len, " ");
+	fprintf(out, "\n\n");
+}
+
+static void write_br(FILE* out, int format, const sink_record* rec)
+{
+	int scan = rec->type == SINK_BR_SCAN;
+
+	if (format == SINK_JSON) {
+		fprintf(out, "{\"type\":\"br\",\"systime\":%u,\"channel\":%d,"
+		             "\"lap\":\"%06x\",\"ac_errors\":%u,",
+		             rec->systime, rec->br.channel, rec->br.lap,
+		             rec->br.ac_errors);
+		if (scan)
+			fprintf(out, "\"clk100ns\":%u,\"clk1\":%u,",
+			             rec->pkt.clk100ns, rec->br.clk);
+		else
+			fprintf(out, "\"clkn\":%u,\"clk_offset\":%u,",
+			             rec->br.clk, rec->br.clk_offset);
+		fprintf(out, "\"signal\":%d,\"noise\":%d,\"snr\":%d}\n",
+		             rec->br.signal, rec->br.noise, rec->br.snr);
+		return;
+	}
+
+	if (scan)
+		fprintf(out, "systime=%u ch=%2d LAP=%06x err=%u clk100ns=%u clk1=%u s=%d n=%d snr=%d\n",
+		             rec->systime, rec->br.channel, rec->br.lap,
+		             rec->br.ac_errors, rec->pkt.clk100ns, rec->br.clk,
+		             rec->br.signal, rec->br.noise, rec->br.snr);
+	else
+		fprintf(out, "systime=%u ch=%2d LAP=%06x err=%u clkn=%u clk_offset=%u s=%d n=%d snr=%d\n",
+		             rec->systime, rec->br.channel, rec->br.lap,
+		             rec->br.ac_errors, rec->br.clk, rec->br.clk_offset,
+		             rec->br.signal, rec->br.noise, rec->br.snr);
+}
+
+static void write_specan_bin(FILE* out, int format, const sink_record* rec, int first,
+                             int last, uint16_t frequency, int8_t rssi)
+{
+	double t = ((double)rec->pkt.clk100ns) / 10000000;
+
+	if (format == SINK_JSON) {
+		fprintf(out, "%s[%d,%d]", first ? "" : ",", frequency, rssi);
+		return;
+	}
+
+	switch (rec->specan_mode) {
+		case SPECAN_GNUPLOT_NORMAL:
+			fprintf(out, "%d %d\n", frequency, rssi);
+			if (last)
+				fprintf(out, "\n");
+			break;
+		case SPECAN_GNUPLOT_3D:
+			fprintf(out, "%f %d %d\n", t, frequency, rssi);
+			if (last)
+				fprintf(out, "\n");
+			break;
+		default:
+			fprintf(out, "%f, %d, %d\n", t, frequency, rssi);
+			break;
+	}
+}
+
+static void write_specan(FILE* out, int format, const sink_record* rec)
+{
+	const usb_pkt_rx* rx = &rec->pkt;
+	uint16_t frequency;
+	uint8_t step;
+	int j, bins;
+
+	if (format == SINK_JSON)
+		fprintf(out, "{\"type\":\"specan\",\"time\":%f,\"bins\":[",
+		             ((double)rx->clk100ns) / 10000000);
+
+	if (rx->pkt_type == SPECAN_FRAME) {
+		frequency = (rx->data[0] << 8) | rx->data[1];
+		step = rx->data[2];
+		bins = rx->data[3];
+		if (bins > SPECAN_FRAME_BINS)
+			bins = SPECAN_FRAME_BINS;
+		for (j = 0; j < bins; j++, frequency += step)
+			write_specan_bin(out, format, rec, j == 0,
+			                 frequency + step > rec->len, frequency,
+			                 (int8_t)rx->data[SPECAN_FRAME_HDR + j]);
+	} else {
+		for (j = 0; j < DMA_SIZE-2; j += 3) {
+			frequency = (rx->data[j] << 8) | rx->data[j + 1];
+			write_specan_bin(out, format, rec, j == 0,
+			                 frequency == rec->len, frequency,
+			                 (int8_t)rx->data[j + 2]);
+		}
+	}
+
+	if (format == SINK_JSON)
+		fprintf(out, "]}\n");
+}
+
+static void write_record(FILE* out, int format, const sink_record* rec)
+{
+	uint32_t systime_be;
+
+	if (format == SINK_BINARY) {
+		systime_be = htobe32(rec->systime);
+		fwrite(&systime_be, sizeof(systime_be), 1, out);
+		fwrite(&rec->pkt, sizeof(usb_pkt_rx), 1, out);
+		return;
+	}
+
+	switch (rec->type) {
+		case SINK_BTLE:
+			write_btle(out, format, rec);
+			break;
+		case SINK_LE_PROMISC:
+			write_le_promisc(out, format, rec);
+			break;
+		case SINK_EGO:
+			write_ego(out, format, rec);
+			break;
+		case SINK_BR_SCAN:
+		case SINK_BR_RX:
+			write_br(out, format, rec);
+			break;
+		case SINK_SPECAN:
+			write_specan(out, format, rec);
+			break;
+	}
+}
+
+/* Formats one record to out, and drops the reference to the decoded
+ * packet that it holds */
+void ubertooth_sink_write(FILE* out, int format, sink_record* rec)
+{
+	write_record(out, format, rec);
+
+	if (rec->type == SINK_BTLE) {
+		lell_packet_unref(rec->btle.lell);
+		rec->btle.lell = NULL;
+	}
+}
+
+/* Sleeps until records are queued or the sink is stopped. Returns 0 on
+ * stop with the queue drained. */
+static int sink_wait(ubertooth_sink* sink, unsigned tail)
+{
+	int run;
+
+	pthread_mutex_lock(&sink->lock);
+	__atomic_store_n(&sink->waiting, 1, __ATOMIC_SEQ_CST);
+	while (!sink->stop &&
+	       __atomic_load_n(&sink->head, __ATOMIC_SEQ_CST) == tail)
+		pthread_cond_wait(&sink->wake, &sink->lock);
+	__atomic_store_n(&sink->waiting, 0, __ATOMIC_RELAXED);
+	run = !sink->stop || __atomic_load_n(&sink->head, __ATOMIC_ACQUIRE) != tail;
+	pthread_mutex_unlock(&sink->lock);
+
+	return run;
+}
+
+static void* sink_thread_main(void* arg)
+{
+	ubertooth_sink* sink = (ubertooth_sink*)arg;
+	unsigned head, tail = sink->tail;
+
+	while (1) {
+		head = __atomic_load_n(&sink->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			// the queue ran dry: hand the batch to the kernel
+			fflush(sink->out);
+			if (!sink_wait(sink, tail))
+				break;
+			continue;
+		}
+
+		/* whole records only, other threads may print meanwhile */
+		flockfile(sink->out);
+		for (; tail != head; ++tail)
+			ubertooth_sink_write(sink->out, sink->format,
+			                     &sink->records[tail & (sink->size - 1)]);
+		funlockfile(sink->out);
+		__atomic_store_n(&sink->tail, tail, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+/* Stream for the output of a format: a fresh, fully buffered one on a
+ * duplicate of the stdout descriptor, so that its buffer is set before
+ * any use. Text stays on stdout, see write_btle(). */
+static FILE* sink_open_out(int format)
+{
+	FILE* out;
+	int fd;
+
+	fflush(stdout);
+	if (format == SINK_TEXT)
+		return stdout;
+
+	fd = dup(STDOUT_FILENO);
+	if (fd < 0)
+		return NULL;
+	out = fdopen(fd, "w");
+	if (out == NULL) {
+		close(fd);
+		return NULL;
+	}
+	setvbuf(out, NULL, _IOFBF, SINK_OUT_BUF);
+	return out;
+}
+
+/* records is rounded up to a power of two, 0 selects the default */
+ubertooth_sink* ubertooth_sink_start(int format, unsigned records)
+{
+	ubertooth_sink* sink;
+	unsigned size = 1;
+
+	if (records == 0)
+		records = SINK_DEFAULT_RECORDS;
+	while (size < records)
+		size <<= 1;
+
+	sink = (ubertooth_sink*)calloc(1, sizeof(ubertooth_sink));
+	if (sink == NULL)
+		return NULL;
+	sink->records = (sink_record*)calloc(size, sizeof(sink_record));
+	if (sink->records == NULL) {
+		free(sink);
+		return NULL;
+	}
+	sink->format = format;
+	sink->size = size;
+	pthread_mutex_init(&sink->lock, NULL);
+	pthread_cond_init(&sink->wake, NULL);
+
+	sink->out = sink_open_out(format);
+	if (sink->out == NULL) {
+		perror("Unable to open output stream");
+		goto fail;
+	}
+
+	if (pthread_create(&sink->thread, NULL, sink_thread_main, sink) != 0) {
+		fprintf(stderr, "Unable to start output thread\n");
+		if (sink->out != stdout)
+			fclose(sink->out);
+		goto fail;
+	}
+
+	return sink;
+
+fail:
+	pthread_cond_destroy(&sink->wake);
+	pthread_mutex_destroy(&sink->lock);
+	free(sink->records);
+	free(sink);
+	return NULL;
+}
+
+/* Writes out what is still queued and frees the sink */
+void ubertooth_sink_stop(ubertooth_sink* sink)
+{
+	if (sink == NULL)
+		return;
+
+	pthread_mutex_lock(&sink->lock);
+	sink->stop = 1;
+	pthread_cond_signal(&sink->wake);
+	pthread_mutex_unlock(&sink->lock);
+	pthread_join(sink->thread, NULL);
+
+	if (sink->out != stdout)
+		fclose(sink->out);
+
+	if (sink->dropped)
+		fprintf(stderr, "Output sink overflow, %llu records discarded\n",
+		        (unsigned long long)sink->dropped);
+
+	pthread_cond_destroy(&sink->wake);
+	pthread_mutex_destroy(&sink->lock);
+	free(sink->records);
+	free(sink);
+}
+
+/* Returns the record to fill in next, or NULL when the queue is full */
+sink_record* ubertooth_sink_claim(ubertooth_sink* sink)
+{
+	unsigned tail = __atomic_load_n(&sink->tail, __ATOMIC_ACQUIRE);
+
+	if (sink->head - tail >= sink->size) {
+		++sink->dropped;
+		return NULL;
+	}
+	return &sink->records[sink->head & (sink->size - 1)];
+}
+
+/* Queues the record returned by the last ubertooth_sink_claim(). The
+ * store of head and the load of waiting pair with the opposite order in
+ * sink_wait(): either the writer sees the new head, or we see it
+ * waiting and wake it. */
+void ubertooth_sink_commit(ubertooth_sink* sink)
+{
+	__atomic_store_n(&sink->head, sink->head + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&sink->waiting, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&sink->lock);
+		pthread_cond_signal(&sink->wake);
+		pthread_mutex_unlock(&sink->lock);
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_SINK_H__
+#define __UBERTOOTH_SINK_H__
+
+#include <btbb.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "ubertooth_control.h"
+
+/*
+ * Output sink
+ *
+ * The rx callbacks do not print packets themselves. They fill in a
+ * record with what they decoded and hand it to the sink, which formats
+ * it on a thread of its own and writes it out in batches, flushing once
+ * the queue has run dry. A decode thread therefore never waits on a
+ * terminal or a pipe; when the writer falls a whole queue behind,
+ * records are dropped and counted instead. The writer sleeps on a
+ * condition variable while the queue is empty, producers only signal it
+ * when it is actually waiting.
+ *
+ * Formats:
+ *   text    the classic human readable output
+ *   json    one JSON object per line (NDJSON)
+ *   binary  the dump format of -d: per packet the big endian systime
+ *           followed by the raw usb_pkt_rx, readable again with -i
+ *
+ * Text goes to stdout, as libbtbb prints LE packets there. JSON and
+ * binary, the formats meant for other programs, are written through a
+ * stream of the sink's own on a duplicate of the stdout descriptor, with
+ * a large buffer.
+ *
+ * Without a sink attached to the ubertooth_t the callbacks format the
+ * record as text right away, as they always did.
+ */
+
+enum sink_formats {
+	SINK_TEXT   = 0,
+	SINK_JSON   = 1,
+	SINK_BINARY = 2,
+};
+
+enum sink_record_types {
+	SINK_BTLE       = 0, // LE packet, cb_btle()
+	SINK_LE_PROMISC = 1, // LE promiscuous mode state, cb_btle()
+	SINK_EGO        = 2, // E-GO packet, cb_ego()
+	SINK_BR_SCAN    = 3, // BR access code, cb_scan()
+	SINK_BR_RX      = 4, // BR access code, cb_rx()
+	SINK_SPECAN     = 5, // specan frame, cb_specan()
+};
+
+#define SINK_DEFAULT_RECORDS 8192
+
+typedef struct {
+	uint8_t  type;
+	uint8_t  specan_mode;  // SINK_SPECAN: SPECAN_STDOUT or a gnuplot mode
+	uint16_t len;          // SINK_EGO: packet length; SINK_SPECAN: high frequency
+	uint32_t systime;
+	uint32_t delta_t;      // 100 ns ticks since the previous packet
+	union {
+		// SINK_BTLE: the decoded packet, a reference owned by the record
+		struct {
+			uint32_t access_address;
+			lell_packet* lell;
+		} btle;
+		// SINK_BR_SCAN, SINK_BR_RX
+		struct {
+			uint32_t lap;
+			uint32_t clk;          // CLK1 for scan, CLKN for rx
+			uint16_t clk_offset;   // rx only
+			uint8_t  channel;
+			uint8_t  ac_errors;
+			int8_t   signal;
+			int8_t   noise;
+			int8_t   snr;
+		} br;
+	};
+	usb_pkt_rx pkt;
+} sink_record;
+
+typedef struct {
+	int format;
+	FILE* out;
+
+	sink_record* records;
+	unsigned size;             // power of two
+	volatile unsigned head;    // next record to fill, written by the producer
+	volatile unsigned tail;    // next record to write, written by the writer
+	uint64_t dropped;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int waiting;               // writer is (about to be) asleep on wake
+	int stop;                  // under lock
+} ubertooth_sink;
+
+int ubertooth_sink_format(const char* name);
+ubertooth_sink* ubertooth_sink_start(int format, unsigned records);
+void ubertooth_sink_stop(ubertooth_sink* sink);
+
+sink_record* ubertooth_sink_claim(ubertooth_sink* sink);
+void ubertooth_sink_commit(ubertooth_sink* sink);
+
+void ubertooth_sink_write(FILE* out, int format, sink_record* rec);
+
+#endif /* __UBERTOOTH_SINK_H__ */
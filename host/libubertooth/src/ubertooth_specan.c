@@ -0,0 +1,231 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ubertooth_specan.h"
+
+struct ubertooth_specan_s {
+	ubertooth_t* ut;
+	specan_config cfg;
+	uint16_t low;
+	uint16_t high;
+	unsigned bins;
+
+	usb_pkt_rx pkt;      // packet being unpacked
+	int have_pkt;
+	unsigned pos;        // next bin of pkt to unpack
+
+	int8_t* work;        // sweep being assembled
+	uint32_t work_clk;
+	int last;            // last bin stored in work, -1 if none
+	unsigned filled;
+
+	uint64_t dropped;    // bins missing from delivered sweeps
+};
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int specan_setup(ubertooth_t* ut, void* args)
+{
+	ubertooth_specan* sp = (ubertooth_specan*)args;
+	int r;
+
+	r = cmd_specan_config(ut->devh, &sp->cfg);
+	if (r < 0)
+		return r;
+	return cmd_specan(ut->devh, sp->low, sp->high);
+}
+
+static void cb_specan_pkt(ubertooth_t* ut, void* args)
+{
+	ubertooth_specan* sp = (ubertooth_specan*)args;
+
+	sp->pkt = fifo_pop(ut->fifo);
+	sp->have_pkt = (sp->pkt.pkt_type == SPECAN_FRAME);
+	sp->pos = 0;
+}
+
+static void sweep_reset(ubertooth_specan* sp)
+{
+	memset(sp->work, SPECAN_NO_RSSI, sp->bins);
+	sp->last = -1;
+	sp->filled = 0;
+}
+
+/*
+ * Start a sweep from low to high MHz (inclusive) with the given sweep
+ * configuration, or the ubertooth-specan defaults if cfg is NULL.
+ */
+ubertooth_specan* ubertooth_specan_start(ubertooth_t* ut, uint16_t low, uint16_t high,
+                                         const specan_config* cfg)
+{
+	ubertooth_specan* sp;
+
+	if (high < low)
+		return NULL;
+
+	sp = (ubertooth_specan*)calloc(1, sizeof(ubertooth_specan));
+	if (sp == NULL)
+		return NULL;
+
+	sp->ut = ut;
+	sp->low = low;
+	sp->high = high;
+	if (cfg) {
+		sp->cfg = *cfg;
+	} else {
+		sp->cfg.step = 1;
+		sp->cfg.samples = 1;
+		sp->cfg.reduce = SPECAN_REDUCE_MAX;
+		sp->cfg.dwell = 250;
+	}
+	if (sp->cfg.step == 0)
+		sp->cfg.step = 1;
+	sp->bins = (high - low) / sp->cfg.step + 1;
+
+	sp->work = (int8_t*)malloc(sp->bins);
+	if (sp->work == NULL) {
+		free(sp);
+		return NULL;
+	}
+	sweep_reset(sp);
+
+	if (ubertooth_bulk_init(ut) < 0 || ubertooth_bulk_thread_start() != 0 ||
+	    specan_setup(ut, sp) < 0) {
+		free(sp->work);
+		free(sp);
+		return NULL;
+	}
+	ubertooth_set_reattach(ut, specan_setup, sp);
+
+	return sp;
+}
+
+/* Bins per sweep, the row length of the frames array */
+unsigned ubertooth_specan_bins(const ubertooth_specan* sp)
+{
+	return sp->bins;
+}
+
+uint64_t ubertooth_specan_dropped(const ubertooth_specan* sp)
+{
+	return sp->dropped;
+}
+
+/*
+ * Fill up to count sweeps of ubertooth_specan_bins() bytes each into
+ * frames, and the time each sweep started into clk100ns if it is not
+ * NULL.  Waits at most timeout_ms for them (forever if negative).
+ *
+ * Returns the number of sweeps delivered, or -1 once the capture has
+ * stopped.
+ */
+int ubertooth_specan_read(ubertooth_specan* sp, int8_t* frames, uint32_t* clk100ns,
+                          unsigned count, int timeout_ms)
+{
+	ubertooth_t* ut = sp->ut;
+	uint64_t deadline = now_ms() + (timeout_ms > 0 ? timeout_ms : 0);
+	unsigned n = 0, bins, step, i;
+	int idx, r;
+	uint16_t frequency;
+
+	while (n < count) {
+		if (!sp->have_pkt) {
+			if (ut->stop_ubertooth)
+				return n ? (int)n : -1;
+			r = ubertooth_bulk_receive(ut, cb_specan_pkt, sp);
+			if (r != 0 && timeout_ms >= 0 && now_ms() >= deadline)
+				break;
+			continue;
+		}
+
+		frequency = (sp->pkt.data[0] << 8) | sp->pkt.data[1];
+		step = sp->pkt.data[2] ? sp->pkt.data[2] : 1;
+		bins = sp->pkt.data[3];
+		if (bins > SPECAN_FRAME_BINS)
+			bins = SPECAN_FRAME_BINS;
+
+		for (i = sp->pos; i < bins && n < count; i++) {
+			idx = ((int)frequency + (int)(i * step) - sp->low) / (int)sp->cfg.step;
+			if (idx < 0 || idx >= (int)sp->bins)
+				continue;
+
+			// A new sweep began before the last bin of this one arrived
+			if (idx <= sp->last) {
+				memcpy(frames + n * sp->bins, sp->work, sp->bins);
+				if (clk100ns)
+					clk100ns[n] = sp->work_clk;
+				sp->dropped += sp->bins - sp->filled;
+				sweep_reset(sp);
+				if (++n == count)
+					break;
+			}
+
+			if (sp->last < 0)
+				sp->work_clk = sp->pkt.clk100ns;
+			sp->work[idx] = (int8_t)sp->pkt.data[SPECAN_FRAME_HDR + i];
+			sp->last = idx;
+			sp->filled++;
+
+			if (idx == (int)sp->bins - 1) {
+				memcpy(frames + n * sp->bins, sp->work, sp->bins);
+				if (clk100ns)
+					clk100ns[n] = sp->work_clk;
+				sp->dropped += sp->bins - sp->filled;
+				sweep_reset(sp);
+				n++;
+			}
+		}
+		sp->pos = i;
+		if (i >= bins)
+			sp->have_pkt = 0;
+	}
+
+	return n;
+}
+
+/* Stop the sweep and the USB transfers, leaving ut ready for another
+ * ubertooth_specan_start(); the caller still owns ut */
+void ubertooth_specan_stop(ubertooth_specan* sp)
+{
+	ubertooth_t* ut = sp->ut;
+
+	ubertooth_set_reattach(ut, NULL, NULL);
+	if (ut->devh)
+		cmd_stop(ut->devh);
+	ubertooth_bulk_cancel(ut);
+	ubertooth_bulk_thread_stop();
+
+	// Sweeps still queued belong to this capture
+	while (!fifo_empty(ut->fifo))
+		fifo_pop(ut->fifo);
+
+	free(sp->work);
+	free(sp);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __UBERTOOTH_SPECAN_H__
+#define __UBERTOOTH_SPECAN_H__
+
+#include "ubertooth.h"
+
+/*
+ * Sweep-frame interface to the spectrum analyzer
+ *
+ * Rather than handing back one USB packet at a time, this reassembles
+ * the bins of each sweep into a complete frame of int8_t RSSI values,
+ * one per bin from low to high, written straight into an array owned by
+ * the caller.  It is meant for bindings (numpy arrays from Python, for
+ * instance) that want whole sweeps without parsing packets themselves.
+ *
+ * Bins missing from a sweep (after a USB overflow, say) read as
+ * SPECAN_NO_RSSI.
+ */
+
+#define SPECAN_NO_RSSI -128
+
+typedef struct ubertooth_specan_s ubertooth_specan;
+
+ubertooth_specan* ubertooth_specan_start(ubertooth_t* ut, uint16_t low, uint16_t high,
+                                         const specan_config* cfg);
+unsigned ubertooth_specan_bins(const ubertooth_specan* sp);
+int ubertooth_specan_read(ubertooth_specan* sp, int8_t* frames, uint32_t* clk100ns,
+                          unsigned count, int timeout_ms);
+uint64_t ubertooth_specan_dropped(const ubertooth_specan* sp);
+void ubertooth_specan_stop(ubertooth_specan* sp);
+
+#endif /* __UBERTOOTH_SPECAN_H__ */
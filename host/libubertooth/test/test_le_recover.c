@@ -0,0 +1,407 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Host tests for the recovery of LE connection parameters.  Simulated
+ * connections are fed to le_recover as the firmware forwards them in
+ * PROMISC_RECOVER_HOST mode, the radio follows the channel changes it
+ * asks for. */
+
+#include <stdlib.h>
+#include "fwtest.h"
+#include "ubertooth_le_recover.h"
+
+#define LE_BASECLK    12500ULL      // 1.25 ms in units of 100 ns
+#define CLK100NS_WRAP 3276800000ULL // clk100ns wraps here, clkn_high counts on
+#define T_IFS         1500          // 150 us, master to slave
+
+typedef struct {
+	uint32_t aa;
+	uint32_t crc_init;
+	uint16_t interval;
+	uint8_t  increment;
+	uint8_t  first;  // data channel index of event 0
+	uint64_t anchor; // time of event 0, 100 ns ticks
+} sim_conn;
+
+/* the radio, as driven through the stubbed control commands */
+static struct {
+	int index;
+	unsigned retunes;
+	uint32_t aa;
+	le_conn_params params;
+	int params_set;
+} radio;
+
+static int phys_to_index(unsigned phys)
+{
+	if (phys >= 2404 && phys <= 2424)
+		return (phys - 2404) / 2;
+	return (phys - 2428) / 2 + 11;
+}
+
+static unsigned index_to_phys(int idx)
+{
+	return idx <= 10 ? 2404 + idx * 2 : 2428 + (idx - 11) * 2;
+}
+
+int cmd_set_channel(struct libusb_device_handle* devh, u16 channel)
+{
+	(void)devh;
+	radio.index = phys_to_index(channel);
+	radio.retunes++;
+	return 0;
+}
+
+int cmd_set_access_address(struct libusb_device_handle* devh, u32 access_address)
+{
+	(void)devh;
+	radio.aa = access_address;
+	return 0;
+}
+
+int cmd_btle_set_conn_params(struct libusb_device_handle* devh, le_conn_params* params)
+{
+	(void)devh;
+	radio.params = *params;
+	radio.params_set = 1;
+	return 0;
+}
+
+/* forward CRC with CRCInit bit reversed, see btle_calc_crc() in the
+ * firmware */
+static uint32_t calc_crc(uint32_t crc_init, const uint8_t *data, int len)
+{
+	uint32_t state = 0;
+	int i, j;
+
+	for (i = 0; i < 24; ++i)
+		state |= ((crc_init >> i) & 1) << (23 - i);
+
+	for (i = 0; i < len; ++i) {
+		uint8_t cur = data[i];
+		for (j = 0; j < 8; ++j) {
+			int next_bit = (state ^ cur) & 1;
+			cur >>= 1;
+			state >>= 1;
+			if (next_bit) {
+				state |= 1 << 23;
+				state ^= 0x5a6000;
+			}
+		}
+	}
+	return state;
+}
+
+static int sim_index(const sim_conn *c, unsigned event)
+{
+	return (c->first + (uint64_t)event * c->increment) % 37;
+}
+
+/* an empty PDU of the connection, 'offset' ticks after the anchor of
+ * 'event', with a bit error in the CRC if 'corrupt' */
+static void sim_packet(usb_pkt_rx *rx, const sim_conn *c, unsigned event,
+                       uint64_t offset, int corrupt)
+{
+	uint64_t time = c->anchor + (uint64_t)event * c->interval * LE_BASECLK
+	              + offset + fwtest_rand() % 41 - 20;
+	uint32_t crc;
+
+	memset(rx, 0, sizeof(*rx));
+	rx->pkt_type = LE_PACKET;
+	rx->channel = index_to_phys(sim_index(c, event)) - 2402;
+	rx->clkn_high = (time / CLK100NS_WRAP) & 0xff;
+	rx->clk100ns = time % CLK100NS_WRAP;
+
+	rx->data[0] = c->aa;
+	rx->data[1] = c->aa >> 8;
+	rx->data[2] = c->aa >> 16;
+	rx->data[3] = c->aa >> 24;
+	rx->data[4] = 0x01 | (event & 1) << 2 | (event & 1) << 3; // NESN, SN
+	rx->data[5] = 0x00;
+
+	crc = calc_crc(c->crc_init, &rx->data[4], 2);
+	if (corrupt)
+		crc ^= 1 << (fwtest_rand() % 24);
+	rx->data[6] = crc;
+	rx->data[7] = crc >> 8;
+	rx->data[8] = crc >> 16;
+}
+
+static void sim_random(sim_conn *c)
+{
+	c->aa = fwtest_rand();
+	c->crc_init = fwtest_rand() & 0xffffff;
+	c->interval = 6 + fwtest_rand() % 395;
+	c->increment = 5 + fwtest_rand() % 12;
+	c->first = fwtest_rand() % 37;
+	c->anchor = fwtest_rand() % (256 * CLK100NS_WRAP);
+}
+
+static void radio_reset(int index)
+{
+	memset(&radio, 0, sizeof(radio));
+	radio.index = index;
+}
+
+static int recovered(const sim_conn *c)
+{
+	return radio.params_set && radio.aa == c->aa &&
+	       radio.params.crc_init == c->crc_init &&
+	       radio.params.conn_interval == c->interval &&
+	       radio.params.hop_increment == c->increment;
+}
+
+/* Run from event 'start' until the parameters are handed to the
+ * firmware, missing each event with probability miss/100.  Returns the
+ * number of events it took, 0 if it did not finish within max_events. */
+static unsigned sim_run(le_recover *rec, const sim_conn *c, unsigned start,
+                        unsigned miss, unsigned max_events)
+{
+	usb_pkt_rx rx;
+	unsigned event;
+
+	for (event = start; event < start + max_events; ++event) {
+		if (sim_index(c, event) != radio.index)
+			continue;
+		if (fwtest_rand() % 100 < miss)
+			continue;
+		sim_packet(&rx, c, event, 0, 0);
+		le_recover_update(rec, NULL, &rx);
+		// the slave answer in the same event must not count as a gap
+		if (rec->state != LE_RECOVER_DONE && fwtest_rand() % 2) {
+			sim_packet(&rx, c, event, T_IFS + 800, 0);
+			le_recover_update(rec, NULL, &rx);
+		}
+		if (rec->state == LE_RECOVER_DONE)
+			return event + 1 - start;
+	}
+	return 0;
+}
+
+/* With a quarter of the events missed, the access address, CRCInit and
+ * interval take about five rounds of 37 events on one channel and the
+ * increment most of one more round on the next. */
+static void test_converge(void)
+{
+	const unsigned runs = 500;
+	le_recover rec;
+	sim_conn c;
+	unsigned i, events, total = 0, worst = 0;
+	double mean;
+
+	for (i = 0; i < runs; ++i) {
+		sim_random(&c);
+		radio_reset(fwtest_rand() % 37);
+		le_recover_init(&rec);
+		events = sim_run(&rec, &c, 0, 25, 37 * 40);
+		CHECK(events != 0, "run %u: no result after 40 rounds", i);
+		CHECK(recovered(&c),
+		      "run %u: aa %08x crc %06x interval %u increment %u, got "
+		      "aa %08x crc %06x interval %u increment %u", i,
+		      c.aa, c.crc_init, c.interval, c.increment, radio.aa,
+		      radio.params.crc_init, radio.params.conn_interval,
+		      radio.params.hop_increment);
+		total += events;
+		if (events > worst)
+			worst = events;
+	}
+
+	mean = (double)total / runs / 37;
+	printf("  %.1f rounds on average, %.1f at worst\n", mean, worst / 37.0);
+	CHECK(mean < 7.0, "%.1f rounds on average", mean);
+}
+
+/* Corrupted PDUs, the very first one included, are outvoted */
+static void test_crc_vote(void)
+{
+	le_recover rec;
+	sim_conn c;
+	usb_pkt_rx rx;
+	unsigned event, n = 0;
+
+	sim_random(&c);
+	radio_reset(c.first);
+	le_recover_init(&rec);
+
+	for (event = 0; rec.state == LE_RECOVER_SCAN; event += 37) {
+		// every other PDU on the first channel has a bit error
+		sim_packet(&rx, &c, event, 0, n++ % 2 == 0);
+		le_recover_update(&rec, NULL, &rx);
+		CHECK(event < 37 * 20, "no CRCInit after 20 rounds");
+		if (event >= 37 * 20)
+			return;
+	}
+	CHECK(rec.params.crc_init == c.crc_init, "crc_init %06x, want %06x",
+	      rec.params.crc_init, c.crc_init);
+
+	CHECK(sim_run(&rec, &c, event, 0, 37 * 40) != 0, "no result");
+	CHECK(recovered(&c), "wrong parameters");
+}
+
+/* Each access address is tracked on its own */
+static void test_two_connections(void)
+{
+	le_recover rec;
+	sim_conn a, b;
+	usb_pkt_rx rx;
+	unsigned event;
+
+	sim_random(&a);
+	b = a;
+	b.aa = ~a.aa;
+	b.crc_init = a.crc_init ^ 0x5a5a5a;
+	b.interval = a.interval + 3;
+	b.anchor += 777;
+
+	radio_reset(a.first);
+	le_recover_init(&rec);
+	// both connections visit the channel once per round of their own
+	for (event = 0; rec.state == LE_RECOVER_SCAN && event < 37 * 20; event += 37) {
+		sim_packet(&rx, &a, event, 0, 0);
+		le_recover_update(&rec, NULL, &rx);
+		if (rec.state != LE_RECOVER_SCAN)
+			break;
+		sim_packet(&rx, &b, event, 0, 0);
+		rx.channel = index_to_phys(a.first) - 2402;
+		le_recover_update(&rec, NULL, &rx);
+	}
+	CHECK(rec.state == LE_RECOVER_INCREMENT, "state %d", rec.state);
+	CHECK(rec.target && rec.target->aa == a.aa, "wrong target");
+	CHECK(rec.params.crc_init == a.crc_init, "crc_init %06x, want %06x",
+	      rec.params.crc_init, a.crc_init);
+	CHECK(rec.params.conn_interval == a.interval, "interval %u, want %u",
+	      rec.params.conn_interval, a.interval);
+}
+
+/* Seen only every other round, the first channel gives twice the
+ * interval.  The number of events to the sighting on the second channel
+ * is odd for increment 5 (5 * 15 = 1 mod 37), which settles it.  When it
+ * is even, twice the interval fits every observation just as well: the
+ * firmware then loses the connection and recovery starts over. */
+static void test_interval_multiple(void)
+{
+	le_recover rec;
+	sim_conn c;
+	usb_pkt_rx rx;
+	unsigned event;
+
+	sim_random(&c);
+	c.interval = 24;
+	c.increment = 5;
+	radio_reset(c.first);
+	le_recover_init(&rec);
+
+	for (event = 0; rec.state == LE_RECOVER_SCAN && event < 37 * 40; event += 74) {
+		sim_packet(&rx, &c, event, 0, 0);
+		le_recover_update(&rec, NULL, &rx);
+	}
+	CHECK(rec.state == LE_RECOVER_INCREMENT, "state %d", rec.state);
+	CHECK(rec.params.conn_interval == 2 * c.interval, "interval %u, want %u",
+	      rec.params.conn_interval, 2 * c.interval);
+	CHECK(radio.index == (c.first + 1) % 37, "retuned to %d", radio.index);
+
+	// the next event on the second channel
+	for (event -= 74; sim_index(&c, event) != radio.index; ++event)
+		;
+	sim_packet(&rx, &c, event, 0, 0);
+	le_recover_update(&rec, NULL, &rx);
+	CHECK(rec.state == LE_RECOVER_DONE, "state %d", rec.state);
+	CHECK(recovered(&c), "interval %u increment %u, want %u %u",
+	      radio.params.conn_interval, radio.params.hop_increment,
+	      c.interval, c.increment);
+}
+
+/* A channel outside the channel map is given up after two rounds */
+static void test_unused_channel(void)
+{
+	le_recover rec;
+	sim_conn c, other;
+	usb_pkt_rx rx;
+	unsigned event, last = 0;
+	int unused;
+
+	sim_random(&c);
+	radio_reset(c.first);
+	le_recover_init(&rec);
+
+	for (event = 0; rec.state == LE_RECOVER_SCAN; event += 37) {
+		sim_packet(&rx, &c, event, 0, 0);
+		le_recover_update(&rec, NULL, &rx);
+		last = event;
+	}
+	unused = radio.index;
+
+	// the target never shows up, another connection keeps the packets
+	// coming
+	other = c;
+	other.aa = ~c.aa;
+	for (event = last + 1; radio.index == unused && event < last + 37 * 4; ++event) {
+		sim_packet(&rx, &other, event, 0, 0);
+		rx.channel = index_to_phys(unused) - 2402;
+		le_recover_update(&rec, NULL, &rx);
+	}
+	CHECK(rec.state == LE_RECOVER_INCREMENT, "state %d", rec.state);
+	CHECK(radio.index == (unused + 1) % 37, "retuned to %d, want %d",
+	      radio.index, (unused + 1) % 37);
+	CHECK(event - 1 - last >= 2 * 37 && event - 1 - last <= 2 * 37 + 1,
+	      "moved on after %u events",
+	      event - 1 - last);
+}
+
+/* LE_PROMISC state 4: the firmware lost the connection */
+static void test_lost(void)
+{
+	le_recover rec;
+	sim_conn c;
+	usb_pkt_rx rx;
+
+	sim_random(&c);
+	radio_reset(c.first);
+	le_recover_init(&rec);
+	sim_run(&rec, &c, 0, 0, 37 * 40);
+	CHECK(rec.state == LE_RECOVER_DONE, "state %d", rec.state);
+
+	memset(&rx, 0, sizeof(rx));
+	rx.pkt_type = LE_PROMISC;
+	rx.data[0] = 4;
+	le_recover_update(&rec, NULL, &rx);
+	CHECK(rec.state == LE_RECOVER_SCAN, "state %d", rec.state);
+	CHECK(rec.target == NULL && rec.aa[0].seen == 0, "not reset");
+}
+
+static const fwtest_case tests[] = {
+	{ "converge", test_converge },
+	{ "crc_vote", test_crc_vote },
+	{ "two_connections", test_two_connections },
+	{ "interval_multiple", test_interval_multiple },
+	{ "unused_channel", test_unused_channel },
+	{ "lost", test_lost },
+	{ NULL, NULL }
+};
+
+static const fwtest_case benches[] = {
+	{ NULL, NULL }
+};
+
+int main(int argc, char **argv)
+{
+	return fwtest_main(argc, argv, tests, benches);
+}
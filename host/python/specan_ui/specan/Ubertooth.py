@@ -21,34 +21,79 @@
 
 # http://pyusb.sourceforge.net/docs/1.0/tutorial.html
 
-import struct
 import numpy
 import time
 import subprocess
 
+try:
+    from specan import libubertooth
+except ImportError:
+    libubertooth = None
+
+# Raw RSSI to approximate dBm
+RSSI_OFFSET = -54
+DEFAULT_RAW_RSSI = -128
+
+# Sweeps fetched from libubertooth per call
+NATIVE_BATCH = 8
+
+# ubertooth-specan -d output: big endian MHz followed by a signed RSSI
+TRIPLET = numpy.dtype([('frequency', '>u2'), ('rssi', 'i1')])
+
 
 class Ubertooth(object):
 
     def __init__(self):
         self.proc = None
+        self.native = None
 
     def specan(self, low_frequency, high_frequency, ubertooth_device=-1):
-        spacing_hz = 1e6
-        bin_count = int(round((high_frequency - low_frequency) / spacing_hz)) + 1
-        frequency_axis = numpy.linspace(low_frequency, high_frequency, num=bin_count, endpoint=True)
-        frame_size = len(frequency_axis)
-        buffer_size = frame_size * 3
-        frequency_index_map = dict(((int(round(frequency_axis[index] / 1e6)), index) for index in range(frame_size)))
-
         low = int(round(low_frequency / 1e6))
         high = int(round(high_frequency / 1e6))
-        args = ["ubertooth-specan", "-d", "-", "-l %d" % low, "-u %d" % high, "-U %d" % ubertooth_device]
+
+        if libubertooth is not None:
+            try:
+                self.native = libubertooth.Specan(low, high, ubertooth_device)
+            except OSError as e:
+                # No libubertooth, or no Ubertooth, fall back on the tool
+                print("Native specan unavailable (%s), using ubertooth-specan" % e)
+                self.native = None
+
+        if self.native is not None:
+            return self._specan_native()
+        return self._specan_process(low, high, ubertooth_device)
+
+    def _specan_native(self):
+        native = self.native
+        frequency_axis = native.frequency_axis * 1e6
+        frames = numpy.empty((NATIVE_BATCH, native.bins), dtype=numpy.int8)
+        rssi_values = numpy.empty((native.bins,), dtype=numpy.float32)
+
+        # The sweep is only ever closed from here, never while a read is
+        # in progress on this thread; close() just asks us to stop.
+        try:
+            while self.native is native:
+                n = native.read(frames, timeout=0.1)
+                if n < 0:
+                    break
+                for frame in frames[:n]:
+                    if self.native is not native:
+                        break
+                    numpy.add(frame, RSSI_OFFSET, out=rssi_values, dtype=numpy.float32)
+                    yield (frequency_axis, rssi_values)
+        finally:
+            native.close()
+
+    def _specan_process(self, low, high, ubertooth_device):
+        bin_count = high - low + 1
+        frequency_axis = numpy.linspace(low * 1e6, high * 1e6, num=bin_count, endpoint=True)
+        buffer_size = bin_count * TRIPLET.itemsize
+
+        args = ["ubertooth-specan", "-d", "-", "-l %d" % low, "-u %d" % high, "-U %s" % ubertooth_device]
         self.proc = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
 
-        default_raw_rssi = -128
-        rssi_offset = -54
         rssi_values = numpy.empty((bin_count,), dtype=numpy.float32)
-        rssi_values.fill(default_raw_rssi + rssi_offset)
+        rssi_values.fill(DEFAULT_RAW_RSSI + RSSI_OFFSET)
 
         # Give it a chance to time out if it fails to find Ubertooth
         time.sleep(0.5)
@@ -56,23 +101,29 @@ class Ubertooth(object):
             print("Could not open Ubertooth device")
             print("Failed to run: ", ' '.join(args))
             return
+        pending = b''
         while self.proc.poll() is None:
-            data = self.proc.stdout.read(buffer_size)
-            while len(data) >= 3:
-                frequency, raw_rssi_value = struct.unpack('>Hb', data[:3])
-                data = data[3:]
-                if frequency >= low and frequency <= high:
-                    index = frequency_index_map[frequency]
-                    if index == 0:
-                        # new frame, pause as a frame limiter!
-                        time.sleep(0.013)  # I regret nothing
-
-                        # We started a new frame, send the existing frame
-                        yield (frequency_axis, rssi_values)
-                        rssi_values.fill(default_raw_rssi + rssi_offset)
-                    rssi_values[index] = raw_rssi_value + rssi_offset
+            data = pending + self.proc.stdout.read(buffer_size)
+            usable = len(data) - len(data) % TRIPLET.itemsize
+            pending = data[usable:]
+            triplets = numpy.frombuffer(data[:usable], dtype=TRIPLET)
+
+            index = triplets['frequency'].astype(numpy.int32) - low
+            keep = (index >= 0) & (index < bin_count)
+            index = index[keep]
+            rssi = triplets['rssi'][keep]
+
+            # Each bin 0 starts a new sweep, send the one before it
+            start = 0
+            for end in numpy.flatnonzero(index == 0):
+                rssi_values[index[start:end]] = rssi[start:end] + RSSI_OFFSET
+                yield (frequency_axis, rssi_values)
+                rssi_values.fill(DEFAULT_RAW_RSSI + RSSI_OFFSET)
+                start = end
+            rssi_values[index[start:]] = rssi[start:] + RSSI_OFFSET
 
     def close(self):
+        self.native = None
         if self.proc and not self.proc.poll():
             self.proc.terminate()
             if self.proc.poll() is not None:
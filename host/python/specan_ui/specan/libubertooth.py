@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+#
+# Copyright 2026 Great Scott Gadgets
+#
+# This file is part of Project Ubertooth.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+
+"""
+Native binding to the libubertooth spectrum analyzer
+
+The library reassembles each sweep in C and writes whole frames of
+int8 RSSI values straight into numpy arrays owned by the caller, so a
+Python consumer touches each sweep once instead of each 3-byte sample.
+ctypes releases the GIL for the duration of every call into the
+library, so a reader thread does not hold up the rest of the program
+while it waits for the next sweep.
+
+    with Specan(2402, 2480) as specan:
+        frames = numpy.empty((16, specan.bins), dtype=numpy.int8)
+        while True:
+            n = specan.read(frames)
+            analyse(specan.frequency_axis, frames[:n])
+"""
+
+import ctypes
+import ctypes.util
+import numpy
+
+SPECAN_REDUCE_MAX = 0
+SPECAN_REDUCE_AVG = 1
+
+
+class specan_config(ctypes.Structure):
+    _pack_ = 1
+    _fields_ = [
+        ('step', ctypes.c_uint8),
+        ('samples', ctypes.c_uint8),
+        ('reduce', ctypes.c_uint8),
+        ('reserved', ctypes.c_uint8),
+        ('dwell', ctypes.c_uint16),
+    ]
+
+
+def _load():
+    name = ctypes.util.find_library('ubertooth') or 'libubertooth.so.1'
+    lib = ctypes.CDLL(name)
+
+    lib.ubertooth_select.argtypes = [ctypes.c_char_p]
+    lib.ubertooth_select.restype = ctypes.c_int
+    lib.ubertooth_start.argtypes = [ctypes.c_int]
+    lib.ubertooth_start.restype = ctypes.c_void_p
+    lib.ubertooth_check_api.argtypes = [ctypes.c_void_p]
+    lib.ubertooth_check_api.restype = ctypes.c_int
+    lib.ubertooth_stop.argtypes = [ctypes.c_void_p]
+    lib.ubertooth_stop.restype = None
+
+    lib.ubertooth_specan_start.argtypes = [ctypes.c_void_p, ctypes.c_uint16,
+                                           ctypes.c_uint16,
+                                           ctypes.POINTER(specan_config)]
+    lib.ubertooth_specan_start.restype = ctypes.c_void_p
+    lib.ubertooth_specan_bins.argtypes = [ctypes.c_void_p]
+    lib.ubertooth_specan_bins.restype = ctypes.c_uint
+    lib.ubertooth_specan_read.argtypes = [ctypes.c_void_p, ctypes.c_void_p,
+                                          ctypes.c_void_p, ctypes.c_uint,
+                                          ctypes.c_int]
+    lib.ubertooth_specan_read.restype = ctypes.c_int
+    lib.ubertooth_specan_dropped.argtypes = [ctypes.c_void_p]
+    lib.ubertooth_specan_dropped.restype = ctypes.c_uint64
+    lib.ubertooth_specan_stop.argtypes = [ctypes.c_void_p]
+    lib.ubertooth_specan_stop.restype = None
+    return lib
+
+
+_lib = None
+
+
+def library():
+    """Return the loaded libubertooth, raising OSError if it is missing."""
+    global _lib
+    if _lib is None:
+        _lib = _load()
+    return _lib
+
+
+class Specan(object):
+    """A running sweep from low_mhz to high_mhz inclusive.
+
+    ubertooth_device is an index, serial number or USB path as accepted
+    by the -U option of the command line tools, or -1 for the first
+    Ubertooth found.
+    """
+
+    def __init__(self, low_mhz, high_mhz, ubertooth_device=-1, step=1,
+                 samples=1, average=False, dwell_us=25):
+        self._ut = None
+        self._sp = None
+        lib = library()
+        self._lib = lib
+
+        if isinstance(ubertooth_device, str):
+            ubertooth_device = lib.ubertooth_select(ubertooth_device.encode())
+            if ubertooth_device < 0:
+                raise IOError("No such Ubertooth")
+
+        self._ut = lib.ubertooth_start(ubertooth_device)
+        if not self._ut:
+            raise IOError("Could not open Ubertooth device")
+        if lib.ubertooth_check_api(self._ut) < 0:
+            self.close()
+            raise IOError("Ubertooth firmware API mismatch")
+
+        cfg = specan_config(step=step, samples=samples,
+                            reduce=SPECAN_REDUCE_AVG if average else SPECAN_REDUCE_MAX,
+                            reserved=0, dwell=dwell_us * 10)
+        self._sp = lib.ubertooth_specan_start(self._ut, low_mhz, high_mhz,
+                                              ctypes.byref(cfg))
+        if not self._sp:
+            self.close()
+            raise IOError("Could not start spectrum analyzer")
+
+        self.bins = lib.ubertooth_specan_bins(self._sp)
+        self.frequency_axis = low_mhz + step * numpy.arange(self.bins)
+
+    def read(self, frames, clk100ns=None, timeout=-1):
+        """Fill rows of frames with complete sweeps.
+
+        frames is a C-contiguous int8 array of shape (n, bins) or
+        (bins,); clk100ns, if given, a uint32 array of n sweep start
+        times.  Blocks until every row is filled, or for at most
+        timeout seconds when timeout is not negative.  Returns the
+        number of rows filled, or -1 once the capture has stopped.
+        """
+        if frames.dtype != numpy.int8 or not frames.flags['C_CONTIGUOUS'] \
+                or frames.shape[-1] != self.bins:
+            raise ValueError("frames must be a contiguous int8 array of "
+                             "rows of %d bins" % self.bins)
+        count = frames.size // self.bins
+        clk_ptr = None
+        if clk100ns is not None:
+            if clk100ns.dtype != numpy.uint32 or clk100ns.size < count \
+                    or not clk100ns.flags['C_CONTIGUOUS']:
+                raise ValueError("clk100ns must be a contiguous uint32 array "
+                                 "of at least %d entries" % count)
+            clk_ptr = clk100ns.ctypes.data
+        timeout_ms = -1 if timeout < 0 else int(timeout * 1000)
+        return self._lib.ubertooth_specan_read(self._sp, frames.ctypes.data,
+                                               clk_ptr, count, timeout_ms)
+
+    @property
+    def dropped(self):
+        """Number of bins missing from the sweeps delivered so far."""
+        return self._lib.ubertooth_specan_dropped(self._sp) if self._sp else 0
+
+    def close(self):
+        if self._sp:
+            self._lib.ubertooth_specan_stop(self._sp)
+            self._sp = None
+        if self._ut:
+            self._lib.ubertooth_stop(self._ut)
+            self._ut = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
@@ -44,6 +44,7 @@ BTCTL_MONITOR_REQ	= 32
 # Device -> Host 
 BTCTL_RX_PKT		= 40
 BTCTL_STATE_RESP	= 41
+BTCTL_FLOW_IND		= 42
 
 # States
 BTCTL_STATE_STANDBY	= 0
@@ -778,6 +779,13 @@ class BTCtl:
 		t,msg =data[0], data[4:]
 		if t == BTCTL_DEBUG:
 			self._print_console(msg)
+		elif t == BTCTL_FLOW_IND:
+			congested, tx_drops, rx_drops, alloc_fail = unpack("<B3xIII", msg[:16])
+			# older firmware does not report skipped slots
+			slot_drops = unpack("<I", msg[16:20])[0] if len(msg) >= 20 else 0
+			log.warning("Device %s: %d tx drops, %d rx drops, %d alloc failures, %d slots skipped"%(
+				"congested" if congested else "recovered",
+				tx_drops, rx_drops, alloc_fail, slot_drops))
 		else:
 			if t == BTCTL_RX_PKT:
 				msg = BTCtlRxPkt.unpack(msg)
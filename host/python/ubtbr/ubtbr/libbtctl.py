@@ -0,0 +1,166 @@
+#
+# Copyright 2026 Great Scott Gadgets
+#
+# This file is part of Project Ubertooth.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+
+"""
+Native BTCTL transport
+
+Framing, reassembly and the bulk transfers are done by the BTCTL module
+of libubertooth, which keeps several multi-packet transfers in flight
+on its own libusb thread.  Python only sees whole messages, so inquiry,
+page and monitor results no longer pay a Python round trip for every
+64 byte USB packet.
+
+NativeBTCtl is a drop in replacement for BTCtl:
+
+    bt = NativeBTCtl.find()
+    bt.connect()
+"""
+
+import ctypes
+import ctypes.util
+
+from ubtbr.btctl import BTCtl, log
+
+
+class _btctl_callbacks(ctypes.Structure):
+	pass
+
+_RX_PKT_CB = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_void_p,
+	ctypes.c_void_p)
+_STATE_CB = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int,
+	ctypes.c_int, ctypes.c_void_p)
+_FLOW_CB = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_void_p,
+	ctypes.c_void_p)
+_DEBUG_CB = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_char_p,
+	ctypes.c_void_p)
+_MSG_CB = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_uint8,
+	ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t, ctypes.c_void_p)
+
+# the typed handlers stay NULL: every message but the debug text comes
+# through msg and is decoded by BTCtl._handle_msg as before
+_btctl_callbacks._fields_ = [
+	('rx_pkt', _RX_PKT_CB),
+	('state', _STATE_CB),
+	('flow', _FLOW_CB),
+	('debug', _DEBUG_CB),
+	('msg', _MSG_CB),
+	('user', ctypes.c_void_p),
+]
+
+
+def _load():
+	name = ctypes.util.find_library('ubertooth') or 'libubertooth.so.1'
+	lib = ctypes.CDLL(name)
+
+	lib.ubertooth_select.argtypes = [ctypes.c_char_p]
+	lib.ubertooth_select.restype = ctypes.c_int
+	lib.ubertooth_start.argtypes = [ctypes.c_int]
+	lib.ubertooth_start.restype = ctypes.c_void_p
+	lib.ubertooth_stop.argtypes = [ctypes.c_void_p]
+	lib.ubertooth_stop.restype = None
+	lib.ubertooth_bulk_thread_start.argtypes = []
+	lib.ubertooth_bulk_thread_start.restype = ctypes.c_int
+	lib.ubertooth_bulk_thread_stop.argtypes = []
+	lib.ubertooth_bulk_thread_stop.restype = None
+
+	lib.btctl_open.argtypes = [ctypes.c_void_p,
+		ctypes.POINTER(_btctl_callbacks)]
+	lib.btctl_open.restype = ctypes.c_void_p
+	lib.btctl_start.argtypes = [ctypes.c_void_p]
+	lib.btctl_start.restype = ctypes.c_int
+	lib.btctl_stop.argtypes = [ctypes.c_void_p]
+	lib.btctl_stop.restype = None
+	lib.btctl_close.argtypes = [ctypes.c_void_p]
+	lib.btctl_close.restype = None
+	lib.btctl_errors.argtypes = [ctypes.c_void_p]
+	lib.btctl_errors.restype = ctypes.c_uint
+	lib.btctl_send.argtypes = [ctypes.c_void_p, ctypes.c_uint8,
+		ctypes.c_char_p, ctypes.c_size_t]
+	lib.btctl_send.restype = ctypes.c_int
+	return lib
+
+
+class NativeBTCtl(BTCtl):
+	def __init__(self, lib, ut):
+		super().__init__(None)
+		self._lib = lib
+		self._ut = ut
+		self._bt = None
+		# keep the callbacks alive for as long as the library holds them
+		self._cbs = _btctl_callbacks(
+			debug=_DEBUG_CB(self._cb_debug),
+			msg=_MSG_CB(self._cb_msg))
+
+	@staticmethod
+	def find(ubertooth_device=-1):
+		"""Open an Ubertooth by index, serial number or USB path, as
+		accepted by the -U option of the command line tools."""
+		lib = _load()
+		if isinstance(ubertooth_device, str):
+			ubertooth_device = lib.ubertooth_select(ubertooth_device.encode())
+			if ubertooth_device < 0:
+				raise Exception("Ubertooth device not found")
+		ut = lib.ubertooth_start(ubertooth_device)
+		if not ut:
+			raise Exception("Ubertooth device not found")
+		return NativeBTCtl(lib, ut)
+
+	# called on the libusb thread
+	def _cb_debug(self, bt, msg, user):
+		self._print_console(msg)
+
+	def _cb_msg(self, bt, t, payload, length, user):
+		self._handle_msg(bytes((t, 0, 0, 0)) + ctypes.string_at(payload, length))
+
+	def connect(self):
+		if self.connected():
+			log.warning("Already connected")
+			return
+		self._bt = self._lib.btctl_open(self._ut, ctypes.byref(self._cbs))
+		if not self._bt:
+			raise Exception("Could not open BTCTL")
+		if self._lib.ubertooth_bulk_thread_start() != 0:
+			raise Exception("Could not start the USB thread")
+		if self._lib.btctl_start(self._bt) < 0:
+			self._lib.ubertooth_bulk_thread_stop()
+			raise Exception("Could not start BTCTL reception")
+		log.info("USB connected")
+		self._con = True
+		self.send_idle_cmd()
+
+	def close(self):
+		if not self.connected():
+			log.warning("Not connected")
+			return
+		self.send_idle_cmd()
+		self._lib.btctl_stop(self._bt)
+		self._lib.ubertooth_bulk_thread_stop()
+		errors = self._lib.btctl_errors(self._bt)
+		if errors:
+			log.warning("%d malformed packets dropped" % errors)
+		self._lib.btctl_close(self._bt)
+		self._bt = None
+		self._lib.ubertooth_stop(self._ut)
+		self._ut = None
+		self._con = False
+
+	def _send_cmd(self, t, data=b''):
+		if self._lib.btctl_send(self._bt, t, data, len(data)) < 0:
+			raise IOError("btctl_send failed")
@@ -120,3 +120,7 @@ static const uint32_t crc_table[] = {
 #define BOOTLOADER_SIZE 0x4000
 #define BLOCK_SIZE (1<<8)
 #define SECTOR_SIZE (1<<12)
+
+/* LPC17xx flash uses 4K sectors up to 0x10000 and 32K sectors above */
+#define LARGE_SECTOR_START 0x10000
+#define LARGE_SECTOR_SIZE (1<<15)
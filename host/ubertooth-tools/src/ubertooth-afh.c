@@ -46,7 +46,7 @@ static void usage()
 	printf("\t-t <seconds> timeout for initial AFH map detection (not required)\n");
 	printf("\t-e maximum access code errors (default: %d, range: 0-4)\n", max_ac_errors);
 	printf("\t-V print version information\n");
-	printf("\t-U <0-7> set ubertooth device to use\n");
+	printf("\t-U <0-7|serial|path> set ubertooth device to use\n");
 }
 
 int main(int argc, char* argv[])
@@ -86,7 +86,9 @@ int main(int argc, char* argv[])
 			timeout = atoi(optarg);
 			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'e':
 			max_ac_errors = atoi(optarg);
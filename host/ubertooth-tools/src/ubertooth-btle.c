@@ -104,6 +104,60 @@ int convert_mac_address(char *s, uint8_t *o, uint8_t *mask_out) {
 	return 1;
 }
 
+static void print_conn_stats(struct libusb_device_handle* devh)
+{
+	le_conn_stats stats[LE_MAX_CONNS];
+	uint32_t lost;
+	int i, n;
+
+	n = cmd_le_conn_stats(devh, stats, LE_MAX_CONNS);
+	for (i = 0; i < n; ++i) {
+		if (stats[i].access_address == 0)
+			continue;
+		lost = stats[i].missed + stats[i].empty;
+		fprintf(stderr, "connection %08x%s: %u events, %u missed, %u empty",
+				stats[i].access_address,
+				stats[i].active ? " (active)" : "",
+				stats[i].events, stats[i].missed, stats[i].empty);
+		if (stats[i].events > 0)
+			fprintf(stderr, " (%.1f%% lost)", 100.0 * lost / stats[i].events);
+		fprintf(stderr, "\n");
+	}
+}
+
+static void print_adv_stats(struct libusb_device_handle* devh)
+{
+	le_adv_stats stats;
+	le_adv_channel_stats *c;
+	int i;
+
+	if (cmd_le_adv_stats(devh, &stats) < 0)
+		return;
+
+	// only filled in while following a target
+	for (i = 0; i < 3; ++i)
+		if (stats.channel[i].adv || stats.channel[i].connect_reqs)
+			break;
+	if (i == 3)
+		return;
+
+	fprintf(stderr, "advertising order");
+	for (i = 0; i < stats.order_len; ++i)
+		fprintf(stderr, " %u", stats.order[i]);
+	if (stats.interval > 0)
+		fprintf(stderr, ", interval %.2f ms", stats.interval / 10000.0);
+	fprintf(stderr, "\n");
+
+	for (i = 0; i < 3; ++i) {
+		c = &stats.channel[i];
+		fprintf(stderr, "channel %d: %u adv, %u connect_req, %u/%u hops caught",
+				37 + i, c->adv, c->connect_reqs, c->hits, c->hops);
+		if (c->hops > 0)
+			fprintf(stderr, " (%.1f%%)", 100.0 * c->hits / c->hops);
+		fprintf(stderr, "\n");
+	}
+}
+
 static void usage(void)
 {
 	printf("ubertooth-btle - passive Bluetooth Low Energy monitoring\n");
@@ -114,18 +168,19 @@ static void usage(void)
 	printf("\t-f follow connections\n");
 	printf("\t-n don't follow, only print advertisements\n");
 	printf("\t-p promiscuous: sniff active connections\n");
+	printf("\t-P promiscuous, recovering connection parameters on the host\n");
 	printf("\n");
 	printf("\t-a[address] get/set access address (example: -a8e89bed6)\n");
 	printf("\t-s<address> faux slave mode, using MAC addr (example: -s22:44:66:88:aa:cc)\n");
 	printf("\t-t<address> set connection following target (example: -t22:44:66:88:aa:cc/48)\n");
 	printf("\t-tnone unset connection following target\n");
 	printf("\n");
-	printf("    Interference (use with -f or -p):\n");
+	printf("    Interference (use with -f, -p or -P):\n");
 	printf("\t-i interfere with one connection and return to idle\n");
 	printf("\t-I interfere continuously\n");
 	printf("\n");
 	printf("    Data source:\n");
-	printf("\t-U<0-7> set ubertooth device to use\n");
+	printf("\t-U<0-7|serial|path> set ubertooth device to use\n");
 	printf("\n");
 	printf("    Misc:\n");
 	printf("\t-r<filename> capture packets to PCAPNG file\n");
@@ -134,6 +189,7 @@ static void usage(void)
 	printf("\t-A<index> advertising channel index (default 37)\n");
 	printf("\t-v[01] verify CRC mode, get status or enable/disable\n");
 	printf("\t-x<n> allow n access address offenses (default 32)\n");
+	printf("\t-F<text|json|binary> write packets from an output thread in this format\n");
 
 	printf("\nIf an input file is not specified, an Ubertooth device is used for live capture.\n");
 	printf("In get/set mode no capture occurs.\n");
@@ -142,12 +198,13 @@ static void usage(void)
 int main(int argc, char *argv[])
 {
 	int opt;
-	int do_follow, do_no_follow, do_promisc;
+	int do_follow, do_no_follow, do_promisc, do_host_recover;
 	int do_get_aa, do_set_aa;
 	int do_crc;
 	int do_adv_index;
 	int do_slave_mode;
 	int do_target;
+	int sink_format = -1;
 	enum jam_modes jam_mode = JAM_NONE;
 	int ubertooth_device = -1;
 	ubertooth_t* ut = ubertooth_init();
@@ -159,13 +216,13 @@ int main(int argc, char *argv[])
 	uint8_t mac_address[6] = { 0, };
 	uint8_t mac_mask = 0;
 
-	do_follow = do_no_follow = do_promisc = 0;
+	do_follow = do_no_follow = do_promisc = do_host_recover = 0;
 	do_get_aa = do_set_aa = 0;
 	do_crc = -1; // 0 and 1 mean set, 2 means get
 	do_adv_index = 37;
 	do_slave_mode = do_target = 0;
 
-	while ((opt=getopt(argc,argv,"a::r:hfnpU:v::A:s:t:x:c:q:jJiI")) != EOF) {
+	while ((opt=getopt(argc,argv,"a::r:hfnpPU:v::A:s:t:x:c:q:jJiIF:")) != EOF) {
 		switch(opt) {
 		case 'a':
 			if (optarg == NULL) {
@@ -184,8 +241,14 @@ int main(int argc, char *argv[])
 		case 'p':
 			do_promisc = 1;
 			break;
+		case 'P':
+			do_promisc = 1;
+			do_host_recover = 1;
+			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'r':
 			if (!ut->h_pcapng_le) {
@@ -255,6 +318,14 @@ int main(int argc, char *argv[])
 				return 1;
 			}
 			break;
+		case 'F':
+			sink_format = ubertooth_sink_format(optarg);
+			if (sink_format < 0) {
+				printf("Error: output format must be text, json or binary\n");
+				usage();
+				return 1;
+			}
+			break;
 		case 'i':
 		case 'j':
 			jam_mode = JAM_ONCE;
@@ -311,8 +382,21 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	// CRC verification also applies to following, so set it first
+	if (do_crc >= 0) {
+		int r;
+		if (do_crc == 2) {
+			r = cmd_get_crc_verify(ut->devh);
+		} else {
+			cmd_set_crc_verify(ut->devh, do_crc);
+			r = do_crc;
+		}
+		printf("CRC: %sverify\n", r ? "" : "DO NOT ");
+	}
+
 	if (do_follow || do_no_follow || do_promisc) {
 		usb_pkt_rx rx;
+		le_recover recover;
 
 		r = cmd_set_jam_mode(ut->devh, jam_mode);
 		if (jam_mode != JAM_NONE && r != 0) {
@@ -331,10 +415,16 @@ int main(int argc, char *argv[])
 				channel = 2480;
 			cmd_set_channel(ut->devh, channel);
 			cmd_btle_sniffing(ut->devh, do_follow);
+		} else if (do_host_recover) {
+			le_recover_init(&recover);
+			cmd_btle_promisc_host(ut->devh);
 		} else {
 			cmd_btle_promisc(ut->devh);
 		}
 
+		if (sink_format >= 0 && ubertooth_sink_attach(ut, sink_format) < 0)
+			return 1;
+
 		// running can be changed by signal handler
 		while (running) {
 			if (cancel_follow) {
@@ -347,11 +437,17 @@ int main(int argc, char *argv[])
 				break;
 			}
 			if (r == sizeof(usb_pkt_rx)) {
+				if (do_host_recover)
+					le_recover_update(&recover, ut->devh, &rx);
 				fifo_push(ut->fifo, &rx);
 				cb_btle(ut, &cb_opts);
 			}
 			usleep(500);
 		}
+		if (do_follow) {
+			print_adv_stats(ut->devh);
+			print_conn_stats(ut->devh);
+		}
 		ubertooth_stop(ut);
 	}
 
@@ -366,17 +462,6 @@ int main(int argc, char *argv[])
 		printf("access address set to: %08x\n", access_address);
 	}
 
-	if (do_crc >= 0) {
-		int r;
-		if (do_crc == 2) {
-			r = cmd_get_crc_verify(ut->devh);
-		} else {
-			cmd_set_crc_verify(ut->devh, do_crc);
-			r = do_crc;
-		}
-		printf("CRC: %sverify\n", r ? "" : "DO NOT ");
-	}
-
 	if (do_slave_mode) {
 		u16 channel;
 		if (do_adv_index == 37)
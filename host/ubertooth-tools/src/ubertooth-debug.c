@@ -40,7 +40,7 @@ static void usage()
     printf("\t-h this message\n");
     printf("\t-r <reg>[,<reg>[,...]] read the contents of CC2400 register(s)\n");
     printf("\t-r <start>-<end> read a consecutive set of CC2400 register(s)\n");
-    printf("\t-U<0-7> set ubertooth device to use\n");
+    printf("\t-U<0-7|serial|path> set ubertooth device to use\n");
     printf("\t-v<0-2> verbosity (default=1)\n");
 }
 
@@ -79,7 +79,9 @@ int main(int argc, char *argv[])
 	    usage();
 	    return 0;
 	case 'U':
-	    ubertooth_device = atoi(optarg);
+	    ubertooth_device = ubertooth_select(optarg);
+	    if (ubertooth_device < 0)
+		return 1;
 	    break;
 	case 'v':
 	    verbose = atoi(optarg);
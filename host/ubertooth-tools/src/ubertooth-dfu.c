@@ -23,8 +23,10 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h> // strcasecmp
 #include <stdlib.h>
 #include <unistd.h>  // sleep
+#include <sys/time.h>
 #include "ubertooth.h"
 #include "dfu.h"
 
@@ -372,6 +374,463 @@ int download(libusb_device_handle* devh, FILE* downfile) {
 	return 0;
 }
 
+/*
+ * Batch mode - flash every attached (or serial-selected) Ubertooth at once
+ *
+ * Each device runs its own small state machine driven by asynchronous
+ * control transfers, so all devices progress in parallel from a single
+ * libusb event loop.  The bootloader erases a flash sector whenever a
+ * block is written to the start of that sector, so the image is compared
+ * and rewritten at sector granularity: sectors that already match the
+ * image are read back once and never erased.
+ */
+#define MAX_DFU_TARGETS 32
+#define MAX_SERIALS     32
+
+enum {
+	PHASE_COMPARE,
+	PHASE_WRITE,
+	PHASE_WRITE_STATUS,
+	PHASE_ABORT,
+	PHASE_VERIFY,
+	PHASE_DETACH,
+	PHASE_DONE
+};
+
+typedef struct {
+	int first_block;  // index into the image, in blocks
+	int num_blocks;
+} dfu_sector;
+
+typedef struct {
+	uint8_t* data;
+	int num_blocks;
+	dfu_sector* sectors;
+	int num_sectors;
+} dfu_image;
+
+typedef struct {
+	libusb_device_handle* devh;
+	struct libusb_transfer* xfer;
+	uint8_t buffer[LIBUSB_CONTROL_SETUP_SIZE + BLOCK_SIZE];
+	uint8_t bus;
+	uint8_t ports[7];
+	int num_ports;
+	char serial[33];
+	const dfu_image* image;
+	uint8_t* dirty;  // per sector
+	int phase;
+	int sector;
+	int block;
+	int written;
+	int reset;
+	const char* error;
+	struct timeval start, end;
+} dfu_target;
+
+static int active_targets = 0;
+
+static uint32_t sector_size(uint32_t address)
+{
+	return address < LARGE_SECTOR_START ? SECTOR_SIZE : LARGE_SECTOR_SIZE;
+}
+
+static int load_image(FILE* downfile, dfu_image* image)
+{
+	uint32_t address, size, length;
+	int i, n;
+
+	fseek(downfile, 0, SEEK_END);
+	length = ftell(downfile);
+	fseek(downfile, 0, SEEK_SET);
+
+	image->num_blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	image->data = malloc(image->num_blocks * BLOCK_SIZE);
+	if (image->data == NULL)
+		return -1;
+	memset(image->data, 0xff, image->num_blocks * BLOCK_SIZE);
+	if (fread(image->data, 1, length, downfile) != length)
+		return -1;
+
+	// Split the image on flash sector boundaries
+	n = 0;
+	address = BOOTLOADER_OFFSET + BOOTLOADER_SIZE;
+	for (i = 0; i < image->num_blocks; i += size / BLOCK_SIZE) {
+		size = sector_size(address);
+		address += size;
+		n++;
+	}
+	image->sectors = calloc(n, sizeof(dfu_sector));
+	if (image->sectors == NULL)
+		return -1;
+	image->num_sectors = n;
+
+	address = BOOTLOADER_OFFSET + BOOTLOADER_SIZE;
+	for (i = 0, n = 0; i < image->num_blocks; i += size / BLOCK_SIZE, n++) {
+		size = sector_size(address);
+		image->sectors[n].first_block = i;
+		image->sectors[n].num_blocks = size / BLOCK_SIZE;
+		if (i + image->sectors[n].num_blocks > image->num_blocks)
+			image->sectors[n].num_blocks = image->num_blocks - i;
+		address += size;
+	}
+	return 0;
+}
+
+static void format_location(const dfu_target* t, char* str, size_t len)
+{
+	int i, n;
+	n = snprintf(str, len, "%d-", t->bus);
+	for (i = 0; i < t->num_ports && n < (int) len; i++)
+		n += snprintf(str + n, len - n, i ? ".%d" : "%d", t->ports[i]);
+}
+
+static int same_location(libusb_device* dev, const dfu_target* t)
+{
+	uint8_t ports[7];
+	int n;
+
+	if (libusb_get_bus_number(dev) != t->bus)
+		return 0;
+	n = libusb_get_port_numbers(dev, ports, sizeof(ports));
+	return (n == t->num_ports) && (memcmp(ports, t->ports, n) == 0);
+}
+
+static void batch_finish(dfu_target* t, const char* error)
+{
+	t->error = error;
+	t->phase = PHASE_DONE;
+	gettimeofday(&t->end, NULL);
+	active_targets--;
+}
+
+static void batch_cb(struct libusb_transfer* xfer);
+
+static void batch_submit(dfu_target* t, uint8_t type, uint8_t request,
+                         uint16_t value, uint16_t length)
+{
+	int rv;
+
+	libusb_fill_control_setup(t->buffer, type, request, value, 0, length);
+	libusb_fill_control_transfer(t->xfer, t->devh, t->buffer, batch_cb, t, 1000);
+	rv = libusb_submit_transfer(t->xfer);
+	if (rv < 0)
+		batch_finish(t, "submit failed");
+}
+
+/* Issue the next request for this device */
+static void batch_step(dfu_target* t)
+{
+	const dfu_image* image = t->image;
+	int first_block = (BOOTLOADER_OFFSET + BOOTLOADER_SIZE) / BLOCK_SIZE;
+
+	switch (t->phase) {
+	case PHASE_COMPARE:
+		if (t->sector == image->num_sectors) {
+			// Write only the sectors that differ from the image
+			for (t->sector = 0; t->sector < image->num_sectors; t->sector++)
+				if (t->dirty[t->sector])
+					break;
+			if (t->sector == image->num_sectors) {
+				// Everything matched, the readback was the verify
+				t->phase = t->reset ? PHASE_DETACH : PHASE_DONE;
+				batch_step(t);
+				return;
+			}
+			t->block = image->sectors[t->sector].first_block;
+			t->phase = PHASE_WRITE;
+			batch_step(t);
+			return;
+		}
+		batch_submit(t, DFU_IN, REQ_UPLOAD, first_block + t->block, BLOCK_SIZE);
+		break;
+	case PHASE_WRITE:
+		memcpy(libusb_control_transfer_get_data(t->xfer),
+		       image->data + t->block * BLOCK_SIZE, BLOCK_SIZE);
+		batch_submit(t, DFU_OUT, REQ_DNLOAD, first_block + t->block, BLOCK_SIZE);
+		break;
+	case PHASE_WRITE_STATUS:
+		batch_submit(t, DFU_IN, REQ_GETSTATUS, 0, 6);
+		break;
+	case PHASE_ABORT:
+		// Leave dfuDNLOAD-IDLE so that uploads are accepted again
+		batch_submit(t, DFU_OUT, REQ_ABORT, 0, 0);
+		break;
+	case PHASE_VERIFY:
+		if (t->block == image->num_blocks) {
+			t->phase = t->reset ? PHASE_DETACH : PHASE_DONE;
+			batch_step(t);
+			return;
+		}
+		batch_submit(t, DFU_IN, REQ_UPLOAD, first_block + t->block, BLOCK_SIZE);
+		break;
+	case PHASE_DETACH:
+		batch_submit(t, DFU_OUT, REQ_DETACH, 0, 0);
+		break;
+	case PHASE_DONE:
+		batch_finish(t, NULL);
+		break;
+	}
+}
+
+static void batch_cb(struct libusb_transfer* xfer)
+{
+	dfu_target* t = xfer->user_data;
+	const dfu_image* image = t->image;
+	const dfu_sector* sector = &image->sectors[t->sector];
+	uint8_t* data = libusb_control_transfer_get_data(xfer);
+	int block_ok;
+
+	if (t->phase == PHASE_DETACH) {
+		// The device may drop off the bus before acknowledging
+		batch_finish(t, NULL);
+		return;
+	}
+	if (xfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		batch_finish(t, xfer->status == LIBUSB_TRANSFER_NO_DEVICE ?
+		             "device disconnected" : "transfer failed");
+		return;
+	}
+
+	switch (t->phase) {
+	case PHASE_COMPARE:
+		if (xfer->actual_length != BLOCK_SIZE) {
+			batch_finish(t, "short read");
+			return;
+		}
+		block_ok = memcmp(data, image->data + t->block * BLOCK_SIZE,
+		                  BLOCK_SIZE) == 0;
+		if (!block_ok)
+			t->dirty[t->sector] = 1;
+		if (!block_ok || ++t->block == sector->first_block + sector->num_blocks) {
+			t->sector++;
+			if (t->sector < image->num_sectors)
+				t->block = image->sectors[t->sector].first_block;
+		}
+		break;
+	case PHASE_WRITE:
+		t->phase = PHASE_WRITE_STATUS;
+		break;
+	case PHASE_WRITE_STATUS:
+		if (xfer->actual_length != 6 || data[0] != STATUS_OK) {
+			batch_finish(t, "write failed");
+			return;
+		}
+		t->phase = PHASE_WRITE;
+		if (++t->block == sector->first_block + sector->num_blocks) {
+			t->written++;
+			for (t->sector++; t->sector < image->num_sectors; t->sector++)
+				if (t->dirty[t->sector])
+					break;
+			if (t->sector == image->num_sectors)
+				t->phase = PHASE_ABORT;
+			else
+				t->block = image->sectors[t->sector].first_block;
+		}
+		break;
+	case PHASE_ABORT:
+		t->phase = PHASE_VERIFY;
+		t->block = 0;
+		break;
+	case PHASE_VERIFY:
+		if (xfer->actual_length != BLOCK_SIZE ||
+		    memcmp(data, image->data + t->block * BLOCK_SIZE, BLOCK_SIZE)) {
+			batch_finish(t, "verify failed");
+			return;
+		}
+		t->block++;
+		break;
+	}
+	batch_step(t);
+}
+
+/* Switch matching Ubertooths to DFU mode and note where they are plugged in */
+static int batch_find_targets(dfu_target* targets, char** serials, int num_serials)
+{
+	struct libusb_device **usb_list = NULL;
+	struct libusb_device_handle *devh = NULL;
+	struct libusb_device_descriptor desc;
+	uint8_t serial[17];
+	char serial_str[33];
+	int usb_devs, i, j, r, n = 0, is_dfu, selected;
+
+	usb_devs = libusb_get_device_list(NULL, &usb_list);
+	for (i = 0; i < usb_devs && n < MAX_DFU_TARGETS; ++i) {
+		r = libusb_get_device_descriptor(usb_list[i], &desc);
+		if (r < 0)
+			continue;
+		is_dfu = (desc.idVendor == TC13_VENDORID && desc.idProduct == TC13_PRODUCTID) ||
+		         (desc.idVendor == U1_DFU_VENDORID && desc.idProduct == U1_DFU_PRODUCTID);
+		if (!is_dfu &&
+		    !(desc.idVendor == U0_VENDORID && desc.idProduct == U0_PRODUCTID) &&
+		    !(desc.idVendor == U1_VENDORID && desc.idProduct == U1_PRODUCTID))
+			continue;
+
+		strcpy(serial_str, "-");
+		if (!is_dfu) {
+			r = libusb_open(usb_list[i], &devh);
+			if (r) {
+				show_libusb_error(r);
+				continue;
+			}
+			if (cmd_get_serial(devh, serial) == 0)
+				for (j = 0; j < 16; j++)
+					sprintf(serial_str + 2*j, "%02x", serial[j+1]);
+		}
+
+		// The bootloader has no serial number, so a serial
+		// filter only ever matches devices running firmware
+		selected = (num_serials == 0);
+		for (j = 0; j < num_serials; j++)
+			if (strcasecmp(serials[j], serial_str) == 0)
+				selected = 1;
+		if (!selected) {
+			if (!is_dfu)
+				libusb_close(devh);
+			continue;
+		}
+
+		memset(&targets[n], 0, sizeof(dfu_target));
+		targets[n].bus = libusb_get_bus_number(usb_list[i]);
+		targets[n].num_ports = libusb_get_port_numbers(usb_list[i],
+				targets[n].ports, sizeof(targets[n].ports));
+		strcpy(targets[n].serial, serial_str);
+		n++;
+
+		if (!is_dfu) {
+			cmd_flash(devh);
+			libusb_close(devh);
+		}
+	}
+	libusb_free_device_list(usb_list, 1);
+	return n;
+}
+
+/* Open the DFU device that reappeared at each target's port */
+static int batch_open_targets(dfu_target* targets, int num_targets)
+{
+	struct libusb_device **usb_list = NULL;
+	struct libusb_device_descriptor desc;
+	int usb_devs, i, j, r, missing = 0;
+
+	usb_devs = libusb_get_device_list(NULL, &usb_list);
+	for (i = 0; i < usb_devs; ++i) {
+		r = libusb_get_device_descriptor(usb_list[i], &desc);
+		if (r < 0)
+			continue;
+		if (!(desc.idVendor == TC13_VENDORID && desc.idProduct == TC13_PRODUCTID) &&
+		    !(desc.idVendor == U1_DFU_VENDORID && desc.idProduct == U1_DFU_PRODUCTID))
+			continue;
+		for (j = 0; j < num_targets; j++) {
+			if (targets[j].devh == NULL && same_location(usb_list[i], &targets[j])) {
+				r = libusb_open(usb_list[i], &targets[j].devh);
+				if (r)
+					show_libusb_error(r);
+				break;
+			}
+		}
+	}
+	libusb_free_device_list(usb_list, 1);
+
+	for (j = 0; j < num_targets; j++)
+		if (targets[j].devh == NULL)
+			missing++;
+	return missing;
+}
+
+int batch_download(FILE* downfile, char** serials, int num_serials, int reset)
+{
+	dfu_target targets[MAX_DFU_TARGETS];
+	dfu_image image;
+	char location[32];
+	double elapsed;
+	int num_targets, i, count = 0, failed = 0;
+
+	if (load_image(downfile, &image) < 0) {
+		fprintf(stderr, "Cannot load firmware image\n");
+		return 1;
+	}
+
+	libusb_init(NULL);
+	num_targets = batch_find_targets(targets, serials, num_serials);
+	if (num_targets == 0) {
+		fprintf(stderr, "Unable to find Ubertooth\n");
+		libusb_exit(NULL);
+		return 1;
+	}
+
+	fprintf(stdout, "Switching %d device%s to DFU mode...\n",
+	        num_targets, num_targets == 1 ? "" : "s");
+	while (batch_open_targets(targets, num_targets) && (count++) < 5)
+		sleep(1);
+
+	for (i = 0; i < num_targets; i++) {
+		dfu_target* t = &targets[i];
+		gettimeofday(&t->start, NULL);
+		t->end = t->start;
+		t->image = &image;
+		t->reset = reset;
+		t->phase = PHASE_DONE;
+		if (t->devh == NULL) {
+			t->error = "not in DFU mode";
+			continue;
+		}
+		if (libusb_claim_interface(t->devh, 0) < 0) {
+			t->error = "claim failed";
+			continue;
+		}
+		if (enter_dfu_mode(t->devh) < 0) {
+			t->error = "not in DFU mode";
+			continue;
+		}
+		t->xfer = libusb_alloc_transfer(0);
+		t->dirty = calloc(image.num_sectors, 1);
+		if (t->xfer == NULL || t->dirty == NULL) {
+			t->error = "out of memory";
+			continue;
+		}
+		t->phase = PHASE_COMPARE;
+		active_targets++;
+		batch_step(t);
+	}
+
+	fprintf(stdout, "Flashing %d device%s...\n",
+	        active_targets, active_targets == 1 ? "" : "s");
+	while (active_targets > 0)
+		libusb_handle_events(NULL);
+
+	fprintf(stdout, "\n%-12s %-32s %7s %7s %6s  %s\n",
+	        "Location", "Serial", "Written", "Skipped", "Time", "Result");
+	for (i = 0; i < num_targets; i++) {
+		dfu_target* t = &targets[i];
+		format_location(t, location, sizeof(location));
+		elapsed = (t->end.tv_sec - t->start.tv_sec) +
+		          (t->end.tv_usec - t->start.tv_usec) / 1e6;
+		fprintf(stdout, "%-12s %-32s %7d %7d %5.1fs  %s\n",
+		        location, t->serial, t->written,
+		        t->error ? 0 : image.num_sectors - t->written,
+		        elapsed, t->error ? t->error : "ok");
+		if (t->error)
+			failed++;
+
+		if (t->xfer)
+			libusb_free_transfer(t->xfer);
+		free(t->dirty);
+		if (t->devh) {
+			libusb_release_interface(t->devh, 0);
+			libusb_close(t->devh);
+		}
+	}
+	libusb_exit(NULL);
+	free(image.sectors);
+	free(image.data);
+
+	if (failed)
+		fprintf(stderr, "Firmware update failed on %d of %d devices\n",
+		        failed, num_targets);
+	return failed ? 1 : 0;
+}
+
 static int get_outfile(char *infile, char **outfile) {
 	char *suffix = strrchr(infile, '.');
 	if (suffix != NULL && strcmp(suffix, ".bin") == 0) {
@@ -393,20 +852,26 @@ static void usage()
 	printf("To update firmware, run:\n");
 	printf("\tubertooth-dfu -d bluetooth_rxtx.dfu -r\n");
 	printf("\n");
+	printf("To update every attached Ubertooth, run:\n");
+	printf("\tubertooth-dfu -d bluetooth_rxtx.dfu -a -r\n");
+	printf("\n");
 	printf("Usage:\n");
 	printf("\t-u <filename> upload - read firmware from device\n");
 	printf("\t-d <filename> download - write DFU file to device\n");
 	printf("\t-r reset Ubertooth after other operations complete\n");
+	printf("\t-a download to all attached Ubertooths concurrently\n");
+	printf("\t-S <serial> download only to this device (implies -a, may be repeated)\n");
 	printf("\n");
 	printf("Miscellaneous:\n");
 	printf("\t-s <filename> add DFU suffix to binary firmware file\n");
-	printf("\t-U <0-7> set ubertooth device to use\n");
+	printf("\t-U <0-7|serial|path> set ubertooth device to use\n");
 }
 
 #define FUNC_DOWNLOAD (1<<0)
 #define FUNC_UPLOAD   (1<<1)
 #define FUNC_SIGN     (1<<2)
 #define FUNC_RESET    (1<<3)
+#define FUNC_BATCH    (1<<4)
 
 int main(int argc, char **argv) {
 	FILE* downfile = NULL;
@@ -414,13 +879,15 @@ int main(int argc, char **argv) {
 	FILE* infile = NULL;
 	FILE* outfile = NULL;
 	char* outfile_name;
+	char* serials[MAX_SERIALS];
+	int num_serials = 0;
 	libusb_device_handle* devh = NULL;
 	uint8_t functions = 0;
 	int opt, ubertooth_device = -1;
 	int r;
 	ubertooth_t* ut = NULL;
 
-	while ((opt=getopt(argc,argv,"hd:u:s:rU:")) != EOF) {
+	while ((opt=getopt(argc,argv,"hd:u:s:raS:U:")) != EOF) {
 		switch(opt) {
 		case 'd':
 			downfile = fopen(optarg, "r+b");
@@ -460,8 +927,21 @@ int main(int argc, char **argv) {
 		case 'r':
 			functions |= FUNC_RESET;
 			break;
+		case 'a':
+			functions |= FUNC_BATCH;
+			break;
+		case 'S':
+			if (num_serials == MAX_SERIALS) {
+				fprintf(stderr, "Too many serial numbers\n");
+				return 1;
+			}
+			serials[num_serials++] = optarg;
+			functions |= FUNC_BATCH;
+			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		default:
 		case 'h':
@@ -476,6 +956,23 @@ int main(int argc, char **argv) {
 		fclose(outfile);
 	}
 
+	if(functions & FUNC_BATCH) {
+		int rv;
+		DFU_suffix suffix;
+		if((functions & FUNC_UPLOAD) || !(functions & FUNC_DOWNLOAD)) {
+			fprintf(stderr, "Batch mode requires -d and does not support -u\n");
+			return 1;
+		}
+		rv = check_suffix(downfile, &suffix);
+		if(rv) {
+			fprintf(stderr, "Signature check failed, firmware will not be update\n");
+			return rv;
+		}
+		rv = batch_download(downfile, serials, num_serials, functions & FUNC_RESET);
+		fclose(downfile);
+		return rv;
+	}
+
 	if(functions & (FUNC_UPLOAD|FUNC_DOWNLOAD|FUNC_RESET)) {
 		// Find Ubertooth and switch it to DFU mode
 		int rv, count= 0;
@@ -31,7 +31,10 @@ static void usage(void)
 	printf("\t-b only dump received bitstream (GnuRadio style)\n");
 	printf("\t-c classic modulation\n");
 	printf("\t-l LE modulation\n");
-	printf("\t-U<0-7> set ubertooth device to use\n");
+	printf("\t-s<sync word> capture packets after a 32 bit sync word (hex)\n");
+	printf("\t-f<MHz> frequency for -s (default: 2402)\n");
+	printf("\t-n<1-%d> bytes captured after the sync word (default: 32)\n", DMA_SIZE);
+	printf("\t-U<0-7|serial|path> set ubertooth device to use\n");
 	printf("\t-d filename\n");
 	printf("\nThis program sends binary data to stdout.  You probably don't want to\n");
 	printf("run it from a terminal without redirecting the output.\n");
@@ -43,19 +46,85 @@ static void usage(void)
  *
  * The -b output format is a stream of bytes, each either 0x00 or 0x01
  * representing the symbol determined by the demodulator (GnuRadio style)
+ *
+ * With -s the chunks are GENERIC_PACKETs: the bytes that followed the sync
+ * word, timestamped when it matched.
  */
 
+typedef struct {
+	uint32_t sync;
+	uint16_t freq;
+	uint8_t len;
+	int modulation;
+} generic_setup;
+
+/* Packet mode with sync word detection, as cc2400_rx_sync() in the
+ * firmware. Also replayed after a USB reset. */
+static int setup_generic(ubertooth_t* ut, void* args)
+{
+	generic_setup* s = (generic_setup*)args;
+	int le = s->modulation == MOD_BT_LOW_ENERGY;
+	static const struct {
+		uint8_t reg;
+		uint16_t val;
+	} regs[] = {
+		{ 0x0d, 0x7fff },  // MANAND
+		{ 0x12, 0x2b22 },  // LMTST
+		{ 0x14, 0x124b },  // MDMTST0, PRNG off
+	};
+	unsigned i;
+	int r;
+
+	r = cmd_set_channel(ut->devh, s->freq);
+	for (i = 0; r >= 0 && i < sizeof(regs) / sizeof(regs[0]); i++)
+		r = cmd_write_register(ut->devh, regs[i].reg, regs[i].val);
+	if (r >= 0) // GRMDM: un-buffered packet mode, 32 bit sync word
+		r = cmd_write_register(ut->devh, 0x20, le ? 0x0561 : 0x0461);
+	if (r >= 0) // SYNCL, SYNCH
+		r = cmd_write_register(ut->devh, 0x2c, s->sync & 0xffff);
+	if (r >= 0)
+		r = cmd_write_register(ut->devh, 0x2d, s->sync >> 16);
+	if (r >= 0) // FSDIV, 1 MHz IF
+		r = cmd_write_register(ut->devh, 0x02, s->freq - 1);
+	if (r >= 0) // MDMCTRL, frequency deviation
+		r = cmd_write_register(ut->devh, 0x03, le ? 0x0040 : 0x0029);
+	if (r >= 0)
+		r = cmd_rfcat_subcmd(ut->devh, RFCAT_CAP_LEN, &s->len, 1);
+	return r < 0 ? -1 : 0;
+}
+
+static int reattach_generic(ubertooth_t* ut, void* args)
+{
+	if (setup_generic(ut, args) < 0)
+		return -1;
+	return cmd_rx_generic(ut->devh);
+}
+
+/* Symbol dump: the modulation is all the setup there is */
+static int reattach_dump(ubertooth_t* ut, void* args)
+{
+	int r = cmd_set_modulation(ut->devh, *(int*)args);
+
+	if (r < 0)
+		return r;
+	return cmd_rx_syms(ut->devh);
+}
+
 int main(int argc, char *argv[])
 {
 	int opt;
 	int bitstream = 0;
 	int modulation = MOD_BT_BASIC_RATE;
 	int ubertooth_device = -1;
+	int generic = 0;
+	generic_setup setup = { 0, 2402, 32, 0 };
+	int len;
+	char* end;
 
 	ubertooth_t* ut = NULL;
 	int r;
 
-	while ((opt=getopt(argc,argv,"bhclU:d:")) != EOF) {
+	while ((opt=getopt(argc,argv,"bhclU:d:s:f:n:")) != EOF) {
 		switch(opt) {
 		case 'b':
 			bitstream = 1;
@@ -67,7 +136,30 @@ int main(int argc, char *argv[])
 			modulation = MOD_BT_LOW_ENERGY;
 			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
+			break;
+		case 's':
+			setup.sync = strtoul(optarg, &end, 16);
+			if (*end != '\0') {
+				printf("Invalid sync word\n");
+				usage();
+				return 1;
+			}
+			generic = 1;
+			break;
+		case 'f':
+			setup.freq = atoi(optarg);
+			break;
+		case 'n':
+			len = atoi(optarg);
+			if (len < 1 || len > DMA_SIZE) {
+				printf("Length must be in [1,%d]\n", DMA_SIZE);
+				usage();
+				return 1;
+			}
+			setup.len = len;
 			break;
 		case 'd':
 			dumpfile = fopen(optarg, "w");
@@ -98,7 +190,17 @@ int main(int argc, char *argv[])
 	register_cleanup_handler(ut, 0);
 
 	cmd_set_modulation(ut->devh, modulation);
-	rx_dump(ut, bitstream);
+	if (generic) {
+		setup.modulation = modulation;
+		if (setup_generic(ut, &setup) < 0)
+			return 1;
+		ubertooth_set_reattach(ut, reattach_generic, &setup);
+		if (rx_dump_generic(ut) < 0)
+			return 1;
+	} else {
+		ubertooth_set_reattach(ut, reattach_dump, &modulation);
+		rx_dump(ut, bitstream);
+	}
 
 	ubertooth_stop(ut);
 	return 0;
@@ -27,15 +27,6 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
-#include <signal.h>
-
-ubertooth_t* ut = NULL;
-int running = 1;
-
-void quit(int signo __attribute__((unused)))
-{
-	running = 0;
-}
 
 static void usage(void)
 {
@@ -50,23 +41,27 @@ static void usage(void)
 	printf("\n");
 	printf("    Options:\n");
 	printf("\t-c <2402-2480> set channel in MHz (for continuous rx)\n");
-	printf("\t-l <1-48> capture length (default: 18)\n");
+	printf("\t-l <1-%d> capture length (default: 18)\n", DMA_SIZE);
 	printf("\t-a <access_code> access code (default: 630f9ffe)\n");
+	printf("\t-F <text|json|binary> write packets from an output thread in this format\n");
 }
 
 int main(int argc, char *argv[])
 {
 	int opt;
+	ubertooth_t* ut = NULL;
 	int do_mode = -1;
 	int do_channel = 2418;
 	int ubertooth_device = -1;
-	uint8_t len = 18;
+	int len = 18;
+	uint8_t cap_len;
 	char *access_code_str = NULL;
 	uint8_t access_code[4];
 	int access_code_len;
+	int sink_format = -1;
 	int r;
 
-	while ((opt=getopt(argc,argv,"frijc:U:a:l:h")) != EOF) {
+	while ((opt=getopt(argc,argv,"frijc:U:a:l:F:h")) != EOF) {
 		switch(opt) {
 		case 'f':
 			do_mode = 0;
@@ -82,7 +77,9 @@ int main(int argc, char *argv[])
 			do_channel = atoi(optarg);
 			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'a':
 			access_code_str = strdup(optarg);
@@ -90,6 +87,14 @@ int main(int argc, char *argv[])
 		case 'l':
 			len = atoi(optarg);
 			break;
+		case 'F':
+			sink_format = ubertooth_sink_format(optarg);
+			if (sink_format < 0) {
+				printf("Output format must be text, json or binary\n");
+				usage();
+				return 1;
+			}
+			break;
 		case 'h':
 		default:
 			usage();
@@ -97,10 +102,12 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (len < 1 || len > 48) {
-		printf("Length must be in [1,48]\n");
+	if (len < 1 || len > DMA_SIZE) {
+		printf("Length must be in [1,%d]\n", DMA_SIZE);
 		usage();
+		return 1;
 	}
+	cap_len = len;
 
 	// access code
 	if (access_code_str != NULL) {
@@ -127,21 +134,25 @@ int main(int argc, char *argv[])
 	if (r < 0)
 		return 1;
 
-	// quit on ctrl-C
-	signal(SIGINT, quit);
-	signal(SIGQUIT, quit);
-	signal(SIGTERM, quit);
-
 	if (do_mode >= 0) {
-		usb_pkt_rx rx;
-
 		if (do_mode == 1) // FIXME magic number!
 			cmd_set_channel(ut->devh, do_channel);
 
 		if (access_code_str != NULL)
 			cmd_rfcat_subcmd(ut->devh, RFCAT_SET_AA, access_code, access_code_len);
 
-		cmd_rfcat_subcmd(ut->devh, RFCAT_CAP_LEN, &len, sizeof(len));
+		cmd_rfcat_subcmd(ut->devh, RFCAT_CAP_LEN, &cap_len, sizeof(cap_len));
+
+		/* Clean up on exit. */
+		register_cleanup_handler(ut, 0);
+
+		r = ubertooth_bulk_init(ut);
+		if (r < 0)
+			return 1;
+
+		r = ubertooth_bulk_thread_start();
+		if (r < 0)
+			return 1;
 
 		r = cmd_ego(ut->devh, do_mode);
 		if (r < 0) {
@@ -152,19 +163,14 @@ int main(int argc, char *argv[])
 			return 1;
 		}
 
-		// running set to 0 in signal handlers
-		while (running) {
-			int r = cmd_poll(ut->devh, &rx);
-			if (r < 0) {
-				printf("USB error\n");
-				break;
-			}
-			if (r == sizeof(usb_pkt_rx)) {
-				fifo_push(ut->fifo, &rx);
-				cb_ego(ut, &len);
-			}
-			usleep(500);
-		}
+		if (sink_format >= 0 && ubertooth_sink_attach(ut, sink_format) < 0)
+			return 1;
+
+		// packets arrive over bulk as they are captured
+		while (!ut->stop_ubertooth)
+			ubertooth_bulk_receive(ut, cb_ego, &cap_len);
+
+		ubertooth_bulk_thread_stop();
 		ubertooth_stop(ut);
 	}
 
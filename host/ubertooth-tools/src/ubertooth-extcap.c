@@ -0,0 +1,504 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "ubertooth.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/*
+ * Wireshark extcap for BLE sniffing
+ *
+ * Packets are read over bulk USB like the other streaming tools and
+ * written to the extcap FIFO as pcapng with the
+ * DLT_BLUETOOTH_LE_LL_WITH_PHDR pseudo-header. libbtbb's pcapng writer
+ * maps its file and seeks in it, which a FIFO does not allow, so the
+ * few blocks needed are written here.
+ */
+
+#define DLT_BLUETOOTH_LE_LL_WITH_PHDR 256
+
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+
+/* pseudo-header flags */
+#define LE_DEWHITENED        0x0001
+#define LE_SIGPOWER_VALID    0x0002
+#define LE_REF_AA_VALID      0x0010
+#define LE_CRC_CHECKED       0x0400
+#define LE_CRC_VALID         0x0800
+
+#define ADV_ACCESS_ADDRESS   0x8e89bed6
+
+#define OUT_BUF_LEN (64 * 1024)
+
+typedef struct {
+	int fd;
+	int batch;      // only write when the USB fifo runs dry
+	size_t len;
+	uint8_t buf[OUT_BUF_LEN];
+} pcapng_out;
+
+typedef struct {
+	uint16_t channel;
+	int follow;
+	int have_target;
+	uint8_t target[6];
+	uint8_t target_mask;
+} extcap_setup;
+
+typedef struct {
+	pcapng_out* out;
+	uint64_t start_us;   // wall clock of the first packet
+	uint64_t ticks;      // 100 ns ticks since the first packet
+	uint32_t last_clk100ns;
+	int have_clk;
+} extcap_capture;
+
+enum long_options {
+	OPT_INTERFACES = 256,
+	OPT_DLTS,
+	OPT_CONFIG,
+	OPT_CAPTURE,
+	OPT_INTERFACE,
+	OPT_FIFO,
+	OPT_VERSION,
+	OPT_FILTER,
+	OPT_CHANNEL,
+	OPT_NO_FOLLOW,
+	OPT_TARGET,
+	OPT_BATCH,
+};
+
+static const struct option long_opts[] = {
+	{ "extcap-interfaces",      no_argument,       NULL, OPT_INTERFACES },
+	{ "extcap-dlts",            no_argument,       NULL, OPT_DLTS },
+	{ "extcap-config",          no_argument,       NULL, OPT_CONFIG },
+	{ "capture",                no_argument,       NULL, OPT_CAPTURE },
+	{ "extcap-interface",       required_argument, NULL, OPT_INTERFACE },
+	{ "fifo",                   required_argument, NULL, OPT_FIFO },
+	{ "extcap-version",         optional_argument, NULL, OPT_VERSION },
+	{ "extcap-capture-filter",  required_argument, NULL, OPT_FILTER },
+	{ "channel",                required_argument, NULL, OPT_CHANNEL },
+	{ "no-follow",              no_argument,       NULL, OPT_NO_FOLLOW },
+	{ "target",                 required_argument, NULL, OPT_TARGET },
+	{ "batch",                  no_argument,       NULL, OPT_BATCH },
+	{ "help",                   no_argument,       NULL, 'h' },
+	{ NULL, 0, NULL, 0 }
+};
+
+static int out_flush(pcapng_out* out)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < out->len) {
+		r = write(out->fd, out->buf + done, out->len - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += r;
+	}
+	out->len = 0;
+	return 0;
+}
+
+/* Append a block made of body and data, data padded to 4 bytes */
+static int out_block(pcapng_out* out, uint32_t type,
+                     const void* body, size_t body_len,
+                     const void* data, size_t data_len)
+{
+	size_t padded = ((body_len + data_len + 3) & ~3u) - body_len;
+	uint32_t total = 12 + body_len + padded;
+	uint8_t* p;
+
+	if (out->len + total > sizeof(out->buf) && out_flush(out) < 0)
+		return -1;
+
+	p = out->buf + out->len;
+	memcpy(p, &type, 4);
+	memcpy(p + 4, &total, 4);
+	memcpy(p + 8, body, body_len);
+	if (data_len)
+		memcpy(p + 8 + body_len, data, data_len);
+	memset(p + 8 + body_len + data_len, 0, padded - data_len);
+	memcpy(p + total - 4, &total, 4);
+	out->len += total;
+
+	if (!out->batch)
+		return out_flush(out);
+	return 0;
+}
+
+static int write_header(pcapng_out* out)
+{
+	struct {
+		uint32_t magic;
+		uint16_t major;
+		uint16_t minor;
+		int64_t section_len;
+		uint32_t opt_end;
+	} __attribute__((packed)) shb = { 0x1a2b3c4d, 1, 0, -1, 0 };
+	struct {
+		uint16_t linktype;
+		uint16_t reserved;
+		uint32_t snaplen;
+		uint32_t opt_end;
+	} __attribute__((packed)) idb = { DLT_BLUETOOTH_LE_LL_WITH_PHDR, 0, 0, 0 };
+
+	if (out_block(out, PCAPNG_SHB, &shb, sizeof(shb), NULL, 0) < 0 ||
+	    out_block(out, PCAPNG_IDB, &idb, sizeof(idb), NULL, 0) < 0)
+		return -1;
+	return out_flush(out);
+}
+
+static uint64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Timestamp of a packet in us: the host clock at the first packet,
+ * advanced by the radio's 100 ns clock.  In LE sniffing that is T1TC,
+ * which wraps at 2^32, so the 32 bit difference is right across a wrap. */
+static uint64_t packet_time(extcap_capture* cap, uint32_t clk100ns)
+{
+	if (!cap->have_clk) {
+		cap->start_us = now_us();
+		cap->have_clk = 1;
+	} else {
+		cap->ticks += (uint32_t)(clk100ns - cap->last_clk100ns);
+	}
+	cap->last_clk100ns = clk100ns;
+	return cap->start_us + cap->ticks / 10;
+}
+
+static void cb_extcap_le(ubertooth_t* ut, void* args)
+{
+	extcap_capture* cap = (extcap_capture*)args;
+	usb_pkt_rx rx = fifo_pop(ut->fifo);
+	uint32_t access_address;
+	uint64_t ts;
+	unsigned len, caplen;
+	struct {
+		uint32_t interface;
+		uint32_t ts_high;
+		uint32_t ts_low;
+		uint32_t caplen;
+		uint32_t len;
+		// DLT_BLUETOOTH_LE_LL_WITH_PHDR
+		uint8_t rf_channel;
+		int8_t signal;
+		int8_t noise;
+		uint8_t aa_offenses;
+		uint32_t ref_access_address;
+		uint16_t flags;
+	} __attribute__((packed)) epb;
+
+	if (rx.pkt_type != LE_PACKET)
+		return;
+
+	memcpy(&access_address, rx.data, 4);
+	ts = packet_time(cap, rx.clk100ns);
+
+	// access address, header, payload and CRC
+	len = 4 + 2 + rx.data[5] + 3;
+	caplen = len > DMA_SIZE ? DMA_SIZE : len;
+
+	epb.interface = 0;
+	epb.ts_high = ts >> 32;
+	epb.ts_low = ts & 0xffffffff;
+	epb.caplen = 10 + caplen;
+	epb.len = 10 + len;
+	epb.rf_channel = rx.channel / 2;
+	epb.signal = rx.rssi_min - 54;
+	epb.noise = 0;
+	epb.aa_offenses = 0;
+	epb.ref_access_address = 0;
+	epb.flags = LE_DEWHITENED | LE_SIGPOWER_VALID | LE_CRC_CHECKED;
+	if (!(rx.status & CRC_ERROR))
+		epb.flags |= LE_CRC_VALID;
+	if (access_address == ADV_ACCESS_ADDRESS) {
+		epb.ref_access_address = ADV_ACCESS_ADDRESS;
+		epb.flags |= LE_REF_AA_VALID;
+	}
+
+	if (out_block(cap->out, PCAPNG_EPB, &epb, sizeof(epb), rx.data, caplen) < 0)
+		ut->stop_ubertooth = 1;
+}
+
+/* Put the radio into BLE sniffing, also after it was re-attached */
+static int setup_le(ubertooth_t* ut, void* args)
+{
+	extcap_setup* setup = (extcap_setup*)args;
+	uint8_t none[6] = { 0, };
+	int r;
+
+	cmd_set_modulation(ut->devh, MOD_BT_LOW_ENERGY);
+
+	// the target persists on the device, clear one left behind
+	if (setup->have_target)
+		r = cmd_btle_set_target(ut->devh, setup->target, setup->target_mask);
+	else
+		r = cmd_btle_set_target(ut->devh, none, 0);
+	if (r < 0)
+		return r;
+
+	r = cmd_set_channel(ut->devh, setup->channel);
+	if (r < 0)
+		return r;
+	return cmd_btle_sniffing(ut->devh, setup->follow);
+}
+
+/* BD ADDR with an optional /mask length, as with ubertooth-btle -t */
+static int parse_target(const char* s, extcap_setup* setup)
+{
+	unsigned b[6], mask = 48;
+	char tail[8];
+	int i, n;
+
+	n = sscanf(s, "%2x:%2x:%2x:%2x:%2x:%2x%7s",
+	           &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], tail);
+	if (n < 6)
+		return -1;
+	if (n == 7 && (sscanf(tail, "/%u", &mask) != 1 || mask > 48))
+		return -1;
+
+	for (i = 0; i < 6; ++i)
+		setup->target[i] = b[i];
+	setup->target_mask = mask;
+	setup->have_target = 1;
+	return 0;
+}
+
+static void list_interfaces(void)
+{
+	unsigned i, n = ubertooth_count();
+	const char* serial;
+
+	for (i = 0; i < n; ++i) {
+		serial = ubertooth_serial(i);
+		printf("interface {value=ubertooth%u}{display=Ubertooth %s}\n",
+		       i, serial[0] ? serial : "(serial unknown)");
+	}
+}
+
+static void list_dlts(void)
+{
+	printf("dlt {number=%d}{name=BLUETOOTH_LE_LL_WITH_PHDR}{display=Bluetooth Low Energy Link Layer}\n",
+	       DLT_BLUETOOTH_LE_LL_WITH_PHDR);
+}
+
+static void list_config(void)
+{
+	printf("arg {number=0}{call=--channel}{display=Advertising channel}{type=selector}"
+	       "{tooltip=Advertising channel to wait for connections on}\n");
+	printf("value {arg=0}{value=37}{display=37}{default=true}\n");
+	printf("value {arg=0}{value=38}{display=38}{default=false}\n");
+	printf("value {arg=0}{value=39}{display=39}{default=false}\n");
+	printf("arg {number=1}{call=--no-follow}{display=Advertisements only}{type=boolflag}"
+	       "{tooltip=Do not follow connections}\n");
+	printf("arg {number=2}{call=--target}{display=Target BD ADDR}{type=string}"
+	       "{tooltip=Only capture this device, optionally with a mask length, e.g. 22:44:66:88:aa:cc/48}"
+	       "{validation=^([0-9a-fA-F]{2}:){5}[0-9a-fA-F]{2}(/[0-9]+)?$}\n");
+	printf("arg {number=3}{call=--batch}{display=Batch writes}{type=boolflag}"
+	       "{tooltip=Write packets in batches instead of one at a time}\n");
+}
+
+static void usage(FILE* file)
+{
+	fprintf(file, "ubertooth-extcap - Wireshark extcap for BLE sniffing\n");
+	fprintf(file, "Usage:\n");
+	fprintf(file, "\t--extcap-interfaces list Ubertooth devices\n");
+	fprintf(file, "\t--extcap-interface=ubertooth<N> --extcap-dlts list link types\n");
+	fprintf(file, "\t--extcap-interface=ubertooth<N> --extcap-config list options\n");
+	fprintf(file, "\t--extcap-interface=ubertooth<N> --capture --fifo=<path> capture\n");
+	fprintf(file, "\n");
+	fprintf(file, "Capture options:\n");
+	fprintf(file, "\t--channel=<37|38|39> advertising channel (default 37)\n");
+	fprintf(file, "\t--no-follow only capture advertisements\n");
+	fprintf(file, "\t--target=<address>[/mask] only capture this device\n");
+	fprintf(file, "\t--batch write packets in batches instead of one at a time\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int opt, r;
+	int do_interfaces = 0, do_dlts = 0, do_config = 0, do_capture = 0;
+	const char* interface = NULL;
+	const char* fifo = NULL;
+	int channel = 37;
+	int batch = 0;
+	int ubertooth_device;
+	extcap_setup setup = { .follow = 1 };
+	extcap_capture cap = { 0, };
+	pcapng_out* out;
+	ubertooth_t* ut;
+
+	while ((opt = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case OPT_INTERFACES:
+			do_interfaces = 1;
+			break;
+		case OPT_DLTS:
+			do_dlts = 1;
+			break;
+		case OPT_CONFIG:
+			do_config = 1;
+			break;
+		case OPT_CAPTURE:
+			do_capture = 1;
+			break;
+		case OPT_INTERFACE:
+			interface = optarg;
+			break;
+		case OPT_FIFO:
+			fifo = optarg;
+			break;
+		case OPT_VERSION:
+		case OPT_FILTER:
+			break;
+		case OPT_CHANNEL:
+			channel = atoi(optarg);
+			if (channel < 37 || channel > 39) {
+				fprintf(stderr, "Advertising channel must be 37, 38 or 39\n");
+				return 1;
+			}
+			break;
+		case OPT_NO_FOLLOW:
+			setup.follow = 0;
+			break;
+		case OPT_TARGET:
+			if (parse_target(optarg, &setup) < 0) {
+				fprintf(stderr, "Invalid target '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		case OPT_BATCH:
+			batch = 1;
+			break;
+		case 'h':
+			usage(stdout);
+			return 0;
+		default:
+			usage(stderr);
+			return 1;
+		}
+	}
+
+	if (do_interfaces) {
+		list_interfaces();
+		return 0;
+	}
+
+	// everything else is about one interface
+	if (interface == NULL || strncmp(interface, "ubertooth", 9) != 0) {
+		usage(stderr);
+		return 1;
+	}
+
+	if (do_dlts) {
+		list_dlts();
+		return 0;
+	}
+	if (do_config) {
+		list_config();
+		return 0;
+	}
+	if (!do_capture || fifo == NULL) {
+		usage(stderr);
+		return 1;
+	}
+
+	ubertooth_device = ubertooth_select(interface + 9);
+	if (ubertooth_device < 0)
+		return 1;
+
+	out = (pcapng_out*)calloc(1, sizeof(pcapng_out));
+	if (out == NULL)
+		return 1;
+	out->batch = batch;
+	cap.out = out;
+
+	// Wireshark closing the FIFO ends the capture through EPIPE
+	signal(SIGPIPE, SIG_IGN);
+	out->fd = open(fifo, O_WRONLY);
+	if (out->fd < 0) {
+		perror(fifo);
+		return 1;
+	}
+	if (write_header(out) < 0) {
+		perror(fifo);
+		return 1;
+	}
+
+	ut = ubertooth_start(ubertooth_device);
+	if (ut == NULL)
+		return 1;
+
+	r = ubertooth_check_api(ut);
+	if (r < 0)
+		return 1;
+
+	/* Clean up on exit. */
+	register_cleanup_handler(ut, 0);
+
+	setup.channel = channel == 37 ? 2402 : channel == 38 ? 2426 : 2480;
+
+	r = ubertooth_bulk_init(ut);
+	if (r < 0)
+		return 1;
+
+	r = ubertooth_bulk_thread_start();
+	if (r < 0)
+		return 1;
+
+	r = setup_le(ut, &setup);
+	if (r < 0)
+		return 1;
+	ubertooth_set_reattach(ut, setup_le, &setup);
+
+	// write as soon as packets arrive, batches once the fifo runs dry
+	while (!ut->stop_ubertooth) {
+		ubertooth_bulk_receive(ut, cb_extcap_le, &cap);
+		if (out->len && fifo_empty(ut->fifo) && out_flush(out) < 0)
+			ut->stop_ubertooth = 1;
+	}
+
+	ubertooth_bulk_thread_stop();
+	ubertooth_stop(ut);
+
+	out_flush(out);
+	close(out->fd);
+	free(out);
+
+	return 0;
+}
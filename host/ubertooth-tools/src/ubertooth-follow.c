@@ -40,7 +40,7 @@ static void usage()
 	printf("\t-h this help\n");
 	printf("\t-l<LAP> (in hexadecimal)\n");
 	printf("\t-u<UAP> (in hexadecimal)\n");
-	printf("\t-U<0-7> set ubertooth device to use\n");
+	printf("\t-U<0-7|serial|path> set ubertooth device to use\n");
 	printf("\t-r<filename> capture packets to PCAPNG file\n");
 	printf("\t-q<filename> capture packets to PCAP file\n");
 	printf("\t-e max_ac_errors\n");
@@ -88,7 +88,9 @@ int main(int argc, char *argv[])
 			}
 			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'r':
 			if (!ut->h_pcapng_bredr) {
@@ -21,10 +21,12 @@
 
 #include "ubertooth.h"
 #include "ubertooth_callback.h"
+#include "ubertooth_daemon.h"
 #include <err.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 static void usage()
 {
@@ -40,7 +42,7 @@ static void usage()
 	printf("\t-l <LAP> to decode (6 hex) - if not specified sniff all LAPs\n");
 	printf("\t-u <UAP> to decode (2 hex) - if not specified calculate UAP (requires LAP)\n");
 	printf("\t-z Survey mode - discover and list piconets (implies -s, interrupt with ctrl-C)\n");
-	printf("\t-i <filename> input file - if not specified use Ubertooth for live capture\n");
+	printf("\t-i <filename> input file or ubertoothd socket - if not specified use Ubertooth for live capture\n");
 	printf("\n");
 	printf("Configuration:\n");
 	printf("\t-c <BT Channel> set a fixed bluetooth channel [Default: 39]\n");
@@ -51,10 +53,28 @@ static void usage()
 	printf("\t-r<filename> capture packets to PcapNG file\n");
 	printf("\t-q<filename> capture packets to PCAP file\n");
 	printf("\t-d<filename> dump packets to binary file\n");
+	printf("\t-F<text|json|binary> write packets from an output thread in this format\n");
 	printf("\n");
 	printf("Miscellaneous:\n");
 	printf("\t-V print version information\n");
-	printf("\t-U <0-7> set ubertooth device to use\n");
+	printf("\t-U <0-7|serial|path> set ubertooth device to use\n");
+}
+
+typedef struct {
+	uint16_t channel;
+	btbb_piconet* pn;
+	int have_uap;
+} rx_setup;
+
+/* Replay the capture setup after the Ubertooth is re-attached */
+static int reattach_rx(ubertooth_t* ut, void* args)
+{
+	rx_setup* setup = (rx_setup*)args;
+
+	if (setup->have_uap)
+		cmd_set_bdaddr(ut->devh, btbb_piconet_get_bdaddr(setup->pn));
+	cmd_set_channel(ut->devh, setup->channel);
+	return cmd_rx_syms(ut->devh);
 }
 
 int main(int argc, char* argv[])
@@ -69,13 +89,22 @@ int main(int argc, char* argv[])
 	uint32_t lap = 0;
 	uint8_t uap = 0;
 	uint16_t channel = 9999;
+	rx_setup setup;
+	ubertoothd_filter filter;
+	struct stat st;
+	int sink_format = -1;
 
 	ubertooth_t* ut = ubertooth_init();
 
-	while ((opt=getopt(argc,argv,"hVi:l:u:U:d:e:r:sq:t:zc:")) != EOF) {
+	while ((opt=getopt(argc,argv,"hVi:l:u:U:d:e:r:sq:t:zc:F:")) != EOF) {
 		switch(opt) {
 		case 'i':
-			infile = fopen(optarg, "r");
+			if (stat(optarg, &st) == 0 && S_ISSOCK(st.st_mode)) {
+				ubertoothd_filter_init(&filter);
+				filter.pkt_types = 1 << BR_PACKET;
+				infile = ubertoothd_open(optarg, &filter);
+			} else
+				infile = fopen(optarg, "r");
 			if (infile == NULL) {
 				printf("Could not open file %s\n", optarg);
 				usage();
@@ -91,7 +120,9 @@ int main(int argc, char* argv[])
 			have_uap++;
 			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'r':
 			if (!ut->h_pcapng_bredr) {
@@ -123,6 +154,14 @@ int main(int argc, char* argv[])
 		case 'e':
 			max_ac_errors = atoi(optarg);
 			break;
+		case 'F':
+			sink_format = ubertooth_sink_format(optarg);
+			if (sink_format < 0) {
+				printf("Output format must be text, json or binary\n");
+				usage();
+				return 1;
+			}
+			break;
 		case 's':
 			fprintf(stderr, "sweep mode is now the default and the -s argument is deprecated\n");
 			break;
@@ -192,6 +231,9 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (sink_format >= 0 && ubertooth_sink_attach(ut, sink_format) < 0)
+		return 1;
+
 	if (infile == NULL) {
 		cmd_set_channel(ut->devh, channel);
 
@@ -201,6 +243,11 @@ int main(int argc, char* argv[])
 		if (timeout)
 			ubertooth_set_timeout(ut, timeout);
 
+		setup.channel = channel;
+		setup.pn = pn;
+		setup.have_uap = have_lap && have_uap;
+		ubertooth_set_reattach(ut, reattach_rx, &setup);
+
 		// init USB transfer
 		r = ubertooth_bulk_init(ut);
 		if (r < 0)
@@ -226,6 +273,7 @@ int main(int argc, char* argv[])
 	} else {
 		stream_rx_file(ut, infile, cb_rx, pn);
 		fclose(infile);
+		ubertooth_sink_detach(ut);
 	}
 
 	if(survey_mode) {
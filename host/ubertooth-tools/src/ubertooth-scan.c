@@ -59,7 +59,7 @@ static void usage()
 	printf("\t-t scan Time (seconds) - length of time to sniff packets. [Default: 20s]\n");
 	printf("\t-e max_ac_errors (default: %d, range: 0-4)\n", max_ac_errors);
 	printf("\t-b Bluetooth device (hci0)\n");
-	printf("\t-U<0-7> set Ubertooth device to use\n");
+	printf("\t-U<0-7|serial|path> set Ubertooth device to use\n");
 }
 
 
@@ -208,7 +208,9 @@ int main(int argc, char *argv[])
 	while ((opt=getopt(argc,argv,"hU:t:e:xsb:")) != EOF) {
 		switch(opt) {
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'b':
 			bt_dev = optarg;
@@ -21,10 +21,28 @@
 
 #include <getopt.h>
 #include <stdlib.h>
+#include <time.h>
 #include "ubertooth.h"
 
 uint8_t debug;
 
+/* -d: raw (frequency, rssi) triplets */
+static int specan_file_output(uint16_t frequency, int8_t rssi)
+{
+	uint8_t triplet[3];
+	int r;
+
+	triplet[0] = frequency >> 8;
+	triplet[1] = frequency & 0xff;
+	triplet[2] = (uint8_t)rssi;
+	r = fwrite(triplet, 1, 3, dumpfile);
+	if(r != 3) {
+		fprintf(stderr, "Error writing to file (%d)\n", r);
+		return -1;
+	}
+	return 0;
+}
+
 void cb_specan(ubertooth_t* ut __attribute__((unused)), void* args)
 {
 	uint16_t high_freq = (((uint8_t*)args)[0]) |
@@ -32,45 +50,44 @@ void cb_specan(ubertooth_t* ut __attribute__((unused)), void* args)
 	uint8_t output_mode = ((uint8_t*)args)[2];
 
 	usb_pkt_rx rx = fifo_pop(ut->fifo);
-	int r, j;
+	int j, bins;
 	uint16_t frequency;
-	int8_t rssi;
+	uint8_t step;
+	sink_record* rec;
+
+	/* text modes are formatted by the output sink */
+	if (output_mode != SPECAN_FILE) {
+		rec = ubertooth_record_claim(ut);
+		if (rec) {
+			rec->type = SINK_SPECAN;
+			rec->specan_mode = output_mode;
+			rec->len = high_freq;
+			rec->systime = (uint32_t)time(NULL);
+			rec->pkt = rx;
+			ubertooth_record_commit(ut, rec);
+		}
+		return;
+	}
 
 	/* process each received block */
-	for (j = 0; j < DMA_SIZE-2; j += 3) {
-		frequency = (rx.data[j] << 8) | rx.data[j + 1];
-		rssi = (int8_t)rx.data[j + 2];
-		switch(output_mode) {
-			case SPECAN_FILE:
-				r = fwrite(&rx.data[j], 1, 3, dumpfile);
-				if(r != 3) {
-					fprintf(stderr, "Error writing to file (%d)\n", r);
-					return;
-				}
-				break;
-			case SPECAN_STDOUT:
-				printf("%f, %d, %d\n", ((double)rx.clk100ns)/10000000,
-				       frequency, rssi);
-				break;
-			case SPECAN_GNUPLOT_NORMAL:
-				printf("%d %d\n", frequency, rssi);
-				if(frequency == high_freq)
-					printf("\n");
-				break;
-			case SPECAN_GNUPLOT_3D:
-				printf("%f %d %d\n", ((double)rx.clk100ns)/10000000,
-				       frequency, rssi);
-				if(frequency == high_freq)
-					printf("\n");
-				break;
-			default:
-				fprintf(stderr, "Unrecognised output mode (%d)\n",
-				        output_mode);
+	if (rx.pkt_type == SPECAN_FRAME) {
+		frequency = (rx.data[0] << 8) | rx.data[1];
+		step = rx.data[2];
+		bins = rx.data[3];
+		if (bins > SPECAN_FRAME_BINS)
+			bins = SPECAN_FRAME_BINS;
+		for (j = 0; j < bins; j++, frequency += step) {
+			if (specan_file_output(frequency,
+			                       (int8_t)rx.data[SPECAN_FRAME_HDR + j]) < 0)
+				return;
+		}
+	} else {
+		for (j = 0; j < DMA_SIZE-2; j += 3) {
+			frequency = (rx.data[j] << 8) | rx.data[j + 1];
+			if (specan_file_output(frequency, (int8_t)rx.data[j + 2]) < 0)
 				return;
-				break;
 		}
 	}
-	fflush(stderr);
 }
 
 static void usage(FILE *file)
@@ -87,9 +104,38 @@ static void usage(FILE *file)
 	fprintf(file, "\t-g output suitable for feedgnuplot\n");
 	fprintf(file, "\t-G output suitable for 3D feedgnuplot\n");
 	fprintf(file, "\t-d <filename> output to file\n");
+	fprintf(file, "\t-F <text|json|binary> write sweeps from an output thread in this format\n");
 	fprintf(file, "\t-l lower frequency (default 2402)\n");
 	fprintf(file, "\t-u upper frequency (default 2480)\n");
-	fprintf(file, "\t-U<0-7> set ubertooth device to use\n");
+	fprintf(file, "\t-s<1-255> step between bins in MHz (default 1)\n");
+	fprintf(file, "\t-w<us> dwell time per bin in microseconds (default 25)\n");
+	fprintf(file, "\t-n<1-%d> RSSI samples per bin (default 1)\n", SPECAN_MAX_SAMPLES);
+	fprintf(file, "\t-a average samples instead of taking the maximum\n");
+	fprintf(file, "\t-U<0-7|serial|path> set ubertooth device to use\n");
+}
+
+typedef struct {
+	specan_config* cfg;
+	uint16_t lower;
+	uint16_t upper;
+} specan_setup;
+
+/* Configure the sweep and start it. Firmware without
+ * UBERTOOTH_SPECAN_CONFIG stalls the request; it is then left to sweep
+ * with its defaults and send triplets, which cb_specan also handles. */
+static int start_specan(ubertooth_t* ut, void* args)
+{
+	specan_setup* setup = (specan_setup*)args;
+	int r;
+
+	r = cmd_specan_config(ut->devh, setup->cfg);
+	if (r == LIBUSB_ERROR_PIPE) {
+		fprintf(stderr, "Firmware does not support sweep configuration, "
+		        "ignoring -s, -w, -n and -a\n");
+	} else if (r < 0) {
+		return r;
+	}
+	return cmd_specan(ut->devh, setup->lower, setup->upper);
 }
 
 int main(int argc, char *argv[])
@@ -97,10 +143,17 @@ int main(int argc, char *argv[])
 	int opt, r = 0, output_mode = SPECAN_STDOUT;
 	int lower= 2402, upper= 2480;
 	int ubertooth_device = -1;
+	int step = 1, dwell = 25, samples = 1;
+	specan_config cfg;
+	specan_setup setup;
+	int sink_format = -1;
 
 	ubertooth_t* ut = NULL;
 
-	while ((opt=getopt(argc,argv,"vhgGd:l::u::U:")) != EOF) {
+	cfg.reduce = SPECAN_REDUCE_MAX;
+	cfg.reserved = 0;
+
+	while ((opt=getopt(argc,argv,"vhgGd:l::u::s:w:n:aU:F:")) != EOF) {
 		switch(opt) {
 		case 'v':
 			debug++;
@@ -135,8 +188,29 @@ int main(int argc, char *argv[])
 			else
 				printf("upper: %d\n", upper);
 			break;
+		case 's':
+			step = atoi(optarg);
+			break;
+		case 'w':
+			dwell = atoi(optarg);
+			break;
+		case 'n':
+			samples = atoi(optarg);
+			break;
+		case 'a':
+			cfg.reduce = SPECAN_REDUCE_AVG;
+			break;
+		case 'F':
+			sink_format = ubertooth_sink_format(optarg);
+			if (sink_format < 0) {
+				usage(stderr);
+				return 1;
+			}
+			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'h':
 			usage(stdout);
@@ -147,6 +221,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (step < 1 || step > 255 || samples < 1 || samples > SPECAN_MAX_SAMPLES
+	    || dwell < 0 || dwell > 6553) {
+		usage(stderr);
+		return 1;
+	}
+	cfg.step = step;
+	cfg.samples = samples;
+	cfg.dwell = dwell * 10;
+
 	ut = ubertooth_start(ubertooth_device);
 
 	if (ut == NULL) {
@@ -154,7 +237,9 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	r = ubertooth_check_api(ut);
+	/* the sweep falls back to triplets on firmware predating
+	 * UBERTOOTH_SPECAN_CONFIG, see start_specan() */
+	r = ubertooth_check_api_min(ut, 0x0107);
 	if (r < 0)
 		return 1;
 
@@ -177,10 +262,20 @@ int main(int argc, char *argv[])
 		return r;
 
 	// tell ubertooth to start specan and send packets
-	r = cmd_specan(ut->devh, lower, upper);
+	setup.cfg = &cfg;
+	setup.lower = lower;
+	setup.upper = upper;
+	r = start_specan(ut, &setup);
 	if (r < 0)
 		return r;
 
+	// replay the sweep setup after the Ubertooth is re-attached
+	ubertooth_set_reattach(ut, start_specan, &setup);
+
+	if (sink_format >= 0 && output_mode != SPECAN_FILE &&
+	    ubertooth_sink_attach(ut, sink_format) < 0)
+		return 1;
+
 	// receive and process each packet
 	while(!ut->stop_ubertooth) {
 		ubertooth_bulk_receive(ut, cb_specan, specan_args);
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "ubertooth.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char* drop_reasons[] = {
+	[TRACE_DROP_QUEUE_FULL] = "queue full",
+	[TRACE_DROP_SQUELCH]    = "squelch",
+	[TRACE_DROP_CRC]        = "crc",
+};
+
+/* trace_event.time is a 32-bit count of 100 ns ticks and wraps after
+ * about seven minutes, extend it to 64 bits across reads. */
+static uint64_t last_time = 0;
+static uint32_t last_raw = 0;
+static uint64_t first_time = 0;
+static int have_time = 0;
+
+static void print_event(trace_event* ev)
+{
+	uint64_t time, delta;
+
+	if (have_time) {
+		time = last_time + (uint32_t)(ev->time - last_raw);
+		delta = time - last_time;
+	} else {
+		time = first_time = ev->time;
+		delta = 0;
+		have_time = 1;
+	}
+	last_time = time;
+	last_raw = ev->time;
+
+	time -= first_time;
+	printf("%10" PRIu64 ".%" PRIu64 " +%7" PRIu64 ".%" PRIu64 " ",
+	       time / 10, time % 10, delta / 10, delta % 10);
+
+	switch (ev->id) {
+	case TRACE_HOP:
+		printf("hop       %u MHz clkn=%u\n", ev->arg0, ev->arg1);
+		break;
+	case TRACE_HOP_DONE:
+		printf("hop done  %u MHz clkn=%u\n", ev->arg0, ev->arg1);
+		break;
+	case TRACE_DMA_TC:
+		printf("dma       %u bytes %u MHz\n", ev->arg0, ev->arg1);
+		break;
+	case TRACE_ENQUEUE:
+		printf("enqueue   type=%u depth=%u\n", ev->arg0, ev->arg1);
+		break;
+	case TRACE_DROP:
+		if (ev->arg0 < sizeof(drop_reasons) / sizeof(drop_reasons[0]))
+			printf("drop      %s", drop_reasons[ev->arg0]);
+		else
+			printf("drop      reason=%u", ev->arg0);
+		if (ev->arg1)
+			printf(" %u MHz", ev->arg1);
+		printf("\n");
+		break;
+	case TRACE_CONN_OPEN:
+		printf("conn open  AA=%08x event=%u\n", ev->arg1, ev->arg0);
+		break;
+	case TRACE_CONN_CLOSE:
+		printf("conn close AA=%08x packets=%u\n", ev->arg1, ev->arg0);
+		break;
+	case TRACE_CONN_SKIP:
+		printf("conn skip  AA=%08x event=%u\n", ev->arg1, ev->arg0);
+		break;
+	case TRACE_SCHED_FULL:
+		printf("sched full %u events, refused cb=%08x\n", ev->arg0, ev->arg1);
+		break;
+	default:
+		printf("event %u   arg0=%u arg1=%u\n", ev->id, ev->arg0, ev->arg1);
+		break;
+	}
+}
+
+/* Read pages until the ring is empty, returns < 0 on error */
+static int drain(ubertooth_t* ut)
+{
+	trace_page page;
+	int r, i;
+
+	do {
+		r = cmd_trace_read(ut->devh, &page);
+		if (r < 0)
+			return r;
+		if (page.lost)
+			printf("*** %u events lost\n", page.lost);
+		for (i = 0; i < r; i++)
+			print_event(&page.events[i]);
+	} while (r == TRACE_PAGE_EVENTS);
+
+	fflush(stdout);
+	return 0;
+}
+
+static void usage()
+{
+	printf("ubertooth-trace - read the firmware event trace\n");
+	printf("Usage:\n");
+	printf("\t-h this help\n");
+	printf("\t-e enable tracing (clears the trace buffer)\n");
+	printf("\t-d disable tracing\n");
+	printf("\t-f follow the trace until interrupted\n");
+	printf("\t-U <0-7|serial|path> set ubertooth device to use\n");
+	printf("\n");
+	printf("Without -e the events in the trace buffer are printed, oldest first.\n");
+	printf("Times are in microseconds since the first event printed.\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int opt, r;
+	int do_enable = 0, do_disable = 0, do_follow = 0;
+	int ubertooth_device = -1;
+	ubertooth_t* ut = NULL;
+
+	while ((opt=getopt(argc,argv,"hedfU:")) != EOF) {
+		switch(opt) {
+		case 'e':
+			do_enable = 1;
+			break;
+		case 'd':
+			do_disable = 1;
+			break;
+		case 'f':
+			do_follow = 1;
+			break;
+		case 'U':
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
+			break;
+		case 'h':
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if (do_enable && do_disable) {
+		fprintf(stderr, "-e and -d are mutually exclusive\n");
+		usage();
+		return 1;
+	}
+
+	ut = ubertooth_start(ubertooth_device);
+	if (ut == NULL) {
+		usage();
+		return 1;
+	}
+
+	r = ubertooth_check_api(ut);
+	if (r < 0)
+		return 1;
+
+	if (do_enable || do_disable) {
+		r = cmd_trace(ut->devh, do_enable);
+		if (r < 0)
+			goto out;
+	}
+
+	if (do_follow) {
+		register_cleanup_handler(ut, 0);
+		while (!ut->stop_ubertooth) {
+			r = drain(ut);
+			if (r < 0)
+				break;
+			usleep(10000);
+		}
+	} else if (!do_enable) {
+		r = drain(ut);
+	}
+
+out:
+	ubertooth_stop(ut);
+
+	return r < 0 ? 1 : 0;
+}
@@ -41,7 +41,7 @@ static void usage()
 	printf("\t-u <UAP> to transmit to (1 byte / 2 hex digits)\n");
 	printf("\t-t <SECONDS> timeout - 0 means no timeout [Default: 0]\n");
 	printf("\t-V print version information\n");
-	printf("\t-U <0-7> set ubertooth device to use\n");
+	printf("\t-U <0-7|serial|path> set ubertooth device to use\n");
 }
 
 int main(int argc, char* argv[])
@@ -67,7 +67,9 @@ int main(int argc, char* argv[])
 			have_uap++;
 			break;
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 't':
 			timeout = atoi(optarg);
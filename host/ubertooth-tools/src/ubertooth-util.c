@@ -43,7 +43,7 @@ static void usage(FILE *output)
 	fprintf(output, "\t-l[0-1] get/set USR LED\n");
 	fprintf(output, "\t-S stop current operation\n");
 	fprintf(output, "\t-r full reset\n");
-	fprintf(output, "\t-U<0-7> set ubertooth device to use\n");
+	fprintf(output, "\t-U<0-7|serial|path> set ubertooth device to use\n");
 	fprintf(output, "\t-N print total number of Uberteeth and exit\n");
 	fprintf(output, "\n");
 	fprintf(output, "Radio options:\n");
@@ -53,6 +53,8 @@ static void usage(FILE *output)
 	fprintf(output, "\t-q[1-225 (RSSI threshold)] start LED spectrum analyzer\n");
 	fprintf(output, "\t-t intitiate continuous transmit test\n");
 	fprintf(output, "\t-z set squelch level\n");
+	fprintf(output, "\t-y<0-40> set squelch hysteresis in dB\n");
+	fprintf(output, "\t-Y print per-channel noise floor and squelch statistics\n");
 	fprintf(output, "\n");
 	fprintf(output, "Range test:\n");
 	fprintf(output, "\t-e start repeater mode\n");
@@ -81,6 +83,7 @@ int main(int argc, char *argv[])
 	int do_range_test, do_repeater, do_firmware, do_board_id;
 	int do_range_result, do_all_leds, do_identify;
 	int do_set_squelch, do_get_squelch, squelch_level;
+	int do_squelch_hyst, do_squelch_stats;
 	int do_something, do_compile_info;
 	int do_number, do_xmas;
 	int ubertooth_device = -1;
@@ -94,13 +97,16 @@ int main(int argc, char *argv[])
 	do_range_test= do_repeater= do_firmware= do_board_id= -1;
 	do_range_result= do_all_leds= do_identify= -1;
 	do_set_squelch= -1, do_get_squelch= -1; squelch_level= 0;
+	do_squelch_hyst= -1; do_squelch_stats= -1;
 	do_something= 0; do_compile_info= -1;
 	do_number= 0; do_xmas= 0;
 
-	while ((opt=getopt(argc,argv,"U:hnmefiIprsStvbl::a::C::c::d::q::z::9VNx")) != EOF) {
+	while ((opt=getopt(argc,argv,"U:hnmefiIprsStvbl::a::C::c::d::q::z::y:Y9VNx")) != EOF) {
 		switch(opt) {
 		case 'U':
-			ubertooth_device = atoi(optarg);
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
 			break;
 		case 'f':
 			fprintf(stderr, "ubertooth-util -f is no longer required - use ubertooth-dfu instead\n");
@@ -187,6 +193,16 @@ int main(int argc, char *argv[])
 				do_get_squelch = 1;
 			}
 			break;
+		case 'y':
+			do_squelch_hyst = atoi(optarg);
+			if (do_squelch_hyst < 0 || do_squelch_hyst > 40) {
+				fprintf(stderr, "squelch hysteresis must be 0-40 dB\n");
+				return 1;
+			}
+			break;
+		case 'Y':
+			do_squelch_stats = 0;
+			break;
 		case '9':
 			do_something= 1;
 			break;
@@ -352,6 +368,34 @@ int main(int argc, char *argv[])
 		r = cmd_get_squelch(ut->devh);
 		fprintf(stdout, "Squelch set to %d\n", (int8_t)r);
 	}
+	if(do_squelch_hyst >= 0) {
+		fprintf(stdout, "Setting squelch hysteresis to %d dB\n", do_squelch_hyst);
+		r = cmd_set_squelch_hysteresis(ut->devh, do_squelch_hyst);
+	}
+	if(do_squelch_stats == 0) {
+		squelch_stats stats[SQUELCH_CHANNELS];
+		int i, n;
+
+		n = cmd_get_squelch_stats(ut->devh, stats);
+		if (n < 0)
+			return n;
+		fprintf(stdout, "channel  floor  gate      passed     dropped\n");
+		for (i = 0; i < n; i++) {
+			if (stats[i].passed == 0 && stats[i].dropped == 0)
+				continue;
+			if (i == SQUELCH_CHANNELS - 1)
+				fprintf(stdout, "  other");
+			else
+				fprintf(stdout, "%7d", 2402 + i);
+			if (stats[i].noise_floor == INT8_MIN)
+				fprintf(stdout, "      -");
+			else
+				fprintf(stdout, "%7d", stats[i].noise_floor);
+			fprintf(stdout, "  %-6s %10u  %10u\n",
+					stats[i].open ? "open" : "closed",
+					stats[i].passed, stats[i].dropped);
+		}
+	}
 	if(do_xmas) {
 		return cmd_xmas(ut->devh);
 	}
@@ -0,0 +1,487 @@
+/*
+ * Copyright 2026 Great Scott Gadgets
+ *
+ * This file is part of Project Ubertooth.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ubertooth.h"
+#include "ubertooth_daemon.h"
+
+/*
+ * ubertoothd owns one Ubertooth, runs a single capture mode on it and
+ * fans the packet stream out to any number of local clients over a
+ * Unix-domain socket.  See ubertooth_daemon.h for the client protocol.
+ *
+ * Every client gets its own bounded ring of records.  Capture never
+ * waits on a client: when a ring is full the new packet is dropped for
+ * that client only and counted.
+ *
+ * The capture is also published to a shared-memory packet ring.  A
+ * client that subscribes with UBERTOOTHD_FLAG_RING is sent the ring's
+ * fd and then reads packets straight out of it without any copying
+ * through the daemon.
+ */
+
+#define MAX_CLIENTS     32
+#define DEFAULT_BACKLOG 4096
+#define MAX_BACKLOG     65535
+#define RECORD_LEN      (4 + PKT_LEN)
+
+enum capture_modes {
+	MODE_RX,
+	MODE_BTLE,
+	MODE_PROMISC,
+	MODE_SPECAN
+};
+
+typedef struct {
+	int mode;
+	uint16_t channel;
+	uint16_t lower;
+	uint16_t upper;
+} capture_setup;
+
+typedef struct {
+	int fd;
+	int subscribed;
+	ubertoothd_filter filter;
+	size_t filter_len;
+
+	uint8_t* ring;
+	unsigned size;     // in records
+	unsigned head;     // next record to fill
+	unsigned tail;     // next record to send
+	unsigned count;
+	unsigned offset;   // bytes of the tail record already sent
+
+	uint64_t sent;
+	uint64_t dropped;
+} client_t;
+
+static client_t clients[MAX_CLIENTS];
+static int num_clients = 0;
+static unsigned default_backlog = DEFAULT_BACKLOG;
+static int ring_fd = -1;
+
+static void usage(FILE *file)
+{
+	fprintf(file, "ubertoothd - share one Ubertooth between many local clients\n");
+	fprintf(file, "Usage:\n");
+	fprintf(file, "\t-h this help\n");
+	fprintf(file, "\t-m <mode> capture mode: rx, btle, promisc or specan [default: rx]\n");
+	fprintf(file, "\t-c <MHz> channel for rx, btle and promisc modes\n");
+	fprintf(file, "\t\t[default: 2441 for rx, 2402 for btle]\n");
+	fprintf(file, "\t-l <MHz> specan lower frequency [default: 2402]\n");
+	fprintf(file, "\t-u <MHz> specan upper frequency [default: 2480]\n");
+	fprintf(file, "\t-s <path> listening socket [default: %s]\n", UBERTOOTHD_SOCKET);
+	fprintf(file, "\t-b <packets> default per-client buffer [default: %d]\n", DEFAULT_BACKLOG);
+	fprintf(file, "\t-r <packets> shared packet ring size, 0 to disable [default: %d]\n", UBERTOOTH_RING_DEFAULT);
+	fprintf(file, "\t-U <0-7|serial|path> set ubertooth device to use\n");
+}
+
+/* Start (or, after a USB reset, restart) the capture on the device */
+static int capture_start(ubertooth_t* ut, void* args)
+{
+	capture_setup* setup = (capture_setup*)args;
+
+	switch (setup->mode) {
+	case MODE_RX:
+		cmd_set_modulation(ut->devh, MOD_BT_BASIC_RATE);
+		cmd_set_channel(ut->devh, setup->channel);
+		return cmd_rx_syms(ut->devh);
+	case MODE_BTLE:
+		cmd_set_modulation(ut->devh, MOD_BT_LOW_ENERGY);
+		cmd_set_channel(ut->devh, setup->channel);
+		return cmd_btle_sniffing(ut->devh, 1);
+	case MODE_PROMISC:
+		cmd_set_modulation(ut->devh, MOD_BT_LOW_ENERGY);
+		cmd_set_channel(ut->devh, setup->channel);
+		return cmd_btle_promisc(ut->devh);
+	case MODE_SPECAN:
+		return cmd_specan(ut->devh, setup->lower, setup->upper);
+	}
+	return -1;
+}
+
+static int set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0)
+		return -1;
+	return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int listen_socket(const char* path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, MAX_CLIENTS) < 0 || set_nonblocking(fd) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void client_accept(int listen_fd)
+{
+	client_t* c;
+	int fd;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		return;
+	if (num_clients == MAX_CLIENTS || set_nonblocking(fd) < 0) {
+		fprintf(stderr, "Refusing client: too many clients\n");
+		close(fd);
+		return;
+	}
+
+	c = &clients[num_clients++];
+	memset(c, 0, sizeof(*c));
+	c->fd = fd;
+}
+
+static void client_close(int i)
+{
+	client_t* c = &clients[i];
+
+	if (c->subscribed)
+		fprintf(stderr, "Client %d disconnected: %llu packets sent, %llu dropped\n",
+		        c->fd, (unsigned long long)c->sent,
+		        (unsigned long long)c->dropped);
+	close(c->fd);
+	free(c->ring);
+	clients[i] = clients[--num_clients];
+}
+
+/* Hand the packet ring to a client, which is done with us afterwards */
+static void client_send_ring(client_t* c)
+{
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	struct iovec iov;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	char byte = 0;
+
+	if (ring_fd < 0) {
+		fprintf(stderr, "Client %d: no packet ring to share\n", c->fd);
+		return;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cbuf, 0, sizeof(cbuf));
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &ring_fd, sizeof(int));
+
+	if (sendmsg(c->fd, &msg, 0) < 0)
+		perror("sendmsg");
+	else
+		fprintf(stderr, "Client %d mapped the packet ring\n", c->fd);
+}
+
+/* Returns -1 when the client should be closed */
+static int client_read(client_t* c)
+{
+	uint8_t buf[64];
+	ssize_t n;
+
+	if (c->subscribed) {
+		// Nothing more is expected from a subscribed client
+		n = read(c->fd, buf, sizeof(buf));
+	} else {
+		n = read(c->fd, (uint8_t*)&c->filter + c->filter_len,
+		         sizeof(c->filter) - c->filter_len);
+	}
+	if (n == 0)
+		return -1;
+	if (n < 0)
+		return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+	if (c->subscribed)
+		return 0;
+
+	c->filter_len += n;
+	if (c->filter_len < sizeof(c->filter))
+		return 0;
+
+	if (c->filter.magic != UBERTOOTHD_MAGIC ||
+	    c->filter.version != UBERTOOTHD_VERSION) {
+		fprintf(stderr, "Client %d: bad subscription\n", c->fd);
+		return -1;
+	}
+	if (c->filter.flags & UBERTOOTHD_FLAG_RING) {
+		client_send_ring(c);
+		return -1;
+	}
+	c->size = c->filter.backlog ? c->filter.backlog : default_backlog;
+	c->ring = malloc(c->size * RECORD_LEN);
+	if (c->ring == NULL)
+		return -1;
+	c->subscribed = 1;
+	fprintf(stderr, "Client %d subscribed: types 0x%x, channels %u-%u, buffer %u\n",
+	        c->fd, c->filter.pkt_types, c->filter.channel_min,
+	        c->filter.channel_max, c->size);
+	return 0;
+}
+
+/* Returns -1 when the client should be closed */
+static int client_write(client_t* c)
+{
+	unsigned span;
+	ssize_t n;
+
+	while (c->count) {
+		// Send the contiguous run of records starting at the tail
+		span = (c->head > c->tail ? c->head : c->size) - c->tail;
+		n = write(c->fd, c->ring + c->tail * RECORD_LEN + c->offset,
+		          span * RECORD_LEN - c->offset);
+		if (n < 0)
+			return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+
+		n += c->offset;
+		c->offset = n % RECORD_LEN;
+		n /= RECORD_LEN;
+		c->tail = (c->tail + n) % c->size;
+		c->count -= n;
+		c->sent += n;
+		if (c->offset)
+			return 0;
+	}
+	return 0;
+}
+
+static void fan_out(const usb_pkt_rx* pkt)
+{
+	uint32_t time_be = htobe32((uint32_t)time(NULL));
+	uint8_t* rec;
+	int i;
+
+	for (i = 0; i < num_clients; i++) {
+		client_t* c = &clients[i];
+		if (!c->subscribed || !ubertoothd_filter_match(&c->filter, pkt))
+			continue;
+		if (c->count == c->size) {
+			c->dropped++;
+			continue;
+		}
+		rec = c->ring + c->head * RECORD_LEN;
+		memcpy(rec, &time_be, 4);
+		memcpy(rec + 4, pkt, PKT_LEN);
+		c->head = (c->head + 1) % c->size;
+		c->count++;
+	}
+}
+
+static void cb_fan_out(ubertooth_t* ut, void* args __attribute__((unused)))
+{
+	usb_pkt_rx usb = fifo_pop(ut->fifo);
+	fan_out(&usb);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd fds[MAX_CLIENTS + 1];
+	capture_setup setup = { MODE_RX, 0, 2402, 2480 };
+	const char* path = UBERTOOTHD_SOCKET;
+	int opt, r, i, listen_fd, ubertooth_device = -1;
+	int ring_slots = UBERTOOTH_RING_DEFAULT;
+	ubertooth_t* ut = NULL;
+
+	while ((opt=getopt(argc,argv,"hm:c:l:u:s:b:r:U:")) != EOF) {
+		switch(opt) {
+		case 'm':
+			if (strcmp(optarg, "rx") == 0)
+				setup.mode = MODE_RX;
+			else if (strcmp(optarg, "btle") == 0)
+				setup.mode = MODE_BTLE;
+			else if (strcmp(optarg, "promisc") == 0)
+				setup.mode = MODE_PROMISC;
+			else if (strcmp(optarg, "specan") == 0)
+				setup.mode = MODE_SPECAN;
+			else {
+				usage(stderr);
+				return 1;
+			}
+			break;
+		case 'c':
+			setup.channel = atoi(optarg);
+			break;
+		case 'l':
+			setup.lower = atoi(optarg);
+			break;
+		case 'u':
+			setup.upper = atoi(optarg);
+			break;
+		case 's':
+			path = optarg;
+			break;
+		case 'b':
+			default_backlog = atoi(optarg);
+			if (default_backlog < 1 || default_backlog > MAX_BACKLOG) {
+				usage(stderr);
+				return 1;
+			}
+			break;
+		case 'r':
+			ring_slots = atoi(optarg);
+			if (ring_slots < 0) {
+				usage(stderr);
+				return 1;
+			}
+			break;
+		case 'U':
+			ubertooth_device = ubertooth_select(optarg);
+			if (ubertooth_device < 0)
+				return 1;
+			break;
+		case 'h':
+			usage(stdout);
+			return 0;
+		default:
+			usage(stderr);
+			return 1;
+		}
+	}
+
+	if (setup.channel == 0)
+		setup.channel = (setup.mode == MODE_RX) ? 2441 : 2402;
+
+	ut = ubertooth_start(ubertooth_device);
+	if (ut == NULL) {
+		usage(stderr);
+		return 1;
+	}
+
+	r = ubertooth_check_api(ut);
+	if (r < 0)
+		return 1;
+
+	// The fifo still feeds the per-client buffers
+	if (ring_slots) {
+		if (ubertooth_ring_attach(ut, ring_slots, 0) < 0) {
+			ubertooth_stop(ut);
+			return 1;
+		}
+		ring_fd = ut->ring->fd;
+	}
+
+	listen_fd = listen_socket(path);
+	if (listen_fd < 0) {
+		ubertooth_stop(ut);
+		return 1;
+	}
+
+	/* A client going away must not kill the daemon */
+	signal(SIGPIPE, SIG_IGN);
+	register_cleanup_handler(ut, 0);
+
+	r = ubertooth_bulk_init(ut);
+	if (r < 0)
+		goto out;
+
+	// pthread_create() reports failure as a positive error number
+	if (ubertooth_bulk_thread_start() != 0) {
+		r = -1;
+		goto out;
+	}
+
+	r = capture_start(ut, &setup);
+	if (r < 0)
+		goto out_thread;
+	ubertooth_set_reattach(ut, capture_start, &setup);
+
+	fprintf(stderr, "Listening on %s\n", path);
+	while (!ut->stop_ubertooth) {
+		// Drain the capture first, clients only ever see a copy
+		while (ubertooth_bulk_receive(ut, cb_fan_out, NULL) == 0)
+			;
+
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < num_clients; i++) {
+			fds[i+1].fd = clients[i].fd;
+			fds[i+1].events = POLLIN | (clients[i].count ? POLLOUT : 0);
+			fds[i+1].revents = 0;
+		}
+
+		r = poll(fds, num_clients + 1, 1);
+		if (r <= 0)
+			continue;
+
+		// Walk backwards so that closing a client doesn't skip one
+		for (i = num_clients - 1; i >= 0; i--) {
+			short ev = fds[i+1].revents;
+			if (((ev & (POLLIN | POLLHUP | POLLERR)) && client_read(&clients[i]) < 0) ||
+			    ((ev & POLLOUT) && client_write(&clients[i]) < 0))
+				client_close(i);
+		}
+		if (fds[0].revents & POLLIN)
+			client_accept(listen_fd);
+	}
+
+	r = 0;
+
+out_thread:
+	ubertooth_bulk_thread_stop();
+out:
+	ubertooth_stop(ut);
+
+	while (num_clients)
+		client_close(num_clients - 1);
+	close(listen_fd);
+	unlink(path);
+	return (r < 0) ? 1 : 0;
+}